@@ -7,6 +7,7 @@
 #include <GroupView.h>
 #include "SettingsWindow.h"
 #include "Settings.h"
+#include "EncoderProfile.h"
 #include <Application.h>
 #include <LayoutBuilder.h>
 #include <StringView.h>
@@ -17,6 +18,8 @@
 #include <Directory.h>
 #include <FindDirectory.h>
 #include <CheckBox.h>
+#include <MenuField.h>
+#include <MenuItem.h>
 #include <stdio.h>
 
 
@@ -42,6 +45,15 @@ SettingsWindow::SettingsWindow(Settings* settings)
         fStartOnBoot->SetValue(B_CONTROL_ON);
     }
 
+    // Encoder Profile, in the order of kEncoderProfiles
+    fProfileMenu = new BPopUpMenu("Profile");
+    for (int32 i = 0; i < kEncoderProfileCount; i++) {
+        BMenuItem* item = new BMenuItem(kEncoderProfiles[i].label, NULL);
+        if (strcmp(kEncoderProfiles[i].name, fSettings->EncoderProfileName()) == 0) item->SetMarked(true);
+        fProfileMenu->AddItem(item);
+    }
+    BMenuField* profileField = new BMenuField("ProfileField", "Encoder profile:", fProfileMenu);
+
     // Certificate View
     fCertView = new BTextView("CertView");
     fCertView->MakeEditable(true);
@@ -66,6 +78,7 @@ SettingsWindow::SettingsWindow(Settings* settings)
         .SetInsets(B_USE_WINDOW_INSETS)
         .Add(fPortInput)
         .Add(fStartOnBoot)
+        .Add(profileField)
         .Add(new BStringView("Label", "SSL Certificate:"))
         .Add(certScroll)
         .Add(new BStringView("Label", "SSL Private Key:"))
@@ -100,6 +113,9 @@ void SettingsWindow::MessageReceived(BMessage* msg) {
         case MSG_APPLY_SETTINGS: {
             uint16 port = atoi(fPortInput->Text());
             if (port > 0) fSettings->SetPort(port);
+
+            int32 profile = fProfileMenu->IndexOf(fProfileMenu->FindMarked());
+            if (profile >= 0) fSettings->SetEncoderProfileName(kEncoderProfiles[profile].name);
             
             // Handle Start on Boot
             BPath bootPath;
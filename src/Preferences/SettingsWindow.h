@@ -10,6 +10,7 @@
 #include <TextView.h>
 #include <CheckBox.h>
 #include <Button.h>
+#include <PopUpMenu.h>
 
 class Settings;
 
@@ -25,6 +26,7 @@ private:
     Settings* fSettings;
     BTextControl* fPortInput;
     BCheckBox* fStartOnBoot;
+    BPopUpMenu* fProfileMenu;
     BTextView* fCertView;
     BTextView* fKeyView;
     BButton* fApplyButton;
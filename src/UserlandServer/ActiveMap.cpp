@@ -0,0 +1,50 @@
+/*
+ * ActiveMap.cpp
+ */
+#include "ActiveMap.h"
+#include <string.h>
+
+ActiveMap::ActiveMap()
+    : fColumns(0), fRows(0), fPeriod(1) {
+}
+
+status_t
+ActiveMap::Init(int32 width, int32 height, int32 period) {
+    if (width <= 0 || height <= 0 || period < 1 || period > 255) return B_BAD_VALUE;
+
+    fColumns = (width + kBlockSize - 1) / kBlockSize;
+    fRows = (height + kBlockSize - 1) / kBlockSize;
+    fPeriod = period;
+
+    // Nothing was coded yet, everything counts as changed
+    fAges.assign(fColumns * fRows, 0);
+    fMap.assign(fColumns * fRows, 1);
+    return B_OK;
+}
+
+bool
+ActiveMap::Update(const YUVFrame &frame) {
+    const int32 count = fColumns * fRows;
+    if (count == 0) return false;
+
+    if (frame.forceKeyframe || !frame.changedBlocks) {
+        memset(fAges.data(), 0, count);
+        return false;
+    }
+
+    int32 active = 0;
+    for (int32 i = 0; i < count; i++) {
+        if (frame.changedBlocks[i]) fAges[i] = 0;
+        fMap[i] = fAges[i] < fPeriod;
+        active += fMap[i];
+    }
+    return active < count;
+}
+
+void
+ActiveMap::Coded() {
+    const int32 count = fColumns * fRows;
+    for (int32 i = 0; i < count; i++) {
+        if (fAges[i] < 255) fAges[i]++;
+    }
+}
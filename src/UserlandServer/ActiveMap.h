@@ -0,0 +1,46 @@
+/*
+ * ActiveMap.h
+ * The blocks an encoder has to look at, from the blocks that changed
+ */
+#ifndef ACTIVE_MAP_H
+#define ACTIVE_MAP_H
+
+#include <SupportDefs.h>
+#include <vector>
+
+#include "EncoderBackend.h"
+
+class ActiveMap {
+public:
+    ActiveMap();
+
+    // period is how many frames back a frame may refer to, 1 without
+    // temporal layers. A changed block stays active until every frame that
+    // could still see its old contents has been coded.
+    status_t Init(int32 width, int32 height, int32 period);
+
+    int32 Columns() const { return fColumns; }
+    int32 Rows() const { return fRows; }
+
+    // Prepares the map for the frame about to be encoded. Returns false if
+    // every block has to be coded anyway: keyframes, frames without a
+    // changedBlocks map, or a change all over the picture.
+    bool Update(const YUVFrame &frame);
+
+    // 1 for the blocks the encoder has to look at, 0 for those it may skip
+    // as unchanged. Valid after Update() returned true.
+    const uint8 *Map() const { return fMap.data(); }
+
+    // The frame from the last Update() made it into the stream
+    void Coded();
+
+private:
+    int32 fColumns;
+    int32 fRows;
+    int32 fPeriod;
+
+    std::vector<uint8> fAges; // Coded frames since the block last changed
+    std::vector<uint8> fMap;
+};
+
+#endif // ACTIVE_MAP_H
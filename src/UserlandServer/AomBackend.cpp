@@ -0,0 +1,177 @@
+/*
+ * AomBackend.cpp
+ */
+#include "AomBackend.h"
+#include <aom/aomcx.h>
+#include <stdio.h>
+#include <string.h>
+
+// Quantizer cap of each refinement step, out of 63
+static const uint32 kRefineMaxQuantizer[kRefineSteps] = {32, 20, 12, 4};
+
+AomBackend::AomBackend()
+    : fFullChroma(false), fInitialized(false), fConfig(), fRefineStep(0), fRefineLossless(false), fFrameRate(30),
+      fActiveMapSet(false) {
+    memset(&fCodec, 0, sizeof(fCodec));
+    memset(&fImage, 0, sizeof(fImage));
+}
+
+AomBackend::~AomBackend() {
+    if (fInitialized) aom_codec_destroy(&fCodec);
+}
+
+status_t
+AomBackend::Init(int32 width, int32 height, int32 bitrateKbps, bool fullChroma, const EncoderProfile &profile) {
+    aom_codec_iface_t *iface = aom_codec_av1_cx();
+    fFullChroma = fullChroma;
+
+    if (const aom_codec_err_t res = aom_codec_enc_config_default(iface, &fConfig, AOM_USAGE_REALTIME)) {
+        fprintf(stderr, "Failed to get AV1 config: %s\n", aom_codec_err_to_string(res));
+        return B_ERROR;
+    }
+
+    fConfig.g_w = width;
+    fConfig.g_h = height;
+    fConfig.g_timebase.num = 1;
+    fConfig.g_timebase.den = kTimebase;
+    fConfig.g_threads = ThreadsFor(width, height);
+    fConfig.g_lag_in_frames = 0; // Low latency
+    if (fFullChroma) fConfig.g_profile = 1; // High: 8-bit 4:4:4
+
+    fConfig.rc_end_usage = AOM_CBR;
+    fConfig.rc_target_bitrate = bitrateKbps;
+    fConfig.rc_min_quantizer = kMinQuantizer;
+    fConfig.rc_max_quantizer = kMaxQuantizer;
+    fConfig.rc_undershoot_pct = 50;
+    fConfig.rc_overshoot_pct = 50;
+    fConfig.rc_buf_sz = 1000;
+    fConfig.rc_buf_initial_sz = 600;
+    fConfig.rc_buf_optimal_sz = 600;
+
+    fActiveMap.Init(width, height, 1);
+    fActiveMapSet = false;
+
+    if (aom_codec_enc_init(&fCodec, iface, &fConfig, MeasureQuality() ? AOM_CODEC_USE_PSNR : 0)) {
+        fprintf(stderr, "Failed to init AV1 codec: %s\n", aom_codec_error(&fCodec));
+        return B_ERROR;
+    }
+    fInitialized = true;
+
+    // Older libaom stops at speed 9 in realtime mode
+    if (aom_codec_control(&fCodec, AOME_SET_CPUUSED, profile.aomSpeed) != AOM_CODEC_OK)
+        aom_codec_control(&fCodec, AOME_SET_CPUUSED, 9);
+    aom_codec_control(&fCodec, AV1E_SET_ROW_MT, 1);
+    aom_codec_control(&fCodec, AV1E_SET_TILE_COLUMNS, TileColumnsFor(width, fConfig.g_threads));
+    aom_codec_control(&fCodec, AV1E_SET_AQ_MODE, 3); // Cyclic refresh
+    aom_codec_control(&fCodec, AV1E_SET_CDF_UPDATE_MODE, 1);
+
+    // Text and flat UI: palette mode, and intra block copy for repeated glyphs
+    aom_codec_control(&fCodec, AV1E_SET_TUNE_CONTENT, profile.screenContent ? AOM_CONTENT_SCREEN : AOM_CONTENT_DEFAULT);
+    aom_codec_control(&fCodec, AV1E_SET_ENABLE_PALETTE, profile.screenContent ? 1 : 0);
+    aom_codec_control(&fCodec, AV1E_SET_ENABLE_INTRABC, profile.screenContent ? 1 : 0);
+
+    // Tools that cost more time than they save bits on a desktop
+    aom_codec_control(&fCodec, AV1E_SET_DELTAQ_MODE, 0);
+    aom_codec_control(&fCodec, AV1E_SET_ENABLE_ORDER_HINT, 0);
+    aom_codec_control(&fCodec, AV1E_SET_ENABLE_TPL_MODEL, 0);
+    aom_codec_control(&fCodec, AV1E_SET_ENABLE_GLOBAL_MOTION, 0);
+    aom_codec_control(&fCodec, AV1E_SET_ENABLE_WARPED_MOTION, 0);
+    aom_codec_control(&fCodec, AV1E_SET_ENABLE_OBMC, 0);
+
+    return B_OK;
+}
+
+void
+AomBackend::SetBitrate(int32 kbps) {
+    if (!fInitialized) return;
+
+    fConfig.rc_target_bitrate = kbps;
+    if (const aom_codec_err_t res = aom_codec_enc_config_set(&fCodec, &fConfig)) {
+        fprintf(stderr, "Failed to update AV1 bitrate: %s\n", aom_codec_err_to_string(res));
+    }
+}
+
+// Same as VpxBackend: sizes above the first may not work with every libaom
+status_t
+AomBackend::Resize(int32 width, int32 height) {
+    if (!fInitialized) return B_NO_INIT;
+
+    aom_codec_enc_cfg_t config = fConfig;
+    config.g_w = width;
+    config.g_h = height;
+    if (aom_codec_enc_config_set(&fCodec, &config) != AOM_CODEC_OK) return B_NOT_SUPPORTED;
+    fConfig = config;
+
+    fActiveMap.Init(width, height, 1);
+    fActiveMapSet = true;
+    return B_OK;
+}
+
+status_t
+AomBackend::Encode(const YUVFrame &frame, EncodedFrame &out) {
+    out.spans = nullptr;
+    out.count = 0;
+    out.size = 0;
+    out.isKey = false;
+    out.layer = 0;
+    out.psnr = 0;
+    if (!fInitialized) return B_NO_INIT;
+
+    // Same as VpxBackend: keep the frame's padded chroma strides
+    if (!aom_img_wrap(&fImage, fFullChroma ? AOM_IMG_FMT_I444 : AOM_IMG_FMT_I420, fConfig.g_w, fConfig.g_h, 1,
+                      frame.planes.plane[0]))
+        return B_ERROR;
+    for (int32 i = 0; i < 3; i++) {
+        fImage.planes[AOM_PLANE_Y + i] = frame.planes.plane[i];
+        fImage.stride[AOM_PLANE_Y + i] = frame.planes.stride[i];
+    }
+
+    // Same as VpxBackend: refinement frames cap the quantizer, and a small
+    // last step is coded losslessly at quantizer 0
+    bool lossless = IsLosslessRefine(frame, fConfig.g_w, fConfig.g_h);
+    if (frame.refine != fRefineStep || lossless != fRefineLossless) {
+        fRefineStep = frame.refine;
+        fRefineLossless = lossless;
+        fConfig.rc_min_quantizer = lossless ? 0 : kMinQuantizer;
+        fConfig.rc_max_quantizer = fRefineStep > 0 ? kRefineMaxQuantizer[fRefineStep - 1] : kMaxQuantizer;
+        if (lossless) fConfig.rc_max_quantizer = 0;
+        if (const aom_codec_err_t res = aom_codec_enc_config_set(&fCodec, &fConfig)) {
+            fprintf(stderr, "Failed to set AV1 refinement quantizer: %s\n", aom_codec_err_to_string(res));
+        }
+        aom_codec_control(&fCodec, AV1E_SET_LOSSLESS, lossless ? 1 : 0);
+    }
+
+    // Same as VpxBackend: unchanged blocks are coded as skipped. libaom
+    // 3.6 takes the map but codes the frame the same without it.
+    bool skipBlocks = fActiveMap.Update(frame);
+    if (skipBlocks || fActiveMapSet) {
+        aom_active_map_t activeMap;
+        activeMap.active_map = skipBlocks ? (unsigned char *) fActiveMap.Map() : nullptr;
+        activeMap.rows = fActiveMap.Rows();
+        activeMap.cols = fActiveMap.Columns();
+        if (aom_codec_control(&fCodec, AOME_SET_ACTIVEMAP, &activeMap) == AOM_CODEC_OK) fActiveMapSet = skipBlocks;
+    }
+
+    unsigned long duration = fFrameRate > 0 && fFrameRate < kTimebase ? kTimebase / fFrameRate : 1;
+    if (aom_codec_encode(&fCodec, &fImage, frame.pts, duration, frame.forceKeyframe ? AOM_EFLAG_FORCE_KF : 0)
+        != AOM_CODEC_OK)
+        return B_ERROR;
+
+    fSpans.clear();
+    aom_codec_iter_t iter = nullptr;
+    const aom_codec_cx_pkt_t *pkt;
+    while ((pkt = aom_codec_get_cx_data(&fCodec, &iter)) != nullptr) {
+        if (pkt->kind == AOM_CODEC_PSNR_PKT) out.psnr = pkt->data.psnr.psnr[0];
+        if (pkt->kind != AOM_CODEC_CX_FRAME_PKT) continue;
+
+        EncodedSpan span = {(const uint8 *) pkt->data.frame.buf, pkt->data.frame.sz};
+        fSpans.push_back(span);
+        out.size += span.size;
+        if (pkt->data.frame.flags & AOM_FRAME_IS_KEY) out.isKey = true;
+    }
+    if (!fSpans.empty()) fActiveMap.Coded();
+
+    out.spans = fSpans.data();
+    out.count = (int32) fSpans.size();
+    return B_OK;
+}
@@ -0,0 +1,52 @@
+/*
+ * AomBackend.h
+ * AV1 through libaom, realtime mode with the screen content tools
+ */
+#ifndef AOM_BACKEND_H
+#define AOM_BACKEND_H
+
+#include <aom/aom_encoder.h>
+#include <vector>
+
+#include "ActiveMap.h"
+#include "EncoderBackend.h"
+
+class AomBackend : public EncoderBackend {
+public:
+    AomBackend();
+
+    virtual ~AomBackend();
+
+    virtual status_t Init(int32 width, int32 height, int32 bitrateKbps, bool fullChroma, const EncoderProfile &profile);
+
+    virtual YUVLayout Layout() const { return fFullChroma ? YUV_I444 : YUV_I420; }
+
+    virtual void SetBitrate(int32 kbps);
+
+    virtual void SetFrameRate(int32 fps) { fFrameRate = fps; }
+
+    virtual status_t Resize(int32 width, int32 height);
+
+    virtual status_t Encode(const YUVFrame &frame, EncodedFrame &out);
+
+private:
+    static const uint32 kMinQuantizer = 2;
+    static const uint32 kMaxQuantizer = 52;
+
+    bool fFullChroma;
+    bool fInitialized;
+
+    aom_codec_ctx_t fCodec;
+    aom_codec_enc_cfg_t fConfig;
+    int32 fRefineStep;
+    bool fRefineLossless;
+    int32 fFrameRate;
+    aom_image_t fImage; // Wraps the frame being encoded
+
+    std::vector<EncodedSpan> fSpans; // One per packet
+
+    ActiveMap fActiveMap;
+    bool fActiveMapSet; // The encoder holds on to it until told otherwise
+};
+
+#endif // AOM_BACKEND_H
@@ -0,0 +1,51 @@
+/*
+ * CaptureFile.h
+ * On-disk layout of recorded capture sessions (FrameRecorder / ReplaySource)
+ *
+ * CaptureFileHeader, then frameCount records of:
+ *   CaptureFrameHeader
+ *   tileCount x (CaptureTileHeader + tile pixels, B_RGB32, rows packed)
+ *
+ * Tiles are clipped at the right and bottom edges. Delta recordings only store
+ * the tiles that changed since the previous frame; the first frame always has
+ * every tile. All values are in host byte order.
+ */
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include <SupportDefs.h>
+
+// "HRDC" spelled out: the same value GCC gives the multi-character constant
+// 'HRDC', so existing recordings still open, without relying on
+// implementation-defined behavior. Stored as "CDRH" on little-endian hosts.
+#define CAPTURE_FILE_MAGIC (((uint32) 'H' << 24) | ((uint32) 'R' << 16) | ((uint32) 'D' << 8) | (uint32) 'C')
+#define CAPTURE_FILE_VERSION 1
+
+enum {
+    CAPTURE_FLAG_DELTA = 0x01
+};
+
+struct CaptureFileHeader {
+    uint32 magic;
+    uint32 version;
+    int32 width;
+    int32 height;
+    int32 tileSize;
+    uint32 flags;
+    uint32 frameCount;
+    uint32 reserved;
+    uint64 dataSize; // Bytes of frame records after this header
+};
+
+struct CaptureFrameHeader {
+    int64 timestamp; // us since the start of the recording
+    uint32 tileCount;
+    uint32 size; // Bytes of tile records after this header
+};
+
+struct CaptureTileHeader {
+    uint16 x; // Tile column / row
+    uint16 y;
+};
+
+#endif // CAPTURE_FILE_H
@@ -0,0 +1,92 @@
+/*
+ * ClientStream.h
+ * What one client is sent of the video: its tier, how many temporal layers
+ * of it, and whether it waits for a keyframe. Apart from the connection, so
+ * the rules hold the same for NetworkServer and its tests.
+ */
+#ifndef CLIENT_STREAM_H
+#define CLIENT_STREAM_H
+
+#include <SupportDefs.h>
+
+#include "StreamTiers.h"
+
+// Round trips above this are congestion: the client sheds a layer, or with
+// only the base left, its bitrate backs off by a fifth
+static const int32 kCongestedRoundTrip = 150;
+
+// Below this the link has room: layers come back first, then the bitrate
+// rises by 5%
+static const int32 kClearRoundTrip = 50;
+
+static const int32 kMinClientKbps = 300;
+static const int32 kMaxClientKbps = 8000;
+
+struct ClientStream {
+    int32 bitrate; // Estimated from its round trips, in kbps
+    int32 tier;    // Index into kStreamTiers
+    int32 layers;  // Temporal layers it is sent, from the base up
+    bool waitingForKeyframe;
+
+    // A new client: the initial bitrate's tier, every layer, nothing until a
+    // keyframe
+    void Start(int32 layerCount) {
+        bitrate = kInitialClientKbps;
+        tier = StreamTierFor(kInitialClientKbps, 0);
+        layers = layerCount;
+        waitingForKeyframe = true;
+    }
+
+    // A new bandwidth estimate. Returns true if it moved the client to
+    // another tier, where it waits for that tier's next keyframe.
+    bool SetBitrate(int32 kbps) {
+        bitrate = kbps;
+        int32 next = StreamTierFor(kbps, tier);
+        if (next == tier) return false;
+
+        tier = next;
+        waitingForKeyframe = true;
+        return true;
+    }
+
+    // Whether a frame of 'frameTier' goes to this client. frameTier < 0 is a
+    // control message, which every client gets.
+    bool Takes(int32 frameTier, bool isKey, int32 layer) const {
+        if (frameTier < 0) return true;
+        if (frameTier != tier) return false;
+        if (waitingForKeyframe && !isKey) return false;
+        return layer < layers;
+    }
+
+    // After a frame Takes() accepted was queued. Control messages don't end
+    // the wait for a keyframe.
+    void Queued(int32 frameTier, bool isKey) {
+        if (frameTier >= 0 && isKey) waitingForKeyframe = false;
+    }
+
+    // Layers and bitrate after a measured round trip, 'rtt' in ms. A
+    // congested client loses frame rate before sharpness, and stays in its
+    // tier longer.
+    void AfterRoundTrip(int32 rtt, int32 layerCount, int32 &nextLayers, int32 &nextKbps) const {
+        nextLayers = layers < layerCount ? layers : layerCount;
+        nextKbps = bitrate;
+
+        if (rtt > kCongestedRoundTrip) {
+            if (nextLayers > 1) {
+                nextLayers--;
+            } else {
+                nextKbps = (int32) (bitrate * 0.8);
+                if (nextKbps < kMinClientKbps) nextKbps = kMinClientKbps;
+            }
+        } else if (rtt >= 0 && rtt < kClearRoundTrip) {
+            if (nextLayers < layerCount) {
+                nextLayers++;
+            } else {
+                nextKbps = (int32) (bitrate * 1.05);
+                if (nextKbps > kMaxClientKbps) nextKbps = kMaxClientKbps;
+            }
+        }
+    }
+};
+
+#endif // CLIENT_STREAM_H
@@ -0,0 +1,191 @@
+/*
+ * ColorConvert.cpp
+ */
+#include "ColorConvert.h"
+#include "CpuFeatures.h"
+#include "WorkerPool.h"
+
+#define MIN_STRIPE_ROWS 16 // Below this, waking a worker costs more than it saves
+
+struct ConvertJob {
+    RowPairFunc rowPair;
+    const uint8 *rgb;
+    int32 stride;
+    int32 width;
+    int32 height;
+    YUVPlanes planes;
+    const clipping_rect *rects; // One part each
+};
+
+// BT.601 studio range, 8-bit fixed point
+static inline uint8
+Luma(int B, int G, int R) {
+    return ((66 * R + 129 * G + 25 * B + 128) >> 8) + 16;
+}
+
+static inline uint8
+ChromaU(int B, int G, int R) {
+    return ((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128;
+}
+
+static inline uint8
+ChromaV(int B, int G, int R) {
+    return ((112 * R - 94 * G - 18 * B + 128) >> 8) + 128;
+}
+
+template <YUVLayout kLayout>
+void
+ConvertRowPairScalar(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width) {
+    if (kLayout == YUV_I444) {
+        for (; x < width; x++) {
+            const uint8 *a = row0 + x * 4;
+            out.y[0][x] = Luma(a[0], a[1], a[2]);
+            out.u[0][x] = ChromaU(a[0], a[1], a[2]);
+            out.v[0][x] = ChromaV(a[0], a[1], a[2]);
+
+            if (out.y[1]) {
+                const uint8 *c = row1 + x * 4;
+                out.y[1][x] = Luma(c[0], c[1], c[2]);
+                out.u[1][x] = ChromaU(c[0], c[1], c[2]);
+                out.v[1][x] = ChromaV(c[0], c[1], c[2]);
+            }
+        }
+        return;
+    }
+
+    for (; x < width; x += 2) {
+        const uint8 *a = row0 + x * 4;
+        const uint8 *c = row1 + x * 4;
+
+        // Past the right edge of an odd width, the last column stands in
+        bool last = x + 1 == width;
+        const uint8 *b = last ? a : a + 4;
+        const uint8 *d = last ? c : c + 4;
+
+        out.y[0][x] = Luma(a[0], a[1], a[2]);
+        if (!last) out.y[0][x + 1] = Luma(b[0], b[1], b[2]);
+        if (out.y[1]) {
+            out.y[1][x] = Luma(c[0], c[1], c[2]);
+            if (!last) out.y[1][x + 1] = Luma(d[0], d[1], d[2]);
+        }
+
+        int B = (a[0] + b[0] + c[0] + d[0] + 2) >> 2;
+        int G = (a[1] + b[1] + c[1] + d[1] + 2) >> 2;
+        int R = (a[2] + b[2] + c[2] + d[2] + 2) >> 2;
+
+        if (kLayout == YUV_NV12) {
+            out.u[0][x] = ChromaU(B, G, R);
+            out.u[0][x + 1] = ChromaV(B, G, R);
+        } else {
+            out.u[0][x / 2] = ChromaU(B, G, R);
+            out.v[0][x / 2] = ChromaV(B, G, R);
+        }
+    }
+}
+
+template void ConvertRowPairScalar<YUV_I420>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairScalar<YUV_NV12>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairScalar<YUV_I444>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+
+static const RowPairFunc kScalarKernels[YUV_LAYOUT_COUNT] = {
+    ConvertRowPairScalar<YUV_I420>, ConvertRowPairScalar<YUV_NV12>, ConvertRowPairScalar<YUV_I444>};
+static const RowPairFunc kSSE41Kernels[YUV_LAYOUT_COUNT] = {
+    ConvertRowPairSSE41<YUV_I420>, ConvertRowPairSSE41<YUV_NV12>, ConvertRowPairSSE41<YUV_I444>};
+static const RowPairFunc kAVX2Kernels[YUV_LAYOUT_COUNT] = {
+    ConvertRowPairAVX2<YUV_I420>, ConvertRowPairAVX2<YUV_NV12>, ConvertRowPairAVX2<YUV_I444>};
+static const RowPairFunc kAVX512Kernels[YUV_LAYOUT_COUNT] = {
+    ConvertRowPairAVX512<YUV_I420>, ConvertRowPairAVX512<YUV_NV12>, ConvertRowPairAVX512<YUV_I444>};
+
+ColorConverter::ColorConverter()
+    : fKernels(kScalarKernels), fName("scalar") {
+    if (CpuFeatures::Has(CpuFeatures::AVX512BW)) {
+        fKernels = kAVX512Kernels;
+        fName = "AVX-512";
+    } else if (CpuFeatures::Has(CpuFeatures::AVX2)) {
+        fKernels = kAVX2Kernels;
+        fName = "AVX2";
+    } else if (CpuFeatures::Has(CpuFeatures::SSE41)) {
+        fKernels = kSSE41Kernels;
+        fName = "SSE4.1";
+    }
+}
+
+void
+ColorConverter::Convert(const uint8 *rgb, int32 stride, int32 width, int32 height, const YUVPlanes &planes,
+                        WorkerPool *workers) const {
+    clipping_rect stripes[WorkerPool::kMaxThreads * 2];
+    int32 count = 1;
+    int32 rows = height;
+
+    // Two stripes per thread, so one that got preempted doesn't hold up the frame.
+    // Stripes start on even rows, so none splits a chroma row.
+    if (workers && workers->CountThreads() > 1 && height >= MIN_STRIPE_ROWS * 2) {
+        count = workers->CountThreads() * 2;
+        rows = ((height + count - 1) / count + 1) & ~1;
+        if (rows < MIN_STRIPE_ROWS) rows = MIN_STRIPE_ROWS;
+        count = (height + rows - 1) / rows;
+    }
+
+    for (int32 i = 0; i < count; i++) {
+        stripes[i].left = 0;
+        stripes[i].top = i * rows;
+        stripes[i].right = width - 1;
+        stripes[i].bottom = i * rows + rows - 1;
+    }
+
+    ConvertRects(rgb, stride, width, height, planes, stripes, count, workers);
+}
+
+void
+ColorConverter::ConvertRects(const uint8 *rgb, int32 stride, int32 width, int32 height, const YUVPlanes &planes,
+                             const clipping_rect *rects, int32 count, WorkerPool *workers) const {
+    ConvertJob job = {fKernels[planes.layout], rgb, stride, width, height, planes, rects};
+
+    // A few small rects (a clock, a caret) are done before a worker would be awake
+    int64 pixels = 0;
+    for (int32 i = 0; i < count; i++)
+        pixels += (int64) (rects[i].right - rects[i].left + 1) * (rects[i].bottom - rects[i].top + 1);
+
+    if (!workers || workers->CountThreads() == 1 || count == 1 || pixels < (int64) width * MIN_STRIPE_ROWS * 2) {
+        for (int32 i = 0; i < count; i++) _ConvertPart(&job, i, count, 0);
+        return;
+    }
+
+    workers->Run(_ConvertPart, &job, count);
+}
+
+void
+ColorConverter::_ConvertPart(void *data, int32 part, int32 /* parts */, int32 /* thread */) {
+    const ConvertJob &job = *(const ConvertJob *) data;
+    const YUVPlanes &planes = job.planes;
+    const clipping_rect &rect = job.rects[part];
+
+    // Grow to whole chroma samples, clip to the frame
+    int32 left = rect.left < 0 ? 0 : rect.left & ~1;
+    int32 top = rect.top < 0 ? 0 : rect.top & ~1;
+    int32 end = rect.right + 1 < job.width ? (rect.right + 2) & ~1 : job.width;
+    int32 bottom = rect.bottom + 1 < job.height ? (rect.bottom + 2) & ~1 : job.height;
+
+    for (int32 y = top; y < bottom; y += 2) {
+        const uint8 *row0 = job.rgb + (size_t) y * job.stride;
+        bool pair = y + 1 < job.height;
+
+        YUVRowPair out;
+        out.y[0] = planes.plane[0] + (size_t) y * planes.stride[0];
+        out.y[1] = pair ? out.y[0] + planes.stride[0] : nullptr;
+
+        if (planes.layout == YUV_I444) {
+            out.u[0] = planes.plane[1] + (size_t) y * planes.stride[1];
+            out.v[0] = planes.plane[2] + (size_t) y * planes.stride[2];
+            out.u[1] = pair ? out.u[0] + planes.stride[1] : nullptr;
+            out.v[1] = pair ? out.v[0] + planes.stride[2] : nullptr;
+        } else {
+            out.u[0] = planes.plane[1] + (size_t) (y / 2) * planes.stride[1];
+            out.v[0] = planes.layout == YUV_NV12 ? nullptr : planes.plane[2] + (size_t) (y / 2) * planes.stride[2];
+            out.u[1] = nullptr;
+            out.v[1] = nullptr;
+        }
+
+        job.rowPair(row0, pair ? row0 + job.stride : row0, out, left, end);
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * ColorConvert.h
+ * B_RGB32 -> YUV conversion, one kernel per instruction set picked at runtime
+ */
+#ifndef COLOR_CONVERT_H
+#define COLOR_CONVERT_H
+
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+
+class WorkerPool;
+
+enum YUVLayout {
+    YUV_I420 = 0, // Three planes, chroma halved both ways
+    YUV_NV12,     // Luma plane and one plane of interleaved U, V pairs
+    YUV_I444,     // Three full size planes
+    YUV_LAYOUT_COUNT
+};
+
+// Where a converted frame goes. For NV12 plane[1] holds U and V, plane[2] is
+// unused.
+struct YUVPlanes {
+    YUVLayout layout;
+    uint8 *plane[3];
+    int32 stride[3];
+};
+
+// Output rows for one pair of input rows. Subsampled layouts only use index 0
+// of u and v (NV12: u[0] is the interleaved row). For the last row of an odd
+// height frame every index 1 pointer is nullptr.
+struct YUVRowPair {
+    uint8 *y[2];
+    uint8 *u[2];
+    uint8 *v[2];
+};
+
+// Converts pixels [x, width) of a pair of B_RGB32 rows. Subsampled chroma is
+// the average of each 2x2 block. x must be even. For the last row of an odd
+// height frame row1 is row0.
+typedef void (*RowPairFunc)(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width);
+
+// The kernels are specialized per output layout at compile time. Input is
+// always B_RGB32, PixelConverter takes care of the other framebuffer formats.
+
+// Reference implementation. The SIMD kernels match it bit for bit and call it
+// for the pixels left over at the end of a row.
+template <YUVLayout kLayout>
+void ConvertRowPairScalar(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width);
+
+// Each built with its own instruction set flags, only call them if the CPU
+// has that set (see CpuFeatures)
+template <YUVLayout kLayout>
+void ConvertRowPairSSE41(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width);
+template <YUVLayout kLayout>
+void ConvertRowPairAVX2(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width);
+template <YUVLayout kLayout>
+void ConvertRowPairAVX512(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width);
+
+class ColorConverter {
+public:
+    // Picks the fastest kernels the CPU supports
+    ColorConverter();
+
+    const char *KernelName() const { return fName; }
+
+    // With a pool, horizontal stripes of the frame are converted in parallel
+    void Convert(const uint8 *rgb, int32 stride, int32 width, int32 height, const YUVPlanes &planes,
+                 WorkerPool *workers = nullptr) const;
+
+    // Only converts the given rects and leaves the rest of the planes as they
+    // are. Each rect is grown to even bounds, so no chroma sample is left
+    // half updated. With a pool, rects are spread over its threads.
+    void ConvertRects(const uint8 *rgb, int32 stride, int32 width, int32 height, const YUVPlanes &planes,
+                      const clipping_rect *rects, int32 count, WorkerPool *workers = nullptr) const;
+
+private:
+    const RowPairFunc *fKernels; // One per layout
+    const char *fName;
+
+    static void _ConvertPart(void *data, int32 part, int32 parts, int32 thread);
+};
+
+#endif // COLOR_CONVERT_H
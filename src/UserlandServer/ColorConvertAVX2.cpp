@@ -0,0 +1,113 @@
+/*
+ * ColorConvertAVX2.cpp
+ * Built with -mavx2
+ */
+#include "ColorConvert.h"
+#include <immintrin.h> // AVX2
+
+// Packs and horizontal adds work within each 128-bit half, which leaves the
+// 64-bit quarters in 0, 2, 1, 3 order
+static inline __m256i
+Unscramble(__m256i v) {
+    return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// B, G and R of 16 pixels as 16-bit lanes
+static inline void
+LoadPixels(const uint8 *src, __m256i &b, __m256i &g, __m256i &r) {
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+    __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32));
+
+    b = _mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask));
+    g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+    r = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask));
+
+    b = Unscramble(b);
+    g = Unscramble(g);
+    r = Unscramble(r);
+}
+
+static inline __m256i
+Luma(__m256i b, __m256i g, __m256i r) {
+    __m256i y = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)),
+                                 _mm256_mullo_epi16(g, _mm256_set1_epi16(129)));
+    y = _mm256_add_epi16(y, _mm256_mullo_epi16(b, _mm256_set1_epi16(25)));
+    y = _mm256_srli_epi16(_mm256_add_epi16(y, _mm256_set1_epi16(128)), 8);
+    return _mm256_add_epi16(y, _mm256_set1_epi16(16));
+}
+
+static inline __m256i
+Chroma(__m256i b, __m256i g, __m256i r, short kb, short kg, short kr) {
+    __m256i c = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(kr)),
+                                 _mm256_mullo_epi16(g, _mm256_set1_epi16(kg)));
+    c = _mm256_add_epi16(c, _mm256_mullo_epi16(b, _mm256_set1_epi16(kb)));
+    c = _mm256_srai_epi16(_mm256_add_epi16(c, _mm256_set1_epi16(128)), 8);
+    return _mm256_add_epi16(c, _mm256_set1_epi16(128));
+}
+
+static inline __m256i
+Average(__m256i lo, __m256i hi) {
+    __m256i sum = Unscramble(_mm256_hadd_epi16(lo, hi));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+// 16 lanes -> 16 bytes
+static inline __m128i
+Pack(__m256i v) {
+    return _mm256_castsi256_si128(Unscramble(_mm256_packus_epi16(v, v)));
+}
+
+// 32 lanes -> 32 bytes
+static inline void
+Store(uint8 *dst, __m256i lo, __m256i hi) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), Unscramble(_mm256_packus_epi16(lo, hi)));
+}
+
+// 32 pixels of each row per iteration
+template <YUVLayout kLayout>
+void
+ConvertRowPairAVX2(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width) {
+    for (; x + 32 <= width; x += 32) {
+        __m256i b0, g0, r0, b1, g1, r1, b2, g2, r2, b3, g3, r3;
+        LoadPixels(row0 + x * 4, b0, g0, r0);
+        LoadPixels(row0 + x * 4 + 64, b1, g1, r1);
+        LoadPixels(row1 + x * 4, b2, g2, r2);
+        LoadPixels(row1 + x * 4 + 64, b3, g3, r3);
+
+        Store(out.y[0] + x, Luma(b0, g0, r0), Luma(b1, g1, r1));
+        if (out.y[1]) Store(out.y[1] + x, Luma(b2, g2, r2), Luma(b3, g3, r3));
+
+        if (kLayout == YUV_I444) {
+            Store(out.u[0] + x, Chroma(b0, g0, r0, 112, -74, -38), Chroma(b1, g1, r1, 112, -74, -38));
+            Store(out.v[0] + x, Chroma(b0, g0, r0, -18, -94, 112), Chroma(b1, g1, r1, -18, -94, 112));
+            if (out.y[1]) {
+                Store(out.u[1] + x, Chroma(b2, g2, r2, 112, -74, -38), Chroma(b3, g3, r3, 112, -74, -38));
+                Store(out.v[1] + x, Chroma(b2, g2, r2, -18, -94, 112), Chroma(b3, g3, r3, -18, -94, 112));
+            }
+            continue;
+        }
+
+        __m256i b = Average(_mm256_add_epi16(b0, b2), _mm256_add_epi16(b1, b3));
+        __m256i g = Average(_mm256_add_epi16(g0, g2), _mm256_add_epi16(g1, g3));
+        __m256i r = Average(_mm256_add_epi16(r0, r2), _mm256_add_epi16(r1, r3));
+
+        __m256i cu = Chroma(b, g, r, 112, -74, -38);
+        __m256i cv = Chroma(b, g, r, -18, -94, 112);
+        if (kLayout == YUV_NV12) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.u[0] + x),
+                                _mm256_or_si256(cu, _mm256_slli_epi16(cv, 8)));
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out.u[0] + x / 2), Pack(cu));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out.v[0] + x / 2), Pack(cv));
+        }
+    }
+
+    ConvertRowPairScalar<kLayout>(row0, row1, out, x, width);
+}
+
+template void ConvertRowPairAVX2<YUV_I420>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairAVX2<YUV_NV12>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairAVX2<YUV_I444>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
@@ -0,0 +1,110 @@
+/*
+ * ColorConvertAVX512.cpp
+ * Built with -mavx512f -mavx512bw
+ */
+#include "ColorConvert.h"
+#include <immintrin.h> // AVX-512F, AVX-512BW
+
+// vpmovdw narrows in order, no lane crossing to undo
+static inline __m512i
+Narrow(__m512i lo, __m512i hi) {
+    return _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi32_epi16(lo)), _mm512_cvtepi32_epi16(hi), 1);
+}
+
+// B, G and R of 32 pixels as 16-bit lanes
+static inline void
+LoadPixels(const uint8 *src, __m512i &b, __m512i &g, __m512i &r) {
+    const __m512i mask = _mm512_set1_epi32(0xFF);
+    __m512i p0 = _mm512_loadu_si512(src);
+    __m512i p1 = _mm512_loadu_si512(src + 64);
+
+    b = Narrow(_mm512_and_si512(p0, mask), _mm512_and_si512(p1, mask));
+    g = Narrow(_mm512_and_si512(_mm512_srli_epi32(p0, 8), mask), _mm512_and_si512(_mm512_srli_epi32(p1, 8), mask));
+    r = Narrow(_mm512_and_si512(_mm512_srli_epi32(p0, 16), mask),
+               _mm512_and_si512(_mm512_srli_epi32(p1, 16), mask));
+}
+
+static inline __m512i
+Luma(__m512i b, __m512i g, __m512i r) {
+    __m512i y = _mm512_add_epi16(_mm512_mullo_epi16(r, _mm512_set1_epi16(66)),
+                                 _mm512_mullo_epi16(g, _mm512_set1_epi16(129)));
+    y = _mm512_add_epi16(y, _mm512_mullo_epi16(b, _mm512_set1_epi16(25)));
+    y = _mm512_srli_epi16(_mm512_add_epi16(y, _mm512_set1_epi16(128)), 8);
+    return _mm512_add_epi16(y, _mm512_set1_epi16(16));
+}
+
+static inline __m512i
+Chroma(__m512i b, __m512i g, __m512i r, short kb, short kg, short kr) {
+    __m512i c = _mm512_add_epi16(_mm512_mullo_epi16(r, _mm512_set1_epi16(kr)),
+                                 _mm512_mullo_epi16(g, _mm512_set1_epi16(kg)));
+    c = _mm512_add_epi16(c, _mm512_mullo_epi16(b, _mm512_set1_epi16(kb)));
+    c = _mm512_srai_epi16(_mm512_add_epi16(c, _mm512_set1_epi16(128)), 8);
+    return _mm512_add_epi16(c, _mm512_set1_epi16(128));
+}
+
+// Neighbouring lanes summed by vpmaddwd, then narrowed back
+static inline __m512i
+Average(__m512i lo, __m512i hi) {
+    const __m512i ones = _mm512_set1_epi16(1);
+    __m512i sum = Narrow(_mm512_madd_epi16(lo, ones), _mm512_madd_epi16(hi, ones));
+    return _mm512_srli_epi16(_mm512_add_epi16(sum, _mm512_set1_epi16(2)), 2);
+}
+
+// Every value is already within 0..255, so truncating equals saturating
+static inline void
+Store(uint8 *dst, __m512i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm512_cvtepi16_epi8(v));
+}
+
+// 64 pixels of each row per iteration
+template <YUVLayout kLayout>
+void
+ConvertRowPairAVX512(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width) {
+    for (; x + 64 <= width; x += 64) {
+        __m512i b0, g0, r0, b1, g1, r1, b2, g2, r2, b3, g3, r3;
+        LoadPixels(row0 + x * 4, b0, g0, r0);
+        LoadPixels(row0 + x * 4 + 128, b1, g1, r1);
+        LoadPixels(row1 + x * 4, b2, g2, r2);
+        LoadPixels(row1 + x * 4 + 128, b3, g3, r3);
+
+        Store(out.y[0] + x, Luma(b0, g0, r0));
+        Store(out.y[0] + x + 32, Luma(b1, g1, r1));
+        if (out.y[1]) {
+            Store(out.y[1] + x, Luma(b2, g2, r2));
+            Store(out.y[1] + x + 32, Luma(b3, g3, r3));
+        }
+
+        if (kLayout == YUV_I444) {
+            Store(out.u[0] + x, Chroma(b0, g0, r0, 112, -74, -38));
+            Store(out.u[0] + x + 32, Chroma(b1, g1, r1, 112, -74, -38));
+            Store(out.v[0] + x, Chroma(b0, g0, r0, -18, -94, 112));
+            Store(out.v[0] + x + 32, Chroma(b1, g1, r1, -18, -94, 112));
+            if (out.y[1]) {
+                Store(out.u[1] + x, Chroma(b2, g2, r2, 112, -74, -38));
+                Store(out.u[1] + x + 32, Chroma(b3, g3, r3, 112, -74, -38));
+                Store(out.v[1] + x, Chroma(b2, g2, r2, -18, -94, 112));
+                Store(out.v[1] + x + 32, Chroma(b3, g3, r3, -18, -94, 112));
+            }
+            continue;
+        }
+
+        __m512i b = Average(_mm512_add_epi16(b0, b2), _mm512_add_epi16(b1, b3));
+        __m512i g = Average(_mm512_add_epi16(g0, g2), _mm512_add_epi16(g1, g3));
+        __m512i r = Average(_mm512_add_epi16(r0, r2), _mm512_add_epi16(r1, r3));
+
+        __m512i cu = Chroma(b, g, r, 112, -74, -38);
+        __m512i cv = Chroma(b, g, r, -18, -94, 112);
+        if (kLayout == YUV_NV12) {
+            _mm512_storeu_si512(out.u[0] + x, _mm512_or_si512(cu, _mm512_slli_epi16(cv, 8)));
+        } else {
+            Store(out.u[0] + x / 2, cu);
+            Store(out.v[0] + x / 2, cv);
+        }
+    }
+
+    ConvertRowPairScalar<kLayout>(row0, row1, out, x, width);
+}
+
+template void ConvertRowPairAVX512<YUV_I420>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairAVX512<YUV_NV12>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairAVX512<YUV_I444>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
@@ -0,0 +1,100 @@
+/*
+ * ColorConvertSSE41.cpp
+ * Built with -msse4.1
+ */
+#include "ColorConvert.h"
+#include <smmintrin.h> // SSE4.1
+
+// B, G and R of 8 pixels as 16-bit lanes
+static inline void
+LoadPixels(const uint8 *src, __m128i &b, __m128i &g, __m128i &r) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+
+    b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+// The sum reaches 56228 and wraps as a signed lane, the logical shift still
+// reads it right
+static inline __m128i
+Luma(__m128i b, __m128i g, __m128i r) {
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    y = _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(128)), 8);
+    return _mm_add_epi16(y, _mm_set1_epi16(16));
+}
+
+static inline __m128i
+Chroma(__m128i b, __m128i g, __m128i r, short kb, short kg, short kr) {
+    __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kr)), _mm_mullo_epi16(g, _mm_set1_epi16(kg)));
+    c = _mm_add_epi16(c, _mm_mullo_epi16(b, _mm_set1_epi16(kb)));
+    c = _mm_srai_epi16(_mm_add_epi16(c, _mm_set1_epi16(128)), 8);
+    return _mm_add_epi16(c, _mm_set1_epi16(128));
+}
+
+// Averages 2x2 blocks: lo and hi hold 8 pixels each of both rows already added
+static inline __m128i
+Average(__m128i lo, __m128i hi) {
+    __m128i sum = _mm_hadd_epi16(lo, hi);
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+// 16 pixels of each row per iteration
+template <YUVLayout kLayout>
+void
+ConvertRowPairSSE41(const uint8 *row0, const uint8 *row1, const YUVRowPair &out, int32 x, int32 width) {
+    for (; x + 16 <= width; x += 16) {
+        __m128i b0, g0, r0, b1, g1, r1, b2, g2, r2, b3, g3, r3;
+        LoadPixels(row0 + x * 4, b0, g0, r0);
+        LoadPixels(row0 + x * 4 + 32, b1, g1, r1);
+        LoadPixels(row1 + x * 4, b2, g2, r2);
+        LoadPixels(row1 + x * 4 + 32, b3, g3, r3);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.y[0] + x),
+                         _mm_packus_epi16(Luma(b0, g0, r0), Luma(b1, g1, r1)));
+        if (out.y[1]) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out.y[1] + x),
+                             _mm_packus_epi16(Luma(b2, g2, r2), Luma(b3, g3, r3)));
+        }
+
+        if (kLayout == YUV_I444) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out.u[0] + x),
+                             _mm_packus_epi16(Chroma(b0, g0, r0, 112, -74, -38), Chroma(b1, g1, r1, 112, -74, -38)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out.v[0] + x),
+                             _mm_packus_epi16(Chroma(b0, g0, r0, -18, -94, 112), Chroma(b1, g1, r1, -18, -94, 112)));
+            if (out.y[1]) {
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(out.u[1] + x),
+                    _mm_packus_epi16(Chroma(b2, g2, r2, 112, -74, -38), Chroma(b3, g3, r3, 112, -74, -38)));
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(out.v[1] + x),
+                    _mm_packus_epi16(Chroma(b2, g2, r2, -18, -94, 112), Chroma(b3, g3, r3, -18, -94, 112)));
+            }
+            continue;
+        }
+
+        __m128i b = Average(_mm_add_epi16(b0, b2), _mm_add_epi16(b1, b3));
+        __m128i g = Average(_mm_add_epi16(g0, g2), _mm_add_epi16(g1, g3));
+        __m128i r = Average(_mm_add_epi16(r0, r2), _mm_add_epi16(r1, r3));
+
+        __m128i cu = Chroma(b, g, r, 112, -74, -38);
+        __m128i cv = Chroma(b, g, r, -18, -94, 112);
+        if (kLayout == YUV_NV12) {
+            // Both fit a byte, so V goes in the high half of each U lane
+            __m128i uv = _mm_or_si128(cu, _mm_slli_epi16(cv, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out.u[0] + x), uv);
+        } else {
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out.u[0] + x / 2), _mm_packus_epi16(cu, cu));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out.v[0] + x / 2), _mm_packus_epi16(cv, cv));
+        }
+    }
+
+    ConvertRowPairScalar<kLayout>(row0, row1, out, x, width);
+}
+
+template void ConvertRowPairSSE41<YUV_I420>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairSSE41<YUV_NV12>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
+template void ConvertRowPairSSE41<YUV_I444>(const uint8 *, const uint8 *, const YUVRowPair &, int32, int32);
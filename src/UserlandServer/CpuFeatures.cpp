@@ -0,0 +1,43 @@
+/*
+ * CpuFeatures.cpp
+ */
+#include "CpuFeatures.h"
+#include <cpuid.h>
+
+#define XCR0_AVX_STATE 0x06    // SSE and AVX registers
+#define XCR0_AVX512_STATE 0xE6 // ... plus the opmask and upper ZMM registers
+
+uint32
+CpuFeatures::Get() {
+    static const uint32 features = _Detect();
+    return features;
+}
+
+uint32
+CpuFeatures::_Detect() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+
+    uint32 features = 0;
+    if (ecx & bit_SSSE3) features |= SSSE3;
+    if (ecx & bit_SSE4_1) features |= SSE41;
+
+    // xgetbv only exists if the OS turned on XSAVE
+    uint64 xcr0 = 0;
+    if (ecx & bit_OSXSAVE) {
+        uint32 low, high;
+        __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        xcr0 = ((uint64) high << 32) | low;
+    }
+
+    bool avx = (ecx & bit_AVX) && (xcr0 & XCR0_AVX_STATE) == XCR0_AVX_STATE;
+    bool avx512 = avx && (xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE;
+
+    if (__get_cpuid_max(0, nullptr) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if (avx && (ebx & bit_AVX2)) features |= AVX2;
+        if (avx512 && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW)) features |= AVX512BW;
+    }
+
+    return features;
+}
@@ -0,0 +1,29 @@
+/*
+ * CpuFeatures.h
+ * Instruction set extensions of the running CPU, for picking SIMD kernels
+ */
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <SupportDefs.h>
+
+class CpuFeatures {
+public:
+    enum {
+        SSSE3 = 1 << 0,
+        SSE41 = 1 << 1,
+        AVX2 = 1 << 2,
+        AVX512BW = 1 << 3 // With AVX-512F
+    };
+
+    // Detected on first use. The AVX levels are only reported if the OS also
+    // saves the wider registers.
+    static uint32 Get();
+
+    static bool Has(uint32 features) { return (Get() & features) == features; }
+
+private:
+    static uint32 _Detect();
+};
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,137 @@
+/*
+ * DamageTracker.cpp
+ */
+#include "DamageTracker.h"
+#include <string.h>
+
+// FNV-1a constants for HashMixLanes()
+static const uint32 kHashPrime = 0x01000193;
+static const uint32 kHashSeed = 0x811C9DC5;
+
+DamageTracker::DamageTracker()
+    : fWidth(0), fHeight(0), fTilesX(0), fTilesY(0), fDirtyCount(0), fPrimed(false) {
+}
+
+DamageTracker::~DamageTracker() {
+}
+
+status_t
+DamageTracker::Init(int32 width, int32 height) {
+    if (width <= 0 || height <= 0) return B_BAD_VALUE;
+
+    fWidth = width;
+    fHeight = height;
+    fTilesX = (width + kTileSize - 1) / kTileSize;
+    fTilesY = (height + kTileSize - 1) / kTileSize;
+
+    fHashes.assign(fTilesX * fTilesY, 0);
+    fDirty.assign(fTilesX * fTilesY, 1);
+    fAccumulators.resize(fTilesX);
+
+    fDirtyCount = fTilesX * fTilesY;
+    fPrimed = false;
+    return B_OK;
+}
+
+int32
+DamageTracker::Update(const uint8 *bits, int32 stride) {
+    if (!bits || fTilesX == 0) return 0;
+
+    fDirtyCount = 0;
+    _ResetAccumulators();
+
+    // Walk the frame row by row (sequential reads), feeding each tile column's
+    // slice of the row into that column's accumulators.
+    for (int32 y = 0; y < fHeight; y++) {
+        const uint8 *rowPtr = bits + y * stride;
+
+        for (int32 tx = 0; tx < fTilesX; tx++) {
+            int32 x0 = tx * kTileSize;
+            int32 x1 = x0 + kTileSize;
+            if (x1 > fWidth) x1 = fWidth;
+
+            _HashRowSegment(fAccumulators[tx].lanes, rowPtr + x0 * 4, (x1 - x0) * 4);
+        }
+
+        // End of a tile row: fold, compare and start over
+        if ((y + 1) % kTileSize == 0 || y == fHeight - 1) {
+            int32 ty = y / kTileSize;
+            for (int32 tx = 0; tx < fTilesX; tx++) {
+                int32 index = ty * fTilesX + tx;
+                uint64 hash = _FoldAccumulators(fAccumulators[tx].lanes);
+
+                bool dirty = !fPrimed || hash != fHashes[index];
+                fHashes[index] = hash;
+                fDirty[index] = dirty ? 1 : 0;
+                if (dirty) fDirtyCount++;
+            }
+            _ResetAccumulators();
+        }
+    }
+
+    fPrimed = true;
+    return fDirtyCount;
+}
+
+void
+DamageTracker::_ResetAccumulators() {
+    const __m128i kSeed = _mm_setr_epi32(kHashSeed, kHashSeed + 1, kHashSeed + 2, kHashSeed + 3);
+    for (size_t i = 0; i < fAccumulators.size(); i++) {
+        for (int32 lane = 0; lane < kLanes; lane++) fAccumulators[i].lanes[lane] = kSeed;
+    }
+}
+
+void
+DamageTracker::_HashRowSegment(__m128i *acc, const uint8 *src, int32 bytes) {
+    const __m128i kPrime = _mm_set1_epi32(kHashPrime);
+
+    __m128i a0 = acc[0];
+    __m128i a1 = acc[1];
+    __m128i a2 = acc[2];
+    __m128i a3 = acc[3];
+
+    int32 i = 0;
+    // 64 bytes (16 pixels) per iteration, one 16-byte chunk per lane
+    for (; i + 64 <= bytes; i += 64) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32));
+        __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 48));
+
+        a0 = HashMixLanes(a0, v0, kPrime);
+        a1 = HashMixLanes(a1, v1, kPrime);
+        a2 = HashMixLanes(a2, v2, kPrime);
+        a3 = HashMixLanes(a3, v3, kPrime);
+    }
+
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        a0 = HashMixLanes(a0, v, kPrime);
+    }
+
+    // Partial edge tile: remaining pixels one at a time
+    for (; i < bytes; i += 4) {
+        uint32 pixel;
+        memcpy(&pixel, src + i, 4);
+        a1 = HashMixLanes(a1, _mm_cvtsi32_si128(pixel), kPrime);
+    }
+
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+}
+
+uint64
+DamageTracker::_FoldAccumulators(const __m128i *acc) {
+    // Rotate lanes between accumulators so identical data in different lanes
+    // does not cancel out
+    __m128i h = acc[0];
+    h = _mm_xor_si128(_mm_shuffle_epi32(h, _MM_SHUFFLE(0, 3, 2, 1)), acc[1]);
+    h = _mm_xor_si128(_mm_shuffle_epi32(h, _MM_SHUFFLE(0, 3, 2, 1)), acc[2]);
+    h = _mm_xor_si128(_mm_shuffle_epi32(h, _MM_SHUFFLE(0, 3, 2, 1)), acc[3]);
+
+    uint64 lo = (uint64) _mm_cvtsi128_si64(h);
+    uint64 hi = (uint64) _mm_cvtsi128_si64(_mm_unpackhi_epi64(h, h));
+    return lo ^ (hi * 0x9E3779B97F4A7C15ULL);
+}
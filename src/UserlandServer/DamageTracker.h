@@ -0,0 +1,79 @@
+/*
+ * DamageTracker.h
+ * Tile-based change detection between consecutive frames
+ */
+#ifndef DAMAGE_TRACKER_H
+#define DAMAGE_TRACKER_H
+
+#include <SupportDefs.h>
+#include <emmintrin.h> // SSE2
+#include <vector>
+
+// FNV-1a style mixing on four 32-bit lanes at once, shared with ScrollDetector.
+// The multiply spreads changes upwards, the shift feeds high bits back down.
+// pmulld is SSE4.1, so the low halves of the products come from two pmuludq.
+static inline __m128i
+HashMixLanes(__m128i acc, __m128i value, __m128i prime) {
+    acc = _mm_xor_si128(acc, value);
+    __m128i even = _mm_mul_epu32(acc, prime);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(acc, 32), _mm_srli_epi64(prime, 32));
+    acc = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                             _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    return _mm_xor_si128(acc, _mm_srli_epi32(acc, 15));
+}
+
+class DamageTracker {
+public:
+    static const int32 kTileSize = 64;
+
+    DamageTracker();
+
+    ~DamageTracker();
+
+    // (Re)allocates the tile grid for a frame size. All tiles start dirty.
+    status_t Init(int32 width, int32 height);
+
+    // Hashes every tile of a B_RGB32 frame and compares it with the previous one.
+    // Returns the number of tiles that changed (all of them on the first call).
+    int32 Update(const uint8 *bits, int32 stride);
+
+    // Forces the next Update() to report every tile as dirty
+    void Invalidate() { fPrimed = false; }
+
+    int32 TilesX() const { return fTilesX; }
+    int32 TilesY() const { return fTilesY; }
+    int32 DirtyCount() const { return fDirtyCount; }
+
+    bool IsDirty(int32 tileX, int32 tileY) const { return fDirty[tileY * fTilesX + tileX] != 0; }
+
+    // One byte per tile, row-major, non-zero if the tile changed in the last Update()
+    const uint8 *DirtyMap() const { return fDirty.data(); }
+
+private:
+    // Independent hash lanes per tile column, to keep the multiply chains short
+    static const int32 kLanes = 4;
+
+    struct TileAccumulator {
+        __m128i lanes[kLanes];
+    };
+
+    int32 fWidth;
+    int32 fHeight;
+    int32 fTilesX;
+    int32 fTilesY;
+
+    std::vector<uint64> fHashes;
+    std::vector<uint8> fDirty;
+    std::vector<TileAccumulator> fAccumulators;
+
+    int32 fDirtyCount;
+    bool fPrimed;
+
+    void _ResetAccumulators();
+
+    void _HashRowSegment(__m128i *acc, const uint8 *src, int32 bytes);
+
+    static uint64 _FoldAccumulators(const __m128i *acc);
+};
+
+#endif // DAMAGE_TRACKER_H
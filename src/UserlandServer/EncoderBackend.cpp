@@ -0,0 +1,116 @@
+/*
+ * EncoderBackend.cpp
+ */
+#include "EncoderBackend.h"
+#include <OS.h>
+#include <string.h>
+
+#include "VpxBackend.h"
+#include "X264Backend.h"
+#ifdef HAVE_AOM
+#include "AomBackend.h"
+#endif
+
+static EncoderBackend *
+CreateVP8() {
+    return new VpxBackend(false);
+}
+
+static EncoderBackend *
+CreateVP9() {
+    return new VpxBackend(true);
+}
+
+static EncoderBackend *
+CreateH264() {
+    return new X264Backend();
+}
+
+#ifdef HAVE_AOM
+static EncoderBackend *
+CreateAV1() {
+    return new AomBackend();
+}
+#endif
+
+// A new codec only needs a backend and a line here
+static const struct {
+    const char *codec;
+    EncoderBackend *(*create)();
+} kBackends[] = {
+    {"vp8", CreateVP8},
+    {"vp9", CreateVP9},
+    {"h264", CreateH264},
+#ifdef HAVE_AOM
+    {"av1", CreateAV1},
+#endif
+};
+
+static const int32 kBackendCount = sizeof(kBackends) / sizeof(kBackends[0]);
+
+// libvpx and libaom take up to 64, x264 more than that, but past this the
+// rows get too few to keep them busy
+static const int32 kMaxEncoderThreads = 16;
+
+static int32 sThreadLimit = 0;
+static bool sMeasureQuality = false;
+
+EncoderBackend *
+EncoderBackend::Create(const char *codec) {
+    for (int32 i = 0; i < kBackendCount; i++) {
+        if (strcmp(kBackends[i].codec, codec) == 0) return kBackends[i].create();
+    }
+    return nullptr;
+}
+
+int32
+EncoderBackend::CountCodecs() {
+    return kBackendCount;
+}
+
+const char *
+EncoderBackend::CodecAt(int32 index) {
+    return index >= 0 && index < kBackendCount ? kBackends[index].codec : nullptr;
+}
+
+bool
+EncoderBackend::HasCodec(const char *codec) {
+    for (int32 i = 0; i < kBackendCount; i++) {
+        if (strcmp(kBackends[i].codec, codec) == 0) return true;
+    }
+    return false;
+}
+
+int32
+EncoderBackend::ThreadsFor(int32 width, int32 height) {
+    system_info info;
+    int32 threads = get_system_info(&info) == B_OK ? (int32) info.cpu_count : 1;
+    if (sThreadLimit > 0 && threads > sThreadLimit) threads = sThreadLimit;
+
+    int32 rows = (height + 63) / 64;
+    if (threads > rows) threads = rows;
+    if (threads > kMaxEncoderThreads) threads = kMaxEncoderThreads;
+    return threads < 1 ? 1 : threads;
+}
+
+int32
+EncoderBackend::TileColumnsFor(int32 width, int32 threads) {
+    int32 log2 = 0;
+    while ((2 << log2) <= threads && (width >> (log2 + 1)) >= 256) log2++;
+    return log2;
+}
+
+void
+EncoderBackend::SetThreadLimit(int32 threads) {
+    sThreadLimit = threads;
+}
+
+void
+EncoderBackend::SetMeasureQuality(bool measure) {
+    sMeasureQuality = measure;
+}
+
+bool
+EncoderBackend::MeasureQuality() {
+    return sMeasureQuality;
+}
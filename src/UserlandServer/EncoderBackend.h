@@ -0,0 +1,132 @@
+/*
+ * EncoderBackend.h
+ * Interface between VideoEncoder and one codec library
+ */
+#ifndef ENCODER_BACKEND_H
+#define ENCODER_BACKEND_H
+
+#include <SupportDefs.h>
+#include <stddef.h>
+
+#include "ColorConvert.h"
+#include "EncoderProfile.h"
+
+// Macroblock size of every codec here, the unit of YUVFrame::changedBlocks
+static const int32 kBlockSize = 16;
+
+// YUVFrame::pts ticks per second, whatever the frame rate
+static const int32 kTimebase = 1000;
+
+// Frames spent sharpening a picture once the screen stopped changing, see
+// YUVFrame::refine
+static const int32 kRefineSteps = 4;
+
+// A converted picture on its way from the conversion stage to the encoder
+struct YUVFrame {
+    YUVPlanes planes; // In the backend's Layout(), memory owned by VideoEncoder
+    int64 pts; // Capture time in 1/kTimebase seconds
+    bool forceKeyframe;
+
+    // 0 for a regular frame. 1 to kRefineSteps for a repeat of a static
+    // picture, which the backends code at a lower quantizer every step, the
+    // last one losslessly where that is small, see IsLosslessRefine().
+    int32 refine;
+
+    // One byte per block, row by row: non-zero where the picture changed
+    // since the frame before it was handed to the encoder. The backends
+    // skip the others cheaply, see ActiveMap. nullptr if unknown.
+    uint8 *changedBlocks;
+};
+
+// Largest share of the picture, as 1/n, that the last refinement step codes
+// losslessly: text and icons come out exact, and over a small area that
+// costs little more than a low quantizer would
+static const int32 kLosslessRefineShare = 16;
+
+// Whether the backends code 'frame' losslessly, see kLosslessRefineShare.
+// Only with a known changedBlocks, a whole picture is too large.
+static inline bool
+IsLosslessRefine(const YUVFrame &frame, int32 width, int32 height) {
+    if (frame.refine != kRefineSteps || frame.changedBlocks == nullptr) return false;
+
+    int32 blocks = ((width + kBlockSize - 1) / kBlockSize) * ((height + kBlockSize - 1) / kBlockSize);
+    int32 changed = 0;
+    for (int32 i = 0; i < blocks; i++) changed += frame.changedBlocks[i] != 0;
+    return changed > 0 && changed <= blocks / kLosslessRefineShare;
+}
+
+// One piece of a compressed frame, in the codec's own output buffers
+struct EncodedSpan {
+    const uint8 *data;
+    size_t size;
+};
+
+// A compressed frame as the codec returned it: the spans are sent one after
+// the other, without being joined first
+struct EncodedFrame {
+    const EncodedSpan *spans;
+    int32 count; // 0 when the codec held the frame back
+    size_t size; // Of all spans together
+    bool isKey;
+    int32 layer; // Temporal layer, 0 for the base and for every keyframe
+    double psnr; // Of the whole picture in dB, 0 unless measured, see SetMeasureQuality()
+};
+
+class EncoderBackend {
+public:
+    virtual ~EncoderBackend() {}
+
+    // fullChroma asks for 4:4:4, codecs without such a mode ignore it
+    virtual status_t Init(int32 width, int32 height, int32 bitrateKbps, bool fullChroma,
+                          const EncoderProfile &profile) = 0;
+
+    // The layout Encode() expects, known after Init()
+    virtual YUVLayout Layout() const = 0;
+
+    virtual void SetBitrate(int32 kbps) = 0;
+
+    // The rate frames are captured at, set before Init() and whenever it
+    // changes. Timestamps are in kTimebase units either way, this only tells
+    // rate control how long a frame is meant to last.
+    virtual void SetFrameRate(int32 fps) = 0;
+
+    // Changes the picture size in place, keeping the rate control state.
+    // B_NOT_SUPPORTED if the codec has to start over with a new backend.
+    virtual status_t Resize(int32 /* width */, int32 /* height */) { return B_NOT_SUPPORTED; }
+
+    // Temporal layers in the stream, known after Init(). A frame only refers
+    // to frames of its own layer or below, so a client can be sent just the
+    // lower layers at a fraction of the frame rate.
+    virtual int32 CountLayers() const { return 1; }
+
+    // Compresses a frame. The frame may be reused as soon as this returns,
+    // the spans in 'out' stay valid until the next call.
+    virtual status_t Encode(const YUVFrame &frame, EncodedFrame &out) = 0;
+
+    // Backend for a codec name the client sent ("vp8", "h264", ...), nullptr
+    // if there is none
+    static EncoderBackend *Create(const char *codec);
+
+    // The codecs this build has a backend for
+    static int32 CountCodecs();
+    static const char *CodecAt(int32 index);
+    static bool HasCodec(const char *codec);
+
+    // Threads for an encoder of that size: one per CPU, but no more than the
+    // picture has rows of 64 pixel blocks to hand out
+    static int32 ThreadsFor(int32 width, int32 height);
+
+    // log2 of the tile columns for that width, at least 256 pixels each and
+    // no more than there are threads
+    static int32 TileColumnsFor(int32 width, int32 threads);
+
+    // Caps ThreadsFor(), 0 for one per CPU. For scaling benchmarks.
+    static void SetThreadLimit(int32 threads);
+
+    // Backends initialized afterwards report each frame's PSNR against its
+    // input. Costs encode time, for benchmarks.
+    static void SetMeasureQuality(bool measure);
+    static bool MeasureQuality();
+};
+
+#endif // ENCODER_BACKEND_H
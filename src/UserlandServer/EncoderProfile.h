@@ -0,0 +1,62 @@
+/*
+ * EncoderProfile.h
+ * Named trade-offs between picture quality, bitrate and CPU time, which every
+ * encoder backend applies in its own terms
+ */
+#ifndef ENCODER_PROFILE_H
+#define ENCODER_PROFILE_H
+
+#include <SupportDefs.h>
+#include <string.h>
+
+struct EncoderProfile {
+    const char *name; // As sent by the client and stored in the settings
+    const char *label;
+
+    // libvpx cpu-used, higher is faster. VP8 goes up to 16 in realtime mode,
+    // VP9 only to 9.
+    int32 vp8Speed;
+    int32 vp9Speed;
+
+    // VP8 skips blocks whose difference to the previous frame sums up to less
+    // than this. Cheap, but a high value leaves faint changes behind.
+    int32 vp8StaticThreshold;
+
+    // Screen content tools: VP8's screen content mode, VP9 and AV1 tuned for
+    // screen content, AV1 palette and intra block copy
+    bool screenContent;
+
+    // x264 preset, always with the zerolatency tune. textTuning turns off the
+    // psychovisual optimizations and weakens the deblocking filter, both of
+    // which smear the edges of glyphs.
+    const char *x264Preset;
+    bool x264TextTuning;
+
+    // libaom realtime cpu-used, 7 to 10
+    int32 aomSpeed;
+};
+
+static const int32 kEncoderProfileCount = 3;
+
+static const EncoderProfile kEncoderProfiles[kEncoderProfileCount] = {
+    // Plenty of bandwidth: spend CPU time on sharp text
+    {"lan-quality", "LAN (quality)", 4, 6, 100, true, "veryfast", true, 8},
+    // The default, for links of a few Mbit/s
+    {"wan-balanced", "WAN (balanced)", 6, 7, 1000, true, "superfast", true, 9},
+    // Slow machines: the fastest settings, without the screen content search
+    {"low-cpu", "Low CPU", 12, 9, 2000, false, "ultrafast", false, 10},
+};
+
+static const char *const kDefaultEncoderProfile = "wan-balanced";
+
+// The profile of that name, nullptr if there is none
+static inline const EncoderProfile *
+EncoderProfileFor(const char *name) {
+    if (!name) return nullptr;
+    for (int32 i = 0; i < kEncoderProfileCount; i++) {
+        if (strcmp(kEncoderProfiles[i].name, name) == 0) return &kEncoderProfiles[i];
+    }
+    return nullptr;
+}
+
+#endif // ENCODER_PROFILE_H
@@ -0,0 +1,73 @@
+/*
+ * FrameBufferPool.cpp
+ */
+#include "FrameBufferPool.h"
+#include <stdio.h>
+
+static inline size_t
+Align(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+FrameBufferPool::FrameBufferPool()
+    : fArea(-1), fBase(nullptr), fAreaSize(0), fBufferSize(0) {
+}
+
+FrameBufferPool::~FrameBufferPool() {
+    Free();
+}
+
+size_t
+FrameBufferPool::Layout(YUVLayout layout, int32 width, int32 height, uint8 *base, YUVPlanes &planes) {
+    int32 chromaWidth = layout == YUV_I444 ? width : (width + 1) / 2;
+    int32 chromaHeight = layout == YUV_I444 ? height : (height + 1) / 2;
+    int32 rows[3] = {height, chromaHeight, chromaHeight};
+
+    planes.layout = layout;
+    planes.stride[0] = Align(width, kAlignment);
+    planes.stride[1] = Align(layout == YUV_NV12 ? chromaWidth * 2 : chromaWidth, kAlignment);
+    planes.stride[2] = layout == YUV_NV12 ? 0 : planes.stride[1];
+
+    // Strides are whole cache lines, so each plane starts on one too
+    size_t offset = 0;
+    for (int32 i = 0; i < 3; i++) {
+        planes.plane[i] = base && planes.stride[i] ? base + offset : nullptr;
+        offset += (size_t) planes.stride[i] * rows[i];
+    }
+    return offset;
+}
+
+status_t
+FrameBufferPool::Reserve(int32 count, size_t size) {
+    size = Align(size, kAlignment);
+    size_t total = Align(size * count, B_PAGE_SIZE);
+
+    // Hand memory back only when most of it would sit unused
+    if (fArea < B_OK || total > fAreaSize || total < fAreaSize / 2) {
+        Free();
+
+        // One area for all buffers: page aligned and mapped once. Pages are
+        // committed as the first conversion touches them.
+        void *address = nullptr;
+        fArea = create_area("yuv frames", &address, B_ANY_ADDRESS, total, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+        if (fArea < B_OK) {
+            fprintf(stderr, "FrameBufferPool: Failed to create a %zu byte area\n", total);
+            fArea = -1;
+            return B_NO_MEMORY;
+        }
+        fBase = (uint8 *) address;
+        fAreaSize = total;
+    }
+
+    fBufferSize = size;
+    return B_OK;
+}
+
+void
+FrameBufferPool::Free() {
+    if (fArea >= B_OK) delete_area(fArea);
+    fArea = -1;
+    fBase = nullptr;
+    fAreaSize = 0;
+    fBufferSize = 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * FrameBufferPool.h
+ * Aligned YUV frame memory that outlives encoder re-inits
+ */
+#ifndef FRAME_BUFFER_POOL_H
+#define FRAME_BUFFER_POOL_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+
+#include "ColorConvert.h"
+
+class FrameBufferPool {
+public:
+    // Every plane and every row starts on a cache line
+    static const int32 kAlignment = 64;
+
+    FrameBufferPool();
+
+    ~FrameBufferPool();
+
+    // Lays out the planes of a width x height frame at 'base' and returns how
+    // many bytes they take. Strides are padded to kAlignment, base may be
+    // nullptr to only get the size.
+    static size_t Layout(YUVLayout layout, int32 width, int32 height, uint8 *base, YUVPlanes &planes);
+
+    // Makes room for 'count' buffers of 'size' bytes each. Memory from earlier
+    // calls is kept when it is big enough, so a codec switch or a smaller
+    // stream doesn't allocate. Contents are not preserved.
+    status_t Reserve(int32 count, size_t size);
+
+    uint8 *BufferAt(int32 index) const { return fBase + (size_t) index * fBufferSize; }
+
+    void Free();
+
+private:
+    area_id fArea;
+    uint8 *fBase;
+    size_t fAreaSize;
+    size_t fBufferSize;
+};
+
+#endif // FRAME_BUFFER_POOL_H
@@ -0,0 +1,914 @@
+/*
+ * FramePipeline.cpp
+ */
+#include "FramePipeline.h"
+#include "FrameSource.h"
+#include "FrameRecorder.h"
+#include "NetworkServer.h"
+#include "NetworkUtils.h"
+#include "RefineSchedule.h"
+#include "TemporalLayers.h"
+#include "messages.pb.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STAGE_WAIT_TIMEOUT 100000 // Re-check fRunning at least every 100ms
+#define KEYFRAME_INTERVAL 60000000
+#define BURST_DURATION 1000000       // Stay at full rate for 1s after input or damage
+#define IDLE_FRAME_INTERVAL 1000000  // ~1 fps on a static screen
+#define STATS_INTERVAL 10000000
+#define PAUSE_TIMEOUT 1000000        // A stage is never stuck for longer, unless something is wrong
+
+static inline void
+MergeDamage(uint8 *dst, const uint8 *src, size_t count) {
+    for (size_t i = 0; i < count; i++) dst[i] |= src[i];
+}
+
+// Sets the blocks the rects touch and clears all others
+static void
+MarkBlocks(uint8 *blocks, int32 columns, int32 rows, const clipping_rect *rects, int32 count) {
+    memset(blocks, 0, (size_t) columns * rows);
+    for (int32 i = 0; i < count; i++) {
+        const clipping_rect &rect = rects[i];
+        int32 left = rect.left / kBlockSize;
+        int32 right = std::min(rect.right / kBlockSize, columns - 1);
+        int32 top = rect.top / kBlockSize;
+        int32 bottom = std::min(rect.bottom / kBlockSize, rows - 1);
+        if (left > right) continue;
+
+        for (int32 y = top; y <= bottom; y++) memset(blocks + y * columns + left, 1, right - left + 1);
+    }
+}
+
+FramePipeline::FramePipeline()
+    : fSource(nullptr), fServer(nullptr), fRecorder(nullptr), fReportStats(false), fTierCount(0), fCaptureThread(-1),
+      fConvertThread(-1), fRunning(false), fFrameInterval(33333), fKeyframeTiers(0), fLastActivity(0) {
+    for (int32 i = 0; i < kStreamTierCount; i++) {
+        Tier &tier = fTiers[i];
+        tier.pipeline = this;
+        tier.index = i;
+        tier.encoder = nullptr;
+        tier.active = false;
+        tier.lastConverted = false;
+        tier.pendingKeyframe = false;
+        tier.nextFrame = nullptr;
+        tier.encodeThread = -1;
+        tier.sendThread = -1;
+        memset(tier.packets, 0, sizeof(tier.packets));
+        tier.paused = false;
+        tier.pauseCount = 0;
+        tier.convertPause = 0;
+        tier.encodePause = 0;
+
+        tier.convertedSem = create_sem(0, "ConvertedFrames");
+        tier.sendSem = create_sem(0, "EncodedPackets");
+        tier.pausedSem = create_sem(0, "PausedStages");
+    }
+
+    fCaptureSem = create_sem(0, "CaptureSignal");
+    fCapturedSem = create_sem(0, "CapturedFrames");
+    fFreeFrameSem = create_sem(0, "FreeFrames");
+}
+
+FramePipeline::~FramePipeline() {
+    Stop();
+
+    delete_sem(fCaptureSem);
+    delete_sem(fCapturedSem);
+    delete_sem(fFreeFrameSem);
+
+    for (int32 i = 0; i < kStreamTierCount; i++) {
+        Tier &tier = fTiers[i];
+        delete_sem(tier.convertedSem);
+        delete_sem(tier.sendSem);
+        delete_sem(tier.pausedSem);
+        for (uint32 k = 0; k < kPacketCount; k++) free(tier.packets[k].data);
+    }
+}
+
+status_t
+FramePipeline::Start(FrameSource *source, VideoEncoder *const *encoders, int32 tierCount, NetworkServer *server) {
+    Stop();
+
+    if (!source || !encoders || !server || tierCount < 1 || tierCount > kStreamTierCount) return B_BAD_VALUE;
+    for (int32 i = 0; i < tierCount; i++) {
+        if (!encoders[i] || encoders[i]->CountFrames() == 0) return B_BAD_VALUE;
+    }
+
+    fSource = source;
+    fServer = server;
+    fSource->SetReportStats(fReportStats);
+
+    // Fresh tile hashes: the first frame is always encoded
+    status_t status = fDamageTracker.Init(source->Width(), source->Height());
+    if (status != B_OK) return status;
+
+    status = fScrollDetector.Init(source->Width(), source->Height());
+    if (status != B_OK) return status;
+
+    size_t tiles = (size_t) fDamageTracker.TilesX() * fDamageTracker.TilesY();
+    for (uint32 i = 0; i < kDamageSlots; i++) fCaptureDamage[i].assign(tiles, 0);
+    fDirtyRects.reserve(tiles);
+
+    for (int32 i = 0; i < tierCount; i++) {
+        Tier &tier = fTiers[i];
+        tier.encoder = encoders[i];
+
+        // Tiers start idle and catch up once watched
+        status = _InitTierFrames(tier);
+        if (status != B_OK) return status;
+        tier.active = false;
+
+        for (uint32 k = 0; k < kPacketCount; k++) tier.freePacketQueue.Push(&tier.packets[k]);
+
+        // Acknowledgements of a pause that timed out before the last Stop()
+        tier.paused = false;
+        tier.convertPause = tier.pauseCount;
+        tier.encodePause = tier.convertPause;
+        int32 pending;
+        if (get_sem_count(tier.pausedSem, &pending) == B_OK && pending > 0)
+            acquire_sem_etc(tier.pausedSem, pending, B_RELATIVE_TIMEOUT, 0);
+    }
+    fTierCount = tierCount;
+
+    fKeyframeTiers = 0;
+    fRunning = true;
+
+    fCaptureThread = spawn_thread(_CaptureLoopSync, "Screen Capture", B_DISPLAY_PRIORITY, this);
+    fConvertThread = spawn_thread(_ConvertLoopSync, "Frame Convert", B_DISPLAY_PRIORITY, this);
+    bool spawned = fCaptureThread >= B_OK && fConvertThread >= B_OK;
+
+    for (int32 i = 0; i < fTierCount; i++) {
+        Tier &tier = fTiers[i];
+        char name[B_OS_NAME_LENGTH];
+        snprintf(name, sizeof(name), "Video Encode %d", (int) i);
+        tier.encodeThread = spawn_thread(_EncodeLoopSync, name, B_DISPLAY_PRIORITY, &tier);
+        snprintf(name, sizeof(name), "Frame Send %d", (int) i);
+        tier.sendThread = spawn_thread(_SendLoopSync, name, B_DISPLAY_PRIORITY, &tier);
+        spawned = spawned && tier.encodeThread >= B_OK && tier.sendThread >= B_OK;
+    }
+
+    if (!spawned) {
+        fprintf(stderr, "FramePipeline: Failed to spawn a stage\n");
+        Stop();
+        return B_ERROR;
+    }
+
+    resume_thread(fCaptureThread);
+    resume_thread(fConvertThread);
+    for (int32 i = 0; i < fTierCount; i++) {
+        resume_thread(fTiers[i].encodeThread);
+        resume_thread(fTiers[i].sendThread);
+    }
+    return B_OK;
+}
+
+static void
+JoinThread(thread_id &thread) {
+    if (thread >= B_OK) {
+        status_t exitVal;
+        wait_for_thread(thread, &exitVal);
+    }
+    thread = -1;
+}
+
+void
+FramePipeline::Stop() {
+    fRunning = false;
+
+    // Kick every stage out of its wait
+    release_sem(fCaptureSem);
+    release_sem(fCapturedSem);
+    release_sem(fFreeFrameSem);
+    for (int32 i = 0; i < fTierCount; i++) {
+        release_sem(fTiers[i].convertedSem);
+        release_sem(fTiers[i].sendSem);
+    }
+
+    JoinThread(fCaptureThread);
+    JoinThread(fConvertThread);
+    for (int32 i = 0; i < fTierCount; i++) {
+        JoinThread(fTiers[i].encodeThread);
+        JoinThread(fTiers[i].sendThread);
+    }
+
+    _Drain();
+    fTierCount = 0;
+}
+
+// Hands the tier's encoder frames to the convert stage. They may be freshly
+// allocated, so their first use converts everything.
+status_t
+FramePipeline::_InitTierFrames(Tier &tier) {
+    VideoEncoder *encoder = tier.encoder;
+    status_t status = tier.scaler.Init(fSource->Width(), fSource->Height(), encoder->Width(), encoder->Height());
+    if (status != B_OK) return status;
+
+    size_t tiles = (size_t) fDamageTracker.TilesX() * fDamageTracker.TilesY();
+    for (int32 k = 0; k < VideoEncoder::kFrameCount; k++) tier.frameDamage[k].assign(tiles, 1);
+    tier.scaleDamage.assign(tiles, 1);
+    tier.encodeDamage.assign(tiles, 1);
+    tier.nextFrame = nullptr;
+    tier.lastConverted = false;
+
+    for (int32 k = 0; k < encoder->CountFrames(); k++) tier.freeFrameQueue.Push(encoder->FrameAt(k));
+    return B_OK;
+}
+
+status_t
+FramePipeline::PauseTier(int32 index) {
+    if (!fRunning || index < 0 || index >= fTierCount) return B_BAD_VALUE;
+
+    Tier &tier = fTiers[index];
+    if (tier.paused) return B_OK;
+
+    tier.pauseCount++;
+    tier.paused = true;
+
+    // Each stage notices at its next check, at the latest after its current
+    // frame. No need to wait out their idle timeouts.
+    release_sem(fFreeFrameSem);
+    release_sem(fCapturedSem);
+    release_sem(tier.convertedSem);
+    return acquire_sem_etc(tier.pausedSem, 2, B_RELATIVE_TIMEOUT, PAUSE_TIMEOUT);
+}
+
+status_t
+FramePipeline::ResumeTier(int32 index) {
+    if (!fRunning || index < 0 || index >= fTierCount || !fTiers[index].paused) return B_BAD_VALUE;
+
+    // No stage touches the tier now, so both ends of its frame queues are ours
+    Tier &tier = fTiers[index];
+    ConvertedItem converted;
+    while (tier.convertedQueue.Pop(converted)) {}
+    YUVFrame *frame;
+    while (tier.freeFrameQueue.Pop(frame)) {}
+
+    status_t status = _InitTierFrames(tier);
+    if (status != B_OK) return status;
+
+    // Whatever clients saw of the old encoder can't be referred to
+    tier.pendingKeyframe = true;
+    tier.paused = false;
+    release_sem(fFreeFrameSem);
+    return B_OK;
+}
+
+void
+FramePipeline::WakeCapture() {
+    fLastActivity = system_time();
+    release_sem(fCaptureSem);
+}
+
+void
+FramePipeline::_Drain() {
+    // Only called with all stages joined, so touching both ends is safe
+    CaptureItem item;
+    while (fCaptureQueue.Pop(item)) fSource->ReleaseSnapshot(item.snapshot);
+
+    for (int32 i = 0; i < fTierCount; i++) {
+        Tier &tier = fTiers[i];
+        tier.nextFrame = nullptr;
+
+        ConvertedItem converted;
+        while (tier.convertedQueue.Pop(converted)) {}
+
+        YUVFrame *frame;
+        while (tier.freeFrameQueue.Pop(frame)) {}
+
+        EncodedPacket *packet;
+        while (tier.sendQueue.Pop(packet)) {}
+        while (tier.freePacketQueue.Pop(packet)) {}
+    }
+}
+
+void
+FramePipeline::_WaitFor(sem_id sem) {
+    acquire_sem_etc(sem, 1, B_RELATIVE_TIMEOUT, STAGE_WAIT_TIMEOUT);
+}
+
+// Prints a stage's time per frame and the share of wall time it was busy,
+// which tells the stage that limits the frame rate
+void
+FramePipeline::_AddStageTime(StageStats &stats, const char *stage, bigtime_t busy) {
+    bigtime_t now = system_time();
+    if (stats.start == 0) stats.start = now - busy;
+    stats.busy += busy;
+    stats.frames++;
+    if (now - stats.start < STATS_INTERVAL) return;
+
+    printf("%s: %d frames, %.2f ms per frame, %.0f%% busy\n", stage, (int) stats.frames,
+           stats.busy / 1000.0 / stats.frames, stats.busy * 100.0 / (now - stats.start));
+    stats.start = now;
+    stats.busy = 0;
+    stats.frames = 0;
+}
+
+status_t
+FramePipeline::_CaptureLoopSync(void *data) {
+    return ((FramePipeline *) data)->_CaptureLoop();
+}
+
+status_t
+FramePipeline::_ConvertLoopSync(void *data) {
+    return ((FramePipeline *) data)->_ConvertLoop();
+}
+
+status_t
+FramePipeline::_EncodeLoopSync(void *data) {
+    Tier *tier = (Tier *) data;
+    return tier->pipeline->_EncodeLoop(*tier);
+}
+
+status_t
+FramePipeline::_SendLoopSync(void *data) {
+    Tier *tier = (Tier *) data;
+    return tier->pipeline->_SendLoop(*tier);
+}
+
+// Stage 1: copy the framebuffer and decide whether the frame is worth encoding.
+// Runs at the configured rate while the screen is busy or the user is typing or
+// moving the mouse, then backs off towards IDLE_FRAME_INTERVAL on a static
+// screen. WakeCapture() cuts an idle sleep short. Once the screen settled, what
+// changed is sent again kRefineSteps times at rising quality, then nothing
+// until the next change.
+status_t
+FramePipeline::_CaptureLoop() {
+    const bigtime_t startTime = system_time();
+    bigtime_t lastKeyframeTime = startTime;
+    bigtime_t lastCaptureTime = 0;
+    bigtime_t nextFrameTime = startTime;
+    bigtime_t interval = fFrameInterval;
+    int64 lastPts = -1;
+
+    // Whether the previous frame with damage went down the pipeline, which
+    // the client needs as the base for a move
+    bool lastQueued = false;
+
+    uint32 damageSlot = 0;
+
+    RefineSchedule refineSchedule;
+    refineSchedule.Init(fCaptureDamage[0].size());
+
+    StageStats captureStats = {};
+
+    const uint32 allTiers = (1u << fTierCount) - 1;
+
+    fLastActivity = startTime;
+
+    while (fRunning) {
+        bigtime_t now = system_time();
+
+        // If extremely late (e.g. paused/lag spike > 100ms), reset schedule
+        if (now - nextFrameTime > 100000) nextFrameTime = now;
+
+        // Recordings are paced by the source, only pick up pending wakeups
+        if (fSource->PacesItself()) nextFrameTime = now;
+
+        status_t status = acquire_sem_etc(fCaptureSem, 1, B_ABSOLUTE_TIMEOUT, nextFrameTime);
+        if (!fRunning) break;
+
+        if (status == B_OK) {
+            // Woken by input: fold any queued wakeups into this one and snap back
+            // to full rate, but never capture faster than the configured FPS
+            int32 pending;
+            if (get_sem_count(fCaptureSem, &pending) == B_OK && pending > 0)
+                acquire_sem_etc(fCaptureSem, pending, B_RELATIVE_TIMEOUT, 0);
+
+            interval = fFrameInterval;
+            bigtime_t earliest = lastCaptureTime + interval;
+            now = system_time();
+            if (now < earliest) snooze(earliest - now);
+            nextFrameTime = system_time();
+        }
+
+        now = system_time();
+        lastCaptureTime = now;
+        nextFrameTime += interval;
+
+        if (!fSource->IsConnected()) {
+            snooze(10000); // Wait bit more if screen not ready
+            continue;
+        }
+
+        // All snapshots still in flight (the convert stage is behind) or the
+        // source has no frame yet: try next tick
+        bigtime_t captureStart = system_time();
+        FrameSnapshot *snapshot = fSource->Snapshot();
+        if (!snapshot) continue;
+
+        // Tiers that dropped output, and tiers a client just moved to
+        uint32 keyframeTiers = fKeyframeTiers.exchange(0) | fServer->TakeKeyframeRequests();
+        if (now - lastKeyframeTime > KEYFRAME_INTERVAL) keyframeTiers = allTiers;
+
+        int32 dirtyTiles = fDamageTracker.Update(snapshot->bits, snapshot->rowBytes);
+        if (dirtyTiles > 0) {
+            fLastActivity = now;
+            refineSchedule.Damaged(fDamageTracker.DirtyMap(), now);
+        }
+
+        if (fRecorder && dirtyTiles > 0) fRecorder->AddFrame(snapshot, fDamageTracker.DirtyMap());
+
+        // Scrolled content is sent as a copy-rect the client applies right away,
+        // the frame itself still carries the whole change. Only the revealed
+        // strip can't be coded: the client draws the decoded picture whole, and
+        // the decoder's reference isn't moved along with the copy.
+        ScrollMove move = {};
+        bool hasMove = dirtyTiles > 0 &&
+                       fScrollDetector.Update(snapshot->bits, snapshot->rowBytes, fDamageTracker.DirtyMap(), move);
+        hasMove = hasMove && lastQueued;
+
+        // Copy, damage and scroll detection, the rest of the stage is bookkeeping
+        if (fReportStats) _AddStageTime(captureStats, "Capture", system_time() - captureStart);
+
+        // Pick the rate for the next tick: full rate during a burst, then decay
+        if (now - fLastActivity < BURST_DURATION) {
+            interval = fFrameInterval;
+        } else if (interval < IDLE_FRAME_INTERVAL) {
+            interval = interval * 3 / 2;
+            if (interval > IDLE_FRAME_INTERVAL) interval = IDLE_FRAME_INTERVAL;
+        }
+
+        // The rate-limited frames of a change are blurry, sharpen the picture
+        // with the bandwidth the static screen leaves unused
+        bool refine = dirtyTiles == 0 && refineSchedule.IsDue(now);
+
+        // Nothing changed on screen: skip conversion and encoding entirely
+        if (dirtyTiles == 0 && keyframeTiers == 0 && !refine) {
+            fSource->ReleaseSnapshot(snapshot);
+            continue;
+        }
+
+        // Timestamps follow wall time, so idle gaps don't look like a burst
+        // of frames to the encoder's rate control
+        int64 pts = (now - startTime) * kTimebase / 1000000;
+        if (pts <= lastPts) pts = lastPts + 1;
+        lastPts = pts;
+
+        if (keyframeTiers == allTiers) lastKeyframeTime = now;
+
+        std::vector<uint8> &damage = fCaptureDamage[damageSlot];
+        int32 refineStep = 0;
+        if (refine) {
+            refineStep = refineSchedule.Next(now, damage.data());
+        } else {
+            memcpy(damage.data(), fDamageTracker.DirtyMap(), damage.size());
+        }
+
+        CaptureItem item = {snapshot, pts, keyframeTiers, hasMove, move, damage.data(), refineStep};
+        // Every queued capture holds a snapshot, so with more queue slots
+        // than snapshots the push below can't find the queue full
+        static_assert(kQueueDepth > SnapshotPool::kMaxSnapshots, "Capture queue must outnumber the snapshots");
+        lastQueued = fCaptureQueue.Push(item);
+        if (!lastQueued) {
+            // Only a source with a bigger pool of its own gets here
+            fSource->ReleaseSnapshot(snapshot);
+            fDamageTracker.Invalidate();
+            continue;
+        }
+        damageSlot = (damageSlot + 1) % kDamageSlots;
+        release_sem(fCapturedSem);
+    }
+    return B_OK;
+}
+
+// Pops the newest capture, handing older ones straight back (latest frame wins).
+// Their damage is folded into the newest one's.
+bool
+FramePipeline::_PopLatestCapture(CaptureItem &item) {
+    bool found = false;
+    bool dropped = false;
+    uint32 keyframeTiers = 0;
+
+    CaptureItem next;
+    while (fCaptureQueue.Pop(next)) {
+        if (found) {
+            fSource->ReleaseSnapshot(item.snapshot);
+            MergeDamage(next.damage, item.damage, fCaptureDamage[0].size());
+            dropped = true;
+        }
+        keyframeTiers |= next.keyframeTiers;
+        item = next;
+        found = true;
+    }
+
+    if (found) {
+        item.keyframeTiers = keyframeTiers;
+        if (dropped) item.hasMove = false;
+    }
+    return found;
+}
+
+// Stage 2: RGB -> YUV into one of each watched tier's frames
+status_t
+FramePipeline::_ConvertLoop() {
+    StageStats stats = {};
+
+    while (fRunning) {
+        // A paused tier's frames are about to go away, a frame taken for it
+        // is forgotten
+        for (int32 i = 0; i < fTierCount; i++) {
+            Tier &tier = fTiers[i];
+            if (!tier.paused || tier.convertPause == tier.pauseCount) continue;
+            tier.nextFrame = nullptr;
+            tier.convertPause = tier.pauseCount;
+            release_sem(tier.pausedSem);
+        }
+
+        _UpdateActiveTiers();
+
+        // Grab free frames first, so the capture picked below is as fresh as
+        // possible. A tier still without one skips that capture.
+        bool haveFrame = false;
+        for (int32 i = 0; i < fTierCount; i++) {
+            Tier &tier = fTiers[i];
+            if (!tier.active || tier.paused) continue;
+            if (!tier.nextFrame && !tier.freeFrameQueue.Pop(tier.nextFrame)) tier.nextFrame = nullptr;
+            if (tier.nextFrame) haveFrame = true;
+        }
+
+        if (!haveFrame) {
+            _WaitFor(fFreeFrameSem);
+            continue;
+        }
+
+        CaptureItem item;
+        if (!_PopLatestCapture(item)) {
+            _WaitFor(fCapturedSem);
+            continue;
+        }
+
+        bigtime_t convertStart = system_time();
+        for (int32 i = 0; i < fTierCount; i++) {
+            if (fTiers[i].active && !fTiers[i].paused) _ConvertTier(fTiers[i], item);
+        }
+        fSource->ReleaseSnapshot(item.snapshot);
+        if (fReportStats) _AddStageTime(stats, "Convert", system_time() - convertStart);
+    }
+    return B_OK;
+}
+
+// A tier is active while clients watch it. Without any client at all, as
+// during a replay, the best tier is.
+void
+FramePipeline::_UpdateActiveTiers() {
+    bool watched = false;
+    for (int32 i = 0; i < fTierCount; i++) {
+        if (fServer->TierClients(i) > 0) watched = true;
+    }
+
+    for (int32 i = 0; i < fTierCount; i++) {
+        Tier &tier = fTiers[i];
+        if (tier.paused) continue; // Caught up on by ResumeTier()
+
+        bool active = fServer->TierClients(i) > 0 || (i == 0 && !watched);
+        if (active && !tier.active) {
+            // Its frames and scaled copy missed every capture while idle
+            for (int32 k = 0; k < VideoEncoder::kFrameCount; k++)
+                std::fill(tier.frameDamage[k].begin(), tier.frameDamage[k].end(), 1);
+            std::fill(tier.scaleDamage.begin(), tier.scaleDamage.end(), 1);
+            std::fill(tier.encodeDamage.begin(), tier.encodeDamage.end(), 1);
+            tier.lastConverted = false;
+            tier.pendingKeyframe = true;
+        }
+        tier.active = active;
+    }
+}
+
+void
+FramePipeline::_ConvertTier(Tier &tier, const CaptureItem &item) {
+    const uint32 tierBit = 1u << tier.index;
+
+    // Every frame is now behind by this capture's damage, the next one
+    // converted catches up
+    size_t tiles = fCaptureDamage[0].size();
+    for (int32 i = 0; i < VideoEncoder::kFrameCount; i++)
+        MergeDamage(tier.frameDamage[i].data(), item.damage, tiles);
+    if (tier.scaler.IsScaling()) MergeDamage(tier.scaleDamage.data(), item.damage, tiles);
+    MergeDamage(tier.encodeDamage.data(), item.damage, tiles);
+
+    YUVFrame *frame = tier.nextFrame;
+    if (!frame) {
+        // The tier's encoder is behind: skip this capture, but not its keyframe
+        if (item.keyframeTiers & tierBit) tier.pendingKeyframe = true;
+        tier.lastConverted = false;
+        return;
+    }
+
+    const uint8 *bits = item.snapshot->bits;
+    int32 rowBytes = item.snapshot->rowBytes;
+    // The scaled copy takes all damage since it was last used, the frame then
+    // converts from it
+    if (tier.scaler.IsScaling()) {
+        int32 changed = _CollectDirtyRects(tier.scaleDamage.data());
+        tier.scaler.MapRects(fDirtyRects.data(), changed, fScaledRects);
+        tier.scaler.Scale(bits, rowBytes, fScaledRects.data(), fScaledRects.size(), tier.encoder->ConvertWorkers());
+        bits = tier.scaler.Bits();
+        rowBytes = tier.scaler.RowBytes();
+    }
+
+    int32 count = _CollectDirtyRects(tier.frameDamage[frame - tier.encoder->FrameAt(0)].data());
+    const clipping_rect *rects = fDirtyRects.data();
+    if (tier.scaler.IsScaling()) {
+        tier.scaler.MapRects(rects, count, fScaledRects);
+        rects = fScaledRects.data();
+        count = fScaledRects.size();
+    }
+
+    tier.encoder->Convert(bits, rowBytes, frame, rects, count);
+
+    // The encoder may skip what didn't change since its previous frame
+    count = _CollectDirtyRects(tier.encodeDamage.data());
+    rects = fDirtyRects.data();
+    if (tier.scaler.IsScaling()) {
+        tier.scaler.MapRects(rects, count, fScaledRects);
+        rects = fScaledRects.data();
+        count = fScaledRects.size();
+    }
+    MarkBlocks(frame->changedBlocks, tier.encoder->BlockColumns(), tier.encoder->BlockRows(), rects, count);
+
+    frame->pts = item.pts;
+    frame->forceKeyframe = (item.keyframeTiers & tierBit) != 0 || tier.pendingKeyframe;
+    frame->refine = item.refine;
+    tier.pendingKeyframe = false;
+
+    // Moves are in screen pixels, which a scaled tier doesn't have
+    bool hasMove = item.hasMove && tier.lastConverted && !tier.scaler.IsScaling();
+
+    // Can't overflow: the queue is deeper than the number of frames
+    ConvertedItem converted = {frame, hasMove, item.move};
+    tier.convertedQueue.Push(converted);
+    tier.nextFrame = nullptr;
+    tier.lastConverted = true;
+    release_sem(tier.convertedSem);
+}
+
+// Turns a tile map into one rect per run of dirty tiles and clears it. Runs are
+// not merged across tile rows, so a full screen still splits into enough rects
+// to keep every conversion thread busy.
+int32
+FramePipeline::_CollectDirtyRects(uint8 *damage) {
+    const int32 tilesX = fDamageTracker.TilesX();
+    const int32 tilesY = fDamageTracker.TilesY();
+    const int32 tileSize = DamageTracker::kTileSize;
+
+    fDirtyRects.clear();
+    for (int32 ty = 0; ty < tilesY; ty++) {
+        uint8 *row = damage + ty * tilesX;
+        for (int32 tx = 0; tx < tilesX; tx++) {
+            if (!row[tx]) continue;
+
+            int32 first = tx;
+            while (tx < tilesX && row[tx]) row[tx++] = 0;
+
+            // Converter clips the last row and column of tiles to the frame
+            clipping_rect rect = {first * tileSize, ty * tileSize, tx * tileSize - 1, ty * tileSize + tileSize - 1};
+            fDirtyRects.push_back(rect);
+        }
+    }
+    return (int32) fDirtyRects.size();
+}
+
+// Stage 3: encode and copy the packets out of the tier's encoder
+status_t
+FramePipeline::_EncodeLoop(Tier &tier) {
+    const uint32 tierBit = 1u << tier.index;
+    int32 bitrate = 0;
+    bigtime_t frameInterval = 0;
+
+    bigtime_t statsStart = system_time();
+    bigtime_t statsEncodeTime = 0;
+    int32 statsFrames = 0;
+    int64 statsBytes = 0;
+
+    // After dropping output, delta frames are useless until the next keyframe
+    bool waitingForKeyframe = false;
+
+    // Whether the client got the previous frame, see CaptureItem
+    bool lastSent = false;
+
+    while (fRunning) {
+        if (tier.paused) {
+            // The encoder is about to change, and starts over with a keyframe
+            if (tier.encodePause != tier.pauseCount) {
+                bitrate = 0;
+                frameInterval = 0;
+                waitingForKeyframe = false;
+                lastSent = false;
+                tier.encodePause = (int32) tier.pauseCount;
+                release_sem(tier.sendSem);
+            }
+            _WaitFor(tier.convertedSem);
+            continue;
+        }
+
+        YUVFrame *frame = nullptr;
+        bool forceKeyframe = false;
+        bool hasMove = false;
+        ScrollMove move = {};
+
+        // Latest frame wins, but a dropped frame's keyframe request is kept
+        ConvertedItem next;
+        while (tier.convertedQueue.Pop(next)) {
+            if (frame) {
+                // The encoder never sees the dropped frame's changes otherwise
+                MergeDamage(next.frame->changedBlocks, frame->changedBlocks,
+                            (size_t) tier.encoder->BlockColumns() * tier.encoder->BlockRows());
+                forceKeyframe |= frame->forceKeyframe;
+                tier.freeFrameQueue.Push(frame);
+                release_sem(fFreeFrameSem);
+                lastSent = false;
+            }
+            frame = next.frame;
+            hasMove = next.hasMove;
+            move = next.move;
+        }
+
+        if (!frame) {
+            _WaitFor(tier.convertedSem);
+            continue;
+        }
+
+        hasMove = hasMove && lastSent;
+        lastSent = false;
+
+        // Follows the slowest client watching the tier
+        if (fServer->TierBitrate(tier.index) != bitrate) {
+            bitrate = fServer->TierBitrate(tier.index);
+            tier.encoder->SetBitrate(bitrate);
+        }
+        if (fFrameInterval != frameInterval) {
+            frameInterval = fFrameInterval;
+            tier.encoder->SetFrameRate((int32) (1000000 / frameInterval));
+        }
+
+        frame->forceKeyframe |= forceKeyframe || waitingForKeyframe;
+
+        bigtime_t encodeStart = system_time();
+        EncodedFrame encoded;
+        status_t status = tier.encoder->Encode(frame, encoded);
+
+        tier.freeFrameQueue.Push(frame);
+        release_sem(fFreeFrameSem);
+
+        if (fReportStats && status == B_OK) {
+            bigtime_t now = system_time();
+            statsEncodeTime += now - encodeStart;
+            statsFrames++;
+            statsBytes += encoded.size;
+
+            if (now - statsStart >= STATS_INTERVAL) {
+                printf("Tier %d (%s, %s, %dx%d): %d frames, %.0f kbit/s, %.2f ms per frame, %.0f%% busy\n",
+                       (int) tier.index, tier.encoder->GetCodecName(), tier.encoder->ProfileName(),
+                       (int) tier.encoder->Width(), (int) tier.encoder->Height(), (int) statsFrames,
+                       statsBytes * 8000.0 / (now - statsStart), statsEncodeTime / 1000.0 / statsFrames,
+                       statsEncodeTime * 100.0 / (now - statsStart));
+                statsStart = now;
+                statsEncodeTime = 0;
+                statsFrames = 0;
+                statsBytes = 0;
+            }
+        }
+
+        if (status != B_OK || encoded.count == 0) continue;
+        if (waitingForKeyframe && !encoded.isKey) continue;
+
+        EncodedPacket *packet = nullptr;
+        if (!tier.freePacketQueue.Pop(packet)) {
+            // Send stage is stuck on a slow client: drop and restart from a keyframe
+            waitingForKeyframe = true;
+            fKeyframeTiers |= tierBit;
+            continue;
+        }
+
+        if (packet->capacity < encoded.size) {
+            uint8 *data = (uint8 *) realloc(packet->data, encoded.size);
+            if (data) {
+                packet->data = data;
+                packet->capacity = encoded.size;
+            }
+        }
+
+        // The spans only live until the next Encode(), while the send stage
+        // may still be writing the previous packet: gather them here, once
+        if (packet->capacity >= encoded.size) {
+            size_t offset = 0;
+            for (int32 i = 0; i < encoded.count; i++) {
+                memcpy(packet->data + offset, encoded.spans[i].data, encoded.spans[i].size);
+                offset += encoded.spans[i].size;
+            }
+            packet->size = encoded.size;
+        } else {
+            // Out of memory: the send stage just recycles an empty packet
+            packet->size = 0;
+            waitingForKeyframe = true;
+        }
+        packet->isKey = encoded.isKey;
+        packet->layer = encoded.layer;
+        packet->hasMove = hasMove && packet->size > 0;
+        packet->move = move;
+
+        tier.sendQueue.Push(packet);
+        release_sem(tier.sendSem);
+
+        lastSent = packet->size > 0;
+
+        if (encoded.isKey && packet->size > 0) waitingForKeyframe = false;
+    }
+    return B_OK;
+}
+
+// Stage 4: frame the packets for WebSocket and write them to the tier's clients
+status_t
+FramePipeline::_SendLoop(Tier &tier) {
+    static const uint8 magicBytes[] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+    char stage[16];
+    snprintf(stage, sizeof(stage), "Send %d", (int) tier.index);
+    StageStats stats = {};
+    int32 sendPause = tier.pauseCount;
+
+    while (fRunning) {
+        // Checked before the queue: once the encode stage let go of the tier,
+        // an empty queue means its last packet went out
+        bool encodePaused = tier.paused && tier.encodePause == tier.pauseCount;
+
+        EncodedPacket *packet = nullptr;
+        if (!tier.sendQueue.Pop(packet)) {
+            if (encodePaused && sendPause != tier.pauseCount) {
+                sendPause = tier.pauseCount;
+                release_sem(tier.pausedSem);
+            }
+            _WaitFor(tier.sendSem);
+            continue;
+        }
+
+        if (packet->size == 0) {
+            tier.freePacketQueue.Push(packet);
+            continue;
+        }
+
+        bigtime_t sendStart = system_time();
+        if (packet->hasMove) _SendCopyRect(tier, packet->move);
+
+        // Construct Payload: [Meta(1)] + [Frame(N)] + [Magic(4)]
+        size_t payloadSz = 1 + packet->size + 4;
+
+        // Construct WebSocket Header
+        uint8 headerBuf[16];
+        size_t headerLen = NetworkUtils::MakeWebSocketHeader(payloadSz, headerBuf, 0x02); // Binary
+
+        uint8 metaByte = FrameMetaByte(packet->isKey, packet->layer);
+
+        struct iovec vec[4];
+        vec[0].iov_base = headerBuf;
+        vec[0].iov_len = headerLen;
+        vec[1].iov_base = &metaByte;
+        vec[1].iov_len = 1;
+        vec[2].iov_base = packet->data;
+        vec[2].iov_len = packet->size;
+        vec[3].iov_base = (void *) magicBytes;
+        vec[3].iov_len = 4;
+
+        fServer->BroadcastToTier(vec, 4, tier.index, packet->isKey, packet->layer);
+
+        tier.freePacketQueue.Push(packet);
+        if (fReportStats) _AddStageTime(stats, stage, system_time() - sendStart);
+    }
+    return B_OK;
+}
+
+// Tells the tier's clients to move part of what they show, ahead of the frame
+// that contains the move
+void
+FramePipeline::_SendCopyRect(const Tier &tier, const ScrollMove &move) {
+    haiku::remote::InputEvent event;
+    event.set_type(haiku::remote::InputEvent::COPY_RECT);
+
+    haiku::remote::CopyRectEvent *copyRect = event.mutable_copy_rect();
+    copyRect->set_src_x(move.x - move.dx);
+    copyRect->set_src_y(move.y - move.dy);
+    copyRect->set_width(move.width);
+    copyRect->set_height(move.height);
+    copyRect->set_dst_x(move.x);
+    copyRect->set_dst_y(move.y);
+
+    std::string serialized;
+    if (!event.SerializeToString(&serialized)) return;
+
+    uint8 headerBuf[16];
+    size_t headerLen = NetworkUtils::MakeWebSocketHeader(serialized.size(), headerBuf, 0x02); // Binary
+
+    struct iovec vec[2];
+    vec[0].iov_base = headerBuf;
+    vec[0].iov_len = headerLen;
+    vec[1].iov_base = (void *) serialized.data();
+    vec[1].iov_len = serialized.size();
+
+    // Never ahead of a keyframe, which is what clients new to the tier wait
+    // for. A move is relative to the frame before, so it only goes to the
+    // clients that get every layer.
+    fServer->BroadcastToTier(vec, 2, tier.index, false, tier.encoder->CountLayers() - 1);
+}
@@ -0,0 +1,232 @@
+/*
+ * FramePipeline.h
+ * Capture -> Convert -> Encode -> Send, each stage on its own thread. Every
+ * stream tier has its own encode and send stage.
+ */
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <vector>
+
+#include "SPSCQueue.h"
+#include "DamageTracker.h"
+#include "FrameScaler.h"
+#include "FrameSnapshot.h"
+#include "ScrollDetector.h"
+#include "StreamTiers.h"
+#include "VideoEncoder.h"
+
+class FrameSource;
+class FrameRecorder;
+class NetworkServer;
+
+class FramePipeline {
+public:
+    FramePipeline();
+
+    ~FramePipeline();
+
+    // Spawns the stage threads, with one encoder per stream tier, best first.
+    // The encoders must already be initialized. One smaller than the source
+    // gets its frames scaled down to its size.
+    status_t Start(FrameSource *source, VideoEncoder *const *encoders, int32 tierCount, NetworkServer *server);
+
+    // Stops and joins all stages, returning every buffer to its pool
+    void Stop();
+
+    // Takes one tier out of the convert and encode stages and waits until its
+    // send stage wrote everything encoded before, so its encoder may be
+    // resized or set up anew while capture and the other tiers go on
+    status_t PauseTier(int32 index);
+
+    // Takes up the paused tier's encoder with its new size and frames. The
+    // tier restarts from a keyframe of the current screen.
+    status_t ResumeTier(int32 index);
+
+    bool IsRunning() const { return fRunning; }
+
+    // May change while running, the encoders follow with their next frame
+    void SetFrameInterval(bigtime_t interval) { fFrameInterval = interval; }
+
+    // Every frame with damage is also written to the recorder. Only change
+    // this while the pipeline is stopped.
+    void SetRecorder(FrameRecorder *recorder) { fRecorder = recorder; }
+
+    // Every few seconds, prints each tier's frame count, bitrate and encode
+    // time per frame, the time each stage spends per frame and the source's
+    // snapshot copy cost, to compare codecs and profiles on a replay. Off by
+    // default. Only change this while the pipeline is stopped.
+    void SetReportStats(bool report) { fReportStats = report; }
+
+    // Called on user input: cuts the capture stage's sleep short and keeps it
+    // at full rate for a while
+    void WakeCapture();
+
+private:
+    // A move is only valid on top of the frame captured just before it, so
+    // every stage that drops a frame also drops the next frame's move
+    struct CaptureItem {
+        FrameSnapshot *snapshot;
+        int64 pts;
+        uint32 keyframeTiers; // One bit per tier
+        bool hasMove;
+        ScrollMove move;
+        uint8 *damage; // Tiles changed since the previous item, one of fCaptureDamage
+        int32 refine; // Refinement step, see YUVFrame. damage is what to refine.
+    };
+
+    struct ConvertedItem {
+        YUVFrame *frame;
+        bool hasMove;
+        ScrollMove move;
+    };
+
+    // Copy of an encoder packet: the encoder reuses its output buffer on the
+    // next Encode(), while the send stage may still be writing this one.
+    struct EncodedPacket {
+        uint8 *data;
+        size_t size;
+        size_t capacity;
+        bool isKey;
+        int32 layer;
+        bool hasMove; // Sent as a copy-rect ahead of the frame
+        ScrollMove move;
+    };
+
+    // Time one stage thread spent working, between two reports
+    struct StageStats {
+        bigtime_t start;
+        bigtime_t busy;
+        int32 frames;
+    };
+
+    static const uint32 kQueueDepth = 4;
+    static const uint32 kPacketCount = 8;
+
+    // At most kQueueDepth items wait in the capture queue and one is being
+    // converted, so a damage map is never rewritten while still in use
+    static const uint32 kDamageSlots = kQueueDepth * 2;
+
+    // Everything one stream tier has on its own: the convert stage fills its
+    // encoder's frames, its encode and send stages take it from there.
+    struct Tier {
+        FramePipeline *pipeline;
+        int32 index;
+        VideoEncoder *encoder;
+
+        // Convert stage only. A tier is active while clients watch it, an
+        // idle tier is neither converted nor encoded.
+        bool active;
+        bool lastConverted; // Whether the previous capture reached the encoder
+        bool pendingKeyframe; // Requested by a capture this tier had to skip
+        YUVFrame *nextFrame;
+
+        // The tiles each of the encoder's frames has not seen change yet.
+        // Frames keep their pixels, so only these are converted.
+        std::vector<uint8> frameDamage[VideoEncoder::kFrameCount];
+
+        // The tiles changed since the previous frame went to the encoder,
+        // turned into each frame's changedBlocks
+        std::vector<uint8> encodeDamage;
+
+        // The source scaled to the encoder's size, and the tiles it still
+        // has to catch up on
+        FrameScaler scaler;
+        std::vector<uint8> scaleDamage;
+
+        // Convert <-> Encode
+        SPSCQueue<ConvertedItem, kQueueDepth> convertedQueue;
+        SPSCQueue<YUVFrame *, kQueueDepth> freeFrameQueue;
+        sem_id convertedSem;
+
+        // Encode <-> Send
+        SPSCQueue<EncodedPacket *, kPacketCount> sendQueue;
+        SPSCQueue<EncodedPacket *, kPacketCount> freePacketQueue;
+        sem_id sendSem;
+        EncodedPacket packets[kPacketCount];
+
+        thread_id encodeThread;
+        thread_id sendThread;
+
+        // Set between PauseTier() and ResumeTier(). Each pause has its own
+        // count, so a stage lets go of the tier once per pause: the convert
+        // stage and then the send stage release pausedSem, the latter after
+        // the encode stage stopped and every packet went out.
+        std::atomic<bool> paused;
+        std::atomic<int32> pauseCount;
+        int32 convertPause; // Convert stage only
+        std::atomic<int32> encodePause;
+        sem_id pausedSem;
+    };
+
+    FrameSource *fSource;
+    NetworkServer *fServer;
+    FrameRecorder *fRecorder;
+    bool fReportStats;
+    DamageTracker fDamageTracker;
+    ScrollDetector fScrollDetector;
+
+    // Written by the capture stage, read by the convert stage once queued
+    std::vector<uint8> fCaptureDamage[kDamageSlots];
+
+    // Convert stage only, reused for every tier
+    std::vector<clipping_rect> fDirtyRects;
+    std::vector<clipping_rect> fScaledRects;
+
+    Tier fTiers[kStreamTierCount];
+    int32 fTierCount;
+
+    thread_id fCaptureThread;
+    thread_id fConvertThread;
+    volatile bool fRunning;
+
+    std::atomic<bigtime_t> fFrameInterval;
+
+    // Set by an encode stage when it had to drop output, so its tier restarts
+    // from a keyframe even on an otherwise static screen. One bit per tier.
+    std::atomic<uint32> fKeyframeTiers;
+
+    // Last input or screen change, drives the adaptive capture rate
+    std::atomic<bigtime_t> fLastActivity;
+
+    // Capture -> Convert (snapshots are returned straight to the source's pool)
+    SPSCQueue<CaptureItem, kQueueDepth> fCaptureQueue;
+    sem_id fCaptureSem;  // Wakes the capture stage early
+    sem_id fCapturedSem; // Signals the convert stage
+
+    // Any encode stage -> Convert, whenever a tier's frame comes back
+    sem_id fFreeFrameSem;
+
+    static status_t _CaptureLoopSync(void *data);
+    static status_t _ConvertLoopSync(void *data);
+    static status_t _EncodeLoopSync(void *data);
+    static status_t _SendLoopSync(void *data);
+
+    status_t _CaptureLoop();
+    status_t _ConvertLoop();
+    status_t _EncodeLoop(Tier &tier);
+    status_t _SendLoop(Tier &tier);
+
+    bool _PopLatestCapture(CaptureItem &item);
+
+    void _UpdateActiveTiers();
+
+    status_t _InitTierFrames(Tier &tier);
+
+    void _ConvertTier(Tier &tier, const CaptureItem &item);
+
+    int32 _CollectDirtyRects(uint8 *damage);
+
+    void _SendCopyRect(const Tier &tier, const ScrollMove &move);
+
+    void _WaitFor(sem_id sem);
+
+    void _AddStageTime(StageStats &stats, const char *stage, bigtime_t busy);
+
+    void _Drain();
+};
+
+#endif // FRAME_PIPELINE_H
@@ -0,0 +1,175 @@
+/*
+ * FrameRecorder.cpp
+ */
+#include "FrameRecorder.h"
+#include "DamageTracker.h"
+#include <OS.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define RECORDER_GROW_SIZE (64 * 1024 * 1024) // Extend the mapping in 64MB steps
+
+FrameRecorder::FrameRecorder()
+    : fFile(-1), fMap(nullptr), fMapSize(0), fOffset(0), fWidth(0), fHeight(0), fTilesX(0), fTilesY(0),
+      fDelta(true), fFrameCount(0), fStartTime(0) {
+}
+
+FrameRecorder::~FrameRecorder() {
+    Close();
+}
+
+status_t
+FrameRecorder::Open(const char *path, int32 width, int32 height, bool delta) {
+    Close();
+
+    if (!path || width <= 0 || height <= 0) return B_BAD_VALUE;
+
+    fFile = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fFile < 0) {
+        fprintf(stderr, "FrameRecorder: Cannot create %s: %s\n", path, strerror(errno));
+        return B_ERROR;
+    }
+
+    fWidth = width;
+    fHeight = height;
+    fTilesX = (width + DamageTracker::kTileSize - 1) / DamageTracker::kTileSize;
+    fTilesY = (height + DamageTracker::kTileSize - 1) / DamageTracker::kTileSize;
+    fDelta = delta;
+    fFrameCount = 0;
+    fOffset = sizeof(CaptureFileHeader);
+    fStartTime = 0;
+
+    status_t status = _Reserve(0);
+    if (status != B_OK) {
+        Close();
+        return status;
+    }
+
+    CaptureFileHeader *header = (CaptureFileHeader *) fMap;
+    memset(header, 0, sizeof(CaptureFileHeader));
+    header->magic = CAPTURE_FILE_MAGIC;
+    header->version = CAPTURE_FILE_VERSION;
+    header->width = width;
+    header->height = height;
+    header->tileSize = DamageTracker::kTileSize;
+    header->flags = delta ? CAPTURE_FLAG_DELTA : 0;
+
+    printf("FrameRecorder: Recording %dx%d to %s\n", (int) width, (int) height, path);
+    return B_OK;
+}
+
+void
+FrameRecorder::Close() {
+    if (fFile < 0) return;
+
+    if (fMap) {
+        CaptureFileHeader *header = (CaptureFileHeader *) fMap;
+        header->frameCount = fFrameCount;
+        header->dataSize = fOffset - sizeof(CaptureFileHeader);
+
+        msync(fMap, fOffset, MS_SYNC);
+        munmap(fMap, fMapSize);
+
+        // Drop the unused tail of the last growth step
+        if (ftruncate(fFile, fOffset) != 0)
+            fprintf(stderr, "FrameRecorder: Cannot trim file: %s\n", strerror(errno));
+
+        printf("FrameRecorder: Wrote %u frames (%lu bytes)\n", (unsigned int) fFrameCount, (unsigned long) fOffset);
+    }
+
+    close(fFile);
+    fFile = -1;
+    fMap = nullptr;
+    fMapSize = 0;
+    fOffset = 0;
+}
+
+status_t
+FrameRecorder::AddFrame(const FrameSnapshot *snapshot, const uint8 *dirtyMap) {
+    if (fFile < 0 || !snapshot) return B_NO_INIT;
+    if (snapshot->width != fWidth || snapshot->height != fHeight) return B_BAD_VALUE;
+
+    // Always store the first frame whole, replay starts from it
+    if (!fDelta || fFrameCount == 0) dirtyMap = nullptr;
+
+    const int32 tileSize = DamageTracker::kTileSize;
+
+    uint32 tileCount = 0;
+    size_t payload = 0;
+    for (int32 ty = 0; ty < fTilesY; ty++) {
+        int32 tileHeight = fHeight - ty * tileSize < tileSize ? fHeight - ty * tileSize : tileSize;
+        for (int32 tx = 0; tx < fTilesX; tx++) {
+            if (dirtyMap && !dirtyMap[ty * fTilesX + tx]) continue;
+            int32 tileWidth = fWidth - tx * tileSize < tileSize ? fWidth - tx * tileSize : tileSize;
+            payload += sizeof(CaptureTileHeader) + (size_t) tileWidth * tileHeight * 4;
+            tileCount++;
+        }
+    }
+
+    if (tileCount == 0) return B_OK;
+
+    status_t status = _Reserve(sizeof(CaptureFrameHeader) + payload);
+    if (status != B_OK) return status;
+
+    if (fFrameCount == 0) fStartTime = snapshot->timestamp;
+
+    CaptureFrameHeader *frame = (CaptureFrameHeader *) (fMap + fOffset);
+    frame->timestamp = snapshot->timestamp - fStartTime;
+    frame->tileCount = tileCount;
+    frame->size = (uint32) payload;
+
+    uint8 *out = fMap + fOffset + sizeof(CaptureFrameHeader);
+    for (int32 ty = 0; ty < fTilesY; ty++) {
+        int32 tileHeight = fHeight - ty * tileSize < tileSize ? fHeight - ty * tileSize : tileSize;
+        for (int32 tx = 0; tx < fTilesX; tx++) {
+            if (dirtyMap && !dirtyMap[ty * fTilesX + tx]) continue;
+            int32 tileWidth = fWidth - tx * tileSize < tileSize ? fWidth - tx * tileSize : tileSize;
+
+            CaptureTileHeader tile = {(uint16) tx, (uint16) ty};
+            memcpy(out, &tile, sizeof(tile));
+            out += sizeof(tile);
+
+            const uint8 *src = snapshot->bits + (size_t) ty * tileSize * snapshot->rowBytes + tx * tileSize * 4;
+            for (int32 y = 0; y < tileHeight; y++) {
+                memcpy(out, src + (size_t) y * snapshot->rowBytes, tileWidth * 4);
+                out += tileWidth * 4;
+            }
+        }
+    }
+
+    fOffset += sizeof(CaptureFrameHeader) + payload;
+    fFrameCount++;
+    return B_OK;
+}
+
+// Makes sure 'bytes' more fit in the mapping, growing the file as needed
+status_t
+FrameRecorder::_Reserve(size_t bytes) {
+    if (fMap && fOffset + bytes <= fMapSize) return B_OK;
+
+    size_t newSize = fMapSize + RECORDER_GROW_SIZE;
+    while (newSize < fOffset + bytes) newSize += RECORDER_GROW_SIZE;
+
+    if (fMap) munmap(fMap, fMapSize);
+    fMap = nullptr;
+    fMapSize = 0;
+
+    if (ftruncate(fFile, newSize) != 0) {
+        fprintf(stderr, "FrameRecorder: Cannot grow file: %s\n", strerror(errno));
+        return B_NO_MEMORY;
+    }
+
+    void *map = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fFile, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "FrameRecorder: Cannot map file: %s\n", strerror(errno));
+        return B_NO_MEMORY;
+    }
+
+    fMap = (uint8 *) map;
+    fMapSize = newSize;
+    return B_OK;
+}
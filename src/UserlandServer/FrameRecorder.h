@@ -0,0 +1,53 @@
+/*
+ * FrameRecorder.h
+ * Writes captured frames to a memory-mapped capture file for later replay
+ */
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <SupportDefs.h>
+
+#include "CaptureFile.h"
+#include "FrameSnapshot.h"
+
+class FrameRecorder {
+public:
+    FrameRecorder();
+
+    ~FrameRecorder();
+
+    // Creates (or truncates) the file. With 'delta', only changed tiles are
+    // stored for each frame.
+    status_t Open(const char *path, int32 width, int32 height, bool delta = true);
+
+    // Appends a frame. dirtyMap has one byte per DamageTracker tile (nullptr
+    // stores every tile). Called from the capture stage only.
+    status_t AddFrame(const FrameSnapshot *snapshot, const uint8 *dirtyMap);
+
+    // Finalizes the header and trims the file to its used size
+    void Close();
+
+    bool IsOpen() const { return fFile >= 0; }
+
+    int32 Width() const { return fWidth; }
+    int32 Height() const { return fHeight; }
+
+private:
+    int fFile;
+    uint8 *fMap;
+    size_t fMapSize;
+    size_t fOffset;
+
+    int32 fWidth;
+    int32 fHeight;
+    int32 fTilesX;
+    int32 fTilesY;
+    bool fDelta;
+
+    uint32 fFrameCount;
+    bigtime_t fStartTime;
+
+    status_t _Reserve(size_t bytes);
+};
+
+#endif // FRAME_RECORDER_H
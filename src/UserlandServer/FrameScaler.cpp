@@ -0,0 +1,252 @@
+/*
+ * FrameScaler.cpp
+ */
+#include "FrameScaler.h"
+#include <emmintrin.h> // SSE2
+#include <stdlib.h>
+#include <string.h>
+
+#define SCALER_ALIGNMENT 64
+
+static inline int32
+AlignRow(int32 bytes) {
+    return (bytes + SCALER_ALIGNMENT - 1) & ~(SCALER_ALIGNMENT - 1);
+}
+
+// Positions are kept in units of 1 / dstSize input pixels: input pixel j spans
+// [j * dstSize, (j + 1) * dstSize), output pixel i spans [i * srcSize, (i + 1) * srcSize).
+// Weights are rounded on the running total, so every output pixel's add up exactly.
+void
+FrameScaler::Filter::Init(int32 srcSize, int32 dstSize) {
+    taps = 1;
+    for (int32 i = 0; i < dstSize; i++) {
+        int32 lo = (int32) ((int64) i * srcSize / dstSize);
+        int32 hi = (int32) (((int64) (i + 1) * srcSize + dstSize - 1) / dstSize);
+        if (hi - lo > taps) taps = hi - lo;
+    }
+
+    first.resize(dstSize);
+    weights.assign((size_t) dstSize * taps, 0);
+
+    for (int32 i = 0; i < dstSize; i++) {
+        int64 start = (int64) i * srcSize;
+        int64 end = start + srcSize;
+        int32 lo = (int32) (start / dstSize);
+
+        // Near the end the padding goes in front, so no tap reads past the frame
+        int32 base = lo + taps > srcSize ? srcSize - taps : lo;
+        first[i] = base;
+
+        int64 covered = 0;
+        int32 given = 0;
+        for (int32 j = lo; (int64) j * dstSize < end; j++) {
+            int64 from = (int64) j * dstSize > start ? (int64) j * dstSize : start;
+            int64 to = (int64) (j + 1) * dstSize < end ? (int64) (j + 1) * dstSize : end;
+            covered += to - from;
+
+            int32 total = (int32) (((covered << kWeightBits) + srcSize / 2) / srcSize);
+            weights[(size_t) i * taps + j - base] = total - given;
+            given = total;
+        }
+    }
+}
+
+FrameScaler::FrameScaler()
+    : fSrcWidth(0), fSrcHeight(0), fDstWidth(0), fDstHeight(0), fBits(nullptr), fRowBytes(0), fRowBuffers(nullptr),
+      fRowBufferBytes(0) {
+}
+
+FrameScaler::~FrameScaler() {
+    _Free();
+}
+
+status_t
+FrameScaler::Init(int32 srcWidth, int32 srcHeight, int32 dstWidth, int32 dstHeight) {
+    _Free();
+
+    if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) return B_BAD_VALUE;
+    if (dstWidth > srcWidth || dstHeight > srcHeight) return B_BAD_VALUE;
+
+    fSrcWidth = srcWidth;
+    fSrcHeight = srcHeight;
+    fDstWidth = dstWidth;
+    fDstHeight = dstHeight;
+
+    if (dstWidth == srcWidth && dstHeight == srcHeight) return B_OK;
+
+    fColumns.Init(srcWidth, dstWidth);
+    fRows.Init(srcHeight, dstHeight);
+
+    fRowBytes = AlignRow(dstWidth * 4);
+    fRowBufferBytes = AlignRow(srcWidth * 4);
+    if (posix_memalign((void **) &fBits, SCALER_ALIGNMENT, (size_t) fRowBytes * dstHeight) != 0) {
+        fBits = nullptr;
+        return B_NO_MEMORY;
+    }
+    if (posix_memalign((void **) &fRowBuffers, SCALER_ALIGNMENT,
+                       (size_t) fRowBufferBytes * WorkerPool::kMaxThreads) != 0) {
+        fRowBuffers = nullptr;
+        _Free();
+        return B_NO_MEMORY;
+    }
+    memset(fBits, 0, (size_t) fRowBytes * dstHeight);
+
+    fBands.resize((dstHeight + kBandRows - 1) / kBandRows);
+    for (size_t i = 0; i < fBands.size(); i++) {
+        int32 top = (int32) i * kBandRows;
+        fBands[i].top = top;
+        fBands[i].bottom = top + kBandRows < dstHeight ? top + kBandRows - 1 : dstHeight - 1;
+    }
+
+    return B_OK;
+}
+
+void
+FrameScaler::_Free() {
+    free(fBits);
+    free(fRowBuffers);
+    fBits = nullptr;
+    fRowBuffers = nullptr;
+    fRowBytes = 0;
+    fRowBufferBytes = 0;
+    fBands.clear();
+}
+
+void
+FrameScaler::MapRects(const clipping_rect *rects, int32 count, std::vector<clipping_rect> &dstRects) {
+    dstRects.clear();
+    if (!fBits) return;
+
+    for (size_t i = 0; i < fBands.size(); i++) {
+        fBands[i].left = fDstWidth;
+        fBands[i].right = -1;
+    }
+
+    for (int32 i = 0; i < count; i++) {
+        const clipping_rect &rect = rects[i];
+
+        // Output pixel x sees input [x * src / dst, (x + 1) * src / dst)
+        int32 left = rect.left > 0 ? (int32) ((int64) rect.left * fDstWidth / fSrcWidth) : 0;
+        int32 top = rect.top > 0 ? (int32) ((int64) rect.top * fDstHeight / fSrcHeight) : 0;
+        int32 right = (int32) (((int64) (rect.right + 1) * fDstWidth + fSrcWidth - 1) / fSrcWidth) - 1;
+        int32 bottom = (int32) (((int64) (rect.bottom + 1) * fDstHeight + fSrcHeight - 1) / fSrcHeight) - 1;
+        if (right >= fDstWidth) right = fDstWidth - 1;
+        if (bottom >= fDstHeight) bottom = fDstHeight - 1;
+        if (left > right || top > bottom) continue;
+
+        for (int32 band = top / kBandRows; band <= bottom / kBandRows; band++) {
+            if (left < fBands[band].left) fBands[band].left = left;
+            if (right > fBands[band].right) fBands[band].right = right;
+        }
+    }
+
+    for (size_t i = 0; i < fBands.size(); i++) {
+        if (fBands[i].right >= fBands[i].left) dstRects.push_back(fBands[i]);
+    }
+}
+
+void
+FrameScaler::Scale(const uint8 *src, int32 srcStride, const clipping_rect *dstRects, int32 count,
+                   WorkerPool *workers) {
+    if (!fBits || !src || count <= 0) return;
+
+    ScaleJob job = {this, src, srcStride, dstRects};
+    if (!workers || workers->CountThreads() == 1 || count == 1) {
+        for (int32 i = 0; i < count; i++) _ScalePart(&job, i, count, 0);
+        return;
+    }
+
+    workers->Run(_ScalePart, &job, count);
+}
+
+// Vertical pass into the thread's row buffer, then horizontal into the frame
+void
+FrameScaler::_ScalePart(void *data, int32 part, int32 /* parts */, int32 thread) {
+    const ScaleJob &job = *(const ScaleJob *) data;
+    const FrameScaler &scaler = *job.scaler;
+    const Filter &columns = scaler.fColumns;
+    const Filter &rows = scaler.fRows;
+    const clipping_rect &rect = job.rects[part];
+
+    uint8 *row = scaler.fRowBuffers + (size_t) thread * scaler.fRowBufferBytes;
+
+    // The source columns this rect is made of
+    int32 sourceLeft = columns.first[rect.left];
+    int32 sourceEnd = columns.first[rect.right] + columns.taps;
+
+    for (int32 y = rect.top; y <= rect.bottom; y++) {
+        const uint8 *src = job.src + (size_t) rows.first[y] * job.srcStride + sourceLeft * 4;
+        _BlendRows(row + sourceLeft * 4, src, job.srcStride, &rows.weights[(size_t) y * rows.taps], rows.taps,
+                   (sourceEnd - sourceLeft) * 4);
+        _BlendColumns(scaler.fBits + (size_t) y * scaler.fRowBytes, row, columns, rect.left, rect.right + 1);
+    }
+}
+
+// dst[i] = sum of src rows' [i] by weight. Products of 8-bit values and weights
+// up to 1 << kWeightBits add up to at most 65280, so 16-bit lanes hold the sum.
+void
+FrameScaler::_BlendRows(uint8 *dst, const uint8 *src, int32 stride, const uint16 *weights, int32 taps,
+                        int32 bytes) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(1 << (kWeightBits - 1));
+
+    int32 i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i lo = round;
+        __m128i hi = round;
+        const uint8 *p = src + i;
+        for (int32 k = 0; k < taps; k++, p += stride) {
+            if (weights[k] == 0) continue;
+            __m128i w = _mm_set1_epi16(weights[k]);
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), w));
+            hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), w));
+        }
+        lo = _mm_srli_epi16(lo, kWeightBits);
+        hi = _mm_srli_epi16(hi, kWeightBits);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    for (; i < bytes; i++) {
+        uint32 sum = 1 << (kWeightBits - 1);
+        for (int32 k = 0; k < taps; k++) sum += src[(size_t) k * stride + i] * weights[k];
+        dst[i] = sum >> kWeightBits;
+    }
+}
+
+// Output pixels [x, end) of a row from a vertically filtered source row
+void
+FrameScaler::_BlendColumns(uint8 *dst, const uint8 *row, const Filter &filter, int32 x, int32 end) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(1 << (kWeightBits - 1));
+    const int32 taps = filter.taps;
+
+    // Two output pixels per register, the four channels of one in each half
+    for (; x + 2 <= end; x += 2) {
+        const uint32 *a = reinterpret_cast<const uint32 *>(row) + filter.first[x];
+        const uint32 *b = reinterpret_cast<const uint32 *>(row) + filter.first[x + 1];
+        const uint16 *wa = &filter.weights[(size_t) x * taps];
+        const uint16 *wb = wa + taps;
+
+        __m128i sum = round;
+        for (int32 k = 0; k < taps; k++) {
+            __m128i v = _mm_unpacklo_epi32(_mm_cvtsi32_si128(a[k]), _mm_cvtsi32_si128(b[k]));
+            __m128i w = _mm_cvtsi32_si128(wa[k] | (wb[k] << 16));
+            w = _mm_unpacklo_epi16(w, w);
+            w = _mm_unpacklo_epi32(w, w);
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), w));
+        }
+        sum = _mm_srli_epi16(sum, kWeightBits);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x * 4), _mm_packus_epi16(sum, sum));
+    }
+
+    for (; x < end; x++) {
+        const uint8 *p = row + filter.first[x] * 4;
+        const uint16 *w = &filter.weights[(size_t) x * taps];
+        for (int32 c = 0; c < 4; c++) {
+            uint32 sum = 1 << (kWeightBits - 1);
+            for (int32 k = 0; k < taps; k++) sum += p[k * 4 + c] * w[k];
+            dst[x * 4 + c] = sum >> kWeightBits;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * FrameScaler.h
+ * Area filtered B_RGB32 downscaling, so the stream can be smaller than the screen
+ */
+#ifndef FRAME_SCALER_H
+#define FRAME_SCALER_H
+
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+#include <vector>
+
+#include "WorkerPool.h"
+
+class FrameScaler {
+public:
+    FrameScaler();
+
+    ~FrameScaler();
+
+    // Only scales down. With the same size on both sides nothing is allocated
+    // and IsScaling() returns false.
+    status_t Init(int32 srcWidth, int32 srcHeight, int32 dstWidth, int32 dstHeight);
+
+    bool IsScaling() const { return fBits != nullptr; }
+
+    // The scaled frame, B_RGB32 with 64-byte aligned rows
+    const uint8 *Bits() const { return fBits; }
+    int32 RowBytes() const { return fRowBytes; }
+    int32 Width() const { return fDstWidth; }
+    int32 Height() const { return fDstHeight; }
+
+    // Turns rects of the source into the destination rects whose pixels they
+    // feed into. The result is one rect per band of kBandRows rows, so rects
+    // never overlap and can be worked on in parallel.
+    void MapRects(const clipping_rect *rects, int32 count, std::vector<clipping_rect> &dstRects);
+
+    // Rescales the given destination rects (see MapRects()) from a source frame
+    void Scale(const uint8 *src, int32 srcStride, const clipping_rect *dstRects, int32 count,
+               WorkerPool *workers = nullptr);
+
+private:
+    static const int32 kBandRows = 16;
+    static const int32 kWeightBits = 8; // The weights of one output pixel add up to this many bits
+
+    // Box filter along one axis: output pixel i is made of input pixels
+    // first[i] .. first[i] + taps - 1, weighted by how much of each it covers.
+    // Every output pixel has the same number of taps, unused ones weigh 0.
+    struct Filter {
+        int32 taps;
+        std::vector<int32> first;
+        std::vector<uint16> weights; // taps per output pixel
+
+        void Init(int32 srcSize, int32 dstSize);
+    };
+
+    struct ScaleJob {
+        FrameScaler *scaler;
+        const uint8 *src;
+        int32 srcStride;
+        const clipping_rect *rects;
+    };
+
+    int32 fSrcWidth;
+    int32 fSrcHeight;
+    int32 fDstWidth;
+    int32 fDstHeight;
+
+    Filter fColumns;
+    Filter fRows;
+
+    uint8 *fBits;
+    int32 fRowBytes;
+
+    // One vertically filtered source row per thread
+    uint8 *fRowBuffers;
+    int32 fRowBufferBytes;
+
+    std::vector<clipping_rect> fBands; // MapRects() scratch
+
+    void _Free();
+
+    static void _ScalePart(void *data, int32 part, int32 parts, int32 thread);
+
+    static void _BlendRows(uint8 *dst, const uint8 *src, int32 stride, const uint16 *weights, int32 taps,
+                           int32 bytes);
+
+    static void _BlendColumns(uint8 *dst, const uint8 *row, const Filter &filter, int32 first, int32 end);
+};
+
+#endif // FRAME_SCALER_H
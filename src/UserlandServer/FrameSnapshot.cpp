@@ -0,0 +1,235 @@
+/*
+ * FrameSnapshot.cpp
+ */
+#include "FrameSnapshot.h"
+#include "PixelConverter.h"
+#include "CpuFeatures.h"
+#include <OS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h> // SSE2
+#include <smmintrin.h> // SSE4.1
+
+#define SNAPSHOT_ALIGNMENT 64
+#define STATS_INTERVAL 5000000 // Report copy cost every 5s
+
+SnapshotPool::SnapshotPool()
+    : fStaging(nullptr), fCount(0), fWidth(0), fHeight(0), fNext(0),
+      fStreamLoads(CpuFeatures::Has(CpuFeatures::SSE41)), fReportStats(false), fStatsStart(0), fStatsCopyTime(0),
+      fStatsBytes(0), fStatsFrames(0) {
+    for (int32 i = 0; i < kMaxSnapshots; i++) {
+        fSnapshots[i].bits = nullptr;
+        fSnapshots[i].inUse = false;
+    }
+}
+
+SnapshotPool::~SnapshotPool() {
+    _Free();
+}
+
+status_t
+SnapshotPool::Init(int32 width, int32 height, int32 count) {
+    if (width <= 0 || height <= 0 || count < 1 || count > kMaxSnapshots) return B_BAD_VALUE;
+
+    _Free();
+
+    // Room for the alignment head and tail of a staged chunk
+    if (posix_memalign((void **) &fStaging, SNAPSHOT_ALIGNMENT, kStagingBytes + 32) != 0) {
+        fStaging = nullptr;
+        return B_NO_MEMORY;
+    }
+
+    // Round rows up to a full cache line so every row starts aligned
+    int32 rowBytes = (width * 4 + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+
+    for (int32 i = 0; i < count; i++) {
+        void *buffer = nullptr;
+        if (posix_memalign(&buffer, SNAPSHOT_ALIGNMENT, (size_t) rowBytes * height) != 0) {
+            _Free();
+            return B_NO_MEMORY;
+        }
+
+        FrameSnapshot &snapshot = fSnapshots[i];
+        snapshot.bits = (uint8 *) buffer;
+        snapshot.rowBytes = rowBytes;
+        snapshot.width = width;
+        snapshot.height = height;
+        snapshot.timestamp = 0;
+        snapshot.copyTime = 0;
+        snapshot.inUse = false;
+    }
+
+    fCount = count;
+    fWidth = width;
+    fHeight = height;
+    fNext = 0;
+    fStatsStart = system_time();
+    return B_OK;
+}
+
+void
+SnapshotPool::_Free() {
+    for (int32 i = 0; i < kMaxSnapshots; i++) {
+        free(fSnapshots[i].bits);
+        fSnapshots[i].bits = nullptr;
+        fSnapshots[i].inUse = false;
+    }
+    free(fStaging);
+    fStaging = nullptr;
+    fCount = 0;
+}
+
+FrameSnapshot *
+SnapshotPool::Capture(const uint8 *bits, int32 stride, const PixelConverter &converter) {
+    if (!bits || fCount == 0 || converter.InitCheck() != B_OK) return nullptr;
+
+    // Round-robin over the pool, skipping snapshots a reader still holds
+    FrameSnapshot *snapshot = nullptr;
+    for (int32 i = 0; i < fCount; i++) {
+        FrameSnapshot *candidate = &fSnapshots[(fNext + i) % fCount];
+        bool expected = false;
+        if (candidate->inUse.compare_exchange_strong(expected, true)) {
+            snapshot = candidate;
+            fNext = (fNext + i + 1) % fCount;
+            break;
+        }
+    }
+
+    if (!snapshot) return nullptr;
+
+    bigtime_t start = system_time();
+
+    for (int32 y = 0; y < fHeight; y++) {
+        _CopyRow(snapshot->bits + y * snapshot->rowBytes, bits + y * stride, fWidth, converter);
+    }
+    // Make the non-temporal stores visible before handing the snapshot out
+    _mm_sfence();
+
+    snapshot->timestamp = system_time();
+    snapshot->copyTime = snapshot->timestamp - start;
+
+    if (fReportStats) _UpdateStats(snapshot->copyTime, (int64) fWidth * converter.BytesPerPixel() * fHeight);
+    return snapshot;
+}
+
+void
+SnapshotPool::Release(FrameSnapshot *snapshot) {
+    if (snapshot) snapshot->inUse = false;
+}
+
+void
+SnapshotPool::SetStreamLoads(bool enabled) {
+    fStreamLoads = enabled && CpuFeatures::Has(CpuFeatures::SSE41);
+}
+
+void
+SnapshotPool::_UpdateStats(bigtime_t copyTime, int64 bytes) {
+    fStatsCopyTime += copyTime;
+    fStatsBytes += bytes;
+    fStatsFrames++;
+
+    bigtime_t now = system_time();
+    if (now - fStatsStart < STATS_INTERVAL) return;
+
+    if (fStatsCopyTime > 0) {
+        printf("Snapshot copy: %d frames, avg %ld us/frame, %.1f MB/s\n", fStatsFrames,
+               (long) (fStatsCopyTime / fStatsFrames), (double) fStatsBytes / fStatsCopyTime);
+    }
+
+    fStatsStart = now;
+    fStatsCopyTime = 0;
+    fStatsBytes = 0;
+    fStatsFrames = 0;
+}
+
+// Framebuffers are usually mapped uncached or write-combined, where ordinary
+// loads are serialized and painfully slow. MOVNTDQA fetches whole lines into
+// the streaming load buffers instead; the data then goes through the staging
+// buffer, which the converter reads at cache speed.
+void
+SnapshotPool::_CopyRow(uint8 *dst, const uint8 *src, int32 width, const PixelConverter &converter) {
+    const int32 bytesPerPixel = converter.BytesPerPixel();
+
+    // A multiple of 16 pixels keeps every chunk at the same 16-byte alignment
+    const int32 chunkPixels = kStagingBytes / (bytesPerPixel * 16) * 16;
+
+    for (int32 x = 0; x < width; x += chunkPixels) {
+        int32 pixels = width - x < chunkPixels ? width - x : chunkPixels;
+        const uint8 *staged = fStreamLoads ? _StreamLoad(fStaging, src + x * bytesPerPixel, pixels * bytesPerPixel)
+                                           : _Load(fStaging, src + x * bytesPerPixel, pixels * bytesPerPixel);
+
+        if (converter.IsNative())
+            _StreamCopyRow(dst + x * 4, staged, pixels * 4);
+        else
+            converter.ConvertRow(dst + x * 4, staged, pixels);
+    }
+}
+
+// Loads 'bytes' from src into staging with MOVNTDQA and returns where the data
+// starts. MOVNTDQA needs aligned addresses, so the enclosing 16-byte blocks are
+// read; they never cross a page, so reading them is always safe. Only this
+// function is built for SSE4.1, callers check the CPU first.
+__attribute__((target("sse4.1"))) const uint8 *
+SnapshotPool::_StreamLoad(uint8 *staging, const uint8 *src, int32 bytes) {
+    const uintptr_t offset = (uintptr_t) src & 15;
+    __m128i *from = reinterpret_cast<__m128i *>(const_cast<uint8 *>(src - offset));
+    __m128i *to = reinterpret_cast<__m128i *>(staging);
+    const int32 blocks = (int32) ((offset + bytes + 15) / 16);
+
+    int32 i = 0;
+    for (; i + 4 <= blocks; i += 4) {
+        __m128i v0 = _mm_stream_load_si128(from + i);
+        __m128i v1 = _mm_stream_load_si128(from + i + 1);
+        __m128i v2 = _mm_stream_load_si128(from + i + 2);
+        __m128i v3 = _mm_stream_load_si128(from + i + 3);
+
+        _mm_store_si128(to + i, v0);
+        _mm_store_si128(to + i + 1, v1);
+        _mm_store_si128(to + i + 2, v2);
+        _mm_store_si128(to + i + 3, v3);
+    }
+
+    for (; i < blocks; i++) _mm_store_si128(to + i, _mm_stream_load_si128(from + i));
+
+    return staging + offset;
+}
+
+// _StreamLoad() with plain loads, for CPUs without SSE4.1. Still reads whole
+// aligned blocks, which write-combined memory handles better than small reads.
+const uint8 *
+SnapshotPool::_Load(uint8 *staging, const uint8 *src, int32 bytes) {
+    const uintptr_t offset = (uintptr_t) src & 15;
+    const __m128i *from = reinterpret_cast<const __m128i *>(src - offset);
+    __m128i *to = reinterpret_cast<__m128i *>(staging);
+    const int32 blocks = (int32) ((offset + bytes + 15) / 16);
+
+    for (int32 i = 0; i < blocks; i++) _mm_store_si128(to + i, _mm_load_si128(from + i));
+
+    return staging + offset;
+}
+
+// Copies one row with streaming stores: the snapshot is written once and read
+// later by another stage, so there is no point in pulling it through the cache.
+void
+SnapshotPool::_StreamCopyRow(uint8 *dst, const uint8 *src, int32 bytes) {
+    int32 i = 0;
+    for (; i + 64 <= bytes; i += 64) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32));
+        __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 48));
+
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), v0);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 16), v1);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 32), v2);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 48), v3);
+    }
+
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+
+    if (i < bytes) memcpy(dst + i, src + i, bytes - i);
+}
@@ -0,0 +1,89 @@
+/*
+ * FrameSnapshot.h
+ * Small pool of aligned frame copies, so encoding never reads the live framebuffer
+ */
+#ifndef FRAME_SNAPSHOT_H
+#define FRAME_SNAPSHOT_H
+
+#include <SupportDefs.h>
+#include <atomic>
+
+class PixelConverter;
+
+struct FrameSnapshot {
+    uint8 *bits;
+    int32 rowBytes;
+    int32 width;
+    int32 height;
+
+    bigtime_t timestamp; // When the copy was taken
+    bigtime_t copyTime;  // How long the copy took (us)
+
+    std::atomic<bool> inUse;
+};
+
+class SnapshotPool {
+public:
+    static const int32 kMaxSnapshots = 3;
+
+    SnapshotPool();
+
+    ~SnapshotPool();
+
+    // Allocates 'count' B_RGB32 buffers (64-byte aligned rows)
+    status_t Init(int32 width, int32 height, int32 count = kMaxSnapshots);
+
+    // Copies a frame into a free snapshot, expanding it to B_RGB32 with the
+    // converter. The framebuffer is read with streaming loads through a small
+    // cache-resident staging buffer, B_RGB32 output is written with
+    // non-temporal stores.
+    // Returns nullptr if every snapshot is still held by a reader.
+    FrameSnapshot *Capture(const uint8 *bits, int32 stride, const PixelConverter &converter);
+
+    void Release(FrameSnapshot *snapshot);
+
+    // Streaming loads are used whenever the CPU has them. Turning them off is
+    // only meant for comparing the two read paths.
+    void SetStreamLoads(bool enabled);
+
+    bool StreamLoads() const { return fStreamLoads; }
+
+    // Prints the copy cost every few seconds. Off by default.
+    void SetReportStats(bool report) { fReportStats = report; }
+
+    int32 Width() const { return fWidth; }
+    int32 Height() const { return fHeight; }
+
+private:
+    // Framebuffer reads are staged in chunks that stay in L1
+    static const int32 kStagingBytes = 4096;
+
+    FrameSnapshot fSnapshots[kMaxSnapshots];
+    uint8 *fStaging;
+    int32 fCount;
+    int32 fWidth;
+    int32 fHeight;
+    int32 fNext;
+    bool fStreamLoads; // MOVNTDQA needs SSE4.1
+    bool fReportStats;
+
+    // Copy cost statistics, reported periodically
+    bigtime_t fStatsStart;
+    bigtime_t fStatsCopyTime;
+    int64 fStatsBytes;
+    int32 fStatsFrames;
+
+    void _Free();
+
+    void _CopyRow(uint8 *dst, const uint8 *src, int32 width, const PixelConverter &converter);
+
+    void _UpdateStats(bigtime_t copyTime, int64 bytes);
+
+    static const uint8 *_StreamLoad(uint8 *staging, const uint8 *src, int32 bytes);
+
+    static const uint8 *_Load(uint8 *staging, const uint8 *src, int32 bytes);
+
+    static void _StreamCopyRow(uint8 *dst, const uint8 *src, int32 bytes);
+};
+
+#endif // FRAME_SNAPSHOT_H
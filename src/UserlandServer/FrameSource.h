@@ -0,0 +1,37 @@
+/*
+ * FrameSource.h
+ * Where the pipeline gets its frames from: the live screen or a recording
+ */
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <SupportDefs.h>
+
+#include "FrameSnapshot.h"
+
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    virtual int32 Width() const = 0;
+    virtual int32 Height() const = 0;
+
+    // False while no frames can be produced (e.g. framebuffer not connected)
+    virtual bool IsConnected() const = 0;
+
+    // Returns a B_RGB32 frame, or nullptr if none is available right now.
+    // Every returned snapshot must be handed back with ReleaseSnapshot().
+    virtual FrameSnapshot *Snapshot() = 0;
+
+    virtual void ReleaseSnapshot(FrameSnapshot *snapshot) = 0;
+
+    // True if Snapshot() itself waits for the next frame, so the capture
+    // stage should not add its own frame pacing
+    virtual bool PacesItself() const { return false; }
+
+    // Lets the source print what its snapshots cost, see
+    // FramePipeline::SetReportStats()
+    virtual void SetReportStats(bool /* report */) {}
+};
+
+#endif // FRAME_SOURCE_H
@@ -19,30 +19,62 @@
 #include <Roster.h>
 #include <Entry.h>
 #include <Clipboard.h>
+#include <Bitmap.h>
+#include <InterfaceDefs.h>
 #define BUFFER_SIZE 4096
+#define CURSOR_POLL_INTERVAL 15000   // ~60 position updates per second
+#define CURSOR_SHAPE_INTERVAL 250000 // Re-read the shape at least every 250ms
+#define MAX_QUEUED_TIME 500000       // How far a client may fall behind its tier before frames are dropped
+#define MIN_QUEUED_BYTES 65536
 
 NetworkServer::NetworkServer(port_id inputPort)
-    : fServerSocket(-1),
+    : fSSLContext(nullptr),
+      fCursorX(-1),
+      fCursorY(-1),
+      fCursorShape(0),
+      fCursorWidth(0),
+      fCursorHeight(0),
+      fCursorHotspotX(0),
+      fCursorHotspotY(0),
+      fLastCursorCheck(0),
+      fLastShapeCheck(0),
+      fServerSocket(-1),
       fInputPort(inputPort),
       fRunning(false),
       fTarget(BMessenger()),
       fWebSocketClientCount(0),
-      fCurrentBitrate(2000),
       fLock("NetworkLock"),
-      fSSLContext(nullptr),
-      fLastX(0),
-      fLastY(0),
-      fLastCursorTime(0),
+      fWriteLock("NetworkWriteLock"),
+      fKeyframeRequests(0),
+      fLayerCount(1),
       fScreenCapture(nullptr) {
     SSL_library_init();
     OpenSSL_add_all_algorithms();
     SSL_load_error_strings();
 
+    for (int32 i = 0; i < kStreamTierCount; i++) {
+        fTierClients[i] = 0;
+        fTierBitrate[i] = kStreamTiers[i].maxKbps;
+    }
+    fTierBitrate[0] = kInitialClientKbps;
+
+    if (pipe(fWakePipe) == 0) {
+        fcntl(fWakePipe[0], F_SETFL, fcntl(fWakePipe[0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fWakePipe[1], F_SETFL, fcntl(fWakePipe[1], F_GETFL, 0) | O_NONBLOCK);
+    } else {
+        perror("NetworkServer: pipe");
+        fWakePipe[0] = fWakePipe[1] = -1;
+    }
+
     // Context created in Start()
 }
 
 NetworkServer::~NetworkServer() {
     Stop();
+    if (fWakePipe[0] >= 0) {
+        close(fWakePipe[0]);
+        close(fWakePipe[1]);
+    }
     if (fSSLContext) SSL_CTX_free(fSSLContext);
     EVP_cleanup();
 }
@@ -57,22 +89,6 @@ NetworkServer::SetScreenCapture(ScreenCapture *screenCapture) {
     fScreenCapture = screenCapture;
 }
 
-void
-NetworkServer::SetCursor(float x, float y) {
-    fLastX = x;
-    fLastY = y;
-    fLastCursorTime = system_time();
-}
-
-bool
-NetworkServer::GetLastCursor(float &x, float &y, bigtime_t &time) {
-    if (fLastCursorTime == 0) return false;
-    x = fLastX;
-    y = fLastY;
-    time = fLastCursorTime;
-    return true;
-}
-
 status_t
 NetworkServer::Start(uint16 port, const char* certPath, const char* keyPath) {
 
@@ -93,6 +109,10 @@ NetworkServer::Start(uint16 port, const char* certPath, const char* keyPath) {
         return B_ERROR;
     }
 
+    // Sockets are non-blocking: SSL_write() may send part of a queue, and
+    // is retried from wherever that queue's buffer is
+    SSL_CTX_set_mode(fSSLContext, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
     if (SSL_CTX_use_certificate_file(fSSLContext, certPath, SSL_FILETYPE_PEM) <= 0) {
         fprintf(stderr, "Failed to load cert: %s\n", certPath);
         ERR_print_errors_fp(stderr);
@@ -136,6 +156,7 @@ NetworkServer::Start(uint16 port, const char* certPath, const char* keyPath) {
 
 void
 NetworkServer::Stop() {
+    fWriteLock.Lock();
     fLock.Lock();
     fRunning = false;
     if (fServerSocket >= 0) {
@@ -151,52 +172,163 @@ NetworkServer::Stop() {
     }
     fClients.MakeEmpty();
     fWebSocketClientCount = 0;
+    _UpdateTiers();
     fLock.Unlock();
+    fWriteLock.Unlock();
 }
 
 void
 NetworkServer::Broadcast(const struct iovec *vec, int count) {
+    _Broadcast(vec, count, -1, true, 0);
+}
+
+void
+NetworkServer::BroadcastToTier(const struct iovec *vec, int count, int32 tier, bool isKey, int32 layer) {
+    _Broadcast(vec, count, tier, isKey, layer);
+}
+
+void
+NetworkServer::_Broadcast(const struct iovec *vec, int count, int32 tier, bool isKey, int32 layer) {
     if (fClients.CountItems() == 0) return;
 
     fLock.Lock();
+
+    // Only queued here, the network thread writes it out. A client that can't
+    // take more of its tier's stream skips frames until the next keyframe,
+    // rather than holding up the other clients and tiers.
+    bool queued = false;
     for (int32 i = 0; i < fClients.CountItems(); i++) {
         ClientState *client = (ClientState *) fClients.ItemAt(i);
-        if (client->isWebSocket && client->sslAccepted) {
-            // We need to flatten the iovec because SSL_write doesn't support scatter/gather directly
-            // (Unless we use BIOs, but that's complex. Flat buffer copy is easier for now)
-            // Calculate Total Size
-            size_t totalLen = 0;
-            for (int k = 0; k < count; k++) totalLen += vec[k].iov_len;
-
-            uint8 *flatBuf = new uint8[totalLen];
-            size_t offset = 0;
-            for (int k = 0; k < count; k++) {
-                memcpy(flatBuf + offset, vec[k].iov_base, vec[k].iov_len);
-                offset += vec[k].iov_len;
-            }
+        if (!client->isWebSocket || !client->sslAccepted) continue;
 
-            size_t sentTotal = 0;
-            while (sentTotal < totalLen) {
-                int written = SSL_write(client->ssl, flatBuf + sentTotal, totalLen - sentTotal);
-                if (written <= 0) {
-                    int err = SSL_get_error(client->ssl, written);
-                    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
-                        // Blocking here is bad, but for simplicity we snooze
-                        snooze(100);
-                        continue;
-                    }
-                    // Error
-                    break;
-                }
-                sentTotal += written;
-            }
+        if (!client->Takes(tier, isKey, layer)) continue;
+        size_t limit = tier >= 0 ? _QueueLimit(client) : 0;
 
-            delete[] flatBuf;
+        if (!client->outgoing.Append(vec, count, limit)) {
+            if (!client->dropped) printf("Client %d: send queue full, waiting for a keyframe\n", client->socket);
+            client->waitingForKeyframe = true;
+            client->dropped = true;
+            continue;
         }
+        client->Queued(tier, isKey);
+        queued = true;
+    }
+    fLock.Unlock();
+
+    if (queued) _Wake();
+}
+
+size_t
+NetworkServer::_QueueLimit(const ClientState *client) const {
+    size_t bytes = (int64) fTierBitrate[client->tier] * MAX_QUEUED_TIME / 8000;
+    return bytes < MIN_QUEUED_BYTES ? MIN_QUEUED_BYTES : bytes;
+}
+
+void
+NetworkServer::_Queue(ClientState *client, const void *data, size_t len) {
+    struct iovec vec;
+    vec.iov_base = (void *) data;
+    vec.iov_len = len;
+    client->outgoing.Append(&vec, 1);
+}
+
+void
+NetworkServer::_Wake() {
+    char byte = 0;
+    if (fWakePipe[1] >= 0) write(fWakePipe[1], &byte, 1); // A full pipe already wakes it
+}
+
+// fWriteLock is taken before fLock, and fLock is released while writing: a
+// sender only ever waits for the queues to be swapped, never for a socket.
+// Only the network thread calls SSL functions, so reads and writes of a
+// connection don't overlap.
+void
+NetworkServer::_FlushClients() {
+    fWriteLock.Lock();
+
+    fFlushing.clear();
+    fLock.Lock();
+    for (int32 i = 0; i < fClients.CountItems(); i++) {
+        ClientState *client = (ClientState *) fClients.ItemAt(i);
+        if (!client->sslAccepted) continue;
+
+        // Caught up after dropping frames, its tier's next keyframe lets it
+        // back in
+        if (client->dropped && client->outgoing.Unsent() == 0) {
+            fKeyframeRequests |= 1u << client->tier;
+            client->dropped = false;
+        }
+
+        client->outgoing.Take();
+        if (client->outgoing.Unsent() > 0) fFlushing.push_back(client);
+    }
+    fLock.Unlock();
+
+    for (ClientState *client : fFlushing) {
+        size_t size;
+        const uint8 *data = client->outgoing.Pending(size);
+        while (size > 0) {
+            // WANT_WRITE: select() tells when there is room again. A broken
+            // connection is noticed and closed by the read side.
+            int written = SSL_write(client->ssl, data, size);
+            if (written <= 0) break;
+
+            client->outgoing.Written(written);
+            data += written;
+            size -= written;
+        }
+    }
+
+    fWriteLock.Unlock();
+}
+
+void
+NetworkServer::SetClientBitrate(ClientState *client, int32 kbps) {
+    if (client->SetBitrate(kbps)) {
+        printf("Client %d: %d kbps, moving to tier %d\n", client->socket, (int) kbps, (int) client->tier);
+        fKeyframeRequests |= 1u << client->tier;
     }
+
+    _UpdateTiers();
+}
+
+void
+NetworkServer::SetLayerCount(int32 count) {
+    fLock.Lock();
+    fLayerCount = count;
+    for (int32 i = 0; i < fClients.CountItems(); i++) ((ClientState *) fClients.ItemAt(i))->layers = count;
     fLock.Unlock();
 }
 
+void
+NetworkServer::SetClientLayers(ClientState *client, int32 layers) {
+    if (layers == client->layers) return;
+    printf("Client %d: sending %d of %d layers\n", client->socket, (int) layers, (int) fLayerCount);
+    client->layers = layers;
+}
+
+void
+NetworkServer::_UpdateTiers() {
+    int32 clients[kStreamTierCount] = {};
+    int32 slowest[kStreamTierCount] = {};
+
+    for (int32 i = 0; i < fClients.CountItems(); i++) {
+        ClientState *client = (ClientState *) fClients.ItemAt(i);
+        if (!client->isWebSocket) continue;
+
+        int32 tier = client->tier;
+        if (clients[tier] == 0 || client->bitrate < slowest[tier]) slowest[tier] = client->bitrate;
+        clients[tier]++;
+    }
+
+    for (int32 i = 0; i < kStreamTierCount; i++) {
+        fTierClients[i] = clients[i];
+        if (clients[i] == 0) continue;
+
+        fTierBitrate[i] = StreamTierKbps(i, slowest[i]);
+    }
+}
+
 void
 NetworkServer::Broadcast(const void *header, size_t headerLen, const void *data, size_t dataLen) {
     struct iovec vec[2];
@@ -214,16 +346,24 @@ NetworkServer::ProcessEvents() {
     fLock.Lock(); // Protect fClients
 
     _CheckClipboard();
+    _CheckCursor();
 
-    fd_set readSet;
+    fd_set readSet, writeSet;
     FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
     FD_SET(fServerSocket, &readSet);
 
     int maxFd = fServerSocket;
+    if (fWakePipe[0] >= 0) {
+        FD_SET(fWakePipe[0], &readSet);
+        if (fWakePipe[0] > maxFd) maxFd = fWakePipe[0];
+    }
 
     for (int32 i = 0; i < fClients.CountItems(); i++) {
         ClientState *client = (ClientState *) fClients.ItemAt(i);
         FD_SET(client->socket, &readSet);
+        // Only waits for room where something is queued
+        if (client->outgoing.Unsent() > 0) FD_SET(client->socket, &writeSet);
         if (client->socket > maxFd) maxFd = client->socket;
     }
 
@@ -233,7 +373,12 @@ NetworkServer::ProcessEvents() {
     tv.tv_sec = 0;
     tv.tv_usec = 10000; // 10ms timeout
 
-    if (select(maxFd + 1, &readSet, nullptr, nullptr, &tv) > 0) {
+    if (select(maxFd + 1, &readSet, &writeSet, nullptr, &tv) > 0) {
+        if (fWakePipe[0] >= 0 && FD_ISSET(fWakePipe[0], &readSet)) {
+            char drain[64];
+            while (read(fWakePipe[0], drain, sizeof(drain)) > 0) {}
+        }
+
         if (FD_ISSET(fServerSocket, &readSet)) {
             _HandleNewConnection(); // Should Lock internally or here? _HandleNewConnection modifies fClients.
         }
@@ -280,14 +425,15 @@ NetworkServer::ProcessEvents() {
                     SSL_free(client->ssl);
                     close(client->socket);
 
+                    fClients.RemoveItem(i);
                     if (client->isWebSocket) {
+                        _UpdateTiers();
                         fWebSocketClientCount--;
                         if (fWebSocketClientCount == 0 && fTarget.IsValid()) {
                             fTarget.SendMessage(MSG_NO_CLIENTS);
                         }
                     }
 
-                    fClients.RemoveItem(i);
                     delete client;
                 } else {
                     // Success
@@ -340,6 +486,8 @@ NetworkServer::ProcessEvents() {
         }
         fLock.Unlock();
     }
+
+    _FlushClients();
 }
 
 void
@@ -360,6 +508,8 @@ NetworkServer::_HandleNewConnection() {
         ClientState *client = new ClientState();
         client->socket = clientSocket;
         client->isWebSocket = false;
+        client->Start(fLayerCount);
+        client->dropped = false;
 
         // Create SSL
         client->ssl = SSL_new(fSSLContext);
@@ -433,12 +583,14 @@ NetworkServer::_ParseHTTP(ClientState *client, const char *data, ssize_t len) {
         printf("Performing WebSocket Handshake...\n");
         BString response = _MakeWebSocketResponse(wsKey.String());
 
-        // SSL Write
-        SSL_write(client->ssl, response.String(), response.Length());
+        // Queued like everything after it, so nothing overtakes it
+        _Queue(client, response.String(), response.Length());
 
         // Mark as upgraded
         client->isWebSocket = true;
         fWebSocketClientCount++;
+        fKeyframeRequests |= 1u << client->tier;
+        _UpdateTiers();
 
         // Send Welcome Message (Init Config) immediately
         if (fWelcomeMessage.Length() > 0) {
@@ -449,8 +601,8 @@ NetworkServer::_ParseHTTP(ClientState *client, const char *data, ssize_t len) {
             uint8 headerBuf[16];
             size_t headerLen = NetworkUtils::MakeWebSocketHeader(fWelcomeMessage.Length(), headerBuf, 0x01); // Text
 
-            SSL_write(client->ssl, headerBuf, headerLen);
-            SSL_write(client->ssl, fWelcomeMessage.String(), fWelcomeMessage.Length());
+            _Queue(client, headerBuf, headerLen);
+            _Queue(client, fWelcomeMessage.String(), fWelcomeMessage.Length());
         }
 
         if (fTarget.IsValid()) {
@@ -649,7 +801,7 @@ NetworkServer::SendMessageToTarget(BMessage *msg) {
 void
 NetworkServer::SendToClient(ClientState *client, const void *data, size_t len) {
     if (!client || !client->sslAccepted) return;
-    SSL_write(client->ssl, data, len); // Simple wrapper, assume non-blocking handles minor buffers
+    _Queue(client, data, len); // Written out after the handler returns
 }
 
 void
@@ -701,23 +853,130 @@ NetworkServer::_CheckClipboard() {
                 for (int32 i = 0; i < fClients.CountItems(); i++) {
                     ClientState *client = (ClientState *) fClients.ItemAt(i);
                     if (client->isWebSocket && client->sslAccepted) {
-                        // Flatten for SSL
-                        size_t totalLen = headerLen + serialized.size();
-                        uint8 *flatBuf = new uint8[totalLen];
-                        memcpy(flatBuf, headerBuf, headerLen);
-                        memcpy(flatBuf + headerLen, serialized.data(), serialized.size());
-
-                        size_t sentTotal = 0;
-                        while (sentTotal < totalLen) {
-                            int written = SSL_write(client->ssl, flatBuf + sentTotal, totalLen - sentTotal);
-                            if (written <= 0) break;
-                            sentTotal += written;
-                        }
-                        delete[] flatBuf;
+                        _Queue(client, headerBuf, headerLen);
+                        _Queue(client, serialized.data(), serialized.size());
                     }
                 }
             }
         }
         be_clipboard->Unlock();
     }
-}
\ No newline at end of file
+}
+
+void
+NetworkServer::_CheckCursor() {
+    bigtime_t now = system_time();
+    if (now - fLastCursorCheck < CURSOR_POLL_INTERVAL) return;
+    fLastCursorCheck = now;
+
+    if (fWebSocketClientCount == 0) return;
+
+    BPoint where;
+    uint32 buttons;
+    if (get_mouse(&where, &buttons) != B_OK) return;
+
+    int32 x = (int32) where.x;
+    int32 y = (int32) where.y;
+    bool moved = x != fCursorX || y != fCursorY;
+    fCursorX = x;
+    fCursorY = y;
+
+    // The shape mostly changes when the pointer moves onto something else
+    bool shapeChanged = false;
+    if (moved || now - fLastShapeCheck > CURSOR_SHAPE_INTERVAL) {
+        fLastShapeCheck = now;
+        shapeChanged = _UpdateCursorShape();
+    }
+
+    if (fCursorShape == 0) return;
+
+    for (int32 i = 0; i < fClients.CountItems(); i++) {
+        ClientState *client = (ClientState *) fClients.ItemAt(i);
+        if (!client->isWebSocket || !client->sslAccepted) continue;
+
+        // New clients get the current cursor even if it hasn't moved
+        if (moved || shapeChanged || client->cursorShapes.empty()) _SendCursor(client);
+    }
+}
+
+// Returns true if the cursor shape differs from the last one seen
+bool
+NetworkServer::_UpdateCursorShape() {
+    BBitmap *bitmap = nullptr;
+    BPoint hotspot;
+    if (get_mouse_bitmap(&bitmap, &hotspot) != B_OK || !bitmap) return false;
+
+    if (bitmap->ColorSpace() != B_RGBA32) {
+        delete bitmap;
+        return false;
+    }
+
+    BRect bounds = bitmap->Bounds();
+    int32 width = bounds.IntegerWidth() + 1;
+    int32 height = bounds.IntegerHeight() + 1;
+    const uint8 *bits = (const uint8 *) bitmap->Bits();
+    int32 bytesPerRow = bitmap->BytesPerRow();
+
+    // B_RGBA32 is BGRA in memory, the client wants RGBA
+    std::string rgba(width * height * 4, '\0');
+    for (int32 y = 0; y < height; y++) {
+        const uint8 *src = bits + y * bytesPerRow;
+        char *dst = &rgba[y * width * 4];
+        for (int32 x = 0; x < width; x++, src += 4, dst += 4) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = src[3];
+        }
+    }
+    delete bitmap;
+
+    // FNV-1a over the pixels and geometry
+    uint32 hash = 2166136261u;
+    for (size_t i = 0; i < rgba.size(); i++) hash = (hash ^ (uint8) rgba[i]) * 16777619u;
+    int32 geometry[4] = {width, height, (int32) hotspot.x, (int32) hotspot.y};
+    for (int32 i = 0; i < 4; i++) hash = (hash ^ (uint32) geometry[i]) * 16777619u;
+
+    // 0 means "no shape", and the id is the last 4 bytes on the wire, so it must
+    // never read as the DE AD BE EF video frame trailer
+    if (hash == 0 || hash == 0xEFBEADDE) hash ^= 1;
+
+    if (hash == fCursorShape) return false;
+
+    fCursorShape = hash;
+    fCursorWidth = width;
+    fCursorHeight = height;
+    fCursorHotspotX = (int32) hotspot.x;
+    fCursorHotspotY = (int32) hotspot.y;
+    fCursorBitmap.swap(rgba);
+    return true;
+}
+
+void
+NetworkServer::_SendCursor(ClientState *client) {
+    haiku::remote::InputEvent event;
+    event.set_type(haiku::remote::InputEvent::CURSOR);
+
+    haiku::remote::CursorEvent *cursor = event.mutable_cursor();
+    cursor->set_x(fCursorX);
+    cursor->set_y(fCursorY);
+    cursor->set_shape(fCursorShape);
+
+    // Bitmap only the first time this client sees the shape
+    if (client->cursorShapes.insert(fCursorShape).second) {
+        cursor->set_bitmap(fCursorBitmap);
+        cursor->set_width(fCursorWidth);
+        cursor->set_height(fCursorHeight);
+        cursor->set_hotspot_x(fCursorHotspotX);
+        cursor->set_hotspot_y(fCursorHotspotY);
+    }
+
+    std::string serialized;
+    event.SerializeToString(&serialized);
+
+    uint8 headerBuf[16];
+    size_t headerLen = NetworkUtils::MakeWebSocketHeader(serialized.size(), headerBuf, 0x02);
+
+    _Queue(client, headerBuf, headerLen);
+    _Queue(client, serialized.data(), serialized.size());
+}
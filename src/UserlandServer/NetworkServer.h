@@ -12,8 +12,10 @@
 #include <Messenger.h>
 #include <Locker.h>
 #include <Locker.h>
+#include <atomic>
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
 
 #include <openssl/ssl.h>
@@ -23,14 +25,16 @@
 #include <netinet/in.h>
 #include <sys/uio.h>
 
+#include "ClientStream.h"
 #include "VirtualMouse.h"
 #include "ScreenCapture.h"
+#include "SendQueue.h"
+#include "StreamTiers.h"
 
 
 enum {
     MSG_CLIENTS_CONNECTED = 'CLCN',
     MSG_NO_CLIENTS = 'NOCL',
-    MSG_UPDATE_BITRATE = 'UPBR',
     MSG_CHANGE_RESOLUTION = 'CHRS',
     MSG_CHANGE_CODEC = 'CHCD',
     MSG_CLIPBOARD_EVENT = 'CLPB',
@@ -57,24 +61,53 @@ public:
     // Process socket events (Non-blocking)
     void ProcessEvents();
 
-    // Broadcast frame to all WebSocket clients (Scatter/Gather)
+    // Queues a message for all WebSocket clients, the network thread writes
+    // it out (Scatter/Gather)
     void Broadcast(const struct iovec *vec, int count);
 
+    // Same, but only to the clients watching a tier and taking the frame's
+    // temporal layer. A client that just moved there skips delta frames until
+    // the tier's next keyframe, and so does one whose queue is full.
+    void BroadcastToTier(const struct iovec *vec, int count, int32 tier, bool isKey, int32 layer);
+
     // Legacy helper (wraps above)
     void Broadcast(const void *header, size_t headerLen, const void *data, size_t dataLen);
 
-    struct ClientState {
+    // The connection, and what it is sent of the video in ClientStream
+    struct ClientState : ClientStream {
         int socket;
         bool isWebSocket;
         std::vector<uint8> buffer;
         SSL *ssl;
         bool sslAccepted;
+        std::set<uint32> cursorShapes; // Shape bitmaps this client already has
+        SendQueue outgoing;            // Written out by _FlushClients()
+        bool dropped;                  // Frames didn't fit its queue, wants a keyframe once it drained
     };
 
     // Accessors for Handlers
     port_id GetInputPort() const { return fInputPort; }
-    int32 GetBitrate() const { return fCurrentBitrate; }
-    void SetBitrate(int32 bitrate) { fCurrentBitrate = bitrate; }
+
+    // Called by handlers, with the lock held. Moves the client to the tier its
+    // bandwidth fits and retunes the tiers' bitrates.
+    void SetClientBitrate(ClientState *client, int32 kbps);
+
+    // Read by the frame pipeline without the lock. A tier nobody watches has
+    // no clients and keeps its last bitrate.
+    int32 TierClients(int32 tier) const { return fTierClients[tier]; }
+    int32 TierBitrate(int32 tier) const { return fTierBitrate[tier]; }
+
+    // Tiers a client moved to since the last call, one bit per tier
+    uint32 TakeKeyframeRequests() { return fKeyframeRequests.exchange(0); }
+
+    // Temporal layers of the current stream. Setting them sends every client
+    // all layers again.
+    int32 CountLayers() const { return fLayerCount; }
+    void SetLayerCount(int32 count);
+
+    // Called by handlers, with the lock held: a client on a congested link
+    // is sent fewer layers before its bitrate is lowered
+    void SetClientLayers(ClientState *client, int32 layers);
 
     void SendMessageToTarget(BMessage *msg);
 
@@ -84,16 +117,18 @@ public:
         fWelcomeMessage.SetTo(msg, len);
     }
 
-    void SetCursor(float x, float y);
-
-    bool GetLastCursor(float &x, float &y, bigtime_t &time);
-
 private:
     SSL_CTX *fSSLContext;
     BString fWelcomeMessage;
 
-    float fLastX, fLastY;
-    bigtime_t fLastCursorTime;
+    // Cursor channel state, polled from the network thread
+    int32 fCursorX, fCursorY;
+    uint32 fCursorShape;
+    int32 fCursorWidth, fCursorHeight;
+    int32 fCursorHotspotX, fCursorHotspotY;
+    std::string fCursorBitmap; // RGBA
+    bigtime_t fLastCursorCheck;
+    bigtime_t fLastShapeCheck;
 
     int fServerSocket;
     BList fClients; // List of ClientState*
@@ -103,10 +138,37 @@ private:
     BMessenger fTarget;
     int32 fWebSocketClientCount;
     BLocker fLock;
-    int32 fCurrentBitrate;
+    BLocker fWriteLock; // Held while writing outside fLock, so Stop() doesn't free a client meanwhile
+    int fWakePipe[2];   // Wakes the network thread when something was queued
+
+    std::atomic<int32> fTierClients[kStreamTierCount];
+    std::atomic<int32> fTierBitrate[kStreamTierCount];
+    std::atomic<uint32> fKeyframeRequests;
+    std::atomic<int32> fLayerCount;
+
+    std::vector<ClientState *> fFlushing; // _FlushClients() only
 
     void _HandleNewConnection();
 
+    // tier < 0 sends to every client
+    void _Broadcast(const struct iovec *vec, int count, int32 tier, bool isKey, int32 layer);
+
+    // Unsent bytes a client's queue may hold before its tier's frames are
+    // dropped, from the tier's bitrate
+    size_t _QueueLimit(const ClientState *client) const;
+
+    // Control messages are always queued, they are small
+    void _Queue(ClientState *client, const void *data, size_t len);
+
+    void _Wake();
+
+    // Writes what the clients queued, without fLock held
+    void _FlushClients();
+
+    // Recounts the clients per tier and gives every watched tier the bitrate of
+    // its slowest client. Called with the lock held.
+    void _UpdateTiers();
+
     // Returns true if connection should be closed
     bool _ParseHTTP(ClientState *client, const char *data, ssize_t len);
 
@@ -121,6 +183,12 @@ private:
 
     void _CheckClipboard();
 
+    void _CheckCursor();
+
+    bool _UpdateCursorShape();
+
+    void _SendCursor(ClientState *client);
+
     ScreenCapture *fScreenCapture;
 };
 
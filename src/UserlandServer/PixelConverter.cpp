@@ -0,0 +1,196 @@
+/*
+ * PixelConverter.cpp
+ */
+#include "PixelConverter.h"
+#include "CpuFeatures.h"
+#include <InterfaceDefs.h>
+#include <stdio.h>
+#include <string.h>
+#include <emmintrin.h> // SSE2
+#include <tmmintrin.h> // SSSE3
+
+PixelConverter::PixelConverter()
+    : fFormat(B_NO_COLOR_SPACE), fBytesPerPixel(0), fConvertRow(nullptr) {
+    memset(fPalette, 0, sizeof(fPalette));
+}
+
+status_t
+PixelConverter::SetFormat(color_space format) {
+    fFormat = format;
+    fConvertRow = nullptr;
+    fBytesPerPixel = 0;
+
+    switch (format) {
+        case B_RGB32:
+        case B_RGBA32:
+            fConvertRow = _ConvertRGB32;
+            fBytesPerPixel = 4;
+            break;
+
+        case B_RGB24:
+            fConvertRow = CpuFeatures::Has(CpuFeatures::SSSE3) ? _ConvertRGB24 : _ConvertRGB24Scalar;
+            fBytesPerPixel = 3;
+            break;
+
+        case B_RGB16:
+            fConvertRow = _ConvertRGB16;
+            fBytesPerPixel = 2;
+            break;
+
+        case B_RGB15:
+        case B_RGBA15:
+            fConvertRow = _ConvertRGB15;
+            fBytesPerPixel = 2;
+            break;
+
+        case B_CMAP8: {
+            const color_map *map = system_colors();
+            if (!map) return B_ERROR;
+
+            for (int32 i = 0; i < 256; i++) {
+                const rgb_color &color = map->color_list[i];
+                fPalette[i] = 0xFF000000 | ((uint32) color.red << 16) | ((uint32) color.green << 8) | color.blue;
+            }
+            fConvertRow = _ConvertCMAP8;
+            fBytesPerPixel = 1;
+            break;
+        }
+
+        case B_GRAY8:
+            for (int32 i = 0; i < 256; i++) fPalette[i] = 0xFF000000 | (i << 16) | (i << 8) | i;
+            fConvertRow = _ConvertCMAP8;
+            fBytesPerPixel = 1;
+            break;
+
+        default:
+            fprintf(stderr, "PixelConverter: Unsupported color space 0x%x\n", (unsigned int) format);
+            return B_BAD_VALUE;
+    }
+
+    return B_OK;
+}
+
+void
+PixelConverter::_ConvertRGB32(uint8 *dst, const uint8 *src, int32 width, const uint32 * /* palette */) {
+    memcpy(dst, src, width * 4);
+}
+
+// B,G,R triplets -> B,G,R,A: one pshufb spreads 4 pixels into 16 bytes. Only
+// this function is built for SSSE3, SetFormat() checks the CPU first.
+__attribute__((target("ssse3"))) void
+PixelConverter::_ConvertRGB24(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+    int32 x = 0;
+    // Each load reads 16 bytes but consumes 12, stay clear of the row end
+    for (; x + 6 <= width; x += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 3));
+        v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), v);
+    }
+
+    _ConvertRGB24Scalar(dst + x * 4, src + x * 3, width - x, palette);
+}
+
+void
+PixelConverter::_ConvertRGB24Scalar(uint8 *dst, const uint8 *src, int32 width, const uint32 * /* palette */) {
+    for (int32 x = 0; x < width; x++) {
+        const uint8 *s = src + x * 3;
+        uint8 *d = dst + x * 4;
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = 0xFF;
+    }
+}
+
+// Packs 8 expanded pixels (16-bit lanes of 8-bit B, G, R) into B,G,R,A
+static inline void
+StorePixels(uint8 *dst, __m128i b, __m128i g, __m128i r) {
+    const __m128i alpha = _mm_set1_epi16((short) 0xFF00);
+    __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    __m128i ra = _mm_or_si128(r, alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), _mm_unpackhi_epi16(bg, ra));
+}
+
+// 5-6-5 -> 8-8-8, replicating the high bits into the low ones so white stays white
+void
+PixelConverter::_ConvertRGB16(uint8 *dst, const uint8 *src, int32 width, const uint32 * /* palette */) {
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+
+    int32 x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+
+        __m128i r = _mm_srli_epi16(p, 11);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+        __m128i b = _mm_and_si128(p, mask5);
+
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+        StorePixels(dst + x * 4, b, g, r);
+    }
+
+    const uint16 *s = reinterpret_cast<const uint16 *>(src);
+    uint32 *d = reinterpret_cast<uint32 *>(dst);
+    for (; x < width; x++) {
+        uint32 p = s[x];
+        uint32 r = p >> 11, g = (p >> 5) & 0x3F, b = p & 0x1F;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+        d[x] = 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+}
+
+// x-5-5-5 -> 8-8-8 (the B_RGBA15 alpha bit is dropped, frames are opaque)
+void
+PixelConverter::_ConvertRGB15(uint8 *dst, const uint8 *src, int32 width, const uint32 * /* palette */) {
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+
+    int32 x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+
+        __m128i r = _mm_and_si128(_mm_srli_epi16(p, 10), mask5);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask5);
+        __m128i b = _mm_and_si128(p, mask5);
+
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+        StorePixels(dst + x * 4, b, g, r);
+    }
+
+    const uint16 *s = reinterpret_cast<const uint16 *>(src);
+    uint32 *d = reinterpret_cast<uint32 *>(dst);
+    for (; x < width; x++) {
+        uint32 p = s[x];
+        uint32 r = (p >> 10) & 0x1F, g = (p >> 5) & 0x1F, b = p & 0x1F;
+        r = (r << 3) | (r >> 2);
+        g = (g << 3) | (g >> 2);
+        b = (b << 3) | (b >> 2);
+        d[x] = 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+}
+
+// Palette lookup. A 1KB table stays in L1, which beats any gather instruction.
+void
+PixelConverter::_ConvertCMAP8(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette) {
+    uint32 *d = reinterpret_cast<uint32 *>(dst);
+
+    int32 x = 0;
+    for (; x + 4 <= width; x += 4) {
+        d[x] = palette[src[x]];
+        d[x + 1] = palette[src[x + 1]];
+        d[x + 2] = palette[src[x + 2]];
+        d[x + 3] = palette[src[x + 3]];
+    }
+    for (; x < width; x++) d[x] = palette[src[x]];
+}
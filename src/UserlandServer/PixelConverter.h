@@ -0,0 +1,49 @@
+/*
+ * PixelConverter.h
+ * Expands framebuffer rows of any supported color_space to B_RGB32
+ */
+#ifndef PIXEL_CONVERTER_H
+#define PIXEL_CONVERTER_H
+
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+
+class PixelConverter {
+public:
+    PixelConverter();
+
+    // Selects the row converter for a framebuffer format. B_CMAP8 reads the
+    // current system palette. Returns B_BAD_VALUE for unsupported formats.
+    status_t SetFormat(color_space format);
+
+    status_t InitCheck() const { return fConvertRow ? B_OK : B_NO_INIT; }
+
+    color_space Format() const { return fFormat; }
+
+    // True if rows are already B_RGB32 and can be copied as-is
+    bool IsNative() const { return fFormat == B_RGB32 || fFormat == B_RGBA32; }
+
+    int32 BytesPerPixel() const { return fBytesPerPixel; }
+
+    // Writes 'width' B_RGB32 pixels to dst
+    void ConvertRow(uint8 *dst, const uint8 *src, int32 width) const {
+        fConvertRow(dst, src, width, fPalette);
+    }
+
+private:
+    typedef void (*RowFunc)(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette);
+
+    color_space fFormat;
+    int32 fBytesPerPixel;
+    RowFunc fConvertRow;
+    uint32 fPalette[256];
+
+    static void _ConvertRGB32(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette);
+    static void _ConvertRGB24(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette);
+    static void _ConvertRGB24Scalar(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette);
+    static void _ConvertRGB16(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette);
+    static void _ConvertRGB15(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette);
+    static void _ConvertCMAP8(uint8 *dst, const uint8 *src, int32 width, const uint32 *palette);
+};
+
+#endif // PIXEL_CONVERTER_H
@@ -0,0 +1,37 @@
+/*
+ * RefineSchedule.cpp
+ */
+#include "RefineSchedule.h"
+#include <algorithm>
+#include <string.h>
+
+RefineSchedule::RefineSchedule() : fStep(kRefineSteps), fLastDamage(0), fNextTime(0) {}
+
+void
+RefineSchedule::Init(size_t tiles) {
+    fDamage.assign(tiles, 0);
+    fStep = kRefineSteps;
+    fLastDamage = 0;
+    fNextTime = 0;
+}
+
+void
+RefineSchedule::Damaged(const uint8 *dirtyMap, bigtime_t now) {
+    for (size_t i = 0; i < fDamage.size(); i++) fDamage[i] |= dirtyMap[i];
+    fStep = 0;
+    fLastDamage = now;
+}
+
+bool
+RefineSchedule::IsDue(bigtime_t now) const {
+    return fStep < kRefineSteps && now - fLastDamage >= kRefineDelay && now >= fNextTime;
+}
+
+int32
+RefineSchedule::Next(bigtime_t now, uint8 *damage) {
+    memcpy(damage, fDamage.data(), fDamage.size());
+    fStep++;
+    fNextTime = now + kRefineInterval;
+    if (fStep == kRefineSteps) std::fill(fDamage.begin(), fDamage.end(), 0);
+    return fStep;
+}
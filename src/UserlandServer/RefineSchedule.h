@@ -0,0 +1,51 @@
+/*
+ * RefineSchedule.h
+ * When the capture stage sends a settled picture again at rising quality,
+ * and which tiles
+ */
+#ifndef REFINE_SCHEDULE_H
+#define REFINE_SCHEDULE_H
+
+#include <SupportDefs.h>
+#include <vector>
+
+#include "EncoderBackend.h"
+
+// Static for this long: start sharpening what changed
+static const bigtime_t kRefineDelay = 250000;
+
+// Between refinement frames, so they don't come in a burst
+static const bigtime_t kRefineInterval = 100000;
+
+class RefineSchedule {
+public:
+    RefineSchedule();
+
+    // One byte per tile, like DamageTracker::DirtyMap(). Nothing is left to
+    // refine afterwards.
+    void Init(size_t tiles);
+
+    // A capture with damage: its tiles join the ones to refine, and the
+    // series starts over once the screen is static again
+    void Damaged(const uint8 *dirtyMap, bigtime_t now);
+
+    // Whether a capture without damage at 'now' should be sent as the next
+    // refinement frame
+    bool IsDue(bigtime_t now) const;
+
+    // Takes the next step of the series and copies its tiles to 'damage'.
+    // Returns the step, 1 to kRefineSteps. After the last one the tiles are
+    // forgotten and nothing is due until the next damage.
+    int32 Next(bigtime_t now, uint8 *damage);
+
+    // kRefineSteps while nothing is left to refine
+    int32 Step() const { return fStep; }
+
+private:
+    std::vector<uint8> fDamage; // Tiles changed since the last finished series
+    int32 fStep;
+    bigtime_t fLastDamage;
+    bigtime_t fNextTime;
+};
+
+#endif // REFINE_SCHEDULE_H
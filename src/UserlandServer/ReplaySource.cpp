@@ -0,0 +1,213 @@
+/*
+ * ReplaySource.cpp
+ */
+#include "ReplaySource.h"
+#include <OS.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REPLAY_MAX_SLEEP 100000 // Keep Snapshot() calls short so the pipeline can stop
+
+ReplaySource::ReplaySource()
+    : fFile(-1), fMap(nullptr), fMapSize(0), fHeader(nullptr), fWidth(0), fHeight(0), fTilesX(0), fTilesY(0),
+      fRealtime(true), fOffset(0), fFrameIndex(0), fPlayStart(0), fPending(false), fCanvas(nullptr),
+      fCanvasRowBytes(0) {
+    fConverter.SetFormat(B_RGB32);
+}
+
+ReplaySource::~ReplaySource() {
+    Close();
+}
+
+status_t
+ReplaySource::Open(const char *path, bool realtime) {
+    Close();
+
+    fFile = open(path, O_RDONLY);
+    if (fFile < 0) {
+        fprintf(stderr, "ReplaySource: Cannot open %s: %s\n", path, strerror(errno));
+        return B_ERROR;
+    }
+
+    struct stat st;
+    if (fstat(fFile, &st) != 0 || (size_t) st.st_size < sizeof(CaptureFileHeader)) {
+        fprintf(stderr, "ReplaySource: %s is not a capture file\n", path);
+        Close();
+        return B_BAD_VALUE;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fFile, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "ReplaySource: Cannot map %s: %s\n", path, strerror(errno));
+        Close();
+        return B_ERROR;
+    }
+    fMap = (const uint8 *) map;
+    fMapSize = st.st_size;
+    fHeader = (const CaptureFileHeader *) fMap;
+
+    if (fHeader->magic != CAPTURE_FILE_MAGIC || fHeader->version != CAPTURE_FILE_VERSION || fHeader->width <= 0 ||
+        fHeader->height <= 0 || fHeader->tileSize <= 0 || fHeader->frameCount == 0 ||
+        fHeader->dataSize > fMapSize - sizeof(CaptureFileHeader)) {
+        fprintf(stderr, "ReplaySource: %s is not a finished capture file\n", path);
+        Close();
+        return B_BAD_VALUE;
+    }
+
+    fWidth = fHeader->width;
+    fHeight = fHeader->height;
+    fTilesX = (fWidth + fHeader->tileSize - 1) / fHeader->tileSize;
+    fTilesY = (fHeight + fHeader->tileSize - 1) / fHeader->tileSize;
+
+    // Validate every record up front, so playback can trust the file
+    size_t offset = sizeof(CaptureFileHeader);
+    const size_t end = offset + fHeader->dataSize;
+    uint32 i = 0;
+    for (; i < fHeader->frameCount; i++) {
+        if (end - offset < sizeof(CaptureFrameHeader)) break;
+        const CaptureFrameHeader *frame = (const CaptureFrameHeader *) (fMap + offset);
+        offset += sizeof(CaptureFrameHeader);
+        if (frame->size > end - offset) break;
+
+        size_t used = 0;
+        uint32 tile = 0;
+        for (; tile < frame->tileCount; tile++) {
+            if (frame->size - used < sizeof(CaptureTileHeader)) break;
+            const CaptureTileHeader *header = (const CaptureTileHeader *) (fMap + offset + used);
+            if (header->x >= fTilesX || header->y >= fTilesY) break;
+
+            int32 tileWidth = fWidth - header->x * fHeader->tileSize;
+            int32 tileHeight = fHeight - header->y * fHeader->tileSize;
+            if (tileWidth > fHeader->tileSize) tileWidth = fHeader->tileSize;
+            if (tileHeight > fHeader->tileSize) tileHeight = fHeader->tileSize;
+
+            size_t tileBytes = sizeof(CaptureTileHeader) + (size_t) tileWidth * tileHeight * 4;
+            if (tileBytes > frame->size - used) break;
+            used += tileBytes;
+        }
+
+        if (tile != frame->tileCount || used != frame->size) {
+            fprintf(stderr, "ReplaySource: Frame %u of %s is corrupt\n", (unsigned int) i, path);
+            Close();
+            return B_BAD_VALUE;
+        }
+        offset += frame->size;
+    }
+
+    if (i != fHeader->frameCount || offset != end) {
+        fprintf(stderr, "ReplaySource: %s is truncated\n", path);
+        Close();
+        return B_BAD_VALUE;
+    }
+
+    fCanvasRowBytes = fWidth * 4;
+    if (posix_memalign((void **) &fCanvas, 64, (size_t) fCanvasRowBytes * fHeight) != 0) {
+        fCanvas = nullptr;
+        Close();
+        return B_NO_MEMORY;
+    }
+    memset(fCanvas, 0, (size_t) fCanvasRowBytes * fHeight);
+
+    status_t status = fSnapshots.Init(fWidth, fHeight);
+    if (status != B_OK) {
+        Close();
+        return status;
+    }
+
+    fRealtime = realtime;
+    _Rewind();
+
+    printf("ReplaySource: %s, %dx%d, %u frames, %s speed\n", path, (int) fWidth, (int) fHeight,
+           (unsigned int) fHeader->frameCount, realtime ? "recorded" : "maximum");
+    return B_OK;
+}
+
+void
+ReplaySource::Close() {
+    if (fMap) munmap((void *) fMap, fMapSize);
+    if (fFile >= 0) close(fFile);
+    free(fCanvas);
+
+    fFile = -1;
+    fMap = nullptr;
+    fMapSize = 0;
+    fHeader = nullptr;
+    fCanvas = nullptr;
+    fPending = false;
+}
+
+void
+ReplaySource::_Rewind() {
+    fOffset = sizeof(CaptureFileHeader);
+    fFrameIndex = 0;
+    fPending = false;
+    fPlayStart = system_time();
+}
+
+FrameSnapshot *
+ReplaySource::Snapshot() {
+    if (!fMap) return nullptr;
+
+    if (!fPending) {
+        if (fFrameIndex == fHeader->frameCount) {
+            bigtime_t elapsed = system_time() - fPlayStart;
+            printf("ReplaySource: %u frames in %ld ms (%.1f fps)\n", (unsigned int) fFrameIndex,
+                   (long) (elapsed / 1000), elapsed > 0 ? fFrameIndex * 1000000.0 / elapsed : 0.0);
+            _Rewind();
+        }
+
+        const CaptureFrameHeader *frame = (const CaptureFrameHeader *) (fMap + fOffset);
+
+        if (fRealtime) {
+            bigtime_t wait = fPlayStart + frame->timestamp - system_time();
+            if (wait > REPLAY_MAX_SLEEP) {
+                snooze(REPLAY_MAX_SLEEP);
+                return nullptr;
+            }
+            if (wait > 0) snooze(wait);
+        }
+
+        _ApplyFrame(frame);
+        fOffset += sizeof(CaptureFrameHeader) + frame->size;
+        fFrameIndex++;
+        fPending = true;
+    }
+
+    // Every snapshot is still in the pipeline: hold on to this frame rather
+    // than racing ahead of the encoder
+    FrameSnapshot *snapshot = fSnapshots.Capture(fCanvas, fCanvasRowBytes, fConverter);
+    if (!snapshot) {
+        snooze(1000);
+        return nullptr;
+    }
+
+    fPending = false;
+    return snapshot;
+}
+
+void
+ReplaySource::_ApplyFrame(const CaptureFrameHeader *frame) {
+    const int32 tileSize = fHeader->tileSize;
+    const uint8 *in = (const uint8 *) (frame + 1);
+
+    for (uint32 i = 0; i < frame->tileCount; i++) {
+        CaptureTileHeader tile;
+        memcpy(&tile, in, sizeof(tile));
+        in += sizeof(tile);
+
+        int32 tileWidth = fWidth - tile.x * tileSize < tileSize ? fWidth - tile.x * tileSize : tileSize;
+        int32 tileHeight = fHeight - tile.y * tileSize < tileSize ? fHeight - tile.y * tileSize : tileSize;
+
+        uint8 *dst = fCanvas + (size_t) tile.y * tileSize * fCanvasRowBytes + tile.x * tileSize * 4;
+        for (int32 y = 0; y < tileHeight; y++) {
+            memcpy(dst + (size_t) y * fCanvasRowBytes, in, tileWidth * 4);
+            in += tileWidth * 4;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * ReplaySource.h
+ * Plays a capture file back through the pipeline instead of the live screen
+ */
+#ifndef REPLAY_SOURCE_H
+#define REPLAY_SOURCE_H
+
+#include <SupportDefs.h>
+
+#include "CaptureFile.h"
+#include "FrameSource.h"
+#include "PixelConverter.h"
+
+class ReplaySource : public FrameSource {
+public:
+    ReplaySource();
+
+    virtual ~ReplaySource();
+
+    // Maps a file written by FrameRecorder. With 'realtime', frames are served
+    // at their recorded pace, otherwise as fast as the pipeline takes them.
+    // Playback loops at the end of the file.
+    status_t Open(const char *path, bool realtime);
+
+    void Close();
+
+    virtual int32 Width() const { return fWidth; }
+    virtual int32 Height() const { return fHeight; }
+
+    virtual bool IsConnected() const { return fMap != nullptr; }
+
+    virtual FrameSnapshot *Snapshot();
+
+    virtual void ReleaseSnapshot(FrameSnapshot *snapshot) { fSnapshots.Release(snapshot); }
+
+    virtual void SetReportStats(bool report) { fSnapshots.SetReportStats(report); }
+
+    virtual bool PacesItself() const { return true; }
+
+private:
+    int fFile;
+    const uint8 *fMap;
+    size_t fMapSize;
+    const CaptureFileHeader *fHeader;
+
+    int32 fWidth;
+    int32 fHeight;
+    int32 fTilesX;
+    int32 fTilesY;
+    bool fRealtime;
+
+    // Playback position
+    size_t fOffset;
+    uint32 fFrameIndex;
+    bigtime_t fPlayStart;
+    bool fPending; // fCanvas holds a frame no snapshot could take yet
+
+    // The reconstructed frame the tiles are applied to
+    uint8 *fCanvas;
+    int32 fCanvasRowBytes;
+
+    SnapshotPool fSnapshots;
+    PixelConverter fConverter;
+
+    void _Rewind();
+
+    void _ApplyFrame(const CaptureFrameHeader *frame);
+};
+
+#endif // REPLAY_SOURCE_H
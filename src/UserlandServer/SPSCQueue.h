@@ -0,0 +1,51 @@
+/*
+ * SPSCQueue.h
+ * Bounded lock-free single-producer/single-consumer queue
+ */
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <SupportDefs.h>
+#include <atomic>
+
+template<typename T, uint32 kCapacity>
+class SPSCQueue {
+    static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SPSCQueue() : fHead(0), fTail(0) {
+    }
+
+    // Producer side. Returns false if the queue is full.
+    bool Push(const T &item) {
+        const uint32 tail = fTail.load(std::memory_order_relaxed);
+        if (tail - fHead.load(std::memory_order_acquire) == kCapacity) return false;
+
+        fItems[tail & (kCapacity - 1)] = item;
+        fTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool Pop(T &item) {
+        const uint32 head = fHead.load(std::memory_order_relaxed);
+        if (head == fTail.load(std::memory_order_acquire)) return false;
+
+        item = fItems[head & (kCapacity - 1)];
+        fHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty() const {
+        return fHead.load(std::memory_order_acquire) == fTail.load(std::memory_order_acquire);
+    }
+
+private:
+    T fItems[kCapacity];
+
+    // Consumer and producer indices on separate cache lines
+    alignas(64) std::atomic<uint32> fHead;
+    alignas(64) std::atomic<uint32> fTail;
+};
+
+#endif // SPSC_QUEUE_H
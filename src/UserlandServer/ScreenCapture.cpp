@@ -4,12 +4,14 @@
 #include "ScreenCapture.h"
 #include <InterfaceDefs.h>
 #include <WindowScreen.h>
+#include <stdio.h>
 
     // 1x1 Transparent Spy Window at (0,0)
 ScreenCapture::ScreenCapture()
     : BDirectWindow(BRect(0, 0, 0, 0), "ScreenCapture", B_NO_BORDER_WINDOW_LOOK, B_NORMAL_WINDOW_FEEL,
                     B_NOT_MOVABLE | B_NOT_RESIZABLE | B_AVOID_FOCUS | B_AVOID_FRONT | B_NOT_ANCHORED_ON_ACTIVATE),
-      fLock("ScreenCaptureLock"), fScreenBits(nullptr), fRowBytes(0), fWidth(0), fHeight(0) {
+      fLock("ScreenCaptureLock"), fScreenBits(nullptr), fRowBytes(0), fFormat(B_NO_COLOR_SPACE), fWidth(0),
+      fHeight(0) {
     fCaptureView = new BView(BRect(0, 0, 0, 0), "CursorTrackingView", B_FOLLOW_NONE, 0);
     fCaptureView->SetViewColor(B_TRANSPARENT_COLOR);
     AddChild(fCaptureView);
@@ -27,6 +29,9 @@ ScreenCapture::Init() {
     fWidth = (int32) frame.IntegerWidth() + 1;
     fHeight = (int32) frame.IntegerHeight() + 1;
 
+    status_t status = fSnapshots.Init(fWidth, fHeight);
+    if (status != B_OK) return status;
+
     // Strategy: 1x1 Transparent Window at Top-Left
     // We need to be "on screen" to get DirectConnected, but we want to be invisible.
     // Fullscreen window caused visual obstruction. 1x1 should be negligible.
@@ -69,4 +74,21 @@ ScreenCapture::Capture(bool waitRetrace) {
     }
 
     return fScreenBits ? B_OK : B_ERROR;
-}
\ No newline at end of file
+}
+
+FrameSnapshot *
+ScreenCapture::Snapshot() {
+    // Holding the lock keeps DirectConnected() from invalidating the
+    // framebuffer while we copy out of it
+    fLock.Lock();
+
+    // Pick the converter on the capturing thread, not in DirectConnected(),
+    // since loading the CMAP8 palette may need to talk to the app_server
+    if (fScreenBits && fFormat != fConverter.Format()) {
+        if (fConverter.SetFormat(fFormat) == B_OK) printf("ScreenCapture: Framebuffer format 0x%x\n", (unsigned int) fFormat);
+    }
+
+    FrameSnapshot *snapshot = fSnapshots.Capture(fScreenBits, fRowBytes, fConverter);
+    fLock.Unlock();
+    return snapshot;
+}
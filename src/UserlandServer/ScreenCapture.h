@@ -11,7 +11,10 @@
 #include <Locker.h>
 #include <View.h>
 
-class ScreenCapture : public BDirectWindow {
+#include "FrameSource.h"
+#include "PixelConverter.h"
+
+class ScreenCapture : public BDirectWindow, public FrameSource {
 public:
     ScreenCapture();
 
@@ -29,10 +32,19 @@ public:
     const uint8 *GetScreenBits() const { return fScreenBits; }
     uint32 GetRowBytes() const { return fRowBytes; }
 
-    int32 Width() const { return fWidth; }
-    int32 Height() const { return fHeight; }
+    virtual int32 Width() const { return fWidth; }
+    virtual int32 Height() const { return fHeight; }
+
+    virtual bool IsConnected() const { return fScreenBits != nullptr; }
+
+    // Copies the current framebuffer into a stable B_RGB32 snapshot, whatever
+    // the screen's color space (nullptr if not connected, the format is not
+    // supported or all snapshots are busy). Release it once encoded.
+    virtual FrameSnapshot *Snapshot();
 
-    bool IsConnected() const { return fScreenBits != nullptr; }
+    virtual void ReleaseSnapshot(FrameSnapshot *snapshot) { fSnapshots.Release(snapshot); }
+
+    virtual void SetReportStats(bool report) { fSnapshots.SetReportStats(report); }
 
 private:
     BLocker fLock;
@@ -45,6 +57,9 @@ private:
     int32 fHeight;
 
     BView *fCaptureView;
+
+    SnapshotPool fSnapshots;
+    PixelConverter fConverter;
 };
 
 #endif // SCREEN_CAPTURE_H
\ No newline at end of file
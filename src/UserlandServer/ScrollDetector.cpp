@@ -0,0 +1,357 @@
+/*
+ * ScrollDetector.cpp
+ */
+#include "ScrollDetector.h"
+#include "DamageTracker.h"
+#include <string.h>
+
+static const uint32 kHashPrime = 0x01000193;
+static const uint32 kHashSeed = 0x811C9DC5;
+
+static const int32 kMinDirtyTiles = 4;     // Smaller damage is cheaper to just encode
+static const int32 kMaxOffset = 512;       // Largest move searched for, in pixels
+static const int32 kSamplesPerSegment = 16; // Lines per segment voting for an offset
+static const int32 kMaxCandidates = 16;
+static const int32 kMinVotes = 3;
+static const int32 kMinLines = 32; // Smallest moved area worth a copy-rect
+
+// HashMixLanes() on a single lane
+static inline uint32
+MixScalar(uint32 acc, uint32 value) {
+    acc = (acc ^ value) * kHashPrime;
+    return acc ^ (acc >> 15);
+}
+
+ScrollDetector::ScrollDetector()
+    : fWidth(0), fHeight(0), fTilesX(0), fTilesY(0), fPrimed(false) {
+}
+
+ScrollDetector::~ScrollDetector() {
+}
+
+status_t
+ScrollDetector::Init(int32 width, int32 height) {
+    if (width <= 0 || height <= 0) return B_BAD_VALUE;
+
+    const int32 tileSize = DamageTracker::kTileSize;
+
+    fWidth = width;
+    fHeight = height;
+    fTilesX = (width + tileSize - 1) / tileSize;
+    fTilesY = (height + tileSize - 1) / tileSize;
+
+    fRowHashes.assign((size_t) height * fTilesX, 0);
+    fPrevRowHashes.assign((size_t) height * fTilesX, 0);
+    fColumnHashes.assign((size_t) fTilesY * width, 0);
+    fPrevColumnHashes.assign((size_t) fTilesY * width, 0);
+    fColumnAccumulators.assign(width, 0);
+
+    int32 segments = fTilesX > fTilesY ? fTilesX : fTilesY;
+    fFirstLine.resize(segments);
+    fEndLine.resize(segments);
+    fMoving.resize(segments);
+
+    fPrimed = false;
+    return B_OK;
+}
+
+bool
+ScrollDetector::Update(const uint8 *bits, int32 stride, const uint8 *dirtyMap, ScrollMove &move) {
+    if (!bits || fTilesX == 0) return false;
+
+    // Only dirty tiles are rehashed, everything else still matches this frame
+    fPrevRowHashes = fRowHashes;
+    fPrevColumnHashes = fColumnHashes;
+
+    bool primed = fPrimed;
+    _HashTiles(bits, stride, primed ? dirtyMap : nullptr);
+    fPrimed = true;
+    if (!primed || !dirtyMap) return false;
+
+    int32 dirtyCount = 0;
+    for (int32 i = 0; i < fTilesX * fTilesY; i++) {
+        if (dirtyMap[i]) dirtyCount++;
+    }
+    if (dirtyCount < kMinDirtyTiles) return false;
+
+    Axis rows = {fRowHashes.data(), fPrevRowHashes.data(), fHeight, fTilesX, fTilesX, 1, true};
+    if (_FindMove(rows, dirtyMap, move)) return true;
+
+    Axis columns = {fColumnHashes.data(), fPrevColumnHashes.data(), fWidth, fTilesY, 1, fWidth, false};
+    return _FindMove(columns, dirtyMap, move);
+}
+
+// Hashes every row segment of the dirty tiles and, in the same pass, every
+// column segment (all tiles if dirtyMap is null)
+void
+ScrollDetector::_HashTiles(const uint8 *bits, int32 stride, const uint8 *dirtyMap) {
+    const int32 tileSize = DamageTracker::kTileSize;
+
+    for (int32 ty = 0; ty < fTilesY; ty++) {
+        const uint8 *dirtyRow = dirtyMap ? dirtyMap + ty * fTilesX : nullptr;
+        int32 y0 = ty * tileSize;
+        int32 y1 = fHeight - y0 < tileSize ? fHeight : y0 + tileSize;
+
+        bool any = false;
+        for (int32 tx = 0; tx < fTilesX; tx++) {
+            if (dirtyRow && !dirtyRow[tx]) continue;
+            int32 x0 = tx * tileSize;
+            int32 x1 = fWidth - x0 < tileSize ? fWidth : x0 + tileSize;
+            for (int32 x = x0; x < x1; x++) fColumnAccumulators[x] = kHashSeed;
+            any = true;
+        }
+        if (!any) continue;
+
+        for (int32 y = y0; y < y1; y++) {
+            const uint8 *row = bits + (size_t) y * stride;
+            uint32 *rowHashes = &fRowHashes[(size_t) y * fTilesX];
+
+            for (int32 tx = 0; tx < fTilesX; tx++) {
+                if (dirtyRow && !dirtyRow[tx]) continue;
+                int32 x0 = tx * tileSize;
+                int32 x1 = fWidth - x0 < tileSize ? fWidth : x0 + tileSize;
+
+                rowHashes[tx] = _HashRow(row + x0 * 4, x1 - x0);
+                _MixColumns(&fColumnAccumulators[x0], row + x0 * 4, x1 - x0);
+            }
+        }
+
+        for (int32 tx = 0; tx < fTilesX; tx++) {
+            if (dirtyRow && !dirtyRow[tx]) continue;
+            int32 x0 = tx * tileSize;
+            int32 x1 = fWidth - x0 < tileSize ? fWidth : x0 + tileSize;
+            memcpy(&fColumnHashes[(size_t) ty * fWidth + x0], &fColumnAccumulators[x0], (x1 - x0) * 4);
+        }
+    }
+}
+
+bool
+ScrollDetector::_IsDirty(const uint8 *dirtyMap, const Axis &axis, int32 line, int32 segment) const {
+    int32 tile = line / DamageTracker::kTileSize;
+    return axis.vertical ? dirtyMap[tile * fTilesX + segment] != 0 : dirtyMap[segment * fTilesX + tile] != 0;
+}
+
+// The move along one axis: the most common offset between matching line
+// segments, then the widest run of segments that agree on it and the longest
+// run of lines that match across all of them
+bool
+ScrollDetector::_FindMove(const Axis &axis, const uint8 *dirtyMap, ScrollMove &move) {
+    const int32 tileSize = DamageTracker::kTileSize;
+
+    for (int32 s = 0; s < axis.segments; s++) {
+        fFirstLine[s] = axis.lines;
+        fEndLine[s] = 0;
+        for (int32 line = 0; line < axis.lines; line += tileSize) {
+            if (!_IsDirty(dirtyMap, axis, line, s)) continue;
+            if (fFirstLine[s] == axis.lines) fFirstLine[s] = line;
+            fEndLine[s] = axis.lines - line < tileSize ? axis.lines : line + tileSize;
+        }
+    }
+
+    int32 offset = _FindOffset(axis);
+    if (offset == 0) return false;
+
+    // Segments mostly made of moved lines
+    for (int32 s = 0; s < axis.segments; s++) {
+        const uint32 *current = axis.current + s * axis.segmentStride;
+        const uint32 *previous = axis.previous + s * axis.segmentStride;
+
+        int32 first = fFirstLine[s] - offset < 0 ? offset : fFirstLine[s];
+        int32 end = fEndLine[s] - offset > axis.lines ? axis.lines + offset : fEndLine[s];
+
+        int32 matched = 0;
+        for (int32 line = first; line < end; line++) {
+            if (current[line * axis.lineStride] == previous[(line - offset) * axis.lineStride]) matched++;
+        }
+        fMoving[s] = fEndLine[s] > fFirstLine[s] && matched * 2 >= fEndLine[s] - fFirstLine[s];
+    }
+
+    int32 bandFirst = 0, bandEnd = 0;
+    for (int32 s = 0; s < axis.segments;) {
+        if (!fMoving[s]) {
+            s++;
+            continue;
+        }
+        int32 start = s;
+        while (s < axis.segments && fMoving[s]) s++;
+        if (s - start > bandEnd - bandFirst) {
+            bandFirst = start;
+            bandEnd = s;
+        }
+    }
+    if (bandEnd == bandFirst) return false;
+
+    int32 first = axis.lines, end = 0;
+    for (int32 s = bandFirst; s < bandEnd; s++) {
+        if (fFirstLine[s] < first) first = fFirstLine[s];
+        if (fEndLine[s] > end) end = fEndLine[s];
+    }
+    if (first - offset < 0) first = offset;
+    if (end - offset > axis.lines) end = axis.lines + offset;
+
+    // Longest run of lines that moved across the whole band
+    int32 runFirst = 0, runEnd = 0;
+    for (int32 line = first; line < end;) {
+        int32 start = line;
+        for (; line < end; line++) {
+            int32 s = bandFirst;
+            for (; s < bandEnd; s++) {
+                const uint32 *current = axis.current + s * axis.segmentStride;
+                const uint32 *previous = axis.previous + s * axis.segmentStride;
+                if (current[line * axis.lineStride] != previous[(line - offset) * axis.lineStride]) break;
+            }
+            if (s < bandEnd) break;
+        }
+        if (line - start > runEnd - runFirst) {
+            runFirst = start;
+            runEnd = line;
+        }
+        line++;
+    }
+    if (runEnd - runFirst < kMinLines) return false;
+
+    int32 across = axis.vertical ? fWidth : fHeight;
+    int32 bandStart = bandFirst * tileSize;
+    int32 bandStop = across - bandEnd * tileSize < 0 ? across : bandEnd * tileSize;
+
+    if (axis.vertical) {
+        move.x = bandStart;
+        move.width = bandStop - bandStart;
+        move.y = runFirst;
+        move.height = runEnd - runFirst;
+        move.dx = 0;
+        move.dy = offset;
+    } else {
+        move.x = runFirst;
+        move.width = runEnd - runFirst;
+        move.y = bandStart;
+        move.height = bandStop - bandStart;
+        move.dx = offset;
+        move.dy = 0;
+    }
+    return true;
+}
+
+// Votes for an offset with a few distinctive lines of each damaged segment,
+// each one matched against the nearest identical line of the previous frame.
+// Returns 0 if no offset got enough votes.
+int32
+ScrollDetector::_FindOffset(const Axis &axis) {
+    int32 offsets[kMaxCandidates];
+    int32 votes[kMaxCandidates];
+    int32 candidates = 0;
+
+    for (int32 s = 0; s < axis.segments; s++) {
+        int32 first = fFirstLine[s], end = fEndLine[s];
+        if (first >= end) continue;
+
+        int32 step = (end - first) / kSamplesPerSegment;
+        if (step < 1) step = 1;
+
+        const uint32 *current = axis.current + s * axis.segmentStride;
+        const uint32 *previous = axis.previous + s * axis.segmentStride;
+
+        for (int32 sample = first + 1; sample < end; sample += step) {
+            // The first useful line of this step. Plain lines (background,
+            // gaps between text lines) match anywhere, unchanged ones carry no
+            // information. Checking both neighbours also drops the first line
+            // of a plain run: with periodic content (lines of text) those all
+            // vote for the same wrong offset. Looking on instead of skipping
+            // the sample keeps a step that is a multiple of the content's
+            // period from landing on plain lines every time.
+            int32 line = sample;
+            int32 stop = sample + step < end ? sample + step : end;
+            uint32 hash = 0;
+            for (; line < stop; line++) {
+                hash = current[line * axis.lineStride];
+                if (hash == current[(line - 1) * axis.lineStride]) continue;
+                if (line + 1 < axis.lines && hash == current[(line + 1) * axis.lineStride]) continue;
+                if (hash == previous[line * axis.lineStride]) continue;
+                break;
+            }
+            if (line == stop) continue;
+
+            int32 offset = 0;
+            for (int32 distance = 1; distance <= kMaxOffset && offset == 0; distance++) {
+                if (line - distance >= 0 && previous[(line - distance) * axis.lineStride] == hash)
+                    offset = distance;
+                else if (line + distance < axis.lines && previous[(line + distance) * axis.lineStride] == hash)
+                    offset = -distance;
+            }
+            if (offset == 0) continue;
+
+            int32 i = 0;
+            while (i < candidates && offsets[i] != offset) i++;
+            if (i == candidates) {
+                if (candidates == kMaxCandidates) continue;
+                offsets[candidates] = offset;
+                votes[candidates] = 0;
+                candidates++;
+            }
+            votes[i]++;
+        }
+    }
+
+    int32 best = 0, bestVotes = kMinVotes - 1;
+    for (int32 i = 0; i < candidates; i++) {
+        if (votes[i] > bestVotes) {
+            best = offsets[i];
+            bestVotes = votes[i];
+        }
+    }
+    return best;
+}
+
+uint32
+ScrollDetector::_HashRow(const uint8 *src, int32 pixels) {
+    const __m128i kPrime = _mm_set1_epi32(kHashPrime);
+    const __m128i kSeed = _mm_set1_epi32(kHashSeed);
+
+    __m128i a0 = kSeed, a1 = kSeed, a2 = kSeed, a3 = kSeed;
+
+    int32 x = 0;
+    for (; x + 16 <= pixels; x += 16) {
+        const __m128i *p = reinterpret_cast<const __m128i *>(src + x * 4);
+        a0 = HashMixLanes(a0, _mm_loadu_si128(p), kPrime);
+        a1 = HashMixLanes(a1, _mm_loadu_si128(p + 1), kPrime);
+        a2 = HashMixLanes(a2, _mm_loadu_si128(p + 2), kPrime);
+        a3 = HashMixLanes(a3, _mm_loadu_si128(p + 3), kPrime);
+    }
+    for (; x + 4 <= pixels; x += 4)
+        a0 = HashMixLanes(a0, _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4)), kPrime);
+
+    uint32 lanes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), a0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 4), a1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 8), a2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 12), a3);
+
+    uint32 hash = kHashSeed;
+    for (int32 i = 0; i < 16; i++) hash = MixScalar(hash, lanes[i]);
+
+    for (; x < pixels; x++) {
+        uint32 pixel;
+        memcpy(&pixel, src + x * 4, 4);
+        hash = MixScalar(hash, pixel);
+    }
+    return hash;
+}
+
+// Feeds one row into the per-column accumulators, four columns at a time
+void
+ScrollDetector::_MixColumns(uint32 *acc, const uint8 *src, int32 pixels) {
+    const __m128i kPrime = _mm_set1_epi32(kHashPrime);
+
+    int32 x = 0;
+    for (; x + 4 <= pixels; x += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + x));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + x), HashMixLanes(a, v, kPrime));
+    }
+
+    for (; x < pixels; x++) {
+        uint32 pixel;
+        memcpy(&pixel, src + x * 4, 4);
+        acc[x] = MixScalar(acc[x], pixel);
+    }
+}
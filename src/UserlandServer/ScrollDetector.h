@@ -0,0 +1,86 @@
+/*
+ * ScrollDetector.h
+ * Finds regions that moved between consecutive frames (scrolling, dragging)
+ */
+#ifndef SCROLL_DETECTOR_H
+#define SCROLL_DETECTOR_H
+
+#include <SupportDefs.h>
+#include <vector>
+
+// A rectangle of the new frame whose content is the previous frame's content
+// at (x - dx, y - dy)
+struct ScrollMove {
+    int32 x;
+    int32 y;
+    int32 width;
+    int32 height;
+    int32 dx;
+    int32 dy;
+};
+
+class ScrollDetector {
+public:
+    ScrollDetector();
+
+    ~ScrollDetector();
+
+    // (Re)allocates the line hashes for a frame size. The next Update() only
+    // primes them.
+    status_t Init(int32 width, int32 height);
+
+    // Rehashes the dirty tiles of a B_RGB32 frame (dirtyMap as produced by
+    // DamageTracker for the same frame) and looks for a vertical, then a
+    // horizontal, move inside the damage. Returns true and fills 'move' if one
+    // was found.
+    bool Update(const uint8 *bits, int32 stride, const uint8 *dirtyMap, ScrollMove &move);
+
+    void Invalidate() { fPrimed = false; }
+
+private:
+    // One axis of the search: hashes of line segments, a line being a pixel
+    // row (vertical moves) or column (horizontal moves) and a segment its
+    // slice through one tile
+    struct Axis {
+        const uint32 *current;
+        const uint32 *previous;
+        int32 lines;
+        int32 segments;
+        int32 lineStride;
+        int32 segmentStride;
+        bool vertical;
+    };
+
+    int32 fWidth;
+    int32 fHeight;
+    int32 fTilesX;
+    int32 fTilesY;
+
+    // Row segments: [y * fTilesX + tileX], column segments: [tileY * fWidth + x]
+    std::vector<uint32> fRowHashes;
+    std::vector<uint32> fPrevRowHashes;
+    std::vector<uint32> fColumnHashes;
+    std::vector<uint32> fPrevColumnHashes;
+    std::vector<uint32> fColumnAccumulators;
+
+    // Per segment of the axis being searched
+    std::vector<int32> fFirstLine;
+    std::vector<int32> fEndLine;
+    std::vector<uint8> fMoving;
+
+    bool fPrimed;
+
+    void _HashTiles(const uint8 *bits, int32 stride, const uint8 *dirtyMap);
+
+    bool _FindMove(const Axis &axis, const uint8 *dirtyMap, ScrollMove &move);
+
+    int32 _FindOffset(const Axis &axis);
+
+    bool _IsDirty(const uint8 *dirtyMap, const Axis &axis, int32 line, int32 segment) const;
+
+    static uint32 _HashRow(const uint8 *src, int32 pixels);
+
+    static void _MixColumns(uint32 *acc, const uint8 *src, int32 pixels);
+};
+
+#endif // SCROLL_DETECTOR_H
@@ -0,0 +1,52 @@
+/*
+ * SendQueue.cpp
+ * A client's outgoing bytes, double buffered between the senders and the
+ * network thread
+ */
+#include "SendQueue.h"
+#include <string.h>
+
+SendQueue::SendQueue()
+    : fWritten(0),
+      fUnsent(0) {
+}
+
+bool
+SendQueue::Append(const struct iovec *vec, int count, size_t limit) {
+    if (limit > 0 && fUnsent > limit) return false;
+
+    size_t size = 0;
+    for (int i = 0; i < count; i++) size += vec[i].iov_len;
+
+    size_t offset = fAppended.size();
+    fAppended.resize(offset + size);
+    for (int i = 0; i < count; i++) {
+        memcpy(fAppended.data() + offset, vec[i].iov_base, vec[i].iov_len);
+        offset += vec[i].iov_len;
+    }
+
+    fUnsent += size;
+    return true;
+}
+
+void
+SendQueue::Take() {
+    if (fWritten < fWriting.size() || fAppended.empty()) return;
+
+    // Swapped rather than moved, both keep their capacity
+    fWriting.swap(fAppended);
+    fAppended.clear();
+    fWritten = 0;
+}
+
+const uint8 *
+SendQueue::Pending(size_t &size) const {
+    size = fWriting.size() - fWritten;
+    return fWriting.data() + fWritten;
+}
+
+void
+SendQueue::Written(size_t bytes) {
+    fWritten += bytes;
+    fUnsent -= bytes;
+}
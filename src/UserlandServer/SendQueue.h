@@ -0,0 +1,42 @@
+/*
+ * SendQueue.h
+ * A client's outgoing bytes: appended by any thread under the server lock,
+ * written out by the network thread without it
+ */
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <SupportDefs.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <vector>
+
+class SendQueue {
+public:
+    SendQueue();
+
+    // Appends a message, unless 'limit' is not 0 and more than that many
+    // bytes are still unsent. The check is made before appending, so a
+    // keyframe bigger than the limit still gets into a drained queue.
+    bool Append(const struct iovec *vec, int count, size_t limit = 0);
+
+    // Appended but not written yet, may be read without the lock
+    size_t Unsent() const { return fUnsent; }
+
+    // With the lock held: once the bytes being written are all out, moves
+    // the ones appended since over to be written next
+    void Take();
+
+    // Without the lock, from the writing thread only: the bytes to write,
+    // and how many of them went out
+    const uint8 *Pending(size_t &size) const;
+    void Written(size_t bytes);
+
+private:
+    std::vector<uint8> fAppended;
+    std::vector<uint8> fWriting;
+    size_t fWritten; // Of fWriting
+    std::atomic<size_t> fUnsent;
+};
+
+#endif // SEND_QUEUE_H
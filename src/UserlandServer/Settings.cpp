@@ -3,6 +3,7 @@
  * Persistent Settings Manager
  */
 #include "Settings.h"
+#include "EncoderProfile.h"
 #include <File.h>
 #include <FindDirectory.h>
 #include <Path.h>
@@ -15,7 +16,7 @@
 #include <stdlib.h>
 
 Settings::Settings()
-    : fPort(8443) {
+    : fPort(8443), fEncoderProfile(kDefaultEncoderProfile) {
     
     // Set default paths to be inside the settings directory
     BPath path;
@@ -114,6 +115,9 @@ status_t Settings::Load() {
 
     if (msg.FindString("key_path", &str) == B_OK) fSSLKeyPath = str;
     // Keep default if not found
+
+    // Profiles may be renamed or dropped between versions
+    if (msg.FindString("encoder_profile", &str) == B_OK && EncoderProfileFor(str)) fEncoderProfile = str;
     
     return B_OK;
 }
@@ -139,6 +143,7 @@ status_t Settings::Save() {
     msg.AddUInt16("port", fPort);
     msg.AddString("cert_path", fSSLCertPath);
     msg.AddString("key_path", fSSLKeyPath);
+    msg.AddString("encoder_profile", fEncoderProfile);
 
     return msg.Flatten(&file);
 }
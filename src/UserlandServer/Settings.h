@@ -25,6 +25,10 @@ public:
 
     const char* SSLKeyPath() const { return fSSLKeyPath.String(); }
     void SetSSLKeyPath(const char* path) { fSSLKeyPath = path; }
+
+    // Name of the EncoderProfile streams start with, clients may pick another
+    const char* EncoderProfileName() const { return fEncoderProfile.String(); }
+    void SetEncoderProfileName(const char* name) { fEncoderProfile = name; }
     
     // New Methods for UI
     status_t GenerateCertificates();
@@ -35,6 +39,7 @@ private:
     uint16 fPort;
     BString fSSLCertPath;
     BString fSSLKeyPath;
+    BString fEncoderProfile;
 };
 
 #endif // SETTINGS_H
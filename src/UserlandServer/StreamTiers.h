@@ -0,0 +1,88 @@
+/*
+ * StreamTiers.h
+ * Simulcast quality tiers: the stream is encoded once per tier, and every
+ * client watches the tier its own link can carry
+ */
+#ifndef STREAM_TIERS_H
+#define STREAM_TIERS_H
+
+#include <SupportDefs.h>
+
+struct StreamTier {
+    int32 scalePercent; // Of the stream size
+    int32 minKbps;      // Clients estimated below this drop to the next tier
+    int32 maxKbps;
+};
+
+static const int32 kStreamTierCount = 3;
+
+// Best first. Lower tiers are also smaller, so a starved link gets a softer
+// picture rather than a blocky one.
+static const StreamTier kStreamTiers[kStreamTierCount] = {
+    {100, 2000, 8000},
+    {75, 800, 2000},
+    {50, 0, 800},
+};
+
+// Where a new client starts, before any round trip was measured
+static const int32 kInitialClientKbps = 2000;
+
+// The tier for a client's estimated bandwidth. Moving up takes a 25% margin
+// over the better tier's minimum, so a client close to a boundary doesn't
+// flip back and forth: every switch costs a keyframe.
+static inline int32
+StreamTierFor(int32 kbps, int32 current) {
+    int32 tier = current;
+    while (tier < kStreamTierCount - 1 && kbps < kStreamTiers[tier].minKbps) tier++;
+    while (tier > 0 && kbps >= kStreamTiers[tier - 1].minKbps * 5 / 4) tier--;
+    return tier;
+}
+
+// Encoder bitrate of a tier: its slowest client's, within the tier's range
+static inline int32
+StreamTierKbps(int32 tier, int32 slowestKbps) {
+    if (slowestKbps < kStreamTiers[tier].minKbps) return kStreamTiers[tier].minKbps;
+    if (slowestKbps > kStreamTiers[tier].maxKbps) return kStreamTiers[tier].maxKbps;
+    return slowestKbps;
+}
+
+// Size of the stream for a screen and the client's view: fit into the view,
+// keeping the aspect ratio and never scaling up. A view of 0 is not known
+// yet. Even on every path, an odd screen mode included: 4:2:0 encoders need
+// whole chroma samples.
+static inline void
+StreamSizeFor(int32 width, int32 height, int32 viewWidth, int32 viewHeight, int32 &streamWidth,
+              int32 &streamHeight) {
+    streamWidth = width;
+    streamHeight = height;
+
+    bool fits = viewWidth <= 0 || viewHeight <= 0 || (viewWidth >= width && viewHeight >= height);
+    if (!fits && (int64) viewWidth * height < (int64) viewHeight * width) {
+        streamHeight = (int32) ((int64) height * viewWidth / width);
+        streamWidth = viewWidth;
+    } else if (!fits) {
+        streamWidth = (int32) ((int64) width * viewHeight / height);
+        streamHeight = viewHeight;
+    }
+
+    streamWidth = streamWidth < 16 ? 16 : streamWidth & ~1;
+    streamHeight = streamHeight < 16 ? 16 : streamHeight & ~1;
+}
+
+// Encoder size of a tier. Scaled tiers are even and at least 16 pixels, like
+// a stream scaled to the client's view.
+static inline void
+StreamTierSize(int32 tier, int32 width, int32 height, int32 &tierWidth, int32 &tierHeight) {
+    if (kStreamTiers[tier].scalePercent == 100) {
+        tierWidth = width;
+        tierHeight = height;
+        return;
+    }
+
+    tierWidth = width * kStreamTiers[tier].scalePercent / 100;
+    tierHeight = height * kStreamTiers[tier].scalePercent / 100;
+    tierWidth = tierWidth < 16 ? 16 : tierWidth & ~1;
+    tierHeight = tierHeight < 16 ? 16 : tierHeight & ~1;
+}
+
+#endif // STREAM_TIERS_H
@@ -0,0 +1,43 @@
+/*
+ * TemporalLayers.h
+ * Temporal layers of the video stream: the pattern they are encoded in and
+ * how a frame's layer travels in its meta byte
+ */
+#ifndef TEMPORAL_LAYERS_H
+#define TEMPORAL_LAYERS_H
+
+#include <SupportDefs.h>
+
+// VP9's 0-2-1-2 pattern, repeating from every keyframe: the base layer runs
+// at a quarter of the frame rate, layer 1 adds the next quarter, layer 2 the
+// rest. A frame only refers to frames of its own layer or below.
+static const int32 kLayerPeriod = 4;
+static const int32 kLayerPattern[kLayerPeriod] = {0, 2, 1, 2};
+
+// The meta byte has two bits for the layer
+static const int32 kMaxLayers = 4;
+
+// Layer of the frame 'frame' frames after a keyframe, which is frame 0 and
+// always in the base layer
+static inline int32
+LayerOfFrame(int64 frame) {
+    return kLayerPattern[frame % kLayerPeriod];
+}
+
+// The byte in front of every video frame: bit 0 keyframe, bits 1-2 layer
+static inline uint8
+FrameMetaByte(bool isKey, int32 layer) {
+    return (isKey ? 0x01 : 0x00) | (uint8) ((layer & (kMaxLayers - 1)) << 1);
+}
+
+static inline bool
+MetaByteIsKey(uint8 meta) {
+    return (meta & 0x01) != 0;
+}
+
+static inline int32
+MetaByteLayer(uint8 meta) {
+    return (meta >> 1) & (kMaxLayers - 1);
+}
+
+#endif // TEMPORAL_LAYERS_H
@@ -1,63 +1,100 @@
 /*
  * VideoEncoder.h
- * Encapsulates VP9 Encoder and Color Conversion
+ * Encapsulates the codec backends and Color Conversion
  */
 #ifndef VIDEO_ENCODER_H
 #define VIDEO_ENCODER_H
 
-#include <vpx/vpx_encoder.h>
-#include <vpx/vp8cx.h>
-#include <smmintrin.h> // SSE4.1
-#include <immintrin.h> // AVX
 #include <String.h>
-#include <x264.h>
+#include <vector>
+
+#include "ColorConvert.h"
+#include "EncoderBackend.h"
+#include "FrameBufferPool.h"
+#include "WorkerPool.h"
 
 class VideoEncoder {
 public:
-    VideoEncoder();
+    static const int32 kFrameCount = 3;
+
+    // Without a pool of conversion threads, the encoder starts its own
+    VideoEncoder(WorkerPool *convertWorkers = nullptr);
 
     ~VideoEncoder();
 
-    status_t Init(const int width, const int height, int32 bitrateKbps = 2000, const char *codec = "vp8");
+    // codec is any name EncoderBackend::Create() knows. fullChroma asks for
+    // 4:4:4 (VP9 profile 1, H.264 High 4:4:4, AV1 High), so colored text
+    // stays sharp. VP8 has no such mode and ignores it. Without a profile,
+    // kDefaultEncoderProfile is used.
+    status_t Init(const int width, const int height, int32 bitrateKbps = 2000, const char *codec = "vp8",
+                  bool fullChroma = false, const EncoderProfile *profile = nullptr);
+
+    int32 Width() const { return fWidth; }
+    int32 Height() const { return fHeight; }
+
+    // Converted frames owned by the encoder, valid until the next Init()
+    int32 CountFrames() const { return fBackend ? kFrameCount : 0; }
+    YUVFrame *FrameAt(int32 index) { return &fFrames[index]; }
 
-    // Encodes raw RGB bits. Returns encoded packets via iterator.
-    // Use GetNextPacket loop after calling Encode.
-    status_t Encode(const uint8 *bits, int32 stride, int64 pts, const bool forceKeyframe);
+    // Size of the frames' changedBlocks maps
+    int32 BlockColumns() const { return (fWidth + kBlockSize - 1) / kBlockSize; }
+    int32 BlockRows() const { return (fHeight + kBlockSize - 1) / kBlockSize; }
 
-    const vpx_codec_cx_pkt_t *GetNextPacket(vpx_codec_iter_t *iter);
+    // Converts raw RGB bits into one of our frames. Only touches 'frame', so it
+    // may run on a different thread than Encode(). Frames keep their contents
+    // between uses: with rects, only those parts are converted again.
+    void Convert(const uint8 *bits, int32 stride, YUVFrame *frame, const clipping_rect *rects = nullptr,
+                 int32 count = 0);
+
+    // Encodes a converted frame. The frame may be reused as soon as this
+    // returns, the spans in 'out' stay valid until the next call.
+    status_t Encode(YUVFrame *frame, EncodedFrame &out);
 
     void SetBitrate(int32 kbps);
 
+    // Kept across Init()
+    void SetFrameRate(int32 fps);
+
+    // Changes the frame size without a new Init(), where the codec can do
+    // that: same codec, settings and rate control state. The frames are
+    // reallocated, so the same rules as for Init() apply.
+    status_t Resize(const int width, const int height);
+
     const char *GetCodecName() const;
-    
-    // H.264 Specific
-    bool GetExtraData(uint8 **data, size_t *size);
+
+    const char *ProfileName() const { return fProfile->name; }
+
+    // Temporal layers the codec splits the stream into, see EncodedFrame
+    int32 CountLayers() const { return fBackend ? fBackend->CountLayers() : 1; }
+
+    // The conversion threads, free for other per-frame work on the thread
+    // that calls Convert()
+    WorkerPool *ConvertWorkers() { return fConvertWorkers; }
+
+    bool IsFullChroma() const { return fFullChroma; }
 
 private:
-    vpx_codec_ctx_t fCodec;
-    vpx_codec_enc_cfg_t fVpxCfg;
-    vpx_image_t *fVpxImg;
-    
-    // H.264 State
-    x264_t *fX264Codec;
-    x264_param_t fX264Param;
-    x264_picture_t fX264PicIn;
-    x264_picture_t fX264PicOut;
-    x264_nal_t *fNals;
-    int fNalCount;
-    int fCurrentNal;
-    
-    // Wrapper to return X264 data as VPX packet to avoid changing server.cpp too much
-    vpx_codec_cx_pkt_t fFakePkt;
-
-    bool fInitialized;
-
-    // SIMD Color Conversion
-    void _RGBToYUV420(const uint8 *rgb, int32 stride, vpx_image_t *img, const int width, const int height);
-    // Overload for x264 picture
-    void _RGBToYUV420_X264(const uint8 *rgb, int32 stride, x264_picture_t *pic, const int width, const int height);
+    EncoderBackend *fBackend;
+
+    YUVFrame fFrames[kFrameCount];
+    FrameBufferPool fFramePool; // Kept across Init()
+    std::vector<uint8> fChangedBlocks[kFrameCount];
+
+    int32 fWidth;
+    int32 fHeight;
+
+    ColorConverter fColorConverter;
+    WorkerPool *fConvertWorkers;
+    WorkerPool fOwnWorkers;
+
+    status_t _AllocFrames(const int width, const int height);
+
+    void _FreeFrames();
 
     BString fCodecName;
+    bool fFullChroma;
+    const EncoderProfile *fProfile;
+    int32 fFrameRate;
 };
 
-#endif // VIDEO_ENCODER_H
\ No newline at end of file
+#endif // VIDEO_ENCODER_H
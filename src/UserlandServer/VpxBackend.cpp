@@ -0,0 +1,266 @@
+/*
+ * VpxBackend.cpp
+ */
+#include "VpxBackend.h"
+#include "TemporalLayers.h"
+#include <stdio.h>
+#include <string.h>
+
+// Attempt to include VP9 header
+#if __has_include(<vpx/vp9cx.h>)
+#include <vpx/vp9cx.h>
+#else
+// Fallback declaration if header is missing but library has it
+extern "C" vpx_codec_iface_t *vpx_codec_vp9_cx(void);
+#endif
+
+// VP9 is encoded in three temporal layers at 1/4, 1/2 and the full frame
+// rate (kLayerPattern), every layer adding to the bitrate of those below
+static const int32 kLayerCount = 3;
+static const int32 kLayerBitratePercent[kLayerCount] = {60, 80, 100};
+
+// Quantizer cap of each refinement step, out of 63
+static const uint32 kRefineMaxQuantizer[kRefineSteps] = {32, 20, 12, 4};
+
+VpxBackend::VpxBackend(bool vp9)
+    : fVP9(vp9), fFullChroma(false), fInitialized(false), fLayerCount(1), fFrameRate(30), fStaticThreshold(0),
+      fRefineStep(0), fRefineLossless(false),
+      fConfig(), fMinQuantizer(0), fMaxQuantizer(63), fActiveMapSet(false) {
+    memset(&fCodec, 0, sizeof(fCodec));
+    memset(&fImage, 0, sizeof(fImage));
+}
+
+VpxBackend::~VpxBackend() {
+    if (fInitialized) vpx_codec_destroy(&fCodec);
+}
+
+status_t
+VpxBackend::Init(int32 width, int32 height, int32 bitrateKbps, bool fullChroma, const EncoderProfile &profile) {
+    vpx_codec_iface_t *iface = fVP9 ? vpx_codec_vp9_cx() : vpx_codec_vp8_cx();
+    fFullChroma = fullChroma && fVP9;
+
+    if (const vpx_codec_err_t res = vpx_codec_enc_config_default(iface, &fConfig, 0)) {
+        fprintf(stderr, "Failed to get config: %s\n", vpx_codec_err_to_string(res));
+        return B_ERROR;
+    }
+
+    fConfig.g_w = width;
+    fConfig.g_h = height;
+    fConfig.rc_target_bitrate = bitrateKbps;
+    fConfig.g_timebase.num = 1;
+    fConfig.g_timebase.den = kTimebase;
+    fConfig.g_threads = ThreadsFor(width, height);
+    fConfig.g_lag_in_frames = 0; // Low latency
+    if (fFullChroma) fConfig.g_profile = 1; // 8-bit 4:4:4
+    fMinQuantizer = fConfig.rc_min_quantizer;
+    fMaxQuantizer = fConfig.rc_max_quantizer;
+    fStaticThreshold = fVP9 ? 0 : profile.vp8StaticThreshold;
+    fRefineStep = 0;
+    fRefineLossless = false;
+
+    // VP8 would need the reference pattern done by hand, VP9 knows it. Layer
+    // rate control only works in CBR mode.
+    fLayerCount = fVP9 ? kLayerCount : 1;
+    if (fLayerCount > 1) {
+        fConfig.rc_end_usage = VPX_CBR;
+        fConfig.rc_undershoot_pct = 50;
+        fConfig.rc_overshoot_pct = 50;
+        fConfig.rc_buf_initial_sz = 500;
+        fConfig.rc_buf_optimal_sz = 600;
+        fConfig.rc_buf_sz = 1000;
+
+        fConfig.ss_number_layers = 1;
+        fConfig.ts_number_layers = fLayerCount;
+        fConfig.ts_periodicity = kLayerPeriod;
+        for (int32 i = 0; i < kLayerPeriod; i++) fConfig.ts_layer_id[i] = kLayerPattern[i];
+        fConfig.ts_rate_decimator[0] = 4;
+        fConfig.ts_rate_decimator[1] = 2;
+        fConfig.ts_rate_decimator[2] = 1;
+        fConfig.temporal_layering_mode = VP9E_TEMPORAL_LAYERING_MODE_0212;
+        _SetLayerBitrates(bitrateKbps);
+    }
+
+    fActiveMap.Init(width, height, _ActiveMapPeriod());
+    fActiveMapSet = false;
+
+    if (vpx_codec_enc_init(&fCodec, iface, &fConfig, MeasureQuality() ? VPX_CODEC_USE_PSNR : 0)) {
+        fprintf(stderr, "Failed to init codec: %s\n", vpx_codec_error(&fCodec));
+        return B_ERROR;
+    }
+    fInitialized = true;
+
+    // Realtime settings
+    if (!fVP9) {
+        vpx_codec_control(&fCodec, VP8E_SET_CPUUSED, profile.vp8Speed);
+        vpx_codec_control(&fCodec, VP8E_SET_STATIC_THRESHOLD, fStaticThreshold);
+        vpx_codec_control(&fCodec, VP8E_SET_NOISE_SENSITIVITY, 0);
+        // One token partition per thread, up to the 8 VP8 allows (log2)
+        int32 partitions = 0;
+        while (partitions < 3 && (2 << partitions) <= (int32) fConfig.g_threads) partitions++;
+        vpx_codec_control(&fCodec, VP8E_SET_TOKEN_PARTITIONS, partitions);
+        vpx_codec_control(&fCodec, VP8E_SET_SCREEN_CONTENT_MODE, profile.screenContent ? 1 : 0);
+    } else {
+        vpx_codec_control(&fCodec, VP8E_SET_CPUUSED, profile.vp9Speed);
+        // Rows of superblocks are encoded in parallel within each tile
+        vpx_codec_control(&fCodec, VP9E_SET_ROW_MT, 1);
+        vpx_codec_control(&fCodec, VP9E_SET_TILE_COLUMNS, TileColumnsFor(width, fConfig.g_threads));
+        vpx_codec_control(&fCodec, VP9E_SET_TUNE_CONTENT,
+                          profile.screenContent ? VP9E_CONTENT_SCREEN : VP9E_CONTENT_DEFAULT);
+
+        if (fLayerCount > 1) {
+            vpx_codec_control(&fCodec, VP9E_SET_SVC, 1);
+            _SetLayerQuantizers();
+        }
+    }
+
+    return B_OK;
+}
+
+void
+VpxBackend::SetBitrate(int32 kbps) {
+    if (!fInitialized) return;
+
+    fConfig.rc_target_bitrate = kbps;
+    if (fLayerCount > 1) _SetLayerBitrates(kbps);
+    if (const vpx_codec_err_t res = vpx_codec_enc_config_set(&fCodec, &fConfig)) {
+        fprintf(stderr, "Failed to update bitrate: %s\n", vpx_codec_err_to_string(res));
+    }
+}
+
+// Smaller than the first size works with every libvpx, larger depending on
+// its version: it then starts with a keyframe at the new size
+status_t
+VpxBackend::Resize(int32 width, int32 height) {
+    if (!fInitialized) return B_NO_INIT;
+
+    vpx_codec_enc_cfg_t config = fConfig;
+    config.g_w = width;
+    config.g_h = height;
+    if (vpx_codec_enc_config_set(&fCodec, &config) != VPX_CODEC_OK) return B_NOT_SUPPORTED;
+    fConfig = config;
+
+    // The encoder drops a map of the old size on its own, but make sure
+    fActiveMap.Init(width, height, _ActiveMapPeriod());
+    fActiveMapSet = true;
+    return B_OK;
+}
+
+// A frame may refer as far back as the layer pattern repeats
+int32
+VpxBackend::_ActiveMapPeriod() const {
+    return fLayerCount > 1 ? fConfig.ts_periodicity : 1;
+}
+
+// The targets are cumulative: a layer's includes all layers below it
+void
+VpxBackend::_SetLayerBitrates(int32 kbps) {
+    for (int32 i = 0; i < fLayerCount; i++) {
+        fConfig.ts_target_bitrate[i] = kbps * kLayerBitratePercent[i] / 100;
+        fConfig.layer_target_bitrate[i] = fConfig.ts_target_bitrate[i];
+    }
+}
+
+// With layers, the quantizer range is per layer and fConfig's is ignored
+void
+VpxBackend::_SetLayerQuantizers() {
+    vpx_svc_extra_cfg_t svc;
+    memset(&svc, 0, sizeof(svc));
+    for (int32 i = 0; i < fLayerCount; i++) {
+        svc.max_quantizers[i] = fConfig.rc_max_quantizer;
+        svc.min_quantizers[i] = fConfig.rc_min_quantizer;
+    }
+    svc.scaling_factor_num[0] = 1;
+    svc.scaling_factor_den[0] = 1;
+    vpx_codec_control(&fCodec, VP9E_SET_SVC_PARAMETERS, &svc);
+}
+
+// Refinement frames cap the quantizer, and VP8 codes the blocks that differ
+// by less than its static threshold, too: those are what needs refining. VP9
+// codes a lossless step at quantizer 0, its lossless mode, whatever the
+// layer it falls in.
+void
+VpxBackend::_SetRefineStep(int32 step, bool lossless) {
+    fRefineStep = step;
+    fRefineLossless = lossless;
+
+    uint32 maxQuantizer = fMaxQuantizer;
+    if (step > 0 && kRefineMaxQuantizer[step - 1] < maxQuantizer) maxQuantizer = kRefineMaxQuantizer[step - 1];
+    if (maxQuantizer < fMinQuantizer) maxQuantizer = fMinQuantizer;
+    fConfig.rc_min_quantizer = lossless ? 0 : fMinQuantizer;
+    fConfig.rc_max_quantizer = lossless ? 0 : maxQuantizer;
+
+    if (const vpx_codec_err_t res = vpx_codec_enc_config_set(&fCodec, &fConfig)) {
+        fprintf(stderr, "Failed to set refinement quantizer: %s\n", vpx_codec_err_to_string(res));
+    }
+    if (fLayerCount > 1) _SetLayerQuantizers();
+    if (fVP9) {
+        vpx_codec_control(&fCodec, VP9E_SET_LOSSLESS, lossless ? 1 : 0);
+    } else {
+        vpx_codec_control(&fCodec, VP8E_SET_STATIC_THRESHOLD, step > 0 ? 0 : fStaticThreshold);
+    }
+}
+
+status_t
+VpxBackend::Encode(const YUVFrame &frame, EncodedFrame &out) {
+    out.spans = nullptr;
+    out.count = 0;
+    out.size = 0;
+    out.isKey = false;
+    out.layer = 0;
+    out.psnr = 0;
+    if (!fInitialized) return B_NO_INIT;
+
+    // vpx_img_wrap() would derive the chroma strides from the luma one, the
+    // frame's own are padded for alignment
+    if (!vpx_img_wrap(&fImage, fFullChroma ? VPX_IMG_FMT_I444 : VPX_IMG_FMT_I420, fConfig.g_w, fConfig.g_h, 1,
+                      frame.planes.plane[0]))
+        return B_ERROR;
+    for (int32 i = 0; i < 3; i++) {
+        fImage.planes[VPX_PLANE_Y + i] = frame.planes.plane[i];
+        fImage.stride[VPX_PLANE_Y + i] = frame.planes.stride[i];
+    }
+
+    bool lossless = fVP9 && IsLosslessRefine(frame, fConfig.g_w, fConfig.g_h);
+    if (frame.refine != fRefineStep || lossless != fRefineLossless) _SetRefineStep(frame.refine, lossless);
+
+    // Unchanged blocks are coded as skipped, without a motion search
+    bool skipBlocks = fActiveMap.Update(frame);
+    if (skipBlocks || fActiveMapSet) {
+        vpx_active_map_t activeMap;
+        activeMap.active_map = skipBlocks ? (unsigned char *) fActiveMap.Map() : nullptr;
+        activeMap.rows = fActiveMap.Rows();
+        activeMap.cols = fActiveMap.Columns();
+        if (vpx_codec_control(&fCodec, VP8E_SET_ACTIVEMAP, &activeMap) == VPX_CODEC_OK) fActiveMapSet = skipBlocks;
+    }
+
+    unsigned long duration = fFrameRate > 0 && fFrameRate < kTimebase ? kTimebase / fFrameRate : 1;
+    if (vpx_codec_encode(&fCodec, &fImage, frame.pts, duration, frame.forceKeyframe ? VPX_EFLAG_FORCE_KF : 0,
+                         VPX_DL_REALTIME) != VPX_CODEC_OK)
+        return B_ERROR;
+
+    fSpans.clear();
+    vpx_codec_iter_t iter = nullptr;
+    const vpx_codec_cx_pkt_t *pkt;
+    while ((pkt = vpx_codec_get_cx_data(&fCodec, &iter)) != nullptr) {
+        if (pkt->kind == VPX_CODEC_PSNR_PKT) out.psnr = pkt->data.psnr.psnr[0];
+        if (pkt->kind != VPX_CODEC_CX_FRAME_PKT) continue;
+
+        EncodedSpan span = {(const uint8 *) pkt->data.frame.buf, pkt->data.frame.sz};
+        fSpans.push_back(span);
+        out.size += span.size;
+        if (pkt->data.frame.flags & VPX_FRAME_IS_KEY) out.isKey = true;
+    }
+
+    if (!fSpans.empty()) fActiveMap.Coded();
+
+    // A keyframe resets every reference, whatever layer it was labeled with
+    if (fLayerCount > 1 && !out.isKey && !fSpans.empty()) {
+        vpx_svc_layer_id_t layerId;
+        if (vpx_codec_control(&fCodec, VP9E_GET_SVC_LAYER_ID, &layerId) == VPX_CODEC_OK)
+            out.layer = layerId.temporal_layer_id;
+    }
+
+    out.spans = fSpans.data();
+    out.count = (int32) fSpans.size();
+    return B_OK;
+}
@@ -0,0 +1,65 @@
+/*
+ * VpxBackend.h
+ * VP8 and VP9 through libvpx
+ */
+#ifndef VPX_BACKEND_H
+#define VPX_BACKEND_H
+
+#include <vpx/vpx_encoder.h>
+#include <vpx/vp8cx.h>
+#include <vector>
+
+#include "ActiveMap.h"
+#include "EncoderBackend.h"
+
+class VpxBackend : public EncoderBackend {
+public:
+    explicit VpxBackend(bool vp9);
+
+    virtual ~VpxBackend();
+
+    virtual status_t Init(int32 width, int32 height, int32 bitrateKbps, bool fullChroma, const EncoderProfile &profile);
+
+    virtual YUVLayout Layout() const { return fFullChroma ? YUV_I444 : YUV_I420; }
+
+    virtual void SetBitrate(int32 kbps);
+
+    virtual void SetFrameRate(int32 fps) { fFrameRate = fps; }
+
+    virtual status_t Resize(int32 width, int32 height);
+
+    virtual int32 CountLayers() const { return fLayerCount; }
+
+    virtual status_t Encode(const YUVFrame &frame, EncodedFrame &out);
+
+private:
+    bool fVP9;
+    bool fFullChroma;
+    bool fInitialized;
+    int32 fLayerCount;
+    int32 fFrameRate;
+    int32 fStaticThreshold;
+    int32 fRefineStep;
+    bool fRefineLossless;
+
+    vpx_codec_ctx_t fCodec;
+    vpx_codec_enc_cfg_t fConfig;
+    uint32 fMinQuantizer; // Of regular frames, fConfig has the current ones
+    uint32 fMaxQuantizer;
+    vpx_image_t fImage; // Wraps the frame being encoded
+
+    std::vector<EncodedSpan> fSpans; // One per packet
+
+    ActiveMap fActiveMap;
+    bool fActiveMapSet; // The encoder holds on to it until told otherwise
+
+    int32 _ActiveMapPeriod() const;
+
+    void _SetLayerBitrates(int32 kbps);
+
+    void _SetLayerQuantizers();
+
+    void _SetRefineStep(int32 step, bool lossless);
+};
+
+#endif // VPX_BACKEND_H
@@ -0,0 +1,107 @@
+/*
+ * WorkerPool.cpp
+ */
+#include "WorkerPool.h"
+#include <stdio.h>
+
+WorkerPool::WorkerPool()
+    : fThreadCount(0), fQuit(false), fStartSem(-1), fDoneSem(-1), fJob(nullptr), fData(nullptr), fParts(0),
+      fNextPart(0), fNextThread(0), fActive(0) {
+    for (int32 i = 0; i < kMaxThreads; i++) fThreads[i] = -1;
+}
+
+WorkerPool::~WorkerPool() {
+    Shutdown();
+}
+
+status_t
+WorkerPool::Init(int32 threads, const char *name) {
+    Shutdown();
+
+    if (threads <= 0) {
+        system_info info;
+        threads = get_system_info(&info) == B_OK ? (int32) info.cpu_count : 1;
+    }
+    if (threads < 1) threads = 1;
+    if (threads > kMaxThreads) threads = kMaxThreads;
+
+    fStartSem = create_sem(0, "WorkerStart");
+    fDoneSem = create_sem(0, "WorkerDone");
+    if (fStartSem < B_OK || fDoneSem < B_OK) {
+        Shutdown();
+        return B_NO_MORE_SEMS;
+    }
+
+    fQuit = false;
+    for (int32 i = 0; i < threads - 1; i++) {
+        thread_id thread = spawn_thread(_WorkerLoopSync, name, B_DISPLAY_PRIORITY, this);
+        if (thread < B_OK) {
+            // Fewer workers only means less parallelism
+            fprintf(stderr, "WorkerPool: Failed to spawn worker %d\n", (int) i);
+            break;
+        }
+        fThreads[fThreadCount++] = thread;
+        resume_thread(thread);
+    }
+
+    return B_OK;
+}
+
+void
+WorkerPool::Shutdown() {
+    fQuit = true;
+    if (fThreadCount > 0) release_sem_etc(fStartSem, fThreadCount, 0);
+
+    for (int32 i = 0; i < fThreadCount; i++) {
+        status_t exitVal;
+        wait_for_thread(fThreads[i], &exitVal);
+        fThreads[i] = -1;
+    }
+    fThreadCount = 0;
+
+    if (fStartSem >= B_OK) delete_sem(fStartSem);
+    if (fDoneSem >= B_OK) delete_sem(fDoneSem);
+    fStartSem = -1;
+    fDoneSem = -1;
+}
+
+void
+WorkerPool::Run(JobFunc job, void *data, int32 parts) {
+    if (parts <= 0) return;
+
+    fJob = job;
+    fData = data;
+    fParts = parts;
+    fNextPart = 0;
+    fNextThread = 1; // The caller is thread 0
+
+    // No point in waking more workers than there are parts left for them
+    int32 helpers = parts - 1 < fThreadCount ? parts - 1 : fThreadCount;
+    fActive = helpers + 1;
+    if (helpers > 0) release_sem_etc(fStartSem, helpers, 0);
+
+    _RunParts(0);
+
+    // The last thread to finish wakes us, unless that was us
+    if (fActive.fetch_sub(1) > 1) acquire_sem(fDoneSem);
+}
+
+void
+WorkerPool::_RunParts(int32 thread) {
+    int32 part;
+    while ((part = fNextPart.fetch_add(1)) < fParts) fJob(fData, part, fParts, thread);
+}
+
+status_t
+WorkerPool::_WorkerLoopSync(void *data) {
+    return ((WorkerPool *) data)->_WorkerLoop();
+}
+
+status_t
+WorkerPool::_WorkerLoop() {
+    while (acquire_sem(fStartSem) == B_OK && !fQuit) {
+        _RunParts(fNextThread.fetch_add(1));
+        if (fActive.fetch_sub(1) == 1) release_sem(fDoneSem);
+    }
+    return B_OK;
+}
@@ -0,0 +1,60 @@
+/*
+ * WorkerPool.h
+ * Persistent threads that split a job into independent parts
+ */
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+#include <atomic>
+
+class WorkerPool {
+public:
+    // Called once for every part, from any thread of the pool. thread is in
+    // [0, CountThreads()) and differs between parts running at the same time,
+    // so it can pick per-thread scratch space.
+    typedef void (*JobFunc)(void *data, int32 part, int32 parts, int32 thread);
+
+    static const int32 kMaxThreads = 16;
+
+    WorkerPool();
+
+    ~WorkerPool();
+
+    // Spawns threads - 1 workers, the caller of Run() being the last one.
+    // 0 means one thread per CPU.
+    status_t Init(int32 threads = 0, const char *name = "Worker");
+
+    void Shutdown();
+
+    int32 CountThreads() const { return fThreadCount + 1; }
+
+    // Runs job(data, part, parts, thread) for every part in [0, parts) and returns
+    // once all of them are done. Only one thread may call this at a time.
+    void Run(JobFunc job, void *data, int32 parts);
+
+private:
+    thread_id fThreads[kMaxThreads];
+    int32 fThreadCount; // Not counting the caller of Run()
+    volatile bool fQuit;
+
+    sem_id fStartSem;
+    sem_id fDoneSem;
+
+    // The job being run
+    JobFunc fJob;
+    void *fData;
+    int32 fParts;
+    std::atomic<int32> fNextPart;
+    std::atomic<int32> fNextThread; // Index for the next worker to join in
+    std::atomic<int32> fActive; // Threads still working on it
+
+    static status_t _WorkerLoopSync(void *data);
+
+    status_t _WorkerLoop();
+
+    void _RunParts(int32 thread);
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,150 @@
+/*
+ * X264Backend.cpp
+ */
+#include "X264Backend.h"
+#include <stdio.h>
+#include <string.h>
+
+// Quantizer of each refinement step, out of 51
+static const int kRefineQuantizer[kRefineSteps] = {30, 24, 18, 12};
+
+X264Backend::X264Backend()
+    : fFullChroma(false), fFrameRate(30), fBitrate(0), fCodec(nullptr) {
+    memset(&fParam, 0, sizeof(fParam));
+    memset(&fPicOut, 0, sizeof(fPicOut));
+}
+
+X264Backend::~X264Backend() {
+    if (fCodec) x264_encoder_close(fCodec);
+}
+
+status_t
+X264Backend::Init(int32 width, int32 height, int32 bitrateKbps, bool fullChroma, const EncoderProfile &profile) {
+    fFullChroma = fullChroma;
+
+    x264_param_default_preset(&fParam, profile.x264Preset, "zerolatency");
+    fParam.i_width = width;
+    fParam.i_height = height;
+    fParam.i_fps_num = fFrameRate;
+    fParam.i_fps_den = 1;
+    // Rate control budgets by i_fps_num, not the timestamps: variable frame
+    // rate input would hold every frame back until the next one arrives.
+    // Frames the capture stage skips on a static screen just go unspent.
+    fParam.b_vfr_input = 0;
+    fParam.i_timebase_num = 1;
+    fParam.i_timebase_den = kTimebase;
+    fParam.i_keyint_max = fFrameRate; // Intra refresh sweeps the picture once a second
+    fParam.b_intra_refresh = 1;
+    fParam.rc.i_rc_method = X264_RC_ABR;
+    fBitrate = bitrateKbps;
+    _SetRateControl();
+    fParam.b_repeat_headers = 1; // Annex B need headers for random access resilience
+    // Frame threads would each hold a frame back, slices split every frame
+    fParam.i_threads = ThreadsFor(width, height);
+    fParam.b_sliced_threads = 1;
+    // Lets Encode() mark the blocks that didn't change, x264 then skips them
+    fParam.analyse.b_mb_info = 1;
+    fParam.analyse.b_psnr = MeasureQuality();
+    // NV12 is x264's own 4:2:0 layout, saves it a copy per frame
+    fParam.i_csp = fFullChroma ? X264_CSP_I444 : X264_CSP_NV12;
+
+    if (profile.x264TextTuning) {
+        fParam.analyse.b_psy = 0;
+        fParam.i_deblocking_filter_alphac0 = -2;
+        fParam.i_deblocking_filter_beta = -2;
+    }
+
+    // Profile
+    x264_param_apply_profile(&fParam, fFullChroma ? "high444" : "baseline");
+
+    fCodec = x264_encoder_open(&fParam);
+    if (!fCodec) {
+        fprintf(stderr, "Failed to open x264 encoder\n");
+        return B_ERROR;
+    }
+
+    fActiveMap.Init(width, height, 1);
+    fMbInfo.assign(fActiveMap.Columns() * fActiveMap.Rows(), 0);
+    return B_OK;
+}
+
+void
+X264Backend::SetBitrate(int32 kbps) {
+    fBitrate = kbps;
+    if (!fCodec) return;
+
+    _SetRateControl();
+    x264_encoder_reconfig(fCodec, &fParam);
+}
+
+void
+X264Backend::SetFrameRate(int32 fps) {
+    if (fps <= 0) return;
+
+    fFrameRate = fps;
+    if (!fCodec) return;
+
+    _SetRateControl();
+    x264_encoder_reconfig(fCodec, &fParam);
+}
+
+// Same buffer as VpxBackend's, a second of the bitrate. Without VBV,
+// x264_encoder_reconfig() keeps the bitrate the encoder was opened with.
+void
+X264Backend::_SetRateControl() {
+    int32 kbps = (int32) ((int64) fBitrate * fParam.i_fps_num / fFrameRate);
+    fParam.rc.i_bitrate = kbps;
+    fParam.rc.i_vbv_max_bitrate = kbps;
+    fParam.rc.i_vbv_buffer_size = kbps;
+}
+
+status_t
+X264Backend::Encode(const YUVFrame &frame, EncodedFrame &out) {
+    out.spans = nullptr;
+    out.count = 0;
+    out.size = 0;
+    out.isKey = false;
+    out.layer = 0;
+    out.psnr = 0;
+    if (!fCodec) return B_NO_INIT;
+
+    x264_picture_t picIn;
+    x264_picture_init(&picIn);
+    picIn.img.i_csp = fParam.i_csp;
+    picIn.img.i_plane = fFullChroma ? 3 : 2;
+    for (int32 i = 0; i < picIn.img.i_plane; i++) {
+        picIn.img.plane[i] = frame.planes.plane[i];
+        picIn.img.i_stride[i] = frame.planes.stride[i];
+    }
+    picIn.i_pts = frame.pts;
+    picIn.i_type = frame.forceKeyframe ? X264_TYPE_IDR : X264_TYPE_AUTO;
+    // Rate control accounts for forced quantizers, refinement frames use one
+    if (frame.refine > 0) picIn.i_qpplus1 = kRefineQuantizer[frame.refine - 1] + 1;
+
+    // Only read during the call: sliced threads and no lookahead
+    if (fActiveMap.Update(frame)) {
+        const uint8 *map = fActiveMap.Map();
+        for (size_t i = 0; i < fMbInfo.size(); i++) fMbInfo[i] = map[i] ? 0 : X264_MBINFO_CONSTANT;
+        picIn.prop.mb_info = fMbInfo.data();
+    }
+
+    x264_nal_t *nals;
+    int nalCount;
+    int frameSize = x264_encoder_encode(fCodec, &nals, &nalCount, &picIn, &fPicOut);
+    if (frameSize < 0) return B_ERROR;
+    if (frameSize > 0) fActiveMap.Coded();
+
+    // x264 usually writes the NALs back to back, but doesn't promise it
+    fSpans.clear();
+    for (int i = 0; i < nalCount; i++) {
+        EncodedSpan span = {nals[i].p_payload, (size_t) nals[i].i_payload};
+        fSpans.push_back(span);
+        out.size += span.size;
+    }
+
+    out.spans = fSpans.data();
+    out.count = (int32) fSpans.size();
+    out.isKey = frameSize > 0 && fPicOut.b_keyframe;
+    if (frameSize > 0 && fParam.analyse.b_psnr) out.psnr = fPicOut.prop.f_psnr_avg;
+    return B_OK;
+}
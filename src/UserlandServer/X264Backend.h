@@ -0,0 +1,51 @@
+/*
+ * X264Backend.h
+ * H.264 through x264
+ */
+#ifndef X264_BACKEND_H
+#define X264_BACKEND_H
+
+#include <stdint.h>
+#include <x264.h>
+#include <vector>
+
+#include "ActiveMap.h"
+#include "EncoderBackend.h"
+
+class X264Backend : public EncoderBackend {
+public:
+    X264Backend();
+
+    virtual ~X264Backend();
+
+    virtual status_t Init(int32 width, int32 height, int32 bitrateKbps, bool fullChroma, const EncoderProfile &profile);
+
+    virtual YUVLayout Layout() const { return fFullChroma ? YUV_I444 : YUV_NV12; }
+
+    virtual void SetBitrate(int32 kbps);
+
+    // x264_encoder_reconfig() ignores the frame rate, an open encoder keeps
+    // budgeting for the one it was opened with. Its bitrate is scaled to
+    // make up for that, the next Init() takes the new rate.
+    virtual void SetFrameRate(int32 fps);
+
+    virtual status_t Encode(const YUVFrame &frame, EncodedFrame &out);
+
+private:
+    bool fFullChroma;
+    int32 fFrameRate;
+    int32 fBitrate; // As asked for, fParam has what x264 is told
+
+    void _SetRateControl();
+
+    x264_t *fCodec;
+    x264_param_t fParam;
+    x264_picture_t fPicOut;
+
+    std::vector<EncodedSpan> fSpans; // One per NAL
+
+    ActiveMap fActiveMap;
+    std::vector<uint8_t> fMbInfo; // x264's flags for the blocks in fActiveMap
+};
+
+#endif // X264_BACKEND_H
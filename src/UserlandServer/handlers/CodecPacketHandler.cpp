@@ -12,6 +12,8 @@ CodecPacketHandler::Handle(NetworkServer *server, NetworkServer::ClientState *cl
 
     BMessage msg(MSG_CHANGE_CODEC);
     msg.AddString("codec", args.codec().c_str());
+    msg.AddBool("fullChroma", args.full_chroma());
+    msg.AddString("profile", args.profile().c_str());
 
     server->SendMessageToTarget(&msg);
 }
\ No newline at end of file
@@ -53,6 +53,9 @@ KeyPacketHandler::Handle(NetworkServer *server, NetworkServer::ClientState *clie
 
     port_id inputPort = server->GetInputPort();
     if (inputPort >= 0) write_port(inputPort, 0, &driverEvent, sizeof(driverEvent));
+
+    // The screen is about to change: get the capture loop out of its idle sleep
+    server->WakeCapture();
 }
 
 void
@@ -42,4 +42,7 @@ MousePacketHandler::Handle(NetworkServer *server, NetworkServer::ClientState *cl
     if (inputPort >= 0) {
         write_port(inputPort, 0, &driverEvent, sizeof(driverEvent));
     }
+
+    // The screen is about to change: get the capture loop out of its idle sleep
+    server->WakeCapture();
 }
\ No newline at end of file
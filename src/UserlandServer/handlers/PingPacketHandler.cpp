@@ -9,34 +9,16 @@ PingPacketHandler::Handle(NetworkServer *server, NetworkServer::ClientState *cli
                           const haiku::remote::InputEvent &event) {
     if (!event.has_ping()) return;
 
-    // 1. Congestion Control
+    // 1. Congestion Control, per client: a slow link only moves its own
+    // client to fewer layers or a lower tier, see ClientStream
     const haiku::remote::PingEvent &pingMsg = event.ping();
     int32 rtt = pingMsg.last_rtt();
 
     if (rtt >= 0) {
-        int32 oldBitrate = server->GetBitrate();
-        int32 newBitrate = oldBitrate;
-
-        if (rtt > 150) {
-            // Backoff 20%
-            newBitrate = (int32)(oldBitrate * 0.8);
-            if (newBitrate < 500) newBitrate = 500;
-        } else if (rtt < 50) {
-            // Increase 5%
-            newBitrate = (int32)(oldBitrate * 1.05);
-            if (newBitrate > 8000) newBitrate = 8000;
-        }
-
-        server->SetBitrate(newBitrate);
-
-        // Notify if change is significant (> 50kbps) from the *previous*
-        if (abs(newBitrate - oldBitrate) > 50) {
-            // printf("Rate Update: %d kbps (RTT: %d ms)\n", newBitrate, rtt);
-
-            BMessage msg(MSG_UPDATE_BITRATE);
-            msg.AddInt32("bitrate", newBitrate);
-            server->SendMessageToTarget(&msg);
-        }
+        int32 layers, bitrate;
+        client->AfterRoundTrip(rtt, server->CountLayers(), layers, bitrate);
+        if (layers != client->layers) server->SetClientLayers(client, layers);
+        if (bitrate != client->bitrate) server->SetClientBitrate(client, bitrate);
     }
 
     // 2. Pong (Echo)
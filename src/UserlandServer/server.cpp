@@ -8,17 +8,17 @@
 
 #include "ScreenCapture.h"
 #include "VideoEncoder.h"
+#include "FramePipeline.h"
+#include "FrameRecorder.h"
+#include "ReplaySource.h"
 #include "NetworkServer.h"
 #include "InputDriverManager.h"
 #include "NetworkUtils.h"
 #include "NetworkUtils.h"
-#include <Screen.h>
 #include <Clipboard.h>
 #include "Settings.h"
 
 #define APP_SIGNATURE "application/x-vnd.Haiku-ScreenCaster"
-#define AREA_NAME "screen_capture_shm"
-#define RING_BUFFER_SIZE (16 * 1024 * 1024)
 
 #define MSG_SETTINGS_CHANGED 'stch'
 
@@ -26,26 +26,46 @@ class ScreenApp : public BApplication {
 public:
     ScreenApp() : BApplication(APP_SIGNATURE) {
         fNetworkThread = -1;
-        fCaptureThread = -1;
         fTerminating = false;
-        fCapturing = false;
         fScreenCapture = new ScreenCapture();
-        fVideoEncoder = new VideoEncoder();
+        // Lower tiers convert on the best tier's threads, the convert stage
+        // runs them one after the other anyway
+        fVideoEncoders[0] = new VideoEncoder();
+        for (int32 i = 1; i < kStreamTierCount; i++)
+            fVideoEncoders[i] = new VideoEncoder(fVideoEncoders[0]->ConvertWorkers());
+        fPipeline = new FramePipeline();
+        fRecorder = new FrameRecorder();
+        fReplaySource = nullptr;
+        fReplayRealtime = true;
         fNetworkServer = nullptr;
         fInputManager = new InputDriverManager();
         fSettings = new Settings();
         fCurrentCodec = "vp8";
+        fFullChroma = false;
+        fEncoderProfile = EncoderProfileFor(kDefaultEncoderProfile);
+        fEncoderFullChroma = false;
+        fEncoderProfileInUse = nullptr;
+        fViewWidth = 0;
+        fViewHeight = 0;
         fTargetFps = 30;
         fFrameWaitTime = 33333; // ~30 FPS
-        fCaptureSem = create_sem(0, "CaptureSignal");
     }
 
     ~ScreenApp() {
+        if (fPipeline) {
+            delete fPipeline;
+        }
+        if (fRecorder) {
+            delete fRecorder;
+        }
+        if (fReplaySource) {
+            delete fReplaySource;
+        }
         if (fScreenCapture) {
             delete fScreenCapture;
         }
-        if (fVideoEncoder) {
-            delete fVideoEncoder;
+        for (int32 i = kStreamTierCount - 1; i >= 0; i--) {
+            delete fVideoEncoders[i];
         }
         if (fNetworkServer) {
             delete fNetworkServer;
@@ -56,7 +76,32 @@ public:
         if (fSettings) {
             delete fSettings;
         }
-        delete_sem(fCaptureSem);
+    }
+
+    // --record <file>: also write every captured frame to a capture file
+    // --replay <file>: serve frames from a capture file instead of the screen
+    // --replay-fast: replay as fast as the pipeline goes, not at recorded pace
+    // --codec <name>, --profile <name>: what to encode with until a client asks
+    //   for something else. With a replay, encoder stats are printed as it runs.
+    // --encoder-threads <n>: at most n threads per encoder, one per CPU otherwise
+    virtual void ArgvReceived(int32 argc, char **argv) {
+        for (int32 i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+                fRecordPath = argv[++i];
+            } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+                fReplayPath = argv[++i];
+            } else if (strcmp(argv[i], "--replay-fast") == 0) {
+                fReplayRealtime = false;
+            } else if (strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+                fCurrentCodec = argv[++i];
+            } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+                fProfileArgument = argv[++i];
+            } else if (strcmp(argv[i], "--encoder-threads") == 0 && i + 1 < argc) {
+                EncoderBackend::SetThreadLimit(atoi(argv[++i]));
+            } else {
+                fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            }
+        }
     }
 
     virtual void ReadyToRun() {
@@ -68,7 +113,7 @@ public:
         }
 
 
-        fSettings->Load();
+        _LoadSettings();
 
         // 1. Install Driver & Restart Input Server
 #ifndef RELEASE_MODE
@@ -120,6 +165,12 @@ public:
         resume_thread(fNetworkThread);
 
 
+        // Replays run without waiting for a client, so they can be used for benchmarks
+        if (fReplaySource) {
+            _StartCapture();
+            return;
+        }
+
         // Waiting for client...
         printf("Screen Capture Server Running on 0.0.0.0:%d (Waiting for client)\n", fSettings->Port());
     }
@@ -134,13 +185,6 @@ public:
                 printf("No Clients: Stopping Capture\n");
                 _StopCapture();
                 break;
-            case MSG_UPDATE_BITRATE: {
-                int32 bitrate;
-                if (msg->FindInt32("bitrate", &bitrate) == B_OK) {
-                    if (fVideoEncoder) fVideoEncoder->SetBitrate(bitrate);
-                }
-                break;
-            }
             case MSG_CHANGE_RESOLUTION: {
                 int32 width, height;
                 if (msg->FindInt32("width", &width) == B_OK &&
@@ -151,8 +195,12 @@ public:
             }
             case MSG_CHANGE_CODEC: {
                 BString codec;
+                bool fullChroma = false;
+                const char *profile = nullptr;
                 if (msg->FindString("codec", &codec) == B_OK) {
-                    _ChangeCodec(codec.String());
+                    msg->FindBool("fullChroma", &fullChroma);
+                    msg->FindString("profile", &profile);
+                    _ChangeCodec(codec.String(), fullChroma, profile);
                 }
                 break;
             }
@@ -164,7 +212,7 @@ public:
                 break;
             }
             case MSG_WAKE_CAPTURE:
-                release_sem(fCaptureSem);
+                fPipeline->WakeCapture();
                 break;
             case MSG_CHANGE_FPS: {
                 int32 fps;
@@ -194,6 +242,7 @@ public:
         }
 
         _StopCapture();
+        fRecorder->Close();
 
         if (fScreenCapture) {
             if (fScreenCapture->Lock()) {
@@ -213,6 +262,9 @@ public:
 
     void _RestartServer() {
         printf("Restarting Server with new settings...\n");
+
+        // The pipeline's send stage writes to the server we are about to delete
+        _StopCapture();
         
         if (fNetworkServer) {
             fNetworkServer->Stop();
@@ -223,7 +275,7 @@ public:
         }
 
         // Reload settings in case they changed on disk
-        fSettings->Load();
+        _LoadSettings();
 
         // Re-init Network Server
         port_id inputPort = find_port("virtual_mouse_input");
@@ -252,32 +304,42 @@ public:
 
 private:
     thread_id fNetworkThread;
-    thread_id fCaptureThread;
 
     volatile bool fTerminating;
-    volatile bool fCapturing;
 
     ScreenCapture *fScreenCapture;
-    VideoEncoder *fVideoEncoder;
+    VideoEncoder *fVideoEncoders[kStreamTierCount]; // Best tier first
+    FramePipeline *fPipeline;
+    FrameRecorder *fRecorder;
+    ReplaySource *fReplaySource;
+    BString fRecordPath;
+    BString fReplayPath;
+    BString fProfileArgument; // Overrides the settings' profile
+    bool fReplayRealtime;
     NetworkServer *fNetworkServer;
     InputDriverManager *fInputManager;
     Settings *fSettings;
     BString fCurrentCodec;
+    bool fFullChroma;
+    const EncoderProfile *fEncoderProfile;
+    // What the encoders were last set up with, empty codec if they weren't
+    BString fEncoderCodec;
+    bool fEncoderFullChroma;
+    const EncoderProfile *fEncoderProfileInUse;
+    int32 fViewWidth; // Size the client shows the stream at, 0 for the screen's
+    int32 fViewHeight;
     int32 fTargetFps;
     bigtime_t fFrameWaitTime;
 
-    int fFrameCount;
-    sem_id fCaptureSem;
-
     static status_t _NetworkLoopSync(void *data) {
         return ((ScreenApp *) data)->_NetworkLoop();
     }
 
-    static status_t _CaptureLoopSync(void *data) {
-        return ((ScreenApp *) data)->_CaptureLoop();
-    }
-
 	status_t _InitResources() {
+		if (fReplayPath.Length() > 0) {
+			fReplaySource = new ReplaySource();
+			return fReplaySource->Open(fReplayPath.String(), fReplayRealtime);
+		}
 		return B_OK;
 	}
 
@@ -288,231 +350,205 @@ private:
         return B_OK;
     }
 
+    void _LoadSettings() {
+        fSettings->Load();
+        const char *name = fProfileArgument.Length() > 0 ? fProfileArgument.String() : fSettings->EncoderProfileName();
+        fEncoderProfile = EncoderProfileFor(name);
+        if (!fEncoderProfile) {
+            fprintf(stderr, "Unknown encoder profile %s, using %s\n", name, kDefaultEncoderProfile);
+            fEncoderProfile = EncoderProfileFor(kDefaultEncoderProfile);
+        }
+    }
+
     void _StartCapture() {
         _StopCapture();
 
-        if (fScreenCapture->Init() != B_OK) {
+        if (!fReplaySource && fScreenCapture->Init() != B_OK) {
             fprintf(stderr, "Failed to init ScreenCapture\n");
             return;
         }
 
         fNetworkServer->SetScreenCapture(fScreenCapture);
 
-        if (fVideoEncoder->Init(fScreenCapture->Width(), fScreenCapture->Height(), 2000, fCurrentCodec.String()) !=
-            B_OK) {
-            fprintf(stderr, "Failed to init VideoEncoder\n");
-            return;
-        }
-
-        fFrameCount = 0;
-        fCapturing = true;
-
-        fCaptureThread = spawn_thread(_CaptureLoopSync, "Screen Capture",
-                                      B_DISPLAY_PRIORITY, this);
-
-        if (fCaptureThread >= B_OK) resume_thread(fCaptureThread);
-        else fCapturing = false;
-
-        // Send Init Config to Client
-        BString config;
-        config << "{\"type\": \"init\", \"width\": " << fScreenCapture->Width()
-                << ", \"height\": " << fScreenCapture->Height()
-                << ", \"codec\": \"" << fVideoEncoder->GetCodecName() << "\"}";
-
-        uint8 headerBuf[16];
-        size_t headerLen = NetworkUtils::MakeWebSocketHeader(config.Length(), headerBuf, 0x01); // 0x01 = Text
-
-
-        fNetworkServer->Broadcast(headerBuf, headerLen, config.String(), config.Length());
-        fNetworkServer->SetWelcomeMessage(config.String(), config.Length());
+        // A new capture may have a new screen size: start over
+        fEncoderCodec = "";
+        _StartEncoding();
     }
 
-    void _StopCapture() {
-        fCapturing = false;
-        if (fCaptureThread > 0) {
-            status_t exitVal;
-            wait_for_thread(fCaptureThread, &exitVal);
-            fCaptureThread = -1;
-        }
-    }
+    // (Re)starts the pipeline on the capture that is already set up
+    void _StartEncoding() {
+        _StopCapture();
 
-    status_t _CaptureLoop() {
-        bigtime_t lastKeyframeTime = system_time();
-        bigtime_t nextFrameTime = system_time();
+        FrameSource *source = fReplaySource ? (FrameSource *) fReplaySource : fScreenCapture;
 
-        while (fCapturing && !fTerminating) {
-            // Absolute Timing Loop: Sleep only the remainder of the frame budget
-            bigtime_t now = system_time();
-            bigtime_t waitTime = nextFrameTime - now;
+        int32 streamWidth, streamHeight;
+        _StreamSize(source, streamWidth, streamHeight);
+        if (_SetupEncoders(streamWidth, streamHeight) != B_OK) return;
 
-            if (waitTime < 0) {
-                // We are late or just starting
-                waitTime = 0;
-                // If extremely late (e.g. paused/lag spike > 100ms), reset schedule
-                if (waitTime < -100000) nextFrameTime = now;
+        // A recording keeps a single resolution, stop it if the screen changed
+        if (fRecordPath.Length() > 0 && !fReplaySource) {
+            if (!fRecorder->IsOpen()) {
+                fRecorder->Open(fRecordPath.String(), source->Width(), source->Height());
+            } else if (fRecorder->Width() != source->Width() || fRecorder->Height() != source->Height()) {
+                printf("Resolution changed, stopping recording\n");
+                fRecorder->Close();
+                fRecordPath = "";
             }
+        }
+        fPipeline->SetRecorder(fRecorder->IsOpen() ? fRecorder : nullptr);
+        fPipeline->SetReportStats(fReplaySource != nullptr);
 
-            acquire_sem_etc(fCaptureSem, 1, B_RELATIVE_TIMEOUT, waitTime);
-            
-            // Advance schedule for next frame
-            nextFrameTime += fFrameWaitTime;
+        fNetworkServer->SetLayerCount(fVideoEncoders[0]->CountLayers());
 
-            int64 pts = fFrameCount++;
+        fPipeline->SetFrameInterval(fFrameWaitTime);
+        if (fPipeline->Start(source, fVideoEncoders, kStreamTierCount, fNetworkServer) != B_OK) {
+            fprintf(stderr, "Failed to start frame pipeline\n");
+            return;
+        }
 
-            // Disable waitRetrace (false) to let fFrameWaitTime control the FPS.
-            // Otherwise, WaitForRetrace + acquire_sem delay caps us at ~30FPS on 60Hz systems.
-            if (fScreenCapture->Capture(false) != B_OK) {
-                snooze(10000); // Wait bit more if screen not ready
-                continue;
-            }
+        _SendInitConfig(source, streamWidth, streamHeight);
+    }
 
-            if (!fScreenCapture->IsConnected()) {
-                snooze(10000);
-                continue;
+    // Changes the stream's size or encoder while capturing. Only the encode
+    // side of each tier pauses, the capture keeps running and the first frame
+    // after the change is a keyframe of the current screen.
+    void _ReconfigureEncoding() {
+        FrameSource *source = fReplaySource ? (FrameSource *) fReplaySource : fScreenCapture;
+
+        int32 streamWidth, streamHeight;
+        _StreamSize(source, streamWidth, streamHeight);
+
+        // Clients set up a new decoder on the init message, so no tier may
+        // send a frame of the old encoder after it
+        bigtime_t start = system_time();
+        for (int32 i = 0; i < kStreamTierCount; i++) {
+            if (fPipeline->PauseTier(i) != B_OK) {
+                fprintf(stderr, "Failed to pause tier %d, restarting the pipeline\n", (int) i);
+                _StartEncoding();
+                return;
             }
+        }
 
-            bool forceKeyframe = false;
-            now = system_time();
-            if (now - lastKeyframeTime > 60000000) forceKeyframe = true;
-
-            // Zero Copy! Direct access to screen memory
-            if (fVideoEncoder->Encode(fScreenCapture->GetScreenBits(), fScreenCapture->GetRowBytes(), pts,
-                                      forceKeyframe) == B_OK) {
-                vpx_codec_iter_t iter = nullptr;
-                const vpx_codec_cx_pkt_t *pkt = nullptr;
-
-                while ((pkt = fVideoEncoder->GetNextPacket(&iter)) != nullptr) {
-                    if (pkt->kind == VPX_CODEC_CX_FRAME_PKT) {
-                        bool isKey = (pkt->data.frame.flags & VPX_FRAME_IS_KEY);
-                        if (isKey) lastKeyframeTime = system_time();
-
-                        // Construct Payload: [Meta(1)] + [Frame(N)] + [Magic(4)]
-                        size_t frameSz = pkt->data.frame.sz;
-                        size_t payloadSz = 1 + frameSz + 4;
-
-                        // Construct WebSocket Header
-                        uint8 headerBuf[16];
-                        size_t headerLen = NetworkUtils::MakeWebSocketHeader(payloadSz, headerBuf, 0x02); // Binary
-
-                        // Prepare Data Chunks (Scatter/Gather)
-                        uint8 metaByte = isKey ? 0x01 : 0x00;
-                        static const uint8 magicBytes[] = {0xDE, 0xAD, 0xBE, 0xEF};
-
-                        struct iovec vec[4];
-
-                        // 1. WebSocket Frame Header
-                        vec[0].iov_base = headerBuf;
-                        vec[0].iov_len = headerLen;
-
-                        // 2. Meta
-                        vec[1].iov_base = &metaByte;
-                        vec[1].iov_len = 1;
-
-                        // 3. Video Frame (Zero Copy from Encoder output)
-                        vec[2].iov_base = pkt->data.frame.buf;
-                        vec[2].iov_len = frameSz;
-
-                        // 4. Magic
-                        vec[3].iov_base = (void *) magicBytes;
-                        vec[3].iov_len = 4;
+        if (_SetupEncoders(streamWidth, streamHeight) != B_OK) {
+            _StopCapture();
+            return;
+        }
+        fNetworkServer->SetLayerCount(fVideoEncoders[0]->CountLayers());
+        _SendInitConfig(source, streamWidth, streamHeight);
 
-                        // Broadcast
-                        fNetworkServer->Broadcast(vec, 4);
-                    }
-                }
+        for (int32 i = 0; i < kStreamTierCount; i++) {
+            if (fPipeline->ResumeTier(i) != B_OK) {
+                fprintf(stderr, "Failed to resume tier %d, restarting the pipeline\n", (int) i);
+                _StartEncoding();
+                return;
             }
-
-            // printf("Process Time: %ld us (Wait: %ld us)\n", endProcess - startProcess, waitTime);
-            // Only print if taking too long (> 10ms)
         }
-        return B_OK;
+        printf("Encoders changed in %.1f ms\n", (system_time() - start) / 1000.0);
     }
 
-    void _ChangeResolution(int32 width, int32 height) {
-        printf("Resolution Change Requested: %ldx%ld\n", width, height);
-
-        BScreen screen(B_MAIN_SCREEN_ID);
-        if (!screen.IsValid()) {
-            fprintf(stderr, "BScreen is invalid\n");
-            return;
+    // Sets every tier's encoder up for the stream size and the current codec.
+    // Where only the size changed, the encoders are resized in place and keep
+    // their rate control state.
+    status_t _SetupEncoders(int32 streamWidth, int32 streamHeight) {
+        bool sameEncoder = fEncoderCodec == fCurrentCodec && fEncoderFullChroma == fFullChroma &&
+                           fEncoderProfileInUse == fEncoderProfile;
+        for (int32 i = 0; i < kStreamTierCount; i++) {
+            int32 tierWidth, tierHeight;
+            StreamTierSize(i, streamWidth, streamHeight, tierWidth, tierHeight);
+
+            VideoEncoder *encoder = fVideoEncoders[i];
+            encoder->SetFrameRate(fTargetFps);
+            if (sameEncoder && encoder->Resize(tierWidth, tierHeight) == B_OK) continue;
+
+            status_t status = encoder->Init(tierWidth, tierHeight, fNetworkServer->TierBitrate(i),
+                                            fCurrentCodec.String(), fFullChroma, fEncoderProfile);
+            if (status != B_OK) {
+                fprintf(stderr, "Failed to init VideoEncoder for tier %d\n", (int) i);
+                fEncoderCodec = "";
+                return status;
+            }
         }
+        fEncoderCodec = fCurrentCodec;
+        fEncoderFullChroma = fFullChroma;
+        fEncoderProfileInUse = fEncoderProfile;
+        return B_OK;
+    }
 
-        display_mode *modeList = nullptr;
-        display_mode targetMode;
-        display_mode currentMode;
+    // Tells every client, and each one connecting later, what the stream is
+    void _SendInitConfig(FrameSource *source, int32 streamWidth, int32 streamHeight) {
+        BString codecs;
+        for (int32 i = 0; i < EncoderBackend::CountCodecs(); i++)
+            codecs << (i > 0 ? ", \"" : "\"") << EncoderBackend::CodecAt(i) << "\"";
 
-        screen.GetMode(&currentMode);
+        BString profiles;
+        for (int32 i = 0; i < kEncoderProfileCount; i++)
+            profiles << (i > 0 ? ", \"" : "\"") << kEncoderProfiles[i].name << "\"";
 
-        uint32 count = 0;
-        if (screen.GetModeList(&modeList, &count) != B_OK) {
-            fprintf(stderr, "Failed to get mode list\n");
-            return;
-        }
-
-        // Find closest mode
-        int32 bestDiff = 0x7FFFFFFF;
-        int32 bestIndex = -1;
-
-        for (uint32 i = 0; i < count; i++) {
-            int32 w = modeList[i].virtual_width;
-            int32 h = modeList[i].virtual_height;
+        BString config;
+        config << "{\"type\": \"init\", \"width\": " << streamWidth
+                << ", \"height\": " << streamHeight
+                << ", \"screenWidth\": " << source->Width()
+                << ", \"screenHeight\": " << source->Height()
+                << ", \"codec\": \"" << fVideoEncoders[0]->GetCodecName() << "\""
+                << ", \"fullChroma\": " << (fVideoEncoders[0]->IsFullChroma() ? "true" : "false")
+                << ", \"codecs\": [" << codecs << "]"
+                << ", \"profile\": \"" << fEncoderProfile->name << "\""
+                << ", \"profiles\": [" << profiles << "]}";
 
-            // Exact Match?
-            if (w == width && h == height) {
-                bestIndex = i;
-                break;
-            }
+        uint8 headerBuf[16];
+        size_t headerLen = NetworkUtils::MakeWebSocketHeader(config.Length(), headerBuf, 0x01); // 0x01 = Text
 
-            // Closest by area or distance? Let's do simple pixel difference sum
-            long diff = abs(w - width) + abs(h - height);
 
-            if (diff < bestDiff) {
-                bestDiff = diff;
-                bestIndex = i;
-            }
-        }
+        fNetworkServer->Broadcast(headerBuf, headerLen, config.String(), config.Length());
+        fNetworkServer->SetWelcomeMessage(config.String(), config.Length());
+    }
 
-        if (bestIndex >= 0) {
-            targetMode = modeList[bestIndex];
-        }
+    void _StopCapture() {
+        fPipeline->Stop();
+    }
 
-        delete[] modeList;
+    // The screen fitted into the client's view, see StreamSizeFor()
+    void _StreamSize(FrameSource *source, int32 &width, int32 &height) {
+        StreamSizeFor(source->Width(), source->Height(), fViewWidth, fViewHeight, width, height);
+    }
 
-        if (bestIndex >= 0) {
-            printf("Switching to closest mode: %dx%d\n",
-                   targetMode.virtual_width, targetMode.virtual_height);
+    // The stream is scaled down to the client's view on our side. The real
+    // display mode is left alone, so the local user isn't disturbed.
+    void _ChangeResolution(int32 width, int32 height) {
+        printf("Resolution Change Requested: %dx%d\n", (int) width, (int) height);
 
-            if (targetMode.virtual_width == currentMode.virtual_width &&
-                targetMode.virtual_height == currentMode.virtual_height) {
-                printf("Already in requested mode.\n");
-                return;
-            }
+        fViewWidth = width;
+        fViewHeight = height;
+        if (!fPipeline->IsRunning()) return;
 
-            // Stop Capture First
-            bool wasCapturing = fCapturing;
-            if (wasCapturing) _StopCapture();
+        FrameSource *source = fReplaySource ? (FrameSource *) fReplaySource : fScreenCapture;
+        int32 streamWidth, streamHeight;
+        _StreamSize(source, streamWidth, streamHeight);
+        if (streamWidth == fVideoEncoders[0]->Width() && streamHeight == fVideoEncoders[0]->Height()) return;
 
-            screen.SetMode(&targetMode);
+        printf("Streaming at %dx%d\n", (int) streamWidth, (int) streamHeight);
+        _ReconfigureEncoding();
+    }
 
-            // Give it a moment to settle
-            snooze(200000);
+    // An empty or unknown profile keeps the current one
+    void _ChangeCodec(const char *codec, bool fullChroma, const char *profileName) {
+        printf("Codec Change Requested: %s%s\n", codec, fullChroma ? " (4:4:4)" : "");
+        const EncoderProfile *profile = EncoderProfileFor(profileName);
+        if (!profile) profile = fEncoderProfile;
 
-            if (wasCapturing) _StartCapture();
-        } else {
-            fprintf(stderr, "No suitable mode found\n");
+        if (!EncoderBackend::HasCodec(codec)) {
+            // The client only offers what the init message listed, but keep
+            // streaming with what we have rather than stop
+            fprintf(stderr, "Codec %s is not available in this build\n", codec);
+            return;
         }
-    }
-
-    void _ChangeCodec(const char *codec) {
-        printf("Codec Change Requested: %s\n", codec);
-        if (fCurrentCodec == codec) return;
+        if (fCurrentCodec == codec && fFullChroma == fullChroma && fEncoderProfile == profile) return;
         fCurrentCodec = codec;
-        // Restart Capture
-        bool wasCapturing = fCapturing;
-        if (wasCapturing) _StopCapture();
-        if (wasCapturing) _StartCapture();
-        if (wasCapturing) _StartCapture();
-        // If not capturing, it will be used next start
+        fFullChroma = fullChroma;
+        fEncoderProfile = profile;
+        // The capture itself stays as it is. If not capturing, it will be
+        // used next start.
+        if (fPipeline->IsRunning()) _ReconfigureEncoding();
     }
 
     void _ChangeFps(int32 fps) {
@@ -521,6 +557,8 @@ private:
         
         fTargetFps = fps;
         fFrameWaitTime = 1000000 / fps; // microseconds per frame
+        // Takes effect without a restart, the encoders pick it up as well
+        fPipeline->SetFrameInterval(fFrameWaitTime);
         
         printf("FPS Changed to %d (WaitTime: %ld us)\n", fTargetFps, fFrameWaitTime);
     }
@@ -0,0 +1,140 @@
+/*
+ * ActiveMapTest.cpp
+ * Which blocks the encoders may skip: the temporal layer period, keyframes
+ * and frames without a changed-block map
+ */
+#include "ActiveMap.h"
+#include "TestUtils.h"
+#include <vector>
+
+static const int32 kWidth = 1921; // Partial blocks at the right and bottom
+static const int32 kHeight = 1081;
+
+// A frame with the listed blocks changed
+struct TestFrame {
+    std::vector<uint8> blocks;
+    YUVFrame frame;
+
+    TestFrame(const ActiveMap &map, std::initializer_list<int32> changed, bool keyframe = false)
+        : blocks(map.Columns() * map.Rows(), 0) {
+        for (int32 block : changed) blocks[block] = 1;
+        frame = YUVFrame();
+        frame.forceKeyframe = keyframe;
+        frame.changedBlocks = blocks.data();
+    }
+};
+
+static int32
+CountActive(const ActiveMap &map) {
+    int32 active = 0;
+    for (int32 i = 0; i < map.Columns() * map.Rows(); i++) active += map.Map()[i] != 0;
+    return active;
+}
+
+// Codes one frame without changes, until the map forgot everything before
+static void
+Settle(ActiveMap &map, int32 period) {
+    for (int32 i = 0; i < period; i++) {
+        TestFrame still(map, {});
+        map.Update(still.frame);
+        map.Coded();
+    }
+}
+
+static void
+TestInit() {
+    ActiveMap map;
+    CHECK_EQUAL(map.Init(0, kHeight, 1), B_BAD_VALUE);
+    CHECK_EQUAL(map.Init(kWidth, kHeight, 0), B_BAD_VALUE);
+    CHECK_EQUAL(map.Init(kWidth, kHeight, 256), B_BAD_VALUE);
+    CHECK_EQUAL(map.Init(kWidth, kHeight, 1), B_OK);
+    CHECK_EQUAL(map.Columns(), 121);
+    CHECK_EQUAL(map.Rows(), 68);
+
+    // Nothing was coded yet, so the first frame is coded whole
+    TestFrame first(map, {5});
+    CHECK(!map.Update(first.frame));
+}
+
+// A changed block is looked at in the frame that changed it and, with
+// temporal layers, until every frame that could still refer to its old
+// contents was coded
+static void
+TestPeriod() {
+    const int32 periods[] = {1, 2, 4};
+    for (int32 period : periods) {
+        ActiveMap map;
+        CHECK_EQUAL(map.Init(kWidth, kHeight, period), B_OK);
+        Settle(map, period);
+
+        const int32 last = map.Columns() * map.Rows() - 1;
+        TestFrame changed(map, {0, 200, last});
+        CHECK(map.Update(changed.frame));
+        CHECK_EQUAL(CountActive(map), 3);
+        CHECK(map.Map()[0] && map.Map()[200] && map.Map()[last]);
+        map.Coded();
+
+        for (int32 frame = 1; frame < period + 1; frame++) {
+            TestFrame still(map, {});
+            CHECK(map.Update(still.frame));
+            CHECK_EQUAL(CountActive(map), frame < period ? 3 : 0);
+            map.Coded();
+        }
+    }
+
+    // A frame the encoder dropped doesn't count towards the period
+    ActiveMap map;
+    map.Init(kWidth, kHeight, 2);
+    Settle(map, 2);
+    TestFrame changed(map, {7});
+    map.Update(changed.frame);
+    map.Coded();
+    TestFrame dropped(map, {});
+    map.Update(dropped.frame);
+    TestFrame still(map, {});
+    map.Update(still.frame);
+    CHECK_EQUAL(CountActive(map), 1);
+    map.Coded();
+    map.Update(still.frame);
+    CHECK_EQUAL(CountActive(map), 0);
+}
+
+// Keyframes and frames without a map code everything, and everything counts
+// as changed afterwards for a whole period
+static void
+TestWholeFrames() {
+    ActiveMap map;
+    map.Init(kWidth, kHeight, 2);
+    Settle(map, 2);
+
+    TestFrame keyframe(map, {3}, true);
+    CHECK(!map.Update(keyframe.frame));
+    map.Coded();
+    TestFrame still(map, {});
+    CHECK(!map.Update(still.frame)); // Every block still within the period
+    map.Coded();
+    CHECK(map.Update(still.frame));
+    CHECK_EQUAL(CountActive(map), 0);
+    map.Coded();
+
+    YUVFrame unknown = YUVFrame();
+    CHECK(!map.Update(unknown));
+    map.Coded();
+    CHECK(!map.Update(still.frame));
+    map.Coded();
+    CHECK(map.Update(still.frame));
+
+    // A change all over the picture isn't worth a map
+    TestFrame everything(map, {});
+    everything.blocks.assign(everything.blocks.size(), 1);
+    CHECK(!map.Update(everything.frame));
+}
+
+int
+main() {
+    TestInit();
+    TestPeriod();
+    TestWholeFrames();
+
+    return TestResult("ActiveMapTest");
+}
@@ -0,0 +1,129 @@
+/*
+ * AlignmentBench.cpp
+ * Conversion into pool frames against tightly packed, unaligned planes, and
+ * what reusing the pool saves on a re-init
+ */
+#include "ColorKernels.h"
+#include "FrameBufferPool.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+
+// Planes packed without padding from an odd address, like vpx_img_alloc()
+// with an alignment of 1 could hand out
+static void
+TightPlanes(YUVLayout layout, int32 width, int32 height, uint8 *base, YUVPlanes &planes) {
+    int32 chromaWidth = layout == YUV_I444 ? width : (width + 1) / 2;
+    int32 chromaHeight = layout == YUV_I444 ? height : (height + 1) / 2;
+
+    planes.layout = layout;
+    planes.stride[0] = width;
+    planes.stride[1] = layout == YUV_NV12 ? chromaWidth * 2 : chromaWidth;
+    planes.stride[2] = layout == YUV_NV12 ? 0 : chromaWidth;
+    planes.plane[0] = base;
+    planes.plane[1] = base + (size_t) width * height;
+    planes.plane[2] = layout == YUV_NV12 ? nullptr : planes.plane[1] + (size_t) planes.stride[1] * chromaHeight;
+}
+
+static bigtime_t
+TimeConvert(RowPairFunc kernel, const uint8 *rgb, int32 width, int32 height, const YUVPlanes &planes,
+            int32 frames) {
+    const int32 stride = width * 4;
+    bigtime_t start = BenchTime();
+    for (int32 i = 0; i < frames; i++) {
+        for (int32 y = 0; y < height; y += 2) {
+            YUVRowPair out;
+            bool pair = y + 1 < height;
+            out.y[0] = planes.plane[0] + (size_t) y * planes.stride[0];
+            out.y[1] = pair ? out.y[0] + planes.stride[0] : nullptr;
+            if (planes.layout == YUV_I444) {
+                out.u[0] = planes.plane[1] + (size_t) y * planes.stride[1];
+                out.v[0] = planes.plane[2] + (size_t) y * planes.stride[2];
+                out.u[1] = pair ? out.u[0] + planes.stride[1] : nullptr;
+                out.v[1] = pair ? out.v[0] + planes.stride[2] : nullptr;
+            } else {
+                out.u[0] = planes.plane[1] + (size_t) (y / 2) * planes.stride[1];
+                out.v[0] = planes.plane[2] ? planes.plane[2] + (size_t) (y / 2) * planes.stride[2] : nullptr;
+                out.u[1] = out.v[1] = nullptr;
+            }
+            const uint8 *row0 = rgb + (size_t) y * stride;
+            kernel(row0, pair ? row0 + stride : row0, out, 0, width);
+        }
+    }
+    return BenchTime() - start;
+}
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 50;
+    if (frames < 1) frames = 1;
+
+    const int32 sizes[][2] = {{1366, 768}, {1920, 1080}, {2560, 1440}};
+    printf("Single thread, %d frames: tight planes at an odd address -> pool layout\n", (int) frames);
+
+    for (const auto &size : sizes) {
+        const int32 width = size[0], height = size[1];
+        std::vector<uint8> rgb((size_t) width * 4 * height);
+        FillRandom(rgb.data(), rgb.size(), 3);
+
+        for (int32 set = 0; set < kKernelSetCount; set++) {
+            if (!CpuFeatures::Has(kKernelSets[set].features)) continue;
+            printf("%4dx%-4d %-8s", (int) width, (int) height, kKernelSets[set].name);
+
+            for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+                RowPairFunc kernel = kKernelSets[set].kernels[layout];
+
+                YUVPlanes pooled;
+                FrameBufferPool pool;
+                pool.Reserve(1, FrameBufferPool::Layout((YUVLayout) layout, width, height, nullptr, pooled));
+                FrameBufferPool::Layout((YUVLayout) layout, width, height, pool.BufferAt(0), pooled);
+
+                std::vector<uint8> packed((size_t) width * height * 3 + 64);
+                YUVPlanes tight;
+                TightPlanes((YUVLayout) layout, width, height, packed.data() + 1, tight);
+
+                // Warm both up, so page faults don't count
+                TimeConvert(kernel, rgb.data(), width, height, tight, 1);
+                TimeConvert(kernel, rgb.data(), width, height, pooled, 1);
+                bigtime_t tightTime = TimeConvert(kernel, rgb.data(), width, height, tight, frames);
+                bigtime_t pooledTime = TimeConvert(kernel, rgb.data(), width, height, pooled, frames);
+
+                printf("  %s %5.2f -> %5.2f ms %+5.1f%%", kLayoutNames[layout], tightTime / 1000.0 / frames,
+                       pooledTime / 1000.0 / frames, 100.0 * (pooledTime - tightTime) / tightTime);
+            }
+            printf("\n");
+        }
+    }
+
+    // A codec or resolution change: the first frame after Init() either
+    // faults in new memory or finds the old pages mapped
+    ColorConverter converter;
+    const int32 width = 1920, height = 1080, reinits = 20;
+    std::vector<uint8> rgb((size_t) width * 4 * height);
+    FillRandom(rgb.data(), rgb.size(), 4);
+
+    bigtime_t fresh = 0, reused = 0;
+    FrameBufferPool kept;
+    for (int32 i = 0; i < reinits; i++) {
+        YUVLayout layout = i % 2 ? YUV_NV12 : YUV_I420; // Switching between VP9 and H.264
+        YUVPlanes planes;
+        size_t bytes = FrameBufferPool::Layout(layout, width, height, nullptr, planes);
+
+        bigtime_t start = BenchTime();
+        {
+            FrameBufferPool pool;
+            pool.Reserve(3, bytes);
+            FrameBufferPool::Layout(layout, width, height, pool.BufferAt(0), planes);
+            converter.Convert(rgb.data(), width * 4, width, height, planes);
+        }
+        fresh += BenchTime() - start;
+
+        start = BenchTime();
+        kept.Reserve(3, bytes);
+        FrameBufferPool::Layout(layout, width, height, kept.BufferAt(0), planes);
+        converter.Convert(rgb.data(), width * 4, width, height, planes);
+        reused += BenchTime() - start;
+    }
+    printf("First 1080p frame after a re-init, %s: new memory %.2f ms, reused pool %.2f ms\n", converter.KernelName(),
+           fresh / 1000.0 / reinits, reused / 1000.0 / reinits);
+    return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * CaptureFileTest.cpp
+ * FrameRecorder -> ReplaySource round trips, pacing and damaged files
+ */
+#include "CaptureFile.h"
+#include "DamageTracker.h"
+#include "FrameRecorder.h"
+#include "ReplaySource.h"
+#include "SyntheticSource.h"
+#include "TestUtils.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static const char *kPath = "capture_file_test.hrdc";
+static const bigtime_t kFrameSpacing = 20000;
+
+// A frame as packed B_RGB32 rows
+static std::vector<uint8>
+CopyFrame(const FrameSnapshot *snapshot) {
+    std::vector<uint8> frame((size_t) snapshot->width * 4 * snapshot->height);
+    for (int32 y = 0; y < snapshot->height; y++)
+        memcpy(&frame[(size_t) y * snapshot->width * 4], snapshot->bits + (size_t) y * snapshot->rowBytes,
+               snapshot->width * 4);
+    return frame;
+}
+
+// Records frames of the synthetic source, kFrameSpacing apart. Returns what
+// each frame looked like.
+static std::vector<std::vector<uint8>>
+Record(int32 width, int32 height, int32 frames, bool delta) {
+    std::vector<std::vector<uint8>> recorded;
+
+    SyntheticSource source(width, height);
+    DamageTracker tracker;
+    tracker.Init(width, height);
+
+    FrameRecorder recorder;
+    CHECK_EQUAL(recorder.Open(kPath, width, height, delta), B_OK);
+
+    for (int32 i = 0; i < frames; i++) {
+        FrameSnapshot *snapshot = source.Snapshot();
+        CHECK(snapshot != nullptr);
+        if (!snapshot) break;
+
+        snapshot->timestamp = 1000000 + i * kFrameSpacing;
+        tracker.Update(snapshot->bits, snapshot->rowBytes);
+        CHECK_EQUAL(recorder.AddFrame(snapshot, tracker.DirtyMap()), B_OK);
+
+        recorded.push_back(CopyFrame(snapshot));
+        source.ReleaseSnapshot(snapshot);
+        source.Advance();
+    }
+
+    recorder.Close();
+    return recorded;
+}
+
+static off_t
+FileSize() {
+    struct stat st;
+    return stat(kPath, &st) == 0 ? st.st_size : -1;
+}
+
+static void
+TestRoundTrip(int32 width, int32 height, bool delta) {
+    const int32 frames = 12;
+    std::vector<std::vector<uint8>> recorded = Record(width, height, frames, delta);
+
+    ReplaySource replay;
+    CHECK_EQUAL(replay.Open(kPath, false), B_OK);
+    CHECK_EQUAL(replay.Width(), width);
+    CHECK_EQUAL(replay.Height(), height);
+    CHECK(replay.IsConnected());
+
+    // Twice through, playback loops at the end
+    for (int32 i = 0; i < frames * 2; i++) {
+        FrameSnapshot *snapshot = replay.Snapshot();
+        CHECK(snapshot != nullptr);
+        if (!snapshot) continue;
+
+        if (CopyFrame(snapshot) != recorded[i % frames])
+            fprintf(stderr, "%dx%d %s: replayed frame %d differs\n", (int) width, (int) height,
+                    delta ? "delta" : "full", (int) i);
+        CHECK(CopyFrame(snapshot) == recorded[i % frames]);
+        replay.ReleaseSnapshot(snapshot);
+    }
+}
+
+// Explicit bytes on disk, the header layout and the size delta saves
+static void
+TestFileLayout() {
+    const int32 width = 200, height = 130;
+    Record(width, height, 6, false);
+    off_t fullSize = FileSize();
+
+    Record(width, height, 6, true);
+    off_t deltaSize = FileSize();
+    CHECK(deltaSize > 0 && deltaSize < fullSize);
+
+    FILE *file = fopen(kPath, "rb");
+    CHECK(file != nullptr);
+    if (!file) return;
+
+    CaptureFileHeader header;
+    CHECK_EQUAL(fread(&header, sizeof(header), 1, file), 1);
+    fclose(file);
+
+    // The magic is the same value the 'HRDC' literal had, in host order
+    uint8 magic[4];
+    memcpy(magic, &header.magic, 4);
+    const uint32 value =
+        (uint32) magic[0] | ((uint32) magic[1] << 8) | ((uint32) magic[2] << 16) | ((uint32) magic[3] << 24);
+    CHECK_EQUAL(value, 0x48524443); // 'H' 'R' 'D' 'C'
+    CHECK_EQUAL(memcmp(magic, "CDRH", 4), 0);
+
+    CHECK_EQUAL(header.version, CAPTURE_FILE_VERSION);
+    CHECK_EQUAL(header.width, width);
+    CHECK_EQUAL(header.height, height);
+    CHECK_EQUAL(header.tileSize, DamageTracker::kTileSize);
+    CHECK_EQUAL(header.flags, CAPTURE_FLAG_DELTA);
+    CHECK_EQUAL(header.frameCount, 6);
+    CHECK_EQUAL(header.dataSize, (uint64) deltaSize - sizeof(header));
+}
+
+// At recorded speed the frames come kFrameSpacing apart
+static void
+TestRealtime() {
+    const int32 frames = 6;
+    Record(96, 64, frames, true);
+
+    ReplaySource replay;
+    CHECK_EQUAL(replay.Open(kPath, true), B_OK);
+
+    bigtime_t start = BenchTime();
+    for (int32 i = 0; i < frames; i++) {
+        FrameSnapshot *snapshot = nullptr;
+        while (!snapshot) snapshot = replay.Snapshot();
+        replay.ReleaseSnapshot(snapshot);
+    }
+    bigtime_t elapsed = BenchTime() - start;
+
+    CHECK(elapsed >= (frames - 1) * kFrameSpacing);
+    CHECK(elapsed < (frames - 1) * kFrameSpacing + 500000);
+}
+
+static void
+TestDamagedFiles() {
+    Record(130, 70, 4, true);
+    off_t size = FileSize();
+
+    ReplaySource replay;
+    CHECK_EQUAL(replay.Open("does-not-exist.hrdc", false), B_ERROR);
+
+    // Cut short in the middle of the last frame
+    CHECK_EQUAL(truncate(kPath, size - 10), 0);
+    CHECK_EQUAL(replay.Open(kPath, false), B_BAD_VALUE);
+    CHECK(!replay.IsConnected());
+
+    // Wrong magic
+    Record(130, 70, 4, true);
+    FILE *file = fopen(kPath, "r+b");
+    if (file) {
+        fwrite("XXXX", 4, 1, file);
+        fclose(file);
+    }
+    CHECK_EQUAL(replay.Open(kPath, false), B_BAD_VALUE);
+
+    // A tile outside the frame
+    Record(130, 70, 4, true);
+    file = fopen(kPath, "r+b");
+    if (file) {
+        CaptureTileHeader tile = {100, 0};
+        fseek(file, sizeof(CaptureFileHeader) + sizeof(CaptureFrameHeader), SEEK_SET);
+        fwrite(&tile, sizeof(tile), 1, file);
+        fclose(file);
+    }
+    CHECK_EQUAL(replay.Open(kPath, false), B_BAD_VALUE);
+
+    // Too short for a header
+    CHECK_EQUAL(truncate(kPath, 8), 0);
+    CHECK_EQUAL(replay.Open(kPath, false), B_BAD_VALUE);
+}
+
+int
+main() {
+    TestRoundTrip(256, 128, true);
+    TestRoundTrip(200, 130, true);
+    TestRoundTrip(200, 130, false);
+    TestRoundTrip(33, 7, true);
+
+    TestFileLayout();
+    TestRealtime();
+    TestDamagedFiles();
+
+    unlink(kPath);
+    return TestResult("CaptureFileTest");
+}
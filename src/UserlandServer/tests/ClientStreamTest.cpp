@@ -0,0 +1,163 @@
+/*
+ * ClientStreamTest.cpp
+ * Temporal layers on the wire and per client: the layer pattern and meta
+ * byte, which frames each client is sent, and how round trips shed and
+ * restore layers before touching the bitrate
+ */
+#include "ClientStream.h"
+#include "TemporalLayers.h"
+#include "TestUtils.h"
+#include <vector>
+
+static void
+TestMetaByte() {
+    for (int32 layer = 0; layer < kMaxLayers; layer++) {
+        for (int32 key = 0; key < 2; key++) {
+            uint8 meta = FrameMetaByte(key != 0, layer);
+            // Bit 0 keyframe, bits 1-2 layer, nothing else
+            CHECK_EQUAL(meta, key | layer << 1);
+            CHECK_EQUAL(MetaByteIsKey(meta), key != 0);
+            CHECK_EQUAL(MetaByteLayer(meta), layer);
+        }
+    }
+}
+
+// Each layer count gets the documented share of the frames: the base a
+// quarter, two layers half, three all of them
+static void
+TestLayerPattern() {
+    CHECK_EQUAL(LayerOfFrame(0), 0);
+
+    int32 frames[kMaxLayers] = {};
+    for (int64 frame = 0; frame < 60; frame++) {
+        int32 layer = LayerOfFrame(frame);
+        CHECK(layer >= 0 && layer < 3);
+        for (int32 layers = 1; layers <= 3; layers++) frames[layers] += layer < layers;
+    }
+    CHECK_EQUAL(frames[1], 15);
+    CHECK_EQUAL(frames[2], 30);
+    CHECK_EQUAL(frames[3], 60);
+
+    // Evenly spaced, so fewer layers are a steady lower frame rate
+    for (int64 frame = 0; frame < 60; frame++) {
+        CHECK_EQUAL(LayerOfFrame(frame) == 0, frame % 4 == 0);
+        CHECK_EQUAL(LayerOfFrame(frame) <= 1, frame % 2 == 0);
+    }
+}
+
+// The steps of NetworkServer::_Broadcast() for every client, without the
+// queues: who is sent what
+static void
+Broadcast(std::vector<ClientStream> &clients, std::vector<std::vector<uint8>> &received, int32 tier, bool isKey,
+          int32 layer) {
+    for (size_t i = 0; i < clients.size(); i++) {
+        if (!clients[i].Takes(tier, isKey, layer)) continue;
+        received[i].push_back(FrameMetaByte(isKey, layer));
+        clients[i].Queued(tier, isKey);
+    }
+}
+
+static void
+TestShedding() {
+    std::vector<ClientStream> clients(4);
+    for (ClientStream &client : clients) client.Start(3);
+    clients[1].layers = 2;
+    clients[2].layers = 1;
+    clients[3].tier = 1; // Watches another tier
+
+    std::vector<std::vector<uint8>> received(clients.size());
+    int32 tier = clients[0].tier;
+
+    // A control message doesn't end the wait, the delta frames before the
+    // first keyframe go to nobody
+    Broadcast(clients, received, -1, true, 0);
+    for (int64 frame = 1; frame < 4; frame++) Broadcast(clients, received, tier, false, LayerOfFrame(frame));
+    for (size_t i = 0; i < clients.size(); i++) {
+        CHECK_EQUAL(received[i].size(), 1);
+        CHECK(clients[i].waitingForKeyframe);
+        received[i].clear();
+    }
+
+    for (int64 frame = 0; frame < 60; frame++) Broadcast(clients, received, tier, frame == 0, LayerOfFrame(frame));
+    CHECK_EQUAL(received[0].size(), 60);
+    CHECK_EQUAL(received[1].size(), 30);
+    CHECK_EQUAL(received[2].size(), 15);
+    CHECK_EQUAL(received[3].size(), 0);
+
+    // Never a layer above the client's
+    for (size_t i = 0; i < 3; i++) {
+        CHECK(MetaByteIsKey(received[i][0]));
+        for (uint8 meta : received[i]) CHECK(MetaByteLayer(meta) < clients[i].layers);
+    }
+
+    // Control messages still reach every client
+    Broadcast(clients, received, -1, true, 0);
+    CHECK_EQUAL(received[3].size(), 1);
+}
+
+static void
+TestRoundTrips() {
+    ClientStream client;
+    client.Start(3);
+    client.bitrate = 4000;
+    int32 layers, kbps;
+
+    // Congested: the layers go first, one per ping
+    for (int32 expected = 2; expected >= 1; expected--) {
+        client.AfterRoundTrip(kCongestedRoundTrip + 1, 3, layers, kbps);
+        CHECK_EQUAL(layers, expected);
+        CHECK_EQUAL(kbps, 4000);
+        client.layers = layers;
+    }
+
+    // Then the bitrate, down to its floor
+    client.AfterRoundTrip(400, 3, layers, kbps);
+    CHECK_EQUAL(layers, 1);
+    CHECK_EQUAL(kbps, 3200);
+    client.bitrate = 310;
+    client.AfterRoundTrip(400, 3, layers, kbps);
+    CHECK_EQUAL(kbps, kMinClientKbps);
+
+    // In between nothing changes
+    client.bitrate = 3200;
+    client.AfterRoundTrip(kClearRoundTrip, 3, layers, kbps);
+    CHECK_EQUAL(layers, 1);
+    CHECK_EQUAL(kbps, 3200);
+    client.AfterRoundTrip(kCongestedRoundTrip, 3, layers, kbps);
+    CHECK_EQUAL(layers, 1);
+    CHECK_EQUAL(kbps, 3200);
+
+    // Clear: the layers come back before the bitrate rises
+    for (int32 expected = 2; expected <= 3; expected++) {
+        client.AfterRoundTrip(10, 3, layers, kbps);
+        CHECK_EQUAL(layers, expected);
+        CHECK_EQUAL(kbps, 3200);
+        client.layers = layers;
+    }
+    client.AfterRoundTrip(10, 3, layers, kbps);
+    CHECK_EQUAL(layers, 3);
+    CHECK_EQUAL(kbps, 3360);
+    client.bitrate = 7900;
+    client.AfterRoundTrip(10, 3, layers, kbps);
+    CHECK_EQUAL(kbps, kMaxClientKbps);
+
+    // A codec without layers only has the bitrate, and a client set up for
+    // more layers than the stream now has is brought down to them
+    client.bitrate = 4000;
+    client.AfterRoundTrip(400, 1, layers, kbps);
+    CHECK_EQUAL(layers, 1);
+    CHECK_EQUAL(kbps, 3200);
+    client.AfterRoundTrip(10, 1, layers, kbps);
+    CHECK_EQUAL(layers, 1);
+    CHECK_EQUAL(kbps, 4200);
+}
+
+int
+main() {
+    TestMetaByte();
+    TestLayerPattern();
+    TestShedding();
+    TestRoundTrips();
+
+    return TestResult("ClientStreamTest");
+}
@@ -0,0 +1,64 @@
+/*
+ * ColorConvertBench.cpp
+ * Single thread conversion speed of every kernel the CPU runs, per layout
+ */
+#include "ColorKernels.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+
+static void
+ConvertFrame(RowPairFunc kernel, const uint8 *rgb, int32 stride, int32 width, int32 height, const YUVPlanes &planes) {
+    for (int32 y = 0; y < height; y += 2) {
+        const uint8 *row0 = rgb + (size_t) y * stride;
+        YUVRowPair out;
+        out.y[0] = planes.plane[0] + (size_t) y * planes.stride[0];
+        out.y[1] = out.y[0] + planes.stride[0];
+        if (planes.layout == YUV_I444) {
+            out.u[0] = planes.plane[1] + (size_t) y * planes.stride[1];
+            out.v[0] = planes.plane[2] + (size_t) y * planes.stride[2];
+            out.u[1] = out.u[0] + planes.stride[1];
+            out.v[1] = out.v[0] + planes.stride[2];
+        } else {
+            out.u[0] = planes.plane[1] + (size_t) (y / 2) * planes.stride[1];
+            out.v[0] = planes.layout == YUV_NV12 ? nullptr : planes.plane[2] + (size_t) (y / 2) * planes.stride[2];
+            out.u[1] = out.v[1] = nullptr;
+        }
+        kernel(row0, row0 + stride, out, 0, width);
+    }
+}
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 50;
+    if (frames < 1) frames = 1;
+
+    const int32 width = 1920, height = 1080, stride = width * 4;
+    std::vector<uint8> rgb((size_t) stride * height);
+    FillRandom(rgb.data(), rgb.size(), 5);
+
+    printf("%dx%d, %d frames\n", (int) width, (int) height, (int) frames);
+    for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+        PlaneBuffer buffer((YUVLayout) layout, width, height);
+        const YUVPlanes &planes = buffer.planes;
+        bigtime_t scalar = 0;
+
+        for (int32 set = 0; set < kKernelSetCount; set++) {
+            if (!CpuFeatures::Has(kKernelSets[set].features)) {
+                printf("%s %-8s  not supported by this CPU\n", kLayoutNames[layout], kKernelSets[set].name);
+                continue;
+            }
+            RowPairFunc kernel = kKernelSets[set].kernels[layout];
+
+            ConvertFrame(kernel, rgb.data(), stride, width, height, planes); // Fault the planes in
+            bigtime_t start = BenchTime();
+            for (int32 i = 0; i < frames; i++) ConvertFrame(kernel, rgb.data(), stride, width, height, planes);
+            bigtime_t elapsed = BenchTime() - start;
+            if (set == 0) scalar = elapsed;
+
+            printf("%s %-8s  %7.1f MP/s %6.2f ms/frame   %.1fx scalar\n", kLayoutNames[layout],
+                   kKernelSets[set].name, (double) width * height * frames / elapsed, elapsed / 1000.0 / frames,
+                   (double) scalar / elapsed);
+        }
+    }
+    return 0;
+}
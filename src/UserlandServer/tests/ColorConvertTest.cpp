@@ -0,0 +1,290 @@
+/*
+ * ColorConvertTest.cpp
+ * Scalar accuracy against BT.601, every SIMD kernel bit exact against scalar
+ */
+#include "ColorKernels.h"
+#include "GuardedRow.h"
+#include "TestUtils.h"
+#include "WorkerPool.h"
+#include <math.h>
+#include <string.h>
+
+// BT.601 studio range in floating point, from 8-bit B, G, R
+static double
+ExactLuma(double b, double g, double r) {
+    return 16 + (65.481 * r + 128.553 * g + 24.966 * b) / 255;
+}
+
+static double
+ExactU(double b, double g, double r) {
+    return 128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255;
+}
+
+static double
+ExactV(double b, double g, double r) {
+    return 128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255;
+}
+
+static void
+CheckClose(int32 actual, double exact, double tolerance, double &worst) {
+    double error = fabs(actual - exact);
+    if (error > worst) worst = error;
+    CHECK(error <= tolerance);
+}
+
+// Output rows for one pair of input rows, the way ColorConverter sets them up
+static YUVRowPair
+RowPair(const PlaneBuffer &buffer, int32 y, bool pair) {
+    const YUVPlanes &planes = buffer.planes;
+    YUVRowPair out;
+    out.y[0] = planes.plane[0] + (size_t) y * planes.stride[0];
+    out.y[1] = pair ? out.y[0] + planes.stride[0] : nullptr;
+
+    if (planes.layout == YUV_I444) {
+        out.u[0] = planes.plane[1] + (size_t) y * planes.stride[1];
+        out.v[0] = planes.plane[2] + (size_t) y * planes.stride[2];
+        out.u[1] = pair ? out.u[0] + planes.stride[1] : nullptr;
+        out.v[1] = pair ? out.v[0] + planes.stride[2] : nullptr;
+    } else {
+        out.u[0] = planes.plane[1] + (size_t) (y / 2) * planes.stride[1];
+        out.v[0] = planes.layout == YUV_NV12 ? nullptr : planes.plane[2] + (size_t) (y / 2) * planes.stride[2];
+        out.u[1] = nullptr;
+        out.v[1] = nullptr;
+    }
+    return out;
+}
+
+// The integer scalar kernel against the exact formulas, for random pixels and
+// the corners of the RGB cube. Subsampled chroma is compared with the exact
+// chroma of the block's average color.
+static void
+TestAccuracy() {
+    const int32 width = 256;
+    std::vector<uint8> rows(width * 4 * 2);
+    FillRandom(rows.data(), rows.size(), 1);
+
+    // All eight corners, in both rows so the 2x2 blocks are solid
+    for (int32 corner = 0; corner < 8; corner++) {
+        for (int32 i = 0; i < 4; i++) {
+            uint8 *pixel = &rows[(corner * 2 + (i & 1) + (i >> 1) * width) * 4];
+            pixel[0] = corner & 1 ? 255 : 0;
+            pixel[1] = corner & 2 ? 255 : 0;
+            pixel[2] = corner & 4 ? 255 : 0;
+        }
+    }
+
+    const uint8 *row0 = rows.data();
+    const uint8 *row1 = row0 + width * 4;
+    double worstLuma = 0, worstChroma = 0, worstAverage = 0;
+
+    for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+        PlaneBuffer buffer((YUVLayout) layout, width, 2);
+        kKernelSets[0].kernels[layout](row0, row1, RowPair(buffer, 0, true), 0, width);
+        const YUVPlanes &planes = buffer.planes;
+
+        for (int32 y = 0; y < 2; y++) {
+            for (int32 x = 0; x < width; x++) {
+                const uint8 *p = (y ? row1 : row0) + x * 4;
+                int32 luma = planes.plane[0][y * planes.stride[0] + x];
+                CheckClose(luma, ExactLuma(p[0], p[1], p[2]), 1.0, worstLuma);
+                CHECK(luma >= 16 && luma <= 235);
+
+                if (layout == YUV_I444) {
+                    CheckClose(planes.plane[1][y * planes.stride[1] + x], ExactU(p[0], p[1], p[2]), 1.0, worstChroma);
+                    CheckClose(planes.plane[2][y * planes.stride[2] + x], ExactV(p[0], p[1], p[2]), 1.0, worstChroma);
+                }
+            }
+        }
+
+        if (layout == YUV_I444) continue;
+
+        for (int32 x = 0; x < width; x += 2) {
+            double b = 0, g = 0, r = 0;
+            for (int32 i = 0; i < 4; i++) {
+                const uint8 *p = (i >> 1 ? row1 : row0) + (x + (i & 1)) * 4;
+                b += p[0] / 4.0;
+                g += p[1] / 4.0;
+                r += p[2] / 4.0;
+            }
+
+            int32 u, v;
+            if (layout == YUV_NV12) {
+                u = planes.plane[1][x];
+                v = planes.plane[1][x + 1];
+            } else {
+                u = planes.plane[1][x / 2];
+                v = planes.plane[2][x / 2];
+            }
+
+            CheckClose(u, ExactU(b, g, r), 1.0, worstAverage);
+            CheckClose(v, ExactV(b, g, r), 1.0, worstAverage);
+            CHECK(u >= 16 && u <= 240 && v >= 16 && v <= 240);
+        }
+    }
+
+    printf("Worst error: luma %.2f, chroma %.2f, averaged chroma %.2f\n", worstLuma, worstChroma, worstAverage);
+}
+
+// One call of a kernel and of the scalar one on the same rows, compared over
+// the whole buffer including the padding after each row
+static bool
+SameAsScalar(RowPairFunc kernel, YUVLayout layout, const uint8 *row0, const uint8 *row1, int32 x, int32 width,
+             bool pair) {
+    PlaneBuffer expected(layout, width, pair ? 2 : 1, 64);
+    PlaneBuffer actual(layout, width, pair ? 2 : 1, 64);
+
+    kKernelSets[0].kernels[layout](row0, pair ? row1 : row0, RowPair(expected, 0, pair), x, width);
+    kernel(row0, pair ? row1 : row0, RowPair(actual, 0, pair), x, width);
+    return expected.data == actual.data;
+}
+
+// Every width up to a few vectors past the widest kernel, so each remainder
+// falls to the scalar tail once. The rows end at an unmapped page.
+static void
+TestKernels() {
+    GuardedRow guarded;
+    std::vector<uint8> rows(guarded.Capacity());
+    const int32 maxWidth = (int32) (guarded.Capacity() / 8);
+
+    for (int32 set = 1; set < kKernelSetCount; set++) {
+        if (!CpuFeatures::Has(kKernelSets[set].features)) {
+            printf("%s: not supported by this CPU, skipped\n", kKernelSets[set].name);
+            continue;
+        }
+
+        int32 mismatches = 0;
+        for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+            for (int32 width = 1; width <= maxWidth; width += width < 200 ? 1 : 37) {
+                FillRandom(rows.data(), width * 8, width * 3 + layout);
+                const uint8 *row0 = guarded.Place(rows.data(), width * 8);
+                const uint8 *row1 = row0 + width * 4;
+                RowPairFunc kernel = kKernelSets[set].kernels[layout];
+
+                for (int32 x = 0; x < width && x <= 10; x += 2) {
+                    if (!SameAsScalar(kernel, (YUVLayout) layout, row0, row1, x, width, true)) {
+                        fprintf(stderr, "%s %s: width %d from %d differs\n", kKernelSets[set].name,
+                                kLayoutNames[layout], (int) width, (int) x);
+                        mismatches++;
+                    }
+                }
+
+                // Last row of an odd height frame
+                if (!SameAsScalar(kernel, (YUVLayout) layout, row1, row1, 0, width, false)) {
+                    fprintf(stderr, "%s %s: single row of width %d differs\n", kKernelSets[set].name,
+                            kLayoutNames[layout], (int) width);
+                    mismatches++;
+                }
+            }
+        }
+        CHECK_EQUAL(mismatches, 0);
+    }
+}
+
+// A frame converted row pair by row pair with the scalar kernels
+static void
+ScalarFrame(PlaneBuffer &buffer, const std::vector<uint8> &rgb, int32 stride, int32 width, int32 height) {
+    YUVLayout layout = buffer.planes.layout;
+    for (int32 y = 0; y < height; y += 2) {
+        bool pair = y + 1 < height;
+        const uint8 *row0 = rgb.data() + (size_t) y * stride;
+        kKernelSets[0].kernels[layout](row0, pair ? row0 + stride : row0, RowPair(buffer, y, pair), 0, width);
+    }
+}
+
+// ColorConverter with the kernels it picked, on odd sizes, alone and with a
+// pool splitting the frame into stripes
+static void
+TestConverter(WorkerPool &workers) {
+    ColorConverter converter;
+    printf("ColorConverter picked %s\n", converter.KernelName());
+
+    const int32 sizes[][2] = {{1, 1}, {3, 1}, {1, 5}, {33, 17}, {639, 479}, {1921, 1081}};
+    for (const auto &size : sizes) {
+        int32 width = size[0], height = size[1], stride = width * 4 + 12;
+        std::vector<uint8> rgb((size_t) stride * height);
+        FillRandom(rgb.data(), rgb.size(), width + height);
+
+        for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+            PlaneBuffer expected((YUVLayout) layout, width, height, 16);
+            ScalarFrame(expected, rgb, stride, width, height);
+
+            PlaneBuffer alone((YUVLayout) layout, width, height, 16);
+            converter.Convert(rgb.data(), stride, width, height, alone.planes);
+            CHECK(alone.data == expected.data);
+
+            PlaneBuffer parallel((YUVLayout) layout, width, height, 16);
+            converter.Convert(rgb.data(), stride, width, height, parallel.planes, &workers);
+            CHECK(parallel.data == expected.data);
+        }
+    }
+}
+
+// Only the rects, grown to even bounds, may change: no chroma sample is shared
+// with a pixel outside. Inside them the result is what a whole frame
+// conversion gives.
+static void
+TestRects(WorkerPool &workers) {
+    ColorConverter converter;
+    const int32 width = 301, height = 203, stride = width * 4;
+    std::vector<uint8> rgb((size_t) stride * height);
+    FillRandom(rgb.data(), rgb.size(), 9);
+
+    const clipping_rect rects[] = {
+        {5, 7, 40, 12},      // Odd edges
+        {290, 190, 400, 300}, // Past the frame
+        {-10, -10, 0, 0},    // Before it
+        {100, 50, 299, 180}, // Big enough for the pool
+    };
+    const int32 count = sizeof(rects) / sizeof(rects[0]);
+
+    for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+        PlaneBuffer full((YUVLayout) layout, width, height, 16);
+        ScalarFrame(full, rgb, stride, width, height);
+
+        for (int32 threaded = 0; threaded < 2; threaded++) {
+            PlaneBuffer partial((YUVLayout) layout, width, height, 16);
+            converter.ConvertRects(rgb.data(), stride, width, height, partial.planes, rects, count,
+                                   threaded ? &workers : nullptr);
+
+            int32 wrong = 0;
+            for (int32 y = 0; y < height; y++) {
+                for (int32 x = 0; x < width; x++) {
+                    bool inside = false;
+                    for (int32 i = 0; i < count; i++) {
+                        inside |= x >= (rects[i].left & ~1) && x <= (rects[i].right | 1) && y >= (rects[i].top & ~1)
+                                  && y <= (rects[i].bottom | 1);
+                    }
+
+                    // Every sample of this pixel in each plane
+                    for (int32 plane = 0; plane < 3; plane++) {
+                        if (!partial.planes.plane[plane]) continue;
+                        int32 px = x, py = y;
+                        if (plane > 0 && layout != YUV_I444) {
+                            px = layout == YUV_NV12 ? x & ~1 : x / 2;
+                            py = y / 2;
+                        }
+                        size_t offset = (size_t) py * partial.planes.stride[plane] + px;
+                        uint8 got = partial.planes.plane[plane][offset];
+                        uint8 want = inside ? full.planes.plane[plane][offset] : 0xA5;
+                        if (got != want) wrong++;
+                    }
+                }
+            }
+            CHECK_EQUAL(wrong, 0);
+        }
+    }
+}
+
+int
+main() {
+    WorkerPool workers;
+    CHECK_EQUAL(workers.Init(4, "ColorConvertTest"), B_OK);
+
+    TestAccuracy();
+    TestKernels();
+    TestConverter(workers);
+    TestRects(workers);
+
+    workers.Shutdown();
+    return TestResult("ColorConvertTest");
+}
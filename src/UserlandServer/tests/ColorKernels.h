@@ -0,0 +1,75 @@
+/*
+ * ColorKernels.h
+ * Every ColorConvert kernel by instruction set, for the tests and benchmarks
+ */
+#ifndef COLOR_KERNELS_H
+#define COLOR_KERNELS_H
+
+#include "ColorConvert.h"
+#include "CpuFeatures.h"
+#include <vector>
+
+struct KernelSet {
+    const char *name;
+    uint32 features; // What the CPU needs to run them
+    RowPairFunc kernels[YUV_LAYOUT_COUNT];
+};
+
+static const KernelSet kKernelSets[] = {
+    {"scalar", 0, {ConvertRowPairScalar<YUV_I420>, ConvertRowPairScalar<YUV_NV12>, ConvertRowPairScalar<YUV_I444>}},
+    {"SSE4.1", CpuFeatures::SSE41,
+     {ConvertRowPairSSE41<YUV_I420>, ConvertRowPairSSE41<YUV_NV12>, ConvertRowPairSSE41<YUV_I444>}},
+    {"AVX2", CpuFeatures::AVX2,
+     {ConvertRowPairAVX2<YUV_I420>, ConvertRowPairAVX2<YUV_NV12>, ConvertRowPairAVX2<YUV_I444>}},
+    {"AVX-512", CpuFeatures::AVX512BW,
+     {ConvertRowPairAVX512<YUV_I420>, ConvertRowPairAVX512<YUV_NV12>, ConvertRowPairAVX512<YUV_I444>}},
+};
+
+static const int32 kKernelSetCount = sizeof(kKernelSets) / sizeof(kKernelSets[0]);
+
+static const char *const kLayoutNames[YUV_LAYOUT_COUNT] = {"I420", "NV12", "I444"};
+
+// Planes for a frame in one buffer. Each row is padded with pad bytes, so
+// writes past the width land somewhere they can be seen.
+struct PlaneBuffer {
+    std::vector<uint8> data;
+    YUVPlanes planes;
+    int32 width[3];
+    int32 height[3];
+
+    PlaneBuffer(YUVLayout layout, int32 frameWidth, int32 frameHeight, int32 pad = 0) {
+        int32 chromaWidth = (frameWidth + 1) / 2;
+        int32 chromaHeight = (frameHeight + 1) / 2;
+
+        width[0] = frameWidth;
+        height[0] = frameHeight;
+        if (layout == YUV_I444) {
+            width[1] = width[2] = frameWidth;
+            height[1] = height[2] = frameHeight;
+        } else if (layout == YUV_NV12) {
+            width[1] = chromaWidth * 2;
+            height[1] = chromaHeight;
+            width[2] = height[2] = 0;
+        } else {
+            width[1] = width[2] = chromaWidth;
+            height[1] = height[2] = chromaHeight;
+        }
+
+        size_t offset[3], size = 0;
+        planes.layout = layout;
+        for (int32 i = 0; i < 3; i++) {
+            planes.stride[i] = width[i] + pad;
+            offset[i] = size;
+            size += (size_t) planes.stride[i] * height[i];
+        }
+
+        data.assign(size, 0xA5);
+        for (int32 i = 0; i < 3; i++) planes.plane[i] = height[i] ? data.data() + offset[i] : nullptr;
+    }
+
+    // The planes point into data
+    PlaneBuffer(const PlaneBuffer &) = delete;
+    PlaneBuffer &operator=(const PlaneBuffer &) = delete;
+};
+
+#endif // COLOR_KERNELS_H
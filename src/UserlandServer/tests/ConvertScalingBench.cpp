@@ -0,0 +1,50 @@
+/*
+ * ConvertScalingBench.cpp
+ * Stripe-parallel frame conversion at 1 to N threads
+ */
+#include "ColorKernels.h"
+#include "TestUtils.h"
+#include "WorkerPool.h"
+#include <stdlib.h>
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 30;
+    if (frames < 1) frames = 1;
+
+    // Up to one thread per CPU unless asked for more
+    system_info info;
+    int32 maxThreads = argc > 2 ? atoi(argv[2]) : get_system_info(&info) == B_OK ? (int32) info.cpu_count : 1;
+    if (maxThreads < 1) maxThreads = 1;
+    if (maxThreads > WorkerPool::kMaxThreads) maxThreads = WorkerPool::kMaxThreads;
+
+    const int32 sizes[][2] = {{1920, 1080}, {3840, 2160}};
+
+    ColorConverter converter;
+    printf("%s kernels, %d frames, I420\n", converter.KernelName(), (int) frames);
+
+    for (const auto &size : sizes) {
+        const int32 width = size[0], height = size[1], stride = width * 4;
+        std::vector<uint8> rgb((size_t) stride * height);
+        FillRandom(rgb.data(), rgb.size(), 11);
+        PlaneBuffer buffer(YUV_I420, width, height);
+
+        double single = 0;
+        for (int32 threads = 1; threads <= maxThreads; threads++) {
+            WorkerPool workers;
+            workers.Init(threads, "ConvertScalingBench");
+
+            converter.Convert(rgb.data(), stride, width, height, buffer.planes, &workers); // Warm up
+            bigtime_t start = BenchTime();
+            for (int32 i = 0; i < frames; i++)
+                converter.Convert(rgb.data(), stride, width, height, buffer.planes, &workers);
+            bigtime_t elapsed = BenchTime() - start;
+
+            double rate = (double) width * height * frames / elapsed;
+            if (threads == 1) single = rate;
+            printf("%dx%d  %2d threads  %7.1f MP/s  %6.2f ms/frame  %.2fx\n", (int) width, (int) height, (int) threads,
+                   rate, elapsed / 1000.0 / frames, rate / single);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * DamageTrackerBench.cpp
+ * Tile hashing throughput on synthetic BGRA frames
+ */
+#include "DamageTracker.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+#include <vector>
+
+// Per pixel version of the same hash, to show what the SIMD lanes buy
+static uint64
+ScalarFrameHash(const uint8 *bits, int32 stride, int32 width, int32 height) {
+    uint32 hash = 0x811C9DC5;
+    for (int32 y = 0; y < height; y++) {
+        const uint32 *row = reinterpret_cast<const uint32 *>(bits + (size_t) y * stride);
+        for (int32 x = 0; x < width; x++) {
+            hash ^= row[x];
+            hash *= 0x01000193;
+            hash ^= hash >> 15;
+        }
+    }
+    return hash;
+}
+
+static void
+RunSize(int32 width, int32 height, int32 frames) {
+    int32 stride = width * 4;
+    std::vector<uint8> frame((size_t) stride * height);
+    FillRandom(frame.data(), frame.size(), 1);
+
+    DamageTracker tracker;
+    tracker.Init(width, height);
+    tracker.Update(frame.data(), stride);
+
+    double megabytes = (double) stride * height / (1024 * 1024);
+
+    // Idle desktop: nothing changes, every tile is hashed and compared
+    bigtime_t start = BenchTime();
+    int32 dirty = 0;
+    for (int32 i = 0; i < frames; i++) dirty += tracker.Update(frame.data(), stride);
+    bigtime_t idle = BenchTime() - start;
+
+    // One pixel per frame changes somewhere
+    uint32 state = 99;
+    start = BenchTime();
+    for (int32 i = 0; i < frames; i++) {
+        frame[(NextRandom(state) % (width * height)) * 4] ^= 0xFF;
+        dirty += tracker.Update(frame.data(), stride);
+    }
+    bigtime_t busy = BenchTime() - start;
+
+    start = BenchTime();
+    uint64 sink = 0;
+    for (int32 i = 0; i < frames; i++) sink += ScalarFrameHash(frame.data(), stride, width, height);
+    bigtime_t scalar = BenchTime() - start;
+
+    printf("%5dx%-5d  idle %6.2f ms/frame %6.0f MB/s   1px %6.2f ms/frame   scalar hash %6.2f ms/frame"
+           "  (%d dirty, %llx)\n",
+           (int) width, (int) height, idle / 1000.0 / frames, megabytes * frames / (idle / 1e6),
+           busy / 1000.0 / frames, scalar / 1000.0 / frames, (int) dirty, (unsigned long long) (sink & 0xF));
+}
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 100;
+    if (frames < 1) frames = 1;
+
+    RunSize(1280, 720, frames);
+    RunSize(1920, 1080, frames);
+    RunSize(2560, 1440, frames);
+    RunSize(3840, 2160, frames / 4 + 1);
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * DamageTrackerTest.cpp
+ * Tile hashing against a scalar reference and single pixel damage
+ */
+#include "DamageTracker.h"
+#include "TestUtils.h"
+#include <string.h>
+#include <vector>
+
+static const uint32 kHashPrime = 0x01000193;
+
+// What HashMixLanes does to each 32-bit lane
+static uint32
+HashMixScalar(uint32 acc, uint32 value) {
+    acc ^= value;
+    acc *= kHashPrime;
+    return acc ^ (acc >> 15);
+}
+
+static void
+TestHashMixLanes() {
+    const __m128i prime = _mm_set1_epi32(kHashPrime);
+    uint32 state = 0x12345678;
+
+    for (int32 round = 0; round < 10000; round++) {
+        uint32 acc[4], value[4], expected[4], actual[4];
+        for (int32 lane = 0; lane < 4; lane++) {
+            acc[lane] = NextRandom(state);
+            value[lane] = NextRandom(state);
+            expected[lane] = HashMixScalar(acc[lane], value[lane]);
+        }
+
+        __m128i result = HashMixLanes(_mm_loadu_si128(reinterpret_cast<const __m128i *>(acc)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i *>(value)), prime);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(actual), result);
+
+        CHECK(memcmp(actual, expected, sizeof(actual)) == 0);
+    }
+
+    // The carries out of the high lanes must not leak into the low ones
+    uint32 acc[4] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+    uint32 value[4] = {0, 0, 0, 0};
+    uint32 actual[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(actual),
+                     HashMixLanes(_mm_loadu_si128(reinterpret_cast<const __m128i *>(acc)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(value)), prime));
+    for (int32 lane = 0; lane < 4; lane++) CHECK_EQUAL(actual[lane], HashMixScalar(0xFFFFFFFF, 0));
+}
+
+// Changes one byte of one pixel and checks that exactly its tile turns dirty
+static void
+CheckSinglePixel(DamageTracker &tracker, std::vector<uint8> &frame, int32 stride, int32 x, int32 y,
+                 int32 channel) {
+    uint8 &byte = frame[(size_t) y * stride + x * 4 + channel];
+    byte ^= 0x01;
+
+    CHECK_EQUAL(tracker.Update(frame.data(), stride), 1);
+    for (int32 ty = 0; ty < tracker.TilesY(); ty++) {
+        for (int32 tx = 0; tx < tracker.TilesX(); tx++) {
+            bool expected = tx == x / DamageTracker::kTileSize && ty == y / DamageTracker::kTileSize;
+            if (tracker.IsDirty(tx, ty) != expected)
+                fprintf(stderr, "pixel %d,%d channel %d: tile %d,%d\n", (int) x, (int) y, (int) channel, (int) tx,
+                        (int) ty);
+            CHECK(tracker.IsDirty(tx, ty) == expected);
+        }
+    }
+
+    // Unchanged since, so nothing is dirty
+    CHECK_EQUAL(tracker.Update(frame.data(), stride), 0);
+}
+
+static void
+TestSinglePixel(int32 width, int32 height, int32 stride) {
+    DamageTracker tracker;
+    CHECK_EQUAL(tracker.Init(width, height), B_OK);
+
+    const int32 tile = DamageTracker::kTileSize;
+    CHECK_EQUAL(tracker.TilesX(), (width + tile - 1) / tile);
+    CHECK_EQUAL(tracker.TilesY(), (height + tile - 1) / tile);
+
+    std::vector<uint8> frame((size_t) stride * height);
+    FillRandom(frame.data(), frame.size(), width * 31 + height);
+
+    // The first update reports everything, the second nothing
+    CHECK_EQUAL(tracker.Update(frame.data(), stride), tracker.TilesX() * tracker.TilesY());
+    CHECK_EQUAL(tracker.Update(frame.data(), stride), 0);
+
+    int32 right = width - 1;
+    int32 bottom = height - 1;
+
+    // Corners, tile borders and the edge tiles
+    const int32 points[][2] = {
+        {0, 0},
+        {tile - 1, 0},
+        {tile, 0},
+        {tile - 1, tile - 1},
+        {tile, tile},
+        {right, 0},
+        {0, bottom},
+        {right, bottom},
+        {right, tile},
+        {tile + 5, bottom},
+        {width / 2, height / 2},
+    };
+
+    for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+        int32 x = points[i][0] < width ? points[i][0] : right;
+        int32 y = points[i][1] < height ? points[i][1] : bottom;
+        for (int32 channel = 0; channel < 4; channel++) CheckSinglePixel(tracker, frame, stride, x, y, channel);
+    }
+
+    // Every pixel of the right edge column: the last tile column is hashed by
+    // the 64-byte, 16-byte and single pixel loops depending on its width
+    for (int32 x = (width - 1) / tile * tile; x < width; x++) CheckSinglePixel(tracker, frame, stride, x, bottom, 2);
+
+    // Bytes past the row end belong to nobody
+    if (stride > width * 4) {
+        frame[stride - 1] ^= 0xFF;
+        frame[(size_t) bottom * stride + width * 4] ^= 0xFF;
+        CHECK_EQUAL(tracker.Update(frame.data(), stride), 0);
+    }
+
+    // Invalidate() makes the next update report everything again
+    tracker.Invalidate();
+    CHECK_EQUAL(tracker.Update(frame.data(), stride), tracker.TilesX() * tracker.TilesY());
+}
+
+// Two pixels trading places within a tile must still change its hash
+static void
+TestSwappedPixels() {
+    const int32 width = 128, height = 64, stride = width * 4;
+    DamageTracker tracker;
+    tracker.Init(width, height);
+
+    std::vector<uint8> frame(stride * height);
+    FillRandom(frame.data(), frame.size(), 7);
+    tracker.Update(frame.data(), stride);
+
+    uint8 *a = &frame[3 * stride + 4 * 4];
+    uint8 *b = &frame[3 * stride + 20 * 4];
+    uint8 pixel[4];
+    memcpy(pixel, a, 4);
+    memcpy(a, b, 4);
+    memcpy(b, pixel, 4);
+
+    CHECK_EQUAL(tracker.Update(frame.data(), stride), 1);
+    CHECK(tracker.IsDirty(0, 0));
+}
+
+static void
+TestBadInput() {
+    DamageTracker tracker;
+    CHECK_EQUAL(tracker.Init(0, 10), B_BAD_VALUE);
+    CHECK_EQUAL(tracker.Init(10, -1), B_BAD_VALUE);
+    CHECK_EQUAL(tracker.Update(nullptr, 0), 0);
+}
+
+int
+main() {
+    TestHashMixLanes();
+
+    // Whole tiles, partial edge tiles of every loop width, padded rows
+    TestSinglePixel(256, 128, 256 * 4);
+    TestSinglePixel(200, 150, 200 * 4);
+    TestSinglePixel(203, 97, 203 * 4);
+    TestSinglePixel(67, 65, 80 * 4);
+    TestSinglePixel(1, 1, 4);
+
+    TestSwappedPixels();
+    TestBadInput();
+
+    return TestResult("DamageTrackerTest");
+}
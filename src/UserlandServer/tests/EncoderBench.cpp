@@ -0,0 +1,397 @@
+/*
+ * EncoderBench.cpp
+ * Bitrate, quality and CPU time of the encoder backends on desktop content
+ */
+#include "ColorKernels.h"
+#include "EncoderBackend.h"
+#include "FrameFeed.h"
+#include "TestUtils.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// CPU time of every thread of the process, encoder threads included
+static bigtime_t
+CpuTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (bigtime_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+struct RunOptions {
+    const char *codec;
+    bool fullChroma;
+    const EncoderProfile *profile;
+    int32 bitrateKbps;
+    bool fullFrames; // Encode without the changed-block map
+};
+
+struct RunResult {
+    int32 frames; // Encoded, frames without a change are skipped like the capture stage does
+    int32 keyframes;
+    int64 bytes;
+    double psnr; // Average, 0 if the codec reported none
+    double kbps;
+    double wallMs; // Per encoded frame
+    double cpuMs;
+};
+
+// Marks the 16x16 blocks that differ from the previous frame, returns how many
+static int32
+ChangedBlocks(const uint8 *bits, int32 stride, std::vector<uint8> &previous, int32 width, int32 height,
+              std::vector<uint8> &blocks) {
+    const int32 columns = (width + kBlockSize - 1) / kBlockSize, rows = (height + kBlockSize - 1) / kBlockSize;
+    const size_t rowBytes = (size_t) width * 4;
+    blocks.assign(columns * rows, 0);
+
+    bool first = previous.empty();
+    if (first) previous.resize(rowBytes * height);
+
+    int32 changed = 0;
+    for (int32 y = 0; y < height; y++) {
+        const uint8 *row = bits + (size_t) y * stride;
+        uint8 *old = &previous[y * rowBytes];
+        uint8 *blockRow = &blocks[(y / kBlockSize) * columns];
+        for (int32 column = 0; column < columns; column++) {
+            int32 x = column * kBlockSize;
+            int32 bytes = (x + kBlockSize <= width ? kBlockSize : width - x) * 4;
+            if (first || memcmp(row + x * 4, old + x * 4, bytes) != 0) blockRow[column] = 1;
+        }
+        memcpy(old, row, rowBytes);
+    }
+    for (uint8 block : blocks) changed += block;
+    return changed;
+}
+
+static bool
+Run(FrameFeed &feed, int32 frames, const RunOptions &options, RunResult &result) {
+    memset(&result, 0, sizeof(result));
+
+    EncoderBackend *backend = EncoderBackend::Create(options.codec);
+    if (!backend) return false;
+
+    const int32 width = feed.Width(), height = feed.Height();
+    backend->SetFrameRate(kFrameRate);
+    if (backend->Init(width, height, options.bitrateKbps, options.fullChroma, *options.profile) != B_OK) {
+        delete backend;
+        return false;
+    }
+
+    ColorConverter converter;
+    PlaneBuffer buffer(backend->Layout(), width, height);
+    std::vector<uint8> previous, blocks;
+    double psnrSum = 0;
+    int32 psnrFrames = 0;
+    bigtime_t wall = 0, cpu = 0;
+
+    feed.Rewind();
+    for (int32 i = 0; i < frames; i++) {
+        int32 stride;
+        const uint8 *bits = feed.Next(stride);
+        if (ChangedBlocks(bits, stride, previous, width, height, blocks) == 0) continue;
+
+        converter.Convert(bits, stride, width, height, buffer.planes);
+
+        YUVFrame frame;
+        frame.planes = buffer.planes;
+        frame.pts = (int64) i * kTimebase / kFrameRate;
+        frame.forceKeyframe = i == 0;
+        frame.refine = 0;
+        frame.changedBlocks = options.fullFrames ? nullptr : blocks.data();
+
+        EncodedFrame out;
+        bigtime_t wallStart = BenchTime(), cpuStart = CpuTime();
+        status_t status = backend->Encode(frame, out);
+        wall += BenchTime() - wallStart;
+        cpu += CpuTime() - cpuStart;
+        if (status != B_OK) {
+            fprintf(stderr, "%s: frame %d failed\n", options.codec, (int) i);
+            break;
+        }
+
+        result.frames++;
+        result.bytes += out.size;
+        result.keyframes += out.isKey;
+        if (out.psnr > 0) {
+            psnrSum += out.psnr;
+            psnrFrames++;
+        }
+    }
+    delete backend;
+
+    if (result.frames == 0) return false;
+    result.psnr = psnrFrames ? psnrSum / psnrFrames : 0;
+    result.kbps = result.bytes * 8.0 / 1000 / ((double) frames / kFrameRate);
+    result.wallMs = wall / 1000.0 / result.frames;
+    result.cpuMs = cpu / 1000.0 / result.frames;
+    return true;
+}
+
+static void
+PrintResult(const char *label, const RunResult &result) {
+    printf("%-28s %7.0f kbps  %5.2f dB  %6.2f ms/frame  %6.2f ms CPU/frame  %d frames, %d key\n", label,
+           result.kbps, result.psnr, result.wallMs, result.cpuMs, (int) result.frames, (int) result.keyframes);
+}
+
+// BT.601 studio range back to B, G, R
+static void
+ToRGB(int32 y, int32 u, int32 v, uint8 *bgr) {
+    int32 c = y - 16, d = u - 128, e = v - 128;
+    int32 values[3] = {(298 * c + 516 * d + 128) >> 8, (298 * c - 100 * d - 208 * e + 128) >> 8,
+                       (298 * c + 409 * e + 128) >> 8};
+    for (int32 i = 0; i < 3; i++) bgr[i] = values[i] < 0 ? 0 : values[i] > 255 ? 255 : values[i];
+}
+
+// PSNR in RGB of a frame converted to the layout and back, what the layout
+// loses before the codec sees the picture
+static double
+LayoutPsnr(YUVLayout layout, const uint8 *bits, int32 stride, int32 width, int32 height) {
+    PlaneBuffer buffer(layout, width, height);
+    ColorConverter().Convert(bits, stride, width, height, buffer.planes);
+    const YUVPlanes &planes = buffer.planes;
+
+    double sse = 0;
+    for (int32 y = 0; y < height; y++) {
+        for (int32 x = 0; x < width; x++) {
+            int32 cx = layout == YUV_I444 ? x : x / 2, cy = layout == YUV_I444 ? y : y / 2;
+            uint8 bgr[3];
+            ToRGB(planes.plane[0][(size_t) y * planes.stride[0] + x],
+                  planes.plane[1][(size_t) cy * planes.stride[1] + cx],
+                  planes.plane[2][(size_t) cy * planes.stride[2] + cx], bgr);
+
+            const uint8 *source = bits + (size_t) y * stride + x * 4;
+            for (int32 i = 0; i < 3; i++) sse += (double) (bgr[i] - source[i]) * (bgr[i] - source[i]);
+        }
+    }
+    double mse = sse / ((double) width * height * 3);
+    return mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 99;
+}
+
+// 4:2:0 against 4:4:4 at the same bitrate, and the color lost to subsampling
+// alone
+static void
+BenchChroma(FrameFeed &feed, int32 frames) {
+    printf("\n4:2:0 against 4:4:4, %s profile\n", kDefaultEncoderProfile);
+
+    feed.Rewind();
+    int32 stride;
+    const uint8 *bits = feed.Next(stride);
+    printf("Conversion round trip in RGB: I420 %.2f dB, I444 %.2f dB\n",
+           LayoutPsnr(YUV_I420, bits, stride, feed.Width(), feed.Height()),
+           LayoutPsnr(YUV_I444, bits, stride, feed.Width(), feed.Height()));
+
+    const char *codecs[] = {"vp9", "h264", "av1"};
+    for (const char *codec : codecs) {
+        for (int32 full = 0; full < 2; full++) {
+            RunOptions options = {codec, full != 0, EncoderProfileFor(kDefaultEncoderProfile), 4000, false};
+            RunResult result;
+            char label[64];
+            snprintf(label, sizeof(label), "%s %s", codec, full ? "4:4:4" : "4:2:0");
+            if (Run(feed, frames, options, result))
+                PrintResult(label, result);
+            else
+                printf("%-28s not available\n", label);
+        }
+    }
+}
+
+// Bitrate needed for a PSNR, interpolated on a log scale between the rungs
+// of a ladder sorted by rate. 0 if the ladder never gets there.
+static double
+RateForPsnr(const std::vector<RunResult> &ladder, double psnr) {
+    for (size_t i = 1; i < ladder.size(); i++) {
+        const RunResult &low = ladder[i - 1], &high = ladder[i];
+        if (psnr < low.psnr || psnr > high.psnr || high.psnr <= low.psnr) continue;
+        double t = (psnr - low.psnr) / (high.psnr - low.psnr);
+        return exp(log(low.kbps) + t * (log(high.kbps) - log(low.kbps)));
+    }
+    return 0;
+}
+
+// Rate of the cheapest rung that reaches a PSNR: what a codec needs at most
+// when even its lowest rung is better than that. 0 if none reaches it.
+static double
+RateBoundForPsnr(const std::vector<RunResult> &ladder, double psnr) {
+    for (const RunResult &result : ladder) {
+        if (result.psnr >= psnr) return result.kbps;
+    }
+    return 0;
+}
+
+// Every codec over a bitrate ladder, then the rate each needs for the
+// quality VP9 reaches at 2000 kbps
+static void
+BenchCodecs(FrameFeed &feed, int32 frames) {
+    printf("\nCodecs at equal quality, %s profile\n", kDefaultEncoderProfile);
+
+    const int32 ladder[] = {500, 1000, 2000, 4000, 8000};
+    const int32 rungs = sizeof(ladder) / sizeof(ladder[0]);
+    std::vector<std::vector<RunResult>> results(EncoderBackend::CountCodecs());
+    double target = 0;
+
+    for (int32 codec = 0; codec < EncoderBackend::CountCodecs(); codec++) {
+        const char *name = EncoderBackend::CodecAt(codec);
+        for (int32 rung = 0; rung < rungs; rung++) {
+            RunOptions options = {name, false, EncoderProfileFor(kDefaultEncoderProfile), ladder[rung], false};
+            RunResult result;
+            char label[64];
+            snprintf(label, sizeof(label), "%s %d kbps", name, (int) ladder[rung]);
+            if (!Run(feed, frames, options, result)) {
+                printf("%-28s not available\n", label);
+                continue;
+            }
+            PrintResult(label, result);
+            results[codec].push_back(result);
+            if (strcmp(name, "vp9") == 0 && ladder[rung] == 2000) target = result.psnr;
+        }
+    }
+
+    if (target <= 0) return;
+
+    // The libraries miss low targets by different amounts, what the ladder
+    // gets sorted by is the rate they ended up at
+    for (std::vector<RunResult> &codec : results) {
+        std::sort(codec.begin(), codec.end(),
+                  [](const RunResult &a, const RunResult &b) { return a.kbps < b.kbps; });
+    }
+
+    double reference = 0;
+    for (int32 codec = 0; codec < EncoderBackend::CountCodecs(); codec++) {
+        if (strcmp(EncoderBackend::CodecAt(codec), "vp9") == 0) reference = RateForPsnr(results[codec], target);
+    }
+
+    printf("Rate for %.2f dB:\n", target);
+    for (int32 codec = 0; codec < EncoderBackend::CountCodecs(); codec++) {
+        double rate = RateForPsnr(results[codec], target);
+        double bound = RateBoundForPsnr(results[codec], target);
+        if (rate > 0 && reference > 0)
+            printf("  %-6s %7.0f kbps  %+5.1f%% against vp9\n", EncoderBackend::CodecAt(codec), rate,
+                   100.0 * (rate - reference) / reference);
+        else if (bound > 0 && reference > 0)
+            printf("  %-6s <=%6.0f kbps %+5.1f%% or less against vp9\n",
+                   EncoderBackend::CodecAt(codec), bound, 100.0 * (bound - reference) / reference);
+        else
+            printf("  %-6s outside its ladder\n", EncoderBackend::CodecAt(codec));
+    }
+}
+
+// Every profile with every codec at one WAN bitrate: what the faster
+// settings cost in quality
+static void
+BenchProfiles(FrameFeed &feed, int32 frames) {
+    const int32 bitrate = 2000;
+    printf("\nProfiles at %d kbps\n", (int) bitrate);
+
+    for (int32 codec = 0; codec < EncoderBackend::CountCodecs(); codec++) {
+        const char *name = EncoderBackend::CodecAt(codec);
+        for (int32 profile = 0; profile < kEncoderProfileCount; profile++) {
+            RunOptions options = {name, false, &kEncoderProfiles[profile], bitrate, false};
+            RunResult result;
+            char label[64];
+            snprintf(label, sizeof(label), "%s %s", name, kEncoderProfiles[profile].name);
+            if (Run(feed, frames, options, result))
+                PrintResult(label, result);
+            else
+                printf("%-28s not available\n", label);
+        }
+    }
+}
+
+// Every codec capped at 1 to N threads, N being what the encoders pick for
+// this picture on this machine. Wall time is what bounds the frame rate.
+static void
+BenchThreads(FrameFeed &feed, int32 frames) {
+    const int32 most = EncoderBackend::ThreadsFor(feed.Width(), feed.Height());
+    printf("\nThread scaling, %s profile, up to %d threads\n", kDefaultEncoderProfile, (int) most);
+
+    for (int32 codec = 0; codec < EncoderBackend::CountCodecs(); codec++) {
+        const char *name = EncoderBackend::CodecAt(codec);
+        double single = 0;
+        for (int32 threads = 1; threads <= most; threads++) {
+            EncoderBackend::SetThreadLimit(threads);
+            RunOptions options = {name, false, EncoderProfileFor(kDefaultEncoderProfile), 4000, false};
+            RunResult result;
+            char label[64];
+            snprintf(label, sizeof(label), "%s %d threads", name, (int) threads);
+            if (!Run(feed, frames, options, result)) {
+                printf("%-28s not available\n", label);
+                break;
+            }
+
+            if (threads == 1) single = result.wallMs;
+            snprintf(label, sizeof(label), "%s %d threads, %.2fx", name, (int) threads, single / result.wallMs);
+            PrintResult(label, result);
+        }
+    }
+    EncoderBackend::SetThreadLimit(0);
+}
+
+// Every codec with and without the changed-block map, which lets it skip
+// the blocks that stayed the same
+static void
+BenchActiveMap(FrameFeed &feed, int32 frames) {
+    printf("\nSkipping unchanged blocks, %s profile\n", kDefaultEncoderProfile);
+
+    for (int32 codec = 0; codec < EncoderBackend::CountCodecs(); codec++) {
+        const char *name = EncoderBackend::CodecAt(codec);
+        RunResult whole, skipping;
+        char label[64];
+
+        RunOptions options = {name, false, EncoderProfileFor(kDefaultEncoderProfile), 4000, true};
+        snprintf(label, sizeof(label), "%s whole frames", name);
+        if (!Run(feed, frames, options, whole)) {
+            printf("%-28s not available\n", label);
+            continue;
+        }
+        PrintResult(label, whole);
+
+        options.fullFrames = false;
+        if (!Run(feed, frames, options, skipping)) continue;
+        snprintf(label, sizeof(label), "%s changed blocks, %+.0f%%", name,
+                 100.0 * (skipping.wallMs - whole.wallMs) / whole.wallMs);
+        PrintResult(label, skipping);
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*run)(FrameFeed &feed, int32 frames);
+} kSections[] = {
+    {"chroma", BenchChroma},
+    {"codecs", BenchCodecs},
+    {"profiles", BenchProfiles},
+    {"threads", BenchThreads},
+    {"activemap", BenchActiveMap},
+};
+
+static const int32 kSectionCount = sizeof(kSections) / sizeof(kSections[0]);
+
+int
+main(int argc, char **argv) {
+    const char *section = argc > 1 ? argv[1] : "all";
+    int32 frames = argc > 2 ? atoi(argv[2]) : kFrameRate * 9;
+    if (frames < 2) frames = 2;
+
+    FrameFeed feed(argc > 3 ? argv[3] : nullptr);
+    if (!feed.IsValid()) return 1;
+
+    EncoderBackend::SetMeasureQuality(true);
+    printf("%dx%d at %d fps, %d frames of %s\n", (int) feed.Width(), (int) feed.Height(), (int) kFrameRate,
+           (int) frames, argc > 3 ? argv[3] : "a synthetic editing session");
+
+    bool found = false;
+    for (int32 i = 0; i < kSectionCount; i++) {
+        if (strcmp(section, "all") != 0 && strcmp(section, kSections[i].name) != 0) continue;
+        kSections[i].run(feed, frames);
+        found = true;
+    }
+
+    if (!found) {
+        fprintf(stderr, "Usage: %s [all", argv[0]);
+        for (int32 i = 0; i < kSectionCount; i++) fprintf(stderr, " | %s", kSections[i].name);
+        fprintf(stderr, "] [frames] [capture file]\n");
+        return 1;
+    }
+    return 0;
+}
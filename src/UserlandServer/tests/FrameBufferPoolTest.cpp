@@ -0,0 +1,130 @@
+/*
+ * FrameBufferPoolTest.cpp
+ * Plane layout alignment, memory reuse, and conversion into pooled frames
+ */
+#include "ColorKernels.h"
+#include "FrameBufferPool.h"
+#include "TestUtils.h"
+#include <string.h>
+
+static const int32 kSizes[][2] = {{1, 1}, {33, 17}, {1366, 768}, {1921, 1081}, {3840, 2160}};
+
+static bool
+Aligned(const void *pointer, size_t alignment) {
+    return ((uintptr_t) pointer & (alignment - 1)) == 0;
+}
+
+static void
+TestLayout() {
+    alignas(64) static uint8 base[64];
+
+    for (const auto &size : kSizes) {
+        const int32 width = size[0], height = size[1];
+        for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+            PlaneBuffer tight((YUVLayout) layout, width, height);
+
+            YUVPlanes planes;
+            size_t bytes = FrameBufferPool::Layout((YUVLayout) layout, width, height, nullptr, planes);
+            CHECK(planes.plane[0] == nullptr);
+
+            // Placed at an aligned base, every plane starts on a cache line
+            YUVPlanes placed;
+            CHECK_EQUAL(FrameBufferPool::Layout((YUVLayout) layout, width, height, base, placed), bytes);
+            CHECK_EQUAL(placed.layout, layout);
+
+            size_t total = 0;
+            for (int32 i = 0; i < 3; i++) {
+                CHECK_EQUAL(placed.stride[i], planes.stride[i]);
+                if (tight.height[i] == 0) {
+                    CHECK(placed.plane[i] == nullptr);
+                    CHECK_EQUAL(placed.stride[i], 0);
+                    continue;
+                }
+
+                CHECK(placed.plane[i] != nullptr);
+                CHECK(Aligned(placed.plane[i], FrameBufferPool::kAlignment));
+                CHECK_EQUAL(placed.stride[i] % FrameBufferPool::kAlignment, 0);
+                CHECK(placed.stride[i] >= tight.width[i]);
+                CHECK(placed.stride[i] < tight.width[i] + FrameBufferPool::kAlignment);
+                CHECK_EQUAL(placed.plane[i] - base, total);
+                total += (size_t) placed.stride[i] * tight.height[i];
+            }
+            CHECK_EQUAL(bytes, total);
+        }
+    }
+}
+
+static void
+TestReserve() {
+    FrameBufferPool pool;
+    YUVPlanes planes;
+    size_t size = FrameBufferPool::Layout(YUV_I420, 1921, 1081, nullptr, planes);
+
+    CHECK_EQUAL(pool.Reserve(3, size), B_OK);
+    uint8 *base = pool.BufferAt(0);
+    CHECK(base != nullptr && Aligned(base, B_PAGE_SIZE));
+    CHECK(Aligned(pool.BufferAt(1), FrameBufferPool::kAlignment));
+    CHECK((size_t) (pool.BufferAt(1) - base) >= size);
+    CHECK_EQUAL(pool.BufferAt(2) - pool.BufferAt(1), pool.BufferAt(1) - base);
+
+    // All of it is usable
+    memset(base, 0x5A, (size_t) (pool.BufferAt(2) - base) + size);
+
+    // Smaller frames, like a scaled stream or a codec switch, keep the memory
+    size_t smaller = FrameBufferPool::Layout(YUV_NV12, 1600, 1000, nullptr, planes);
+    CHECK_EQUAL(pool.Reserve(3, smaller), B_OK);
+    CHECK(pool.BufferAt(0) == base);
+    CHECK((size_t) (pool.BufferAt(1) - pool.BufferAt(0)) >= smaller);
+
+    // Bigger ones get new memory that fits
+    size_t bigger = FrameBufferPool::Layout(YUV_I444, 3840, 2160, nullptr, planes);
+    CHECK_EQUAL(pool.Reserve(3, bigger), B_OK);
+    CHECK(pool.BufferAt(0) != nullptr);
+    memset(pool.BufferAt(0), 0xA5, (size_t) (pool.BufferAt(2) - pool.BufferAt(0)) + bigger);
+
+    pool.Free();
+    CHECK(pool.BufferAt(0) == nullptr);
+}
+
+// Padded strides don't change what the converter writes
+static void
+TestConvert() {
+    ColorConverter converter;
+    FrameBufferPool pool;
+
+    for (const auto &size : kSizes) {
+        const int32 width = size[0], height = size[1], stride = width * 4;
+        std::vector<uint8> rgb((size_t) stride * height);
+        FillRandom(rgb.data(), rgb.size(), width);
+
+        for (int32 layout = 0; layout < YUV_LAYOUT_COUNT; layout++) {
+            PlaneBuffer tight((YUVLayout) layout, width, height);
+            converter.Convert(rgb.data(), stride, width, height, tight.planes);
+
+            YUVPlanes planes;
+            CHECK_EQUAL(pool.Reserve(1, FrameBufferPool::Layout((YUVLayout) layout, width, height, nullptr, planes)),
+                        B_OK);
+            FrameBufferPool::Layout((YUVLayout) layout, width, height, pool.BufferAt(0), planes);
+            converter.Convert(rgb.data(), stride, width, height, planes);
+
+            int32 wrong = 0;
+            for (int32 i = 0; i < 3; i++) {
+                for (int32 y = 0; y < tight.height[i]; y++) {
+                    wrong += memcmp(planes.plane[i] + (size_t) y * planes.stride[i],
+                                    tight.planes.plane[i] + (size_t) y * tight.planes.stride[i], tight.width[i])
+                             != 0;
+                }
+            }
+            CHECK_EQUAL(wrong, 0);
+        }
+    }
+}
+
+int
+main() {
+    TestLayout();
+    TestReserve();
+    TestConvert();
+
+    return TestResult("FrameBufferPoolTest");
+}
@@ -0,0 +1,33 @@
+/*
+ * FrameDump.cpp
+ * The frames encoder_bench runs on as raw B_RGB32 on stdout, to feed the same
+ * content to encoders outside the tree (ffmpeg -f rawvideo -pix_fmt bgra)
+ */
+#include "FrameFeed.h"
+#include <stdlib.h>
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : kFrameRate * 9;
+    int32 width = 1920, height = 1080;
+    const char *path = nullptr;
+    if (argc > 2 && sscanf(argv[2], "%dx%d", &width, &height) != 2) path = argv[2];
+    if (frames < 1 || width < 1760 || height < 1020) {
+        fprintf(stderr, "Usage: %s [frames] [capture file | WIDTHxHEIGHT of at least 1760x1020]\n", argv[0]);
+        return 1;
+    }
+
+    FrameFeed feed(path, width, height);
+    if (!feed.IsValid()) return 1;
+    fprintf(stderr, "%dx%d, %d frames\n", (int) feed.Width(), (int) feed.Height(), (int) frames);
+
+    feed.Rewind();
+    for (int32 i = 0; i < frames; i++) {
+        int32 stride;
+        const uint8 *bits = feed.Next(stride);
+        for (int32 y = 0; y < feed.Height(); y++) {
+            if (fwrite(bits + (size_t) y * stride, 4, feed.Width(), stdout) != (size_t) feed.Width()) return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * FrameFeed.h
+ * The frames the encoder benchmarks run on, from a capture file or scripted
+ */
+#ifndef FRAME_FEED_H
+#define FRAME_FEED_H
+
+#include "ReplaySource.h"
+#include "ScrollContent.h"
+#include "TestUtils.h"
+#include <stdio.h>
+
+// The rate the frames are meant to be shown at, and the scripted session's
+// phases are timed in
+static const int32 kFrameRate = 30;
+
+// The frames to encode: a capture file, or a scripted session of typing,
+// scrolling and reading in an editor window on a desktop of the given size
+class FrameFeed {
+public:
+    FrameFeed(const char *path, int32 width = 1920, int32 height = 1080)
+        : fPath(path), fReplay(nullptr), fSnapshot(nullptr), fWidth(width), fHeight(height), fDocument(1600, 8000, 1),
+          fScene(nullptr), fScrollY(0), fIndex(0) {
+        if (fPath) {
+            fReplay = new ReplaySource;
+            if (fReplay->Open(fPath, false) == B_OK) {
+                fWidth = fReplay->Width();
+                fHeight = fReplay->Height();
+            } else {
+                fprintf(stderr, "Cannot open %s\n", fPath);
+                delete fReplay;
+                fReplay = nullptr;
+            }
+        }
+    }
+
+    ~FrameFeed() {
+        _Release();
+        delete fReplay;
+        delete fScene;
+    }
+
+    bool IsValid() const { return !fPath || fReplay; }
+
+    int32 Width() const { return fWidth; }
+    int32 Height() const { return fHeight; }
+
+    // Back to the first frame, every run sees the same sequence
+    void Rewind() {
+        _Release();
+        fIndex = 0;
+        if (fReplay) {
+            fReplay->Open(fPath, false);
+            return;
+        }
+
+        delete fScene;
+        fScene = new ScrollScene(fWidth, fHeight, 160, 60, 1600, 960, false);
+        fDocument = Document(1600, 8000, 1);
+        fScrollY = 0;
+    }
+
+    // B_RGB32 bits of the next frame, valid until the next call
+    const uint8 *Next(int32 &stride) {
+        _Release();
+        if (fReplay) {
+            while (!fSnapshot) fSnapshot = fReplay->Snapshot();
+            stride = fSnapshot->rowBytes;
+            return fSnapshot->bits;
+        }
+
+        // Three seconds each of typing, scrolling and reading
+        int32 phase = (fIndex++ / (kFrameRate * 3)) % 3;
+        if (phase == 0)
+            _Type();
+        else if (phase == 1)
+            fScrollY = fScrollY + 4 + 960 < fDocument.height ? fScrollY + 4 : 0;
+
+        fScene->Show(fDocument, 0, fScrollY);
+        stride = fScene->Stride();
+        return fScene->Bits();
+    }
+
+private:
+    const char *fPath;
+    ReplaySource *fReplay;
+    FrameSnapshot *fSnapshot;
+    int32 fWidth;
+    int32 fHeight;
+
+    Document fDocument;
+    ScrollScene *fScene;
+    int32 fScrollY;
+    int32 fIndex;
+
+    void _Release() {
+        if (fSnapshot) fReplay->ReleaseSnapshot(fSnapshot);
+        fSnapshot = nullptr;
+    }
+
+    // One glyph per frame at a caret that wraps at the end of the line
+    void _Type() {
+        int32 column = fIndex % 150, line = fScrollY / 16 + 20 + fIndex / 150 % 30;
+        uint32 state = fIndex + 1;
+        uint32 color = 0xFF000000 | (NextRandom(state) & 0x3F3F3F);
+        for (int32 y = line * 16 + 3; y < line * 16 + 13; y++) {
+            for (int32 x = 0; x < 6; x++)
+                fDocument.pixels[(size_t) y * fDocument.width + 8 + column * 8 + x] =
+                    NextRandom(state) & 1 ? color : 0xFFFFFFFF;
+        }
+    }
+};
+
+#endif // FRAME_FEED_H
@@ -0,0 +1,176 @@
+/*
+ * FrameScalerTest.cpp
+ * Downscaling against an exact area average, at odd sizes and ratios, and
+ * rescaling only the dirty rects against a full rescale
+ */
+#include "FrameScaler.h"
+#include "TestUtils.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// A B_RGB32 frame with some row padding, like a framebuffer
+struct TestImage {
+    int32 width;
+    int32 height;
+    int32 stride;
+    std::vector<uint8> bits;
+
+    TestImage(int32 width, int32 height, uint32 seed)
+        : width(width), height(height), stride(width * 4 + 32), bits((size_t) stride * height) {
+        FillRandom(bits.data(), bits.size(), seed);
+    }
+
+    uint8 *Pixel(int32 x, int32 y) { return &bits[(size_t) y * stride + x * 4]; }
+};
+
+// Output pixel (x, y) as the exact average of the source area it covers
+static double
+ReferencePixel(const TestImage &src, int32 dstWidth, int32 dstHeight, int32 x, int32 y, int32 channel) {
+    double left = (double) x * src.width / dstWidth, right = (double) (x + 1) * src.width / dstWidth;
+    double top = (double) y * src.height / dstHeight, bottom = (double) (y + 1) * src.height / dstHeight;
+
+    double sum = 0;
+    for (int32 sy = (int32) top; sy < bottom && sy < src.height; sy++) {
+        double h = fmin(bottom, sy + 1) - fmax(top, sy);
+        for (int32 sx = (int32) left; sx < right && sx < src.width; sx++) {
+            double w = fmin(right, sx + 1) - fmax(left, sx);
+            sum += w * h * src.bits[(size_t) sy * src.stride + sx * 4 + channel];
+        }
+    }
+    return sum / ((right - left) * (bottom - top));
+}
+
+static void
+ScaleAll(FrameScaler &scaler, const TestImage &src, WorkerPool *workers = nullptr) {
+    clipping_rect all = {0, 0, src.width - 1, src.height - 1};
+    std::vector<clipping_rect> rects;
+    scaler.MapRects(&all, 1, rects);
+    scaler.Scale(src.bits.data(), src.stride, rects.data(), rects.size(), workers);
+}
+
+// Weights are 8 bit and both passes round, so a pixel may be off by a little;
+// on average it is not
+static void
+CheckAgainstReference(int32 srcWidth, int32 srcHeight, int32 dstWidth, int32 dstHeight) {
+    TestImage src(srcWidth, srcHeight, srcWidth * 31 + dstWidth);
+    FrameScaler scaler;
+    CHECK_EQUAL(scaler.Init(srcWidth, srcHeight, dstWidth, dstHeight), B_OK);
+    CHECK(scaler.IsScaling());
+    CHECK_EQUAL(scaler.RowBytes() % 64, 0);
+    ScaleAll(scaler, src);
+
+    double most = 0, total = 0;
+    for (int32 y = 0; y < dstHeight; y++) {
+        const uint8 *row = scaler.Bits() + (size_t) y * scaler.RowBytes();
+        for (int32 x = 0; x < dstWidth; x++) {
+            for (int32 c = 0; c < 4; c++) {
+                double error = fabs(row[x * 4 + c] - ReferencePixel(src, dstWidth, dstHeight, x, y, c));
+                if (error > most) most = error;
+                total += error;
+            }
+        }
+    }
+    double mean = total / ((double) dstWidth * dstHeight * 4);
+    if (most > 2 || mean > 0.55) {
+        fprintf(stderr, "%dx%d -> %dx%d: off by up to %.2f, %.3f on average\n", (int) srcWidth, (int) srcHeight,
+                (int) dstWidth, (int) dstHeight, most, mean);
+    }
+    CHECK(most <= 2);
+    CHECK(mean <= 0.55);
+}
+
+static void
+TestReference() {
+    // Common view sizes, non-integer ratios
+    CheckAgainstReference(1920, 1080, 1366, 768);
+    CheckAgainstReference(2560, 1440, 1920, 1080);
+    CheckAgainstReference(1920, 1080, 1280, 720);
+    CheckAgainstReference(1920, 1080, 1153, 647);
+
+    // Exactly half, and a single axis
+    CheckAgainstReference(640, 480, 320, 240);
+    CheckAgainstReference(640, 480, 640, 301);
+
+    // Odd sizes on both sides, down to a single pixel
+    CheckAgainstReference(1921, 1081, 1001, 563);
+    CheckAgainstReference(17, 13, 5, 3);
+    CheckAgainstReference(3, 3, 1, 1);
+    CheckAgainstReference(99, 1, 7, 1);
+}
+
+static void
+TestInit() {
+    FrameScaler scaler;
+    CHECK_EQUAL(scaler.Init(0, 1080, 100, 100), B_BAD_VALUE);
+    CHECK_EQUAL(scaler.Init(1920, 1080, 1920, 1200), B_BAD_VALUE); // Never scales up
+    CHECK(!scaler.IsScaling());
+
+    // The same size on both sides is left to the caller
+    CHECK_EQUAL(scaler.Init(1920, 1080, 1920, 1080), B_OK);
+    CHECK(!scaler.IsScaling());
+    std::vector<clipping_rect> rects;
+    clipping_rect all = {0, 0, 1919, 1079};
+    scaler.MapRects(&all, 1, rects);
+    CHECK(rects.empty());
+}
+
+// Scaling only what the changed source rects feed into gives the same frame
+// as scaling everything again, with and without worker threads
+static void
+TestDirtyRects(int32 srcWidth, int32 srcHeight, int32 dstWidth, int32 dstHeight, WorkerPool *workers) {
+    TestImage src(srcWidth, srcHeight, 5);
+    FrameScaler partial;
+    CHECK_EQUAL(partial.Init(srcWidth, srcHeight, dstWidth, dstHeight), B_OK);
+    ScaleAll(partial, src, workers);
+
+    uint32 state = 99;
+    for (int32 round = 0; round < 20; round++) {
+        // A few changed rects anywhere, edges and single pixels included
+        std::vector<clipping_rect> changed;
+        int32 count = 1 + NextRandom(state) % 4;
+        for (int32 i = 0; i < count; i++) {
+            clipping_rect rect;
+            rect.left = NextRandom(state) % srcWidth;
+            rect.top = NextRandom(state) % srcHeight;
+            rect.right = rect.left + NextRandom(state) % (i == 0 ? 1 : 200);
+            rect.bottom = rect.top + NextRandom(state) % (i == 0 ? 1 : 120);
+            if (rect.right >= srcWidth) rect.right = srcWidth - 1;
+            if (rect.bottom >= srcHeight) rect.bottom = srcHeight - 1;
+            changed.push_back(rect);
+
+            for (int32 y = rect.top; y <= rect.bottom; y++)
+                FillRandom(src.Pixel(rect.left, y), (rect.right - rect.left + 1) * 4, NextRandom(state));
+        }
+
+        std::vector<clipping_rect> dstRects;
+        partial.MapRects(changed.data(), changed.size(), dstRects);
+        CHECK(!dstRects.empty());
+        partial.Scale(src.bits.data(), src.stride, dstRects.data(), dstRects.size(), workers);
+
+        FrameScaler full;
+        full.Init(srcWidth, srcHeight, dstWidth, dstHeight);
+        ScaleAll(full, src);
+
+        int32 differentRows = 0;
+        for (int32 y = 0; y < dstHeight; y++) {
+            differentRows += memcmp(partial.Bits() + (size_t) y * partial.RowBytes(),
+                                    full.Bits() + (size_t) y * full.RowBytes(), dstWidth * 4) != 0;
+        }
+        CHECK_EQUAL(differentRows, 0);
+    }
+}
+
+int
+main() {
+    TestInit();
+    TestReference();
+
+    WorkerPool workers;
+    CHECK_EQUAL(workers.Init(4, "FrameScalerTest"), B_OK);
+    TestDirtyRects(1920, 1080, 1366, 768, nullptr);
+    TestDirtyRects(1920, 1080, 1366, 768, &workers);
+    TestDirtyRects(1921, 1081, 1001, 563, &workers);
+
+    return TestResult("FrameScalerTest");
+}
@@ -0,0 +1,39 @@
+/*
+ * GuardedRow.h
+ * Input that ends right before an unmapped page
+ */
+#ifndef GUARDED_ROW_H
+#define GUARDED_ROW_H
+
+#include <SupportDefs.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Source rows that end right before an unmapped page, so a converter reading
+// past the last pixel crashes the test
+class GuardedRow {
+public:
+    GuardedRow() {
+        fPageSize = sysconf(_SC_PAGESIZE);
+        fBase = (uint8 *) mmap(nullptr, fPageSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        mprotect(fBase + fPageSize, fPageSize, PROT_NONE);
+    }
+
+    ~GuardedRow() { munmap(fBase, fPageSize * 2); }
+
+    // Copies bytes to the end of the accessible page
+    const uint8 *Place(const uint8 *data, size_t bytes) {
+        uint8 *start = fBase + fPageSize - bytes;
+        memcpy(start, data, bytes);
+        return start;
+    }
+
+    size_t Capacity() const { return fPageSize; }
+
+private:
+    uint8 *fBase;
+    size_t fPageSize;
+};
+
+#endif // GUARDED_ROW_H
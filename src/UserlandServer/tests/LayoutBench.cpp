@@ -0,0 +1,80 @@
+/*
+ * LayoutBench.cpp
+ * Output layouts compared: what each costs to fill and what it saves x264
+ */
+#include "ColorKernels.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// What x264 does to I420 input before encoding: U and V interleaved into
+// its NV12 chroma plane
+static void
+InterleaveChroma(const YUVPlanes &i420, const YUVPlanes &nv12, int32 width, int32 height) {
+    int32 chromaWidth = (width + 1) / 2;
+    int32 chromaHeight = (height + 1) / 2;
+    for (int32 y = 0; y < chromaHeight; y++) {
+        const uint8 *u = i420.plane[1] + (size_t) y * i420.stride[1];
+        const uint8 *v = i420.plane[2] + (size_t) y * i420.stride[2];
+        uint8 *uv = nv12.plane[1] + (size_t) y * nv12.stride[1];
+        for (int32 x = 0; x < chromaWidth; x++) {
+            uv[x * 2] = u[x];
+            uv[x * 2 + 1] = v[x];
+        }
+    }
+}
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 50;
+    if (frames < 1) frames = 1;
+
+    const int32 width = 1920, height = 1080, stride = width * 4;
+    std::vector<uint8> rgb((size_t) stride * height);
+    FillRandom(rgb.data(), rgb.size(), 7);
+
+    ColorConverter converter;
+    PlaneBuffer i420(YUV_I420, width, height);
+    PlaneBuffer nv12(YUV_NV12, width, height);
+    PlaneBuffer i444(YUV_I444, width, height);
+
+    // Warm up, and the repacked I420 must come out as the direct NV12
+    converter.Convert(rgb.data(), stride, width, height, i420.planes);
+    converter.Convert(rgb.data(), stride, width, height, nv12.planes);
+    converter.Convert(rgb.data(), stride, width, height, i444.planes);
+    PlaneBuffer repacked(YUV_NV12, width, height);
+    memcpy(repacked.planes.plane[0], i420.planes.plane[0], (size_t) width * height);
+    InterleaveChroma(i420.planes, repacked.planes, width, height);
+    if (repacked.data != nv12.data) {
+        fprintf(stderr, "I420 repacked to NV12 differs from direct NV12\n");
+        return 1;
+    }
+
+    printf("%dx%d, %s kernels, %d frames\n", (int) width, (int) height, converter.KernelName(), (int) frames);
+
+    const struct {
+        const char *name;
+        PlaneBuffer *buffer;
+    } direct[] = {{"I420", &i420}, {"NV12", &nv12}, {"I444", &i444}};
+
+    for (const auto &layout : direct) {
+        bigtime_t start = BenchTime();
+        for (int32 i = 0; i < frames; i++)
+            converter.Convert(rgb.data(), stride, width, height, layout.buffer->planes);
+        bigtime_t elapsed = BenchTime() - start;
+
+        printf("%-22s %6.2f ms/frame  %7.1f MP/s  %5.2f MB/frame\n", layout.name, elapsed / 1000.0 / frames,
+               (double) width * height * frames / elapsed, layout.buffer->data.size() / 1e6);
+    }
+
+    // x264 fed I420 repacks every frame, fed NV12 it takes the planes as they are
+    bigtime_t start = BenchTime();
+    for (int32 i = 0; i < frames; i++) {
+        converter.Convert(rgb.data(), stride, width, height, i420.planes);
+        InterleaveChroma(i420.planes, repacked.planes, width, height);
+    }
+    bigtime_t elapsed = BenchTime() - start;
+    printf("%-22s %6.2f ms/frame  %7.1f MP/s\n", "I420 + x264 repack", elapsed / 1000.0 / frames,
+           (double) width * height * frames / elapsed);
+    return 0;
+}
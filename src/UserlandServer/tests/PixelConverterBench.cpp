@@ -0,0 +1,61 @@
+/*
+ * PixelConverterBench.cpp
+ * Row conversion speed per color_space, against the per-pixel reference
+ */
+#include "PixelConverter.h"
+#include "PixelReference.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+#include <vector>
+
+static const struct {
+    color_space format;
+    const char *name;
+} kFormats[] = {
+    {B_RGB32, "RGB32"}, {B_RGB24, "RGB24"}, {B_RGB16, "RGB16"}, {B_RGB15, "RGB15"}, {B_CMAP8, "CMAP8"}, {B_GRAY8, "GRAY8"},
+};
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 50;
+    if (frames < 1) frames = 1;
+
+    const int32 width = 1920, height = 1080;
+    std::vector<uint8> src((size_t) width * 4 * height);
+    FillRandom(src.data(), src.size(), 3);
+    std::vector<uint32> dst((size_t) width * height);
+
+    uint32 palette[256];
+    for (int32 i = 0; i < 256; i++) palette[i] = MakePixel(i, 255 - i, i / 2);
+
+    printf("%dx%d, %d frames\n", (int) width, (int) height, (int) frames);
+    for (size_t f = 0; f < sizeof(kFormats) / sizeof(kFormats[0]); f++) {
+        PixelConverter converter;
+        converter.SetFormat(kFormats[f].format);
+        const int32 stride = width * converter.BytesPerPixel();
+
+        bigtime_t start = BenchTime();
+        for (int32 i = 0; i < frames; i++) {
+            for (int32 y = 0; y < height; y++)
+                converter.ConvertRow(reinterpret_cast<uint8 *>(&dst[(size_t) y * width]), &src[(size_t) y * stride], width);
+        }
+        bigtime_t simd = BenchTime() - start;
+
+        start = BenchTime();
+        for (int32 i = 0; i < frames; i++) {
+            for (int32 y = 0; y < height; y++) {
+                const uint8 *row = &src[(size_t) y * stride];
+                uint32 *out = &dst[(size_t) y * width];
+                for (int32 x = 0; x < width; x++)
+                    out[x] = ReferenceExpand(kFormats[f].format, row + x * converter.BytesPerPixel(), palette);
+            }
+        }
+        bigtime_t scalar = BenchTime() - start;
+
+        double pixels = (double) width * height * frames;
+        printf("%-6s  converter %7.1f MP/s %6.2f ms/frame   reference %7.1f MP/s %6.2f ms/frame   %.1fx\n",
+               kFormats[f].name, pixels / simd, simd / 1000.0 / frames, pixels / scalar, scalar / 1000.0 / frames,
+               (double) scalar / simd);
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * PixelConverterTest.cpp
+ * Every color_space against the scalar reference, round trips and the palette
+ */
+#include "GuardedRow.h"
+#include "PixelConverter.h"
+#include "PixelReference.h"
+#include "TestUtils.h"
+#include <string.h>
+#include <vector>
+
+static const color_space kFormats[] = {B_RGB32, B_RGBA32, B_RGB24, B_RGB16, B_RGB15, B_RGBA15, B_CMAP8, B_GRAY8};
+
+static const uint32 *
+SystemPalette(uint32 *palette) {
+    const color_map *map = system_colors();
+    for (int32 i = 0; i < 256; i++) {
+        const rgb_color &color = map->color_list[i];
+        palette[i] = MakePixel(color.red, color.green, color.blue);
+    }
+    return palette;
+}
+
+// Random rows of every width up to a few SIMD blocks, compared pixel by pixel
+static void
+TestAgainstReference(color_space format) {
+    PixelConverter converter;
+    CHECK_EQUAL(converter.SetFormat(format), B_OK);
+    CHECK_EQUAL(converter.InitCheck(), B_OK);
+    CHECK_EQUAL(converter.Format(), format);
+
+    const int32 bytesPerPixel = ReferenceBytesPerPixel(format);
+    CHECK_EQUAL(converter.BytesPerPixel(), bytesPerPixel);
+    CHECK_EQUAL(converter.IsNative(), format == B_RGB32 || format == B_RGBA32);
+
+    uint32 palette[256];
+    SystemPalette(palette);
+
+    GuardedRow guarded;
+    std::vector<uint8> src(guarded.Capacity());
+    std::vector<uint32> dst;
+
+    for (int32 width = 1; width <= 70; width++) {
+        FillRandom(src.data(), width * bytesPerPixel, format * 1000 + width);
+        const uint8 *row = guarded.Place(src.data(), width * bytesPerPixel);
+
+        // One sentinel pixel past the end must survive
+        dst.assign(width + 1, 0xDEADBEEF);
+        converter.ConvertRow(reinterpret_cast<uint8 *>(dst.data()), row, width);
+
+        int32 mismatches = 0;
+        for (int32 x = 0; x < width; x++) {
+            if (dst[x] != ReferenceExpand(format, row + x * bytesPerPixel, palette)) mismatches++;
+        }
+        if (mismatches) fprintf(stderr, "format 0x%x width %d: %d pixels differ\n", format, (int) width, (int) mismatches);
+        CHECK_EQUAL(mismatches, 0);
+        CHECK_EQUAL(dst[width], 0xDEADBEEF);
+    }
+}
+
+// Every value a 16-bit format can hold expands and packs back to itself
+static void
+TestRoundTrip16(color_space format) {
+    PixelConverter converter;
+    converter.SetFormat(format);
+
+    // B_RGB15 ignores the top bit, so round trips only cover the low 15
+    const int32 count = format == B_RGB16 ? 65536 : 32768;
+    std::vector<uint16> src(count);
+    for (int32 i = 0; i < count; i++) src[i] = (uint16) i;
+
+    std::vector<uint32> dst(count);
+    converter.ConvertRow(reinterpret_cast<uint8 *>(dst.data()), reinterpret_cast<const uint8 *>(src.data()), count);
+
+    int32 mismatches = 0;
+    for (int32 i = 0; i < count; i++) {
+        uint8 packed[4];
+        ReferencePack(format, dst[i], packed);
+        if ((packed[0] | (packed[1] << 8)) != i) mismatches++;
+    }
+    CHECK_EQUAL(mismatches, 0);
+
+    // Black and white stay exact
+    CHECK_EQUAL(dst[0], 0xFF000000);
+    CHECK_EQUAL(dst[count - 1], 0xFFFFFFFF);
+
+    // The alpha bit of B_RGBA15 doesn't change the color
+    if (format != B_RGB16) {
+        uint16 withAlpha[2] = {0x8000 | 0x1234, 0x1234};
+        uint32 out[2];
+        converter.ConvertRow(reinterpret_cast<uint8 *>(out), reinterpret_cast<const uint8 *>(withAlpha), 2);
+        CHECK_EQUAL(out[0], out[1]);
+    }
+}
+
+// B_RGB32 built from the reference packs back into the same B_RGB24 bytes
+static void
+TestRoundTrip24() {
+    PixelConverter converter;
+    converter.SetFormat(B_RGB24);
+
+    const int32 width = 4099;
+    std::vector<uint8> src(width * 3);
+    FillRandom(src.data(), src.size(), 24);
+
+    std::vector<uint32> dst(width);
+    converter.ConvertRow(reinterpret_cast<uint8 *>(dst.data()), src.data(), width);
+
+    std::vector<uint8> packed(width * 3);
+    for (int32 x = 0; x < width; x++) {
+        ReferencePack(B_RGB24, dst[x], &packed[x * 3]);
+        CHECK_EQUAL(dst[x] >> 24, 0xFF);
+    }
+    CHECK(memcmp(packed.data(), src.data(), src.size()) == 0);
+}
+
+// B_CMAP8 takes its colors from the system palette at SetFormat() time
+static void
+TestPalette() {
+    PixelConverter converter;
+    CHECK_EQUAL(converter.SetFormat(B_CMAP8), B_OK);
+
+    uint8 indices[256];
+    for (int32 i = 0; i < 256; i++) indices[i] = (uint8) i;
+
+    uint32 out[256];
+    converter.ConvertRow(reinterpret_cast<uint8 *>(out), indices, 256);
+
+    const color_map *map = system_colors();
+    for (int32 i = 0; i < 256; i++) {
+        const rgb_color &color = map->color_list[i];
+        CHECK_EQUAL(out[i], MakePixel(color.red, color.green, color.blue));
+    }
+
+    // Distinct palette entries come out distinct
+    int32 duplicates = 0;
+    for (int32 i = 0; i < 256; i++) {
+        for (int32 j = i + 1; j < 256; j++) duplicates += out[i] == out[j];
+    }
+    CHECK_EQUAL(duplicates, 0);
+
+    // B_GRAY8 uses a ramp instead
+    CHECK_EQUAL(converter.SetFormat(B_GRAY8), B_OK);
+    converter.ConvertRow(reinterpret_cast<uint8 *>(out), indices, 256);
+    for (int32 i = 0; i < 256; i++) CHECK_EQUAL(out[i], MakePixel(i, i, i));
+}
+
+static void
+TestUnsupported() {
+    PixelConverter converter;
+    CHECK_EQUAL(converter.InitCheck(), B_NO_INIT);
+    CHECK_EQUAL(converter.SetFormat((color_space) 0x1234), B_BAD_VALUE);
+    CHECK_EQUAL(converter.InitCheck(), B_NO_INIT);
+
+    // A failed SetFormat() doesn't leave the previous converter behind
+    converter.SetFormat(B_RGB16);
+    converter.SetFormat(B_NO_COLOR_SPACE);
+    CHECK_EQUAL(converter.InitCheck(), B_NO_INIT);
+}
+
+int
+main() {
+    for (size_t i = 0; i < sizeof(kFormats) / sizeof(kFormats[0]); i++) TestAgainstReference(kFormats[i]);
+
+    TestRoundTrip16(B_RGB16);
+    TestRoundTrip16(B_RGB15);
+    TestRoundTrip16(B_RGBA15);
+    TestRoundTrip24();
+    TestPalette();
+    TestUnsupported();
+
+    return TestResult("PixelConverterTest");
+}
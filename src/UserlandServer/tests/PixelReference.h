@@ -0,0 +1,93 @@
+/*
+ * PixelReference.h
+ * Scalar packing and expansion of every framebuffer format, one pixel at a time
+ */
+#ifndef PIXEL_REFERENCE_H
+#define PIXEL_REFERENCE_H
+
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+#include <string.h>
+
+// Replicates the high bits into the low ones, so full intensity stays 255
+static inline uint32
+ExpandBits(uint32 value, int32 bits) {
+    return (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+static inline uint32
+MakePixel(uint32 r, uint32 g, uint32 b) {
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+static inline int32
+ReferenceBytesPerPixel(color_space format) {
+    switch (format) {
+        case B_RGB32:
+        case B_RGBA32: return 4;
+        case B_RGB24: return 3;
+        case B_RGB16:
+        case B_RGB15:
+        case B_RGBA15: return 2;
+        default: return 1;
+    }
+}
+
+// One source pixel as B_RGB32. B_RGB32 keeps its alpha byte, the others are
+// opaque.
+static inline uint32
+ReferenceExpand(color_space format, const uint8 *src, const uint32 *palette) {
+    switch (format) {
+        case B_RGB32:
+        case B_RGBA32: {
+            uint32 pixel;
+            memcpy(&pixel, src, 4);
+            return pixel;
+        }
+        case B_RGB24: return MakePixel(src[2], src[1], src[0]);
+        case B_RGB16: {
+            uint32 p = src[0] | (src[1] << 8);
+            return MakePixel(ExpandBits(p >> 11, 5), ExpandBits((p >> 5) & 0x3F, 6), ExpandBits(p & 0x1F, 5));
+        }
+        case B_RGB15:
+        case B_RGBA15: {
+            uint32 p = src[0] | (src[1] << 8);
+            return MakePixel(ExpandBits((p >> 10) & 0x1F, 5), ExpandBits((p >> 5) & 0x1F, 5),
+                             ExpandBits(p & 0x1F, 5));
+        }
+        case B_GRAY8: return MakePixel(src[0], src[0], src[0]);
+        default: return palette[src[0]];
+    }
+}
+
+// The source pixel that expands to a given B_RGB32 one, if the format can hold
+// it exactly (anything ReferenceExpand() produced). Not for the palette formats.
+static inline void
+ReferencePack(color_space format, uint32 pixel, uint8 *dst) {
+    uint32 r = (pixel >> 16) & 0xFF, g = (pixel >> 8) & 0xFF, b = pixel & 0xFF;
+    switch (format) {
+        case B_RGB32:
+        case B_RGBA32: memcpy(dst, &pixel, 4); break;
+        case B_RGB24:
+            dst[0] = b;
+            dst[1] = g;
+            dst[2] = r;
+            break;
+        case B_RGB16: {
+            uint32 p = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+            dst[0] = (uint8) p;
+            dst[1] = (uint8) (p >> 8);
+            break;
+        }
+        case B_RGB15:
+        case B_RGBA15: {
+            uint32 p = ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+            dst[0] = (uint8) p;
+            dst[1] = (uint8) (p >> 8);
+            break;
+        }
+        default: dst[0] = (uint8) g; break;
+    }
+}
+
+#endif // PIXEL_REFERENCE_H
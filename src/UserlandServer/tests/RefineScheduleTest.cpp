@@ -0,0 +1,124 @@
+/*
+ * RefineScheduleTest.cpp
+ * The refinement series on a settled screen: its delay, spacing and number
+ * of steps, which tiles each step carries, and damage cutting it short
+ */
+#include "RefineSchedule.h"
+#include "TestUtils.h"
+#include <vector>
+
+static const size_t kTiles = 64;
+static const bigtime_t kTick = 16666; // Captures at 60 fps
+
+static std::vector<uint8>
+Tiles(std::initializer_list<int32> dirty) {
+    std::vector<uint8> map(kTiles, 0);
+    for (int32 tile : dirty) map[tile] = 1;
+    return map;
+}
+
+// A refinement frame as the capture stage sends it
+struct RefineFrame {
+    bigtime_t time;
+    int32 step;
+    std::vector<uint8> tiles;
+};
+
+// Captures without damage from 'start' to 'end', like the capture loop on a
+// static screen
+static std::vector<RefineFrame>
+RunStatic(RefineSchedule &schedule, bigtime_t start, bigtime_t end) {
+    std::vector<RefineFrame> frames;
+    for (bigtime_t now = start; now < end; now += kTick) {
+        if (!schedule.IsDue(now)) continue;
+        RefineFrame frame = {now, 0, std::vector<uint8>(kTiles, 0xff)};
+        frame.step = schedule.Next(now, frame.tiles.data());
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+static void
+TestIdle() {
+    // Nothing changed yet, nothing to refine
+    RefineSchedule schedule;
+    schedule.Init(kTiles);
+    CHECK_EQUAL(schedule.Step(), kRefineSteps);
+    CHECK(RunStatic(schedule, 0, 10000000).empty());
+}
+
+static void
+TestSeries() {
+    RefineSchedule schedule;
+    schedule.Init(kTiles);
+    std::vector<uint8> change = Tiles({3, 7});
+    schedule.Damaged(change.data(), 1000000);
+
+    // Not before the delay, and not again until the interval passed
+    CHECK(!schedule.IsDue(1000000));
+    CHECK(!schedule.IsDue(1000000 + kRefineDelay - 1));
+    CHECK(schedule.IsDue(1000000 + kRefineDelay));
+
+    std::vector<RefineFrame> frames = RunStatic(schedule, 1000000 + kTick, 10000000);
+    CHECK_EQUAL(frames.size(), kRefineSteps);
+    for (size_t i = 0; i < frames.size(); i++) {
+        CHECK_EQUAL(frames[i].step, (int32) i + 1);
+        CHECK(frames[i].tiles == change);
+        if (i == 0) {
+            CHECK(frames[i].time >= 1000000 + kRefineDelay);
+            CHECK(frames[i].time < 1000000 + kRefineDelay + kTick);
+        } else {
+            CHECK(frames[i].time - frames[i - 1].time >= kRefineInterval);
+            CHECK(frames[i].time - frames[i - 1].time < kRefineInterval + kTick);
+        }
+    }
+    CHECK_EQUAL(schedule.Step(), kRefineSteps);
+
+    // Then quiet. The next change's series only carries its own tiles.
+    CHECK(RunStatic(schedule, 10000000, 20000000).empty());
+    std::vector<uint8> next = Tiles({40});
+    schedule.Damaged(next.data(), 20000000);
+    frames = RunStatic(schedule, 20000000 + kTick, 30000000);
+    CHECK_EQUAL(frames.size(), kRefineSteps);
+    for (const RefineFrame &frame : frames) CHECK(frame.tiles == next);
+}
+
+// A change halfway through a series starts it over, with the tiles of both
+static void
+TestInterrupted() {
+    RefineSchedule schedule;
+    schedule.Init(kTiles);
+    std::vector<uint8> first = Tiles({1, 2});
+    schedule.Damaged(first.data(), 0);
+
+    std::vector<RefineFrame> frames = RunStatic(schedule, kTick, kRefineDelay + kRefineInterval + 3 * kTick);
+    CHECK_EQUAL(frames.size(), 2);
+
+    bigtime_t changed = frames.back().time + kTick;
+    std::vector<uint8> second = Tiles({9});
+    schedule.Damaged(second.data(), changed);
+    CHECK_EQUAL(schedule.Step(), 0);
+
+    // A screen that keeps changing is never refined
+    for (bigtime_t end = changed + 2000000; changed + kTick < end; changed += kTick) {
+        schedule.Damaged(second.data(), changed + kTick);
+        CHECK(!schedule.IsDue(changed + kTick));
+    }
+
+    frames = RunStatic(schedule, changed + kTick, changed + 5000000);
+    CHECK_EQUAL(frames.size(), kRefineSteps);
+    CHECK(frames.size() > 0 && frames[0].time >= changed + kRefineDelay);
+    for (size_t i = 0; i < frames.size(); i++) {
+        CHECK_EQUAL(frames[i].step, (int32) i + 1);
+        CHECK(frames[i].tiles == Tiles({1, 2, 9}));
+    }
+}
+
+int
+main() {
+    TestIdle();
+    TestSeries();
+    TestInterrupted();
+
+    return TestResult("RefineScheduleTest");
+}
@@ -0,0 +1,109 @@
+/*
+ * ReplayBench.cpp
+ * Replay throughput at maximum speed, and whether every pass is identical
+ */
+#include "DamageTracker.h"
+#include "FrameRecorder.h"
+#include "ReplaySource.h"
+#include "SyntheticSource.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char *kSyntheticPath = "replay_bench.hrdc";
+
+// Records a synthetic session to replay when no capture file is given
+static status_t
+RecordSynthetic(int32 width, int32 height, int32 frames) {
+    SyntheticSource source(width, height);
+    DamageTracker tracker;
+    tracker.Init(width, height);
+
+    FrameRecorder recorder;
+    status_t status = recorder.Open(kSyntheticPath, width, height, true);
+    if (status != B_OK) return status;
+
+    for (int32 i = 0; i < frames; i++) {
+        FrameSnapshot *snapshot = source.Snapshot();
+        if (!snapshot) return B_ERROR;
+        snapshot->timestamp = i * 16667;
+        tracker.Update(snapshot->bits, snapshot->rowBytes);
+        recorder.AddFrame(snapshot, tracker.DirtyMap());
+        source.ReleaseSnapshot(snapshot);
+        source.Advance();
+    }
+    recorder.Close();
+    return B_OK;
+}
+
+static uint64
+HashFrame(uint64 hash, const FrameSnapshot *snapshot) {
+    for (int32 y = 0; y < snapshot->height; y++) {
+        const uint64 *row = (const uint64 *) (snapshot->bits + (size_t) y * snapshot->rowBytes);
+        for (int32 x = 0; x < snapshot->width / 2; x++) hash = (hash ^ row[x]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+int
+main(int argc, char **argv) {
+    int32 passes = argc > 1 ? atoi(argv[1]) : 3;
+    if (passes < 1) passes = 1;
+
+    const char *path = argc > 2 ? argv[2] : kSyntheticPath;
+    if (argc <= 2 && RecordSynthetic(1920, 1080, 120) != B_OK) {
+        fprintf(stderr, "Cannot record %s\n", kSyntheticPath);
+        return 1;
+    }
+
+    ReplaySource replay;
+    if (replay.Open(path, false) != B_OK) return 1;
+
+    // The frame count is only in the header, so read it from the file once
+    CaptureFileHeader header;
+    FILE *file = fopen(path, "rb");
+    if (!file || fread(&header, sizeof(header), 1, file) != 1) return 1;
+    fclose(file);
+
+    DamageTracker tracker;
+    tracker.Init(replay.Width(), replay.Height());
+
+    uint64 firstHash = 0;
+    int64 firstDirty = 0;
+    bool identical = true;
+
+    for (int32 pass = 0; pass < passes; pass++) {
+        uint64 hash = 0xCBF29CE484222325ULL;
+        int64 dirty = 0;
+        bigtime_t copyTime = 0;
+
+        tracker.Invalidate();
+        bigtime_t start = BenchTime();
+        for (uint32 i = 0; i < header.frameCount; i++) {
+            FrameSnapshot *snapshot = nullptr;
+            while (!snapshot) snapshot = replay.Snapshot();
+
+            copyTime += snapshot->copyTime;
+            hash = HashFrame(hash, snapshot);
+            dirty += tracker.Update(snapshot->bits, snapshot->rowBytes);
+            replay.ReleaseSnapshot(snapshot);
+        }
+        bigtime_t elapsed = BenchTime() - start;
+
+        if (pass == 0) {
+            firstHash = hash;
+            firstDirty = dirty;
+        } else if (hash != firstHash || dirty != firstDirty) {
+            identical = false;
+        }
+
+        printf("pass %d: %u frames %dx%d, %.1f fps, snapshot %.0f us/frame, %lld dirty tiles, hash %016llx\n",
+               (int) pass, (unsigned int) header.frameCount, (int) replay.Width(), (int) replay.Height(),
+               header.frameCount * 1e6 / elapsed, (double) copyTime / header.frameCount, (long long) dirty,
+               (unsigned long long) hash);
+    }
+
+    printf("%s\n", identical ? "All passes identical" : "Passes DIFFER");
+    if (path == kSyntheticPath) unlink(kSyntheticPath);
+    return identical ? 0 : 1;
+}
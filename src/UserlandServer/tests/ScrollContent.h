@@ -0,0 +1,82 @@
+/*
+ * ScrollContent.h
+ * Synthetic documents and the desktop frames showing them scrolled
+ */
+#ifndef SCROLL_CONTENT_H
+#define SCROLL_CONTENT_H
+
+#include "TestUtils.h"
+#include <SupportDefs.h>
+#include <string.h>
+#include <vector>
+
+// A B_RGB32 page of "text": 16 pixel lines of random glyph blocks on white,
+// with blank gaps and margins like a terminal or a web page
+struct Document {
+    int32 width;
+    int32 height;
+    std::vector<uint32> pixels;
+
+    Document(int32 width, int32 height, uint32 seed)
+        : width(width), height(height), pixels((size_t) width * height, 0xFFFFFFFF) {
+        uint32 state = seed;
+        for (int32 line = 0; line + 16 <= height; line += 16) {
+            // Some lines are left empty
+            if (NextRandom(state) % 5 == 0) continue;
+
+            for (int32 x = 8; x + 8 <= width - 8; x += 8) {
+                uint32 glyph = NextRandom(state);
+                if (glyph % 7 == 0) continue; // A space
+                uint32 color = 0xFF000000 | (glyph & 0x3F3F3F);
+                for (int32 y = line + 3; y < line + 13; y++) {
+                    for (int32 dx = 0; dx < 6; dx++) {
+                        if ((glyph >> ((y - line) * 3 + dx) % 31) & 1) pixels[(size_t) y * width + x + dx] = color;
+                    }
+                }
+            }
+        }
+    }
+};
+
+// A desktop with a window showing the document from (scrollX, scrollY)
+class ScrollScene {
+public:
+    // A noisy wallpaper makes sure the desktop outside the window matches
+    // nothing, a smooth one is more like what encoders get to see
+    ScrollScene(int32 width, int32 height, int32 windowX, int32 windowY, int32 windowWidth, int32 windowHeight,
+                bool noisy = true)
+        : fWidth(width), fHeight(height), fWindowX(windowX), fWindowY(windowY), fWindowWidth(windowWidth),
+          fWindowHeight(windowHeight), fFrame((size_t) width * height) {
+        if (noisy) {
+            FillRandom(reinterpret_cast<uint8 *>(fFrame.data()), fFrame.size() * 4, 77);
+            return;
+        }
+        for (int32 y = 0; y < height; y++) {
+            for (int32 x = 0; x < width; x++)
+                fFrame[(size_t) y * width + x] = 0xFF000000 | (x * 255 / width) << 16 | (y * 255 / height) << 8 | 0x80;
+        }
+    }
+
+    void Show(const Document &document, int32 scrollX, int32 scrollY) {
+        for (int32 y = 0; y < fWindowHeight; y++) {
+            memcpy(&fFrame[(size_t) (fWindowY + y) * fWidth + fWindowX],
+                   &document.pixels[(size_t) (scrollY + y) * document.width + scrollX], fWindowWidth * 4);
+        }
+    }
+
+    const uint8 *Bits() const { return reinterpret_cast<const uint8 *>(fFrame.data()); }
+    int32 Stride() const { return fWidth * 4; }
+
+    uint32 Pixel(int32 x, int32 y) const { return fFrame[(size_t) y * fWidth + x]; }
+
+private:
+    int32 fWidth;
+    int32 fHeight;
+    int32 fWindowX;
+    int32 fWindowY;
+    int32 fWindowWidth;
+    int32 fWindowHeight;
+    std::vector<uint32> fFrame;
+};
+
+#endif // SCROLL_CONTENT_H
@@ -0,0 +1,106 @@
+/*
+ * ScrollDetectorBench.cpp
+ * Scroll detection on synthetic 1080p sequences: hit rate, cost, damage saved
+ */
+#include "DamageTracker.h"
+#include "ScrollContent.h"
+#include "ScrollDetector.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+
+static const int32 kWidth = 1920;
+static const int32 kHeight = 1080;
+
+// A window showing a document that scrolls by (stepX, stepY) per frame, or
+// changes some other way for the sequences without a move
+struct Sequence {
+    const char *name;
+    int32 stepX;
+    int32 stepY;
+    bool retype; // Content changes in place instead of moving
+};
+
+static void
+Run(const Sequence &sequence, const Document &document, int32 frames) {
+    const int32 windowX = 160, windowY = 60, windowWidth = 1600, windowHeight = 960;
+    ScrollScene scene(kWidth, kHeight, windowX, windowY, windowWidth, windowHeight);
+
+    DamageTracker tracker;
+    ScrollDetector detector;
+    tracker.Init(kWidth, kHeight);
+    detector.Init(kWidth, kHeight);
+
+    // Start halfway down, so scrolling either way has room
+    const int32 startX = (document.width - windowWidth) / 2, startY = (document.height - windowHeight) / 2;
+    int32 scrollX = startX, scrollY = startY;
+    scene.Show(document, scrollX, scrollY);
+    tracker.Update(scene.Bits(), scene.Stride());
+    ScrollMove move;
+    detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), move);
+
+    Document other(document.width, document.height, 1234);
+
+    bigtime_t damageTime = 0, detectTime = 0;
+    int32 hits = 0, wrong = 0;
+    int64 damagedPixels = 0, movedPixels = 0;
+
+    for (int32 i = 0; i < frames; i++) {
+        if (sequence.retype) {
+            scene.Show(i % 2 ? document : other, 0, 0);
+        } else {
+            scrollX += sequence.stepX;
+            scrollY += sequence.stepY;
+            // Jump back at either end of the document, that frame has no move
+            if (scrollY < 0 || scrollY + windowHeight > document.height) scrollY = startY;
+            if (scrollX < 0 || scrollX + windowWidth > document.width) scrollX = startX;
+            scene.Show(document, scrollX, scrollY);
+        }
+
+        bigtime_t start = BenchTime();
+        int32 dirty = tracker.Update(scene.Bits(), scene.Stride());
+        bigtime_t tracked = BenchTime();
+        bool found = detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), move);
+        bigtime_t detected = BenchTime();
+
+        damageTime += tracked - start;
+        detectTime += detected - tracked;
+        damagedPixels += (int64) dirty * DamageTracker::kTileSize * DamageTracker::kTileSize;
+
+        if (found) {
+            if (move.dx == -sequence.stepX && move.dy == -sequence.stepY && !sequence.retype) {
+                hits++;
+                movedPixels += (int64) move.width * move.height;
+            } else {
+                wrong++;
+            }
+        }
+    }
+
+    printf("%-26s  moves %3d/%-3d wrong %3d   damage %5.2f ms  detect %5.2f ms/frame   %5.1f%% of damage moved\n",
+           sequence.name, (int) hits, (int) frames, (int) wrong, damageTime / 1000.0 / frames,
+           detectTime / 1000.0 / frames, damagedPixels ? 100.0 * movedPixels / damagedPixels : 0.0);
+}
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 60;
+    if (frames < 1) frames = 1;
+
+    Document tall(1600, 8000, 1);
+    Document wide(6000, 960, 2);
+
+    const Sequence sequences[] = {
+        {"terminal, line per frame", 0, 16, false},
+        {"smooth scroll 3px", 0, 3, false},
+        {"wheel scroll 40px", 0, 40, false},
+        {"scrolling back up 40px", 0, -40, false},
+        {"page down 400px", 0, 400, false},
+        {"horizontal pan 8px", 8, 0, false},
+        {"content replaced", 0, 0, true},
+    };
+
+    printf("%dx%d desktop, 1600x960 window, %d frames\n", (int) kWidth, (int) kHeight, (int) frames);
+    for (size_t i = 0; i < sizeof(sequences) / sizeof(sequences[0]); i++)
+        Run(sequences[i], sequences[i].stepX ? wide : tall, frames);
+    return 0;
+}
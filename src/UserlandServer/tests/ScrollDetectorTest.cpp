@@ -0,0 +1,155 @@
+/*
+ * ScrollDetectorTest.cpp
+ * Vertical and horizontal moves in synthetic frames, and frames without one
+ */
+#include "DamageTracker.h"
+#include "ScrollContent.h"
+#include "ScrollDetector.h"
+#include "TestUtils.h"
+#include <vector>
+
+static const int32 kWidth = 640;
+static const int32 kHeight = 480;
+
+struct Detection {
+    bool found;
+    ScrollMove move;
+    std::vector<uint32> previous; // The frame before the move
+};
+
+// Shows the document at two scroll positions and runs both frames through
+// DamageTracker and ScrollDetector like the capture stage does
+static Detection
+Detect(ScrollScene &scene, const Document &document, int32 fromX, int32 fromY, int32 toX, int32 toY) {
+    DamageTracker tracker;
+    ScrollDetector detector;
+    tracker.Init(kWidth, kHeight);
+    CHECK_EQUAL(detector.Init(kWidth, kHeight), B_OK);
+
+    Detection result;
+    scene.Show(document, fromX, fromY);
+    tracker.Update(scene.Bits(), scene.Stride());
+    CHECK(!detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), result.move)); // Only primes
+
+    const uint32 *pixels = reinterpret_cast<const uint32 *>(scene.Bits());
+    result.previous.assign(pixels, pixels + kWidth * kHeight);
+
+    scene.Show(document, toX, toY);
+    tracker.Update(scene.Bits(), scene.Stride());
+    result.found = detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), result.move);
+    return result;
+}
+
+// The move must be exact: every pixel of the rect is the previous frame's
+// pixel at (x - dx, y - dy)
+static void
+CheckMove(const ScrollScene &scene, const Detection &detection, int32 dx, int32 dy, int32 minWidth,
+          int32 minHeight) {
+    if (!detection.found) fprintf(stderr, "No move found, expected %d,%d\n", (int) dx, (int) dy);
+    CHECK(detection.found);
+    if (!detection.found) return;
+
+    const ScrollMove &move = detection.move;
+    CHECK_EQUAL(move.dx, dx);
+    CHECK_EQUAL(move.dy, dy);
+    CHECK(move.width >= minWidth);
+    CHECK(move.height >= minHeight);
+
+    // Source and destination both inside the frame
+    CHECK(move.x >= 0 && move.y >= 0 && move.x + move.width <= kWidth && move.y + move.height <= kHeight);
+    CHECK(move.x - move.dx >= 0 && move.y - move.dy >= 0);
+    CHECK(move.x - move.dx + move.width <= kWidth && move.y - move.dy + move.height <= kHeight);
+
+    int32 wrong = 0;
+    for (int32 y = move.y; y < move.y + move.height; y++) {
+        for (int32 x = move.x; x < move.x + move.width; x++) {
+            if (scene.Pixel(x, y) != detection.previous[(size_t) (y - move.dy) * kWidth + x - move.dx]) wrong++;
+        }
+    }
+    CHECK_EQUAL(wrong, 0);
+}
+
+// Every small move and a spread of larger ones up to just under half the
+// window, both ways, with the window on the tile grid and off it. Larger moves leave most of the damage newly
+// revealed, and the detector leaves those to the encoder.
+static void
+TestVertical() {
+    Document document(512, 2000, 1);
+    ScrollScene aligned(kWidth, kHeight, 64, 64, 512, 384);
+    ScrollScene offGrid(kWidth, kHeight, 40, 30, 500, 420);
+
+    for (int32 amount = 1; amount < 180; amount += amount < 40 ? 1 : 7) {
+        for (int32 direction = -1; direction <= 1; direction += 2) {
+            Detection detection = Detect(aligned, document, 0, 600, 0, 600 - direction * amount);
+            CheckMove(aligned, detection, 0, direction * amount, 512, (384 - amount) / 2);
+
+            detection = Detect(offGrid, document, 0, 600, 0, 600 - direction * amount);
+            CheckMove(offGrid, detection, 0, direction * amount, 384, (420 - amount) / 2);
+        }
+    }
+}
+
+static void
+TestHorizontal() {
+    Document document(2000, 400, 2);
+    ScrollScene aligned(kWidth, kHeight, 64, 64, 512, 384);
+    ScrollScene offGrid(kWidth, kHeight, 37, 50, 530, 400);
+
+    for (int32 amount = 1; amount < 240; amount += amount < 40 ? 1 : 7) {
+        for (int32 direction = -1; direction <= 1; direction += 2) {
+            Detection detection = Detect(aligned, document, 600, 0, 600 - direction * amount, 0);
+            CheckMove(aligned, detection, direction * amount, 0, (512 - amount) / 2, 384);
+
+            detection = Detect(offGrid, document, 600, 0, 600 - direction * amount, 0);
+            CheckMove(offGrid, detection, direction * amount, 0, (530 - amount) / 2, 320);
+        }
+    }
+}
+
+static void
+TestNoMove() {
+    Document document(512, 2000, 3);
+    Document other(512, 2000, 4);
+
+    // Nothing changed
+    ScrollScene scene(kWidth, kHeight, 64, 64, 512, 384);
+    Detection detection = Detect(scene, document, 0, 100, 0, 100);
+    CHECK(!detection.found);
+
+    // Different content altogether, as when switching tabs
+    DamageTracker tracker;
+    ScrollDetector detector;
+    tracker.Init(kWidth, kHeight);
+    detector.Init(kWidth, kHeight);
+    ScrollMove move;
+
+    scene.Show(document, 0, 0);
+    tracker.Update(scene.Bits(), scene.Stride());
+    detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), move);
+    scene.Show(other, 0, 0);
+    tracker.Update(scene.Bits(), scene.Stride());
+    CHECK(!detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), move));
+
+    // Damage too small to be worth a copy-rect: a scroll inside one tile
+    ScrollScene small(kWidth, kHeight, 128, 128, 48, 48);
+    detection = Detect(small, document, 0, 100, 0, 116);
+    CHECK(!detection.found);
+
+    // Invalidate() forgets the previous frame, so nothing can match
+    scene.Show(document, 0, 100);
+    tracker.Update(scene.Bits(), scene.Stride());
+    detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), move);
+    detector.Invalidate();
+    scene.Show(document, 0, 140);
+    tracker.Update(scene.Bits(), scene.Stride());
+    CHECK(!detector.Update(scene.Bits(), scene.Stride(), tracker.DirtyMap(), move));
+}
+
+int
+main() {
+    TestVertical();
+    TestHorizontal();
+    TestNoMove();
+
+    return TestResult("ScrollDetectorTest");
+}
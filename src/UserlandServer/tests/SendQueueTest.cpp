@@ -0,0 +1,305 @@
+/*
+ * SendQueueTest.cpp
+ * Queue limits and byte order, and a loopback stream to clients of mixed
+ * speed: the fast ones get every frame while the slow one drops to keyframes
+ */
+#include "SendQueue.h"
+#include "TestUtils.h"
+#include <OS.h>
+#include <atomic>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+static struct iovec
+Piece(const void *data, size_t size) {
+    struct iovec vec;
+    vec.iov_base = (void *) data;
+    vec.iov_len = size;
+    return vec;
+}
+
+// Everything the writer side hands out, in order
+static std::vector<uint8>
+Drain(SendQueue &queue, size_t most) {
+    std::vector<uint8> out;
+    queue.Take();
+    size_t size;
+    const uint8 *data = queue.Pending(size);
+    if (size > most) size = most;
+    out.assign(data, data + size);
+    queue.Written(size);
+    return out;
+}
+
+static void
+TestQueue() {
+    SendQueue queue;
+    const uint8 bytes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+    // Pieces are joined, the limit only counts what is already queued
+    struct iovec vec[2] = {Piece(bytes, 4), Piece(bytes + 4, 4)};
+    CHECK(queue.Append(vec, 2, 5));
+    CHECK_EQUAL(queue.Unsent(), 8);
+    CHECK(!queue.Append(vec, 1, 5));
+    CHECK(queue.Append(vec, 1, 8)); // Not over it yet
+    CHECK(queue.Append(vec, 1)); // Control messages have no limit
+    CHECK_EQUAL(queue.Unsent(), 16);
+
+    // Written in parts; what is appended meanwhile waits for the current
+    // buffer to go out
+    std::vector<uint8> out = Drain(queue, 3);
+    CHECK(out == std::vector<uint8>({1, 2, 3}));
+    struct iovec tail = Piece(bytes + 8, 2);
+    CHECK(queue.Append(&tail, 1));
+    out = Drain(queue, 100);
+    CHECK(out == std::vector<uint8>({4, 5, 6, 7, 8, 1, 2, 3, 4, 1, 2, 3, 4}));
+    out = Drain(queue, 100);
+    CHECK(out == std::vector<uint8>({9, 10}));
+    CHECK_EQUAL(queue.Unsent(), 0);
+
+    // A message bigger than the limit still goes into a drained queue
+    std::vector<uint8> big(1000, 7);
+    struct iovec keyframe = Piece(big.data(), big.size());
+    CHECK(queue.Append(&keyframe, 1, 100));
+    CHECK(!queue.Append(vec, 1, 100));
+    CHECK_EQUAL(Drain(queue, 2000).size(), 1000);
+    CHECK(queue.Append(vec, 1, 100));
+}
+
+static const int32 kClients = 3;
+static const int32 kFrames = 180;
+static const bigtime_t kFrameInterval = 16666;
+static const size_t kDeltaSize = 20000;
+static const size_t kKeySize = 80000;
+static const size_t kQueueLimit = kDeltaSize * 30; // Half a second, like NetworkServer
+
+// A frame on the wire: size, index, keyframe flag, then the index's low byte
+// as payload
+struct FrameHeader {
+    uint32 size;
+    uint32 index;
+    uint32 isKey;
+};
+
+struct Client {
+    int serverSocket;
+    int clientSocket;
+    size_t readRate; // Bytes per 10 ms, 0 for as fast as it can
+
+    // Under the lock, like NetworkServer::ClientState
+    SendQueue queue;
+    bool waitingForKeyframe = true;
+    bool dropped = false;
+    size_t mostQueued = 0;
+
+    // Reader thread
+    std::vector<uint32> frames;
+    std::vector<bool> keys;
+    int32 corrupt = 0;
+};
+
+struct Loopback {
+    Client clients[kClients];
+    std::mutex lock;
+    std::atomic<bool> keyframeRequested{false};
+    std::atomic<bool> quit{false};
+};
+
+// The steps of NetworkServer::_Broadcast() for one tier
+static void
+Broadcast(Loopback &loopback, const std::vector<uint8> &frame, bool isKey) {
+    struct iovec vec = Piece(frame.data(), frame.size());
+    std::lock_guard<std::mutex> locker(loopback.lock);
+    for (Client &client : loopback.clients) {
+        if (client.waitingForKeyframe && !isKey) continue;
+        if (!client.queue.Append(&vec, 1, kQueueLimit)) {
+            client.waitingForKeyframe = true;
+            client.dropped = true;
+            continue;
+        }
+        if (isKey) client.waitingForKeyframe = false;
+        if (client.queue.Unsent() > client.mostQueued) client.mostQueued = client.queue.Unsent();
+    }
+}
+
+// NetworkServer::_FlushClients(), with send() for SSL_write()
+static status_t
+WriterLoop(void *data) {
+    Loopback &loopback = *(Loopback *) data;
+    while (!loopback.quit) {
+        struct pollfd fds[kClients];
+        int count = 0;
+        {
+            std::lock_guard<std::mutex> locker(loopback.lock);
+            for (Client &client : loopback.clients) {
+                if (client.dropped && client.queue.Unsent() == 0) {
+                    loopback.keyframeRequested = true;
+                    client.dropped = false;
+                }
+                client.queue.Take();
+            }
+        }
+
+        for (Client &client : loopback.clients) {
+            size_t size;
+            const uint8 *bytes = client.queue.Pending(size);
+            while (size > 0) {
+                ssize_t written = send(client.serverSocket, bytes, size, MSG_DONTWAIT);
+                if (written <= 0) break;
+                client.queue.Written(written);
+                bytes += written;
+                size -= written;
+            }
+            if (client.queue.Unsent() > 0) fds[count++] = {client.serverSocket, POLLOUT, 0};
+        }
+        poll(fds, count, 1);
+    }
+    return B_OK;
+}
+
+static status_t
+ReaderLoop(void *data) {
+    Client &client = *(Client *) data;
+    std::vector<uint8> buffer;
+    uint8 chunk[65536];
+
+    while (true) {
+        size_t most = client.readRate ? client.readRate : sizeof(chunk);
+        ssize_t got = recv(client.clientSocket, chunk, most, 0);
+        if (got <= 0) break;
+        buffer.insert(buffer.end(), chunk, chunk + got);
+
+        // Every complete frame
+        size_t offset = 0;
+        while (buffer.size() - offset >= sizeof(FrameHeader)) {
+            FrameHeader header;
+            memcpy(&header, &buffer[offset], sizeof(header));
+            if (header.size < sizeof(header) || header.size > kKeySize) {
+                client.corrupt++;
+                return B_ERROR;
+            }
+            if (buffer.size() - offset < header.size) break;
+
+            for (size_t i = sizeof(header); i < header.size; i++) {
+                if (buffer[offset + i] != (uint8) header.index) {
+                    client.corrupt++;
+                    break;
+                }
+            }
+            client.frames.push_back(header.index);
+            client.keys.push_back(header.isKey != 0);
+            offset += header.size;
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + offset);
+
+        if (client.readRate) snooze(10000);
+    }
+    return B_OK;
+}
+
+// One tier streamed at 60 fps to two clients that keep up and one reading
+// two thirds of the stream's rate. The sender must never wait for the slow one.
+static void
+TestLoopback() {
+    Loopback loopback;
+    for (int32 i = 0; i < kClients; i++) {
+        Client &client = loopback.clients[i];
+        int sockets[2];
+        CHECK_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+        client.serverSocket = sockets[0];
+        client.clientSocket = sockets[1];
+        client.readRate = i == kClients - 1 ? 8000 : 0;
+
+        // Small socket buffers, so the queue is where a slow client backs up
+        int size = 32768;
+        setsockopt(client.serverSocket, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(client.clientSocket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        fcntl(client.serverSocket, F_SETFL, fcntl(client.serverSocket, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    thread_id writer = spawn_thread(WriterLoop, "writer", B_NORMAL_PRIORITY, &loopback);
+    thread_id readers[kClients];
+    for (int32 i = 0; i < kClients; i++) {
+        readers[i] = spawn_thread(ReaderLoop, "reader", B_NORMAL_PRIORITY, &loopback.clients[i]);
+        resume_thread(readers[i]);
+    }
+    resume_thread(writer);
+
+    bigtime_t slowest = 0, start = BenchTime();
+    int32 keyframes = 0;
+    for (int32 index = 0; index < kFrames; index++) {
+        bool isKey = index == 0 || loopback.keyframeRequested.exchange(false);
+        keyframes += isKey;
+
+        std::vector<uint8> frame(isKey ? kKeySize : kDeltaSize, (uint8) index);
+        FrameHeader header = {(uint32) frame.size(), (uint32) index, isKey};
+        memcpy(frame.data(), &header, sizeof(header));
+
+        bigtime_t before = BenchTime();
+        Broadcast(loopback, frame, isKey);
+        bigtime_t took = BenchTime() - before;
+        if (took > slowest) slowest = took;
+
+        bigtime_t next = start + (index + 1) * kFrameInterval, now = BenchTime();
+        if (next > now) snooze(next - now);
+    }
+
+    // Give the fast clients time to read the rest
+    for (int32 wait = 0; wait < 200; wait++) {
+        bool done = true;
+        for (int32 i = 0; i < kClients - 1; i++) done &= loopback.clients[i].queue.Unsent() == 0;
+        if (done) break;
+        snooze(10000);
+    }
+    snooze(50000);
+
+    loopback.quit = true;
+    status_t result;
+    wait_for_thread(writer, &result);
+    for (int32 i = 0; i < kClients; i++) {
+        shutdown(loopback.clients[i].serverSocket, SHUT_RDWR);
+        wait_for_thread(readers[i], &result);
+        close(loopback.clients[i].serverSocket);
+        close(loopback.clients[i].clientSocket);
+    }
+
+    for (int32 i = 0; i < kClients; i++) {
+        Client &client = loopback.clients[i];
+        CHECK_EQUAL(client.corrupt, 0);
+        CHECK(client.mostQueued <= kQueueLimit + kKeySize);
+        if (i < kClients - 1) {
+            // Every frame, in order
+            CHECK_EQUAL(client.frames.size(), kFrames);
+            int32 outOfOrder = 0;
+            for (size_t frame = 0; frame < client.frames.size(); frame++) outOfOrder += client.frames[frame] != frame;
+            CHECK_EQUAL(outOfOrder, 0);
+            continue;
+        }
+
+        // Frames are skipped, but only ever up to a keyframe
+        CHECK(client.frames.size() > 0 && client.frames.size() < (size_t) kFrames);
+        for (size_t frame = 1; frame < client.frames.size(); frame++) {
+            if (client.frames[frame] != client.frames[frame - 1] + 1) CHECK(client.keys[frame]);
+        }
+    }
+
+    printf("Fast clients %d and %d frames, slow client %d, %d keyframes, slowest broadcast %.2f ms\n",
+           (int) loopback.clients[0].frames.size(), (int) loopback.clients[1].frames.size(),
+           (int) loopback.clients[kClients - 1].frames.size(), (int) keyframes, slowest / 1000.0);
+
+    // Copies into three queues, never a wait for a socket
+    CHECK(slowest < 50000);
+}
+
+int
+main() {
+    TestQueue();
+    TestLoopback();
+
+    return TestResult("SendQueueTest");
+}
@@ -0,0 +1,63 @@
+/*
+ * SnapshotPoolBench.cpp
+ * Copy cost of snapshots from a synthetic source, against a plain memcpy
+ */
+#include "FrameSnapshot.h"
+#include "SyntheticSource.h"
+#include "TestUtils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static const char *
+FormatName(color_space format) {
+    switch (format) {
+        case B_RGB32: return "RGB32";
+        case B_RGB24: return "RGB24";
+        case B_RGB16: return "RGB16";
+        case B_RGB15: return "RGB15";
+        case B_CMAP8: return "CMAP8";
+        default: return "?";
+    }
+}
+
+static void
+RunSize(int32 width, int32 height, color_space format, int32 frames) {
+    SyntheticSource source(width, height, format);
+    if (source.InitCheck() != B_OK) return;
+
+    // What the pool measures itself, per snapshot
+    bigtime_t copyTime = 0;
+    for (int32 i = 0; i < frames; i++) {
+        FrameSnapshot *snapshot = source.Snapshot();
+        if (!snapshot) continue;
+        copyTime += snapshot->copyTime;
+        source.ReleaseSnapshot(snapshot);
+    }
+
+    // The same bytes with memcpy, the floor for a straight copy
+    size_t bytes = (size_t) source.Stride() * height;
+    std::vector<uint8> copy(bytes);
+    bigtime_t start = BenchTime();
+    for (int32 i = 0; i < frames; i++) memcpy(copy.data(), source.Bits(), bytes);
+    bigtime_t memcpyTime = BenchTime() - start;
+
+    double megabytes = (double) bytes * frames / (1024 * 1024);
+    printf("%5dx%-5d %-6s  snapshot %7.0f us/frame %6.0f MB/s   memcpy %7.0f us/frame %6.0f MB/s\n", (int) width,
+           (int) height, FormatName(format), (double) copyTime / frames, megabytes / (copyTime / 1e6),
+           (double) memcpyTime / frames, megabytes / (memcpyTime / 1e6));
+}
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 100;
+    if (frames < 1) frames = 1;
+
+    const color_space formats[] = {B_RGB32, B_RGB24, B_RGB16, B_CMAP8};
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        RunSize(1920, 1080, formats[i], frames);
+        RunSize(2560, 1440, formats[i], frames);
+    }
+    RunSize(3840, 2160, B_RGB32, frames / 4 + 1);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * SnapshotPoolTest.cpp
+ * Snapshots of a synthetic source: content, alignment and pool exhaustion
+ */
+#include "FrameSnapshot.h"
+#include "PixelConverter.h"
+#include "SyntheticSource.h"
+#include "TestUtils.h"
+#include <string.h>
+#include <vector>
+
+// Compares a snapshot with the source framebuffer expanded row by row
+static void
+CheckContent(SyntheticSource &source, const FrameSnapshot *snapshot) {
+    CHECK(snapshot != nullptr);
+    if (!snapshot) return;
+
+    CHECK_EQUAL(snapshot->width, source.Width());
+    CHECK_EQUAL(snapshot->height, source.Height());
+    CHECK_EQUAL((uintptr_t) snapshot->bits % 64, 0);
+    CHECK_EQUAL(snapshot->rowBytes % 64, 0);
+    CHECK(snapshot->rowBytes >= source.Width() * 4);
+
+    std::vector<uint8> expected(source.Width() * 4);
+    int32 badRows = 0;
+    for (int32 y = 0; y < source.Height(); y++) {
+        source.Converter().ConvertRow(expected.data(), source.Bits() + (size_t) y * source.Stride(), source.Width());
+        if (memcmp(snapshot->bits + (size_t) y * snapshot->rowBytes, expected.data(), expected.size()) != 0)
+            badRows++;
+    }
+    CHECK_EQUAL(badRows, 0);
+}
+
+static void
+TestContent(int32 width, int32 height, color_space format, int32 rowPadding, bool streamLoads) {
+    SyntheticSource source(width, height, format, rowPadding);
+    CHECK_EQUAL(source.InitCheck(), B_OK);
+    source.SetStreamLoads(streamLoads);
+
+    for (int32 frame = 0; frame < 3; frame++) {
+        FrameSnapshot *snapshot = source.Snapshot();
+        CheckContent(source, snapshot);
+        source.ReleaseSnapshot(snapshot);
+        source.Advance();
+    }
+}
+
+// Rows that don't start on a 16-byte boundary go through the staging offset
+static void
+TestUnalignedSource() {
+    const int32 width = 101, height = 9;
+    PixelConverter converter;
+    converter.SetFormat(B_RGB32);
+
+    SnapshotPool pool;
+    CHECK_EQUAL(pool.Init(width, height, 1), B_OK);
+
+    std::vector<uint8> buffer(width * 4 * height + 64);
+    FillRandom(buffer.data(), buffer.size(), 5);
+
+    for (int32 offset = 0; offset < 32; offset += 4) {
+        // Both read paths
+        pool.SetStreamLoads(offset < 16);
+
+        const uint8 *bits = buffer.data() + 16 + offset % 16;
+        FrameSnapshot *snapshot = pool.Capture(bits, width * 4, converter);
+        CHECK(snapshot != nullptr);
+        if (!snapshot) continue;
+
+        for (int32 y = 0; y < height; y++)
+            CHECK(memcmp(snapshot->bits + y * snapshot->rowBytes, bits + y * width * 4, width * 4) == 0);
+        pool.Release(snapshot);
+    }
+}
+
+static void
+TestExhaustion() {
+    const int32 width = 64, height = 16;
+    PixelConverter converter;
+    converter.SetFormat(B_RGB32);
+    std::vector<uint8> frame(width * 4 * height, 0x80);
+
+    SnapshotPool pool;
+    CHECK_EQUAL(pool.Init(width, height), B_OK);
+
+    // Every snapshot held by a reader: the next capture fails
+    FrameSnapshot *held[SnapshotPool::kMaxSnapshots];
+    for (int32 i = 0; i < SnapshotPool::kMaxSnapshots; i++) {
+        held[i] = pool.Capture(frame.data(), width * 4, converter);
+        CHECK(held[i] != nullptr);
+        for (int32 j = 0; j < i; j++) CHECK(held[i] != held[j]);
+    }
+    CHECK(pool.Capture(frame.data(), width * 4, converter) == nullptr);
+
+    // Releasing one makes exactly that one available again
+    pool.Release(held[1]);
+    FrameSnapshot *again = pool.Capture(frame.data(), width * 4, converter);
+    CHECK(again == held[1]);
+    CHECK(pool.Capture(frame.data(), width * 4, converter) == nullptr);
+
+    for (int32 i = 0; i < SnapshotPool::kMaxSnapshots; i++) pool.Release(held[i]);
+    CHECK(pool.Capture(frame.data(), width * 4, converter) != nullptr);
+}
+
+static void
+TestBadInput() {
+    SnapshotPool pool;
+    CHECK_EQUAL(pool.Init(0, 10), B_BAD_VALUE);
+    CHECK_EQUAL(pool.Init(10, 10, 0), B_BAD_VALUE);
+    CHECK_EQUAL(pool.Init(10, 10, SnapshotPool::kMaxSnapshots + 1), B_BAD_VALUE);
+
+    PixelConverter converter;
+    converter.SetFormat(B_RGB32);
+    uint8 pixel[4] = {};
+    CHECK(pool.Capture(pixel, 4, converter) == nullptr); // Not initialized
+
+    CHECK_EQUAL(pool.Init(1, 1), B_OK);
+    CHECK(pool.Capture(nullptr, 4, converter) == nullptr);
+    CHECK(pool.Capture(pixel, 4, PixelConverter()) == nullptr); // No format
+}
+
+int
+main() {
+    // Both framebuffer read paths
+    for (int32 stream = 0; stream < 2; stream++) {
+        TestContent(640, 48, B_RGB32, 0, stream);
+        TestContent(333, 21, B_RGB32, 12, stream);
+        TestContent(333, 21, B_RGB24, 1, stream);
+        TestContent(250, 17, B_RGB16, 6, stream);
+        TestContent(250, 17, B_RGB15, 0, stream);
+        TestContent(127, 5, B_CMAP8, 3, stream);
+    }
+
+    TestUnalignedSource();
+    TestExhaustion();
+    TestBadInput();
+
+    return TestResult("SnapshotPoolTest");
+}
@@ -0,0 +1,113 @@
+/*
+ * StreamLoadBench.cpp
+ * Snapshot copies with plain against streaming (MOVNTDQA) framebuffer reads
+ */
+#include "CpuFeatures.h"
+#include "FrameSnapshot.h"
+#include "PixelConverter.h"
+#include "TestUtils.h"
+#include <emmintrin.h> // SSE2
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+// Evicts a buffer from every cache level, like memory the CPU never caches
+static void
+Flush(const uint8 *bits, size_t bytes) {
+    for (size_t i = 0; i < bytes; i += 64) _mm_clflush(bits + i);
+    _mm_mfence();
+}
+
+// Average copy time of both read paths over the same frames
+static void
+Compare(const char *name, const uint8 *bits, int32 stride, int32 width, int32 height, color_space format, int32 frames,
+        bool cold) {
+    PixelConverter converter;
+    if (converter.SetFormat(format) != B_OK) return;
+
+    SnapshotPool pool;
+    if (pool.Init(width, height, 1) != B_OK) return;
+
+    bigtime_t time[2] = {0, 0};
+    for (int32 i = 0; i < frames; i++) {
+        // Alternate, so neither path gets the warmer machine
+        for (int32 stream = 0; stream < 2; stream++) {
+            pool.SetStreamLoads(stream);
+            if (cold) Flush(bits, (size_t) stride * height);
+
+            FrameSnapshot *snapshot = pool.Capture(bits, stride, converter);
+            if (!snapshot) continue;
+            time[stream] += snapshot->copyTime;
+            pool.Release(snapshot);
+        }
+    }
+
+    double megabytes = (double) stride * height * frames / (1024 * 1024);
+    printf("%-22s %5dx%-5d  plain %7.0f us/frame %6.0f MB/s   streaming %7.0f us/frame %6.0f MB/s\n", name,
+           (int) width, (int) height, (double) time[0] / frames, megabytes / (time[0] / 1e6),
+           (double) time[1] / frames, megabytes / (time[1] / 1e6));
+}
+
+static void
+RunMemory(int32 width, int32 height, int32 frames) {
+    std::vector<uint8> frame((size_t) width * 4 * height);
+    FillRandom(frame.data(), frame.size(), 11);
+
+    Compare("memory, cached", frame.data(), width * 4, width, height, B_RGB32, frames, false);
+    Compare("memory, flushed", frame.data(), width * 4, width, height, B_RGB32, frames, true);
+}
+
+// A Linux framebuffer device. Its mapping is usually write-combined, which is
+// what the streaming loads are for.
+static void
+RunFramebuffer(const char *path, int32 frames) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return;
+    }
+
+    struct fb_var_screeninfo var;
+    struct fb_fix_screeninfo fix;
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &var) != 0 || ioctl(fd, FBIOGET_FSCREENINFO, &fix) != 0) {
+        perror("FBIOGET_*SCREENINFO");
+        close(fd);
+        return;
+    }
+
+    color_space format = var.bits_per_pixel == 32 ? B_RGB32
+                         : var.bits_per_pixel == 24 ? B_RGB24
+                         : var.bits_per_pixel == 16 ? (var.green.length == 6 ? B_RGB16 : B_RGB15)
+                                                    : B_NO_COLOR_SPACE;
+
+    size_t size = (size_t) fix.line_length * var.yres;
+    void *bits = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bits == MAP_FAILED) {
+        perror("mmap");
+        return;
+    }
+
+    Compare(path, (const uint8 *) bits, fix.line_length, var.xres, var.yres, format, frames, false);
+    munmap(bits, size);
+}
+
+int
+main(int argc, char **argv) {
+    int32 frames = argc > 1 ? atoi(argv[1]) : 50;
+    if (frames < 1) frames = 1;
+
+    if (!CpuFeatures::Has(CpuFeatures::SSE41)) printf("No SSE4.1, both columns use plain loads\n");
+
+    RunMemory(1920, 1080, frames);
+    RunMemory(3840, 2160, frames / 4 + 1);
+
+    // Write-combined memory needs a device, e.g. /dev/fb0
+    if (argc > 2) RunFramebuffer(argv[2], frames);
+    else printf("Pass a framebuffer device (e.g. /dev/fb0) to measure write-combined memory\n");
+    return 0;
+}
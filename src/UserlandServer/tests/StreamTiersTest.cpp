@@ -0,0 +1,189 @@
+/*
+ * StreamTiersTest.cpp
+ * Which tier a client's bandwidth puts it in, with the margin against
+ * flipping back and forth, the keyframe wait a move costs, and the bitrate
+ * and size each tier is encoded at. The stream's own size fitted into a
+ * client's view.
+ */
+#include "ClientStream.h"
+#include "StreamTiers.h"
+#include "TestUtils.h"
+#include <math.h>
+
+static void
+TestTierFor() {
+    // Down as soon as a tier's minimum isn't met, straight past several
+    CHECK_EQUAL(StreamTierFor(2000, 0), 0);
+    CHECK_EQUAL(StreamTierFor(1999, 0), 1);
+    CHECK_EQUAL(StreamTierFor(799, 0), 2);
+    CHECK_EQUAL(StreamTierFor(799, 1), 2);
+    CHECK_EQUAL(StreamTierFor(0, 0), 2);
+
+    // Up only with 25% over the better tier's minimum
+    CHECK_EQUAL(StreamTierFor(2499, 1), 1);
+    CHECK_EQUAL(StreamTierFor(2500, 1), 0);
+    CHECK_EQUAL(StreamTierFor(999, 2), 2);
+    CHECK_EQUAL(StreamTierFor(1000, 2), 1);
+    CHECK_EQUAL(StreamTierFor(2500, 2), 0);
+    CHECK_EQUAL(StreamTierFor(100000, 2), 0);
+
+    for (int32 kbps = 0; kbps <= 10000; kbps += 10) {
+        for (int32 current = 0; current < kStreamTierCount; current++) {
+            int32 tier = StreamTierFor(kbps, current);
+            // Never a tier the client can't carry, and asking again with the
+            // answer doesn't move it
+            CHECK(tier == kStreamTierCount - 1 || kbps >= kStreamTiers[tier].minKbps);
+            CHECK_EQUAL(StreamTierFor(kbps, tier), tier);
+        }
+    }
+}
+
+static void
+TestTierKbps() {
+    CHECK_EQUAL(StreamTierKbps(0, 500), 2000);
+    CHECK_EQUAL(StreamTierKbps(0, 3000), 3000);
+    CHECK_EQUAL(StreamTierKbps(0, 20000), 8000);
+    CHECK_EQUAL(StreamTierKbps(1, 2400), 2000);
+    CHECK_EQUAL(StreamTierKbps(2, 300), 300);
+}
+
+static void
+TestTierSize() {
+    int32 width, height;
+    StreamTierSize(0, 1921, 1081, width, height);
+    CHECK_EQUAL(width, 1921);
+    CHECK_EQUAL(height, 1081);
+
+    StreamTierSize(1, 1920, 1080, width, height);
+    CHECK_EQUAL(width, 1440);
+    CHECK_EQUAL(height, 810);
+    StreamTierSize(2, 1921, 1081, width, height);
+    CHECK_EQUAL(width, 960);
+    CHECK_EQUAL(height, 540);
+
+    // Scaled tiers are even and at least 16 pixels
+    StreamTierSize(1, 1366, 767, width, height);
+    CHECK_EQUAL(width, 1024);
+    CHECK_EQUAL(height, 574);
+    StreamTierSize(2, 30, 20, width, height);
+    CHECK_EQUAL(width, 16);
+    CHECK_EQUAL(height, 16);
+}
+
+static void
+CheckStreamSize(int32 width, int32 height, int32 viewWidth, int32 viewHeight, int32 expectedWidth,
+                int32 expectedHeight) {
+    int32 streamWidth, streamHeight;
+    StreamSizeFor(width, height, viewWidth, viewHeight, streamWidth, streamHeight);
+    if (streamWidth != expectedWidth || streamHeight != expectedHeight) {
+        fprintf(stderr, "%dx%d in %dx%d: %dx%d, expected %dx%d\n", (int) width, (int) height, (int) viewWidth,
+                (int) viewHeight, (int) streamWidth, (int) streamHeight, (int) expectedWidth, (int) expectedHeight);
+    }
+    CHECK_EQUAL(streamWidth, expectedWidth);
+    CHECK_EQUAL(streamHeight, expectedHeight);
+}
+
+static void
+TestStreamSize() {
+    // No view yet, or one the screen fits into: the screen's size, never
+    // scaled up
+    CheckStreamSize(1920, 1080, 0, 0, 1920, 1080);
+    CheckStreamSize(1920, 1080, 1280, 0, 1920, 1080);
+    CheckStreamSize(1920, 1080, 1920, 1080, 1920, 1080);
+    CheckStreamSize(1920, 1080, 3840, 2160, 1920, 1080);
+    CheckStreamSize(1920, 1080, 2560, 900, 1600, 900);
+
+    // The narrower side of the view decides, the aspect ratio stays
+    CheckStreamSize(1920, 1080, 1280, 1024, 1280, 720);
+    CheckStreamSize(1920, 1080, 1920, 720, 1280, 720);
+    CheckStreamSize(2560, 1440, 1366, 768, 1364, 768);
+    CheckStreamSize(1920, 1200, 390, 844, 390, 242);
+
+    // Even on every path, an odd screen mode and odd views included
+    CheckStreamSize(1921, 1081, 0, 0, 1920, 1080);
+    CheckStreamSize(1920, 1080, 1001, 2000, 1000, 562);
+    CheckStreamSize(1366, 768, 683, 1000, 682, 384);
+
+    // At least 16 pixels, however small the view
+    CheckStreamSize(1920, 1080, 20, 20, 20, 16);
+    CheckStreamSize(1920, 1080, 1, 1, 16, 16);
+
+    // Whatever the view, the fit is inside it (once it is 16 or more), even,
+    // and no bigger than the screen. The side scaled to match the other is
+    // off by less than the flooring and evening, 2 pixels.
+    uint32 state = 7;
+    for (int32 i = 0; i < 10000; i++) {
+        int32 width = 16 + NextRandom(state) % 4000, height = 16 + NextRandom(state) % 3000;
+        int32 viewWidth = 16 + NextRandom(state) % 4000, viewHeight = 16 + NextRandom(state) % 3000;
+        int32 streamWidth, streamHeight;
+        StreamSizeFor(width, height, viewWidth, viewHeight, streamWidth, streamHeight);
+
+        CHECK(streamWidth % 2 == 0 && streamHeight % 2 == 0);
+        CHECK(streamWidth >= 16 && streamHeight >= 16);
+        CHECK(streamWidth <= width && streamHeight <= height);
+        CHECK(streamWidth <= viewWidth && streamHeight <= viewHeight);
+        if (streamWidth > 16 && streamHeight > 16) {
+            double heightError = fabs((double) streamWidth * height / width - streamHeight);
+            double widthError = fabs((double) streamHeight * width / height - streamWidth);
+            CHECK(heightError < 2 || widthError < 2);
+        }
+    }
+}
+
+// A client moves between tiers on its bandwidth estimate. Every move waits
+// for a keyframe, the estimate wobbling near a boundary doesn't move it.
+static void
+TestMoves() {
+    ClientStream client;
+    client.Start(3);
+    CHECK_EQUAL(client.tier, 0);
+    CHECK(client.waitingForKeyframe);
+    client.waitingForKeyframe = false;
+
+    CHECK(!client.SetBitrate(2100));
+    CHECK_EQUAL(client.bitrate, 2100);
+    CHECK(!client.waitingForKeyframe);
+
+    CHECK(client.SetBitrate(1900));
+    CHECK_EQUAL(client.tier, 1);
+    CHECK(client.waitingForKeyframe);
+    client.waitingForKeyframe = false;
+
+    for (int32 i = 0; i < 10; i++) CHECK(!client.SetBitrate(i % 2 ? 1900 : 2400));
+    CHECK_EQUAL(client.tier, 1);
+    CHECK(!client.waitingForKeyframe);
+
+    // Congested pings all the way down, then clear ones back up: each tier
+    // is passed once per direction
+    int32 moves = 0, layers, kbps;
+    for (int32 ping = 0; ping < 40; ping++) {
+        client.AfterRoundTrip(400, 3, layers, kbps);
+        client.layers = layers;
+        moves += client.SetBitrate(kbps);
+    }
+    CHECK_EQUAL(client.tier, 2);
+    CHECK_EQUAL(client.bitrate, kMinClientKbps);
+    CHECK_EQUAL(moves, 1);
+
+    moves = 0;
+    for (int32 ping = 0; ping < 100; ping++) {
+        client.AfterRoundTrip(10, 3, layers, kbps);
+        client.layers = layers;
+        moves += client.SetBitrate(kbps);
+    }
+    CHECK_EQUAL(client.tier, 0);
+    CHECK_EQUAL(client.layers, 3);
+    CHECK_EQUAL(moves, 2);
+    CHECK(client.waitingForKeyframe);
+}
+
+int
+main() {
+    TestTierFor();
+    TestTierKbps();
+    TestTierSize();
+    TestMoves();
+    TestStreamSize();
+
+    return TestResult("StreamTiersTest");
+}
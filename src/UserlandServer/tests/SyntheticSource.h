@@ -0,0 +1,123 @@
+/*
+ * SyntheticSource.h
+ * A FrameSource drawing moving test content into an in-memory framebuffer
+ */
+#ifndef SYNTHETIC_SOURCE_H
+#define SYNTHETIC_SOURCE_H
+
+#include "FrameSnapshot.h"
+#include "FrameSource.h"
+#include "PixelConverter.h"
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+#include <vector>
+
+class SyntheticSource : public FrameSource {
+public:
+    // rowPadding extra bytes per row, like the framebuffers that have some
+    SyntheticSource(int32 width, int32 height, color_space format = B_RGB32, int32 rowPadding = 0)
+        : fWidth(width), fHeight(height), fStride(0), fFrame(0), fStatus(B_OK) {
+        fStatus = fConverter.SetFormat(format);
+        if (fStatus != B_OK) return;
+
+        fStride = width * fConverter.BytesPerPixel() + rowPadding;
+        fFramebuffer.assign((size_t) fStride * height, 0);
+        fStatus = fSnapshots.Init(width, height);
+        Draw(0);
+    }
+
+    status_t InitCheck() const { return fStatus; }
+
+    virtual int32 Width() const { return fWidth; }
+    virtual int32 Height() const { return fHeight; }
+
+    virtual bool IsConnected() const { return fStatus == B_OK; }
+
+    virtual FrameSnapshot *Snapshot() {
+        if (fStatus != B_OK) return nullptr;
+        return fSnapshots.Capture(fFramebuffer.data(), fStride, fConverter);
+    }
+
+    virtual void ReleaseSnapshot(FrameSnapshot *snapshot) { fSnapshots.Release(snapshot); }
+
+    virtual void SetReportStats(bool report) { fSnapshots.SetReportStats(report); }
+
+    void SetStreamLoads(bool enabled) { fSnapshots.SetStreamLoads(enabled); }
+
+    // Draws the next frame: a static gradient, a band of text-like stripes
+    // scrolling up a line per frame and a box moving across
+    void Advance() { Draw(++fFrame); }
+
+    void Draw(int32 frame) {
+        fFrame = frame;
+        int32 boxX = (frame * 8) % (fWidth > 64 ? fWidth - 64 : 1);
+        int32 boxY = fHeight / 3;
+        for (int32 y = 0; y < fHeight; y++) {
+            uint8 *row = fFramebuffer.data() + (size_t) y * fStride;
+            for (int32 x = 0; x < fWidth; x++) {
+                uint8 b = (uint8) x, g = (uint8) y, r = (uint8) (x + y);
+                if (y >= fHeight / 2 && x < fWidth / 2 && ((y + frame) % 16) < 10 && (x % 8) < 5) {
+                    // Scrolling "text"
+                    b = g = r = 20;
+                } else if (x >= boxX && x < boxX + 64 && y >= boxY && y < boxY + 64) {
+                    b = 200;
+                    g = 40;
+                    r = (uint8) frame;
+                }
+                _Store(row, x, b, g, r);
+            }
+        }
+    }
+
+    const uint8 *Bits() const { return fFramebuffer.data(); }
+    int32 Stride() const { return fStride; }
+    int32 Frame() const { return fFrame; }
+
+    const PixelConverter &Converter() const { return fConverter; }
+
+private:
+    int32 fWidth;
+    int32 fHeight;
+    int32 fStride;
+    int32 fFrame;
+    status_t fStatus;
+
+    std::vector<uint8> fFramebuffer;
+    PixelConverter fConverter;
+    SnapshotPool fSnapshots;
+
+    void _Store(uint8 *row, int32 x, uint8 b, uint8 g, uint8 r) {
+        switch (fConverter.Format()) {
+            case B_RGB24:
+                row[x * 3] = b;
+                row[x * 3 + 1] = g;
+                row[x * 3 + 2] = r;
+                break;
+            case B_RGB16: {
+                uint16 p = (uint16) (((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+                row[x * 2] = (uint8) p;
+                row[x * 2 + 1] = (uint8) (p >> 8);
+                break;
+            }
+            case B_RGB15:
+            case B_RGBA15: {
+                uint16 p = (uint16) (0x8000 | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3));
+                row[x * 2] = (uint8) p;
+                row[x * 2 + 1] = (uint8) (p >> 8);
+                break;
+            }
+            case B_CMAP8:
+            case B_GRAY8:
+                row[x] = (uint8) ((b + g + r) / 3);
+                break;
+            default:
+                row[x * 4] = b;
+                row[x * 4 + 1] = g;
+                row[x * 4 + 2] = r;
+                row[x * 4 + 3] = 255;
+                break;
+        }
+    }
+};
+
+#endif // SYNTHETIC_SOURCE_H
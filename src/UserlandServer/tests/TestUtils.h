@@ -0,0 +1,68 @@
+/*
+ * TestUtils.h
+ * Checks for the unit tests and timing for the benchmarks
+ */
+#ifndef TEST_UTILS_H
+#define TEST_UTILS_H
+
+#include <SupportDefs.h>
+#include <stdio.h>
+#include <time.h>
+
+static int32 sFailures = 0;
+
+// Reports and counts a failed check, the test keeps going
+#define CHECK(condition)                                                           \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            sFailures++;                                                           \
+        }                                                                          \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected)                                              \
+    do {                                                                           \
+        long long _actual = (long long) (actual);                                  \
+        long long _expected = (long long) (expected);                              \
+        if (_actual != _expected) {                                                \
+            fprintf(stderr, "%s:%d: CHECK_EQUAL failed: %s is %lld, expected %lld\n", __FILE__, __LINE__, \
+                    #actual, _actual, _expected);                                  \
+            sFailures++;                                                           \
+        }                                                                          \
+    } while (0)
+
+// Exit code for main()
+static inline int
+TestResult(const char *name) {
+    if (sFailures == 0) {
+        printf("%s: all checks passed\n", name);
+        return 0;
+    }
+    printf("%s: %d checks failed\n", name, (int) sFailures);
+    return 1;
+}
+
+// Deterministic noise, so failures reproduce
+static inline uint32
+NextRandom(uint32 &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static inline void
+FillRandom(uint8 *data, size_t size, uint32 seed) {
+    uint32 state = seed ? seed : 1;
+    for (size_t i = 0; i < size; i++) data[i] = (uint8) NextRandom(state);
+}
+
+// Monotonic wall time in microseconds
+static inline bigtime_t
+BenchTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (bigtime_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+#endif // TEST_UTILS_H
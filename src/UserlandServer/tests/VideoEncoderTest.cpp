@@ -0,0 +1,310 @@
+/*
+ * VideoEncoderTest.cpp
+ * VideoEncoder against a fake backend: codec lookup, the frames it hands
+ * out, output spans passed on without a copy, layers, resizing in place or
+ * not at all, frames converted again only where the picture changed, and
+ * which refinement frames are coded losslessly
+ */
+#include "VideoEncoder.h"
+#include "TemporalLayers.h"
+#include "TestUtils.h"
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+// Encodes nothing, but answers like a codec library: several spans per frame
+// in buffers of its own, a temporal layer pattern, and optionally a resize
+class FakeBackend : public EncoderBackend {
+public:
+    FakeBackend(int32 layers, bool resizable)
+        : fLayers(layers), fResizable(resizable), fWidth(0), fHeight(0), fBitrate(0), fFrameRate(0), fFrames(0),
+          fSinceKey(0) {
+        sLast = this;
+    }
+
+    virtual status_t Init(int32 width, int32 height, int32 bitrateKbps, bool /* fullChroma */,
+                          const EncoderProfile & /* profile */) {
+        if (width <= 0 || height <= 0) return B_BAD_VALUE;
+        fWidth = width;
+        fHeight = height;
+        fBitrate = bitrateKbps;
+        return B_OK;
+    }
+
+    virtual YUVLayout Layout() const { return YUV_I420; }
+    virtual void SetBitrate(int32 kbps) { fBitrate = kbps; }
+    virtual void SetFrameRate(int32 fps) { fFrameRate = fps; }
+
+    virtual status_t Resize(int32 width, int32 height) {
+        if (!fResizable) return B_NOT_SUPPORTED;
+        fWidth = width;
+        fHeight = height;
+        return B_OK;
+    }
+
+    virtual int32 CountLayers() const { return fLayers; }
+
+    virtual status_t Encode(const YUVFrame &frame, EncodedFrame &out) {
+        if (frame.forceKeyframe || fFrames == 0) fSinceKey = 0;
+        fFrames++;
+
+        // A header, the picture and a trailer, like the NALs of an x264 frame
+        fHeader.assign(8, 1);
+        fPicture.assign(1000 + fFrames, frame.planes.plane[0][0]);
+        fTrailer.assign(3, 2);
+        fSpans[0] = {fHeader.data(), fHeader.size()};
+        fSpans[1] = {fPicture.data(), fPicture.size()};
+        fSpans[2] = {fTrailer.data(), fTrailer.size()};
+
+        out.spans = fSpans;
+        out.count = 3;
+        out.size = fHeader.size() + fPicture.size() + fTrailer.size();
+        out.isKey = fSinceKey == 0;
+        out.layer = fLayers > 1 ? LayerOfFrame(fSinceKey) : 0;
+        out.psnr = 0;
+        fSinceKey++;
+        return B_OK;
+    }
+
+    int32 fLayers;
+    bool fResizable;
+    int32 fWidth, fHeight;
+    int32 fBitrate;
+    int32 fFrameRate;
+    int32 fFrames;
+    int64 fSinceKey;
+    std::vector<uint8> fHeader, fPicture, fTrailer;
+    EncodedSpan fSpans[3];
+
+    static FakeBackend *sLast;
+};
+
+FakeBackend *FakeBackend::sLast = nullptr;
+
+// The backends this test has, in place of EncoderBackend.cpp and the codec
+// libraries
+EncoderBackend *
+EncoderBackend::Create(const char *codec) {
+    if (strcmp(codec, "fake") == 0) return new FakeBackend(1, false);
+    if (strcmp(codec, "fake-layers") == 0) return new FakeBackend(3, true);
+    return nullptr;
+}
+
+int32
+EncoderBackend::CountCodecs() {
+    return 2;
+}
+
+const char *
+EncoderBackend::CodecAt(int32 index) {
+    return index == 0 ? "fake" : "fake-layers";
+}
+
+bool
+EncoderBackend::HasCodec(const char *codec) {
+    return strcmp(codec, "fake") == 0 || strcmp(codec, "fake-layers") == 0;
+}
+
+int32
+EncoderBackend::ThreadsFor(int32 /* width */, int32 /* height */) {
+    return 1;
+}
+
+int32
+EncoderBackend::TileColumnsFor(int32 /* width */, int32 /* threads */) {
+    return 0;
+}
+
+void
+EncoderBackend::SetThreadLimit(int32 /* threads */) {}
+
+void
+EncoderBackend::SetMeasureQuality(bool /* measure */) {}
+
+bool
+EncoderBackend::MeasureQuality() {
+    return false;
+}
+
+static void
+CheckFrames(VideoEncoder &encoder, int32 width, int32 height) {
+    CHECK_EQUAL(encoder.Width(), width);
+    CHECK_EQUAL(encoder.Height(), height);
+    CHECK_EQUAL(encoder.CountFrames(), VideoEncoder::kFrameCount);
+    CHECK_EQUAL(encoder.BlockColumns(), (width + 15) / 16);
+    CHECK_EQUAL(encoder.BlockRows(), (height + 15) / 16);
+
+    for (int32 i = 0; i < encoder.CountFrames(); i++) {
+        YUVFrame *frame = encoder.FrameAt(i);
+        CHECK_EQUAL(frame->planes.layout, YUV_I420);
+        CHECK(frame->planes.stride[0] >= width);
+        CHECK(frame->planes.stride[1] >= (width + 1) / 2);
+        for (int32 p = 0; p < 3; p++) CHECK(frame->planes.plane[p] && (uintptr_t) frame->planes.plane[p] % 64 == 0);
+
+        // Until the caller keeps track, every block counts as changed
+        int32 blocks = encoder.BlockColumns() * encoder.BlockRows(), changed = 0;
+        for (int32 b = 0; b < blocks; b++) changed += frame->changedBlocks[b] != 0;
+        CHECK_EQUAL(changed, blocks);
+    }
+}
+
+static void
+TestInit() {
+    VideoEncoder encoder(nullptr);
+    CHECK_EQUAL(encoder.Init(640, 480, 2000, "none"), B_ERROR);
+    CHECK_EQUAL(encoder.CountFrames(), 0);
+    CHECK_EQUAL(encoder.CountLayers(), 1);
+    EncodedFrame out;
+    CHECK_EQUAL(encoder.Encode(encoder.FrameAt(0), out), B_NO_INIT);
+    CHECK_EQUAL(encoder.Resize(320, 240), B_NO_INIT);
+
+    // The frame rate is kept for the backends of later Init()s
+    encoder.SetFrameRate(60);
+    CHECK_EQUAL(encoder.Init(0, 480, 2000, "fake"), B_BAD_VALUE);
+    CHECK_EQUAL(encoder.CountFrames(), 0);
+
+    CHECK_EQUAL(encoder.Init(641, 481, 1500, "fake"), B_OK);
+    CHECK_EQUAL(strcmp(encoder.GetCodecName(), "fake"), 0);
+    CHECK_EQUAL(strcmp(encoder.ProfileName(), kDefaultEncoderProfile), 0);
+    CHECK_EQUAL(FakeBackend::sLast->fFrameRate, 60);
+    CHECK_EQUAL(FakeBackend::sLast->fBitrate, 1500);
+    CHECK_EQUAL(encoder.CountLayers(), 1);
+    CheckFrames(encoder, 641, 481);
+
+    encoder.SetBitrate(900);
+    CHECK_EQUAL(FakeBackend::sLast->fBitrate, 900);
+    encoder.SetFrameRate(30);
+    CHECK_EQUAL(FakeBackend::sLast->fFrameRate, 30);
+}
+
+// The spans are the backend's own buffers, passed on as they are
+static void
+TestEncode() {
+    VideoEncoder encoder(nullptr);
+    CHECK_EQUAL(encoder.Init(320, 240, 2000, "fake-layers"), B_OK);
+    CHECK_EQUAL(encoder.CountLayers(), 3);
+    FakeBackend *backend = FakeBackend::sLast;
+
+    for (int32 index = 0; index < 12; index++) {
+        YUVFrame *frame = encoder.FrameAt(index % encoder.CountFrames());
+        frame->planes.plane[0][0] = (uint8) index;
+        frame->forceKeyframe = index == 8;
+
+        EncodedFrame out;
+        CHECK_EQUAL(encoder.Encode(frame, out), B_OK);
+        CHECK_EQUAL(out.count, 3);
+        CHECK(out.spans == backend->fSpans);
+        CHECK(out.spans[0].data == backend->fHeader.data());
+        CHECK(out.spans[1].data == backend->fPicture.data());
+        CHECK(out.spans[2].data == backend->fTrailer.data());
+        CHECK_EQUAL(out.size, out.spans[0].size + out.spans[1].size + out.spans[2].size);
+        CHECK_EQUAL(out.spans[1].data[0], index);
+
+        // Keyframes in the base layer, the pattern starting over from them
+        CHECK_EQUAL(out.isKey, index == 0 || index == 8);
+        CHECK_EQUAL(out.layer, LayerOfFrame(index < 8 ? index : index - 8));
+    }
+}
+
+static void
+TestResize() {
+    // In place: the same backend, new frames
+    VideoEncoder encoder(nullptr);
+    CHECK_EQUAL(encoder.Init(1920, 1080, 2000, "fake-layers"), B_OK);
+    FakeBackend *backend = FakeBackend::sLast;
+    EncodedFrame out;
+    CHECK_EQUAL(encoder.Encode(encoder.FrameAt(0), out), B_OK);
+
+    CHECK_EQUAL(encoder.Resize(1920, 1080), B_OK);
+    CHECK_EQUAL(encoder.Resize(1366, 768), B_OK);
+    CHECK(FakeBackend::sLast == backend);
+    CHECK_EQUAL(backend->fWidth, 1366);
+    CHECK_EQUAL(backend->fHeight, 768);
+    CheckFrames(encoder, 1366, 768);
+    CHECK_EQUAL(encoder.Encode(encoder.FrameAt(0), out), B_OK);
+    CHECK_EQUAL(backend->fFrames, 2);
+    CHECK(!out.isKey);
+
+    // A codec that can't leaves everything as it was, for the caller to
+    // Init() again
+    CHECK_EQUAL(encoder.Init(1920, 1080, 2000, "fake"), B_OK);
+    CHECK_EQUAL(encoder.Resize(1280, 720), B_NOT_SUPPORTED);
+    CheckFrames(encoder, 1920, 1080);
+    CHECK_EQUAL(encoder.Encode(encoder.FrameAt(0), out), B_OK);
+}
+
+// Frames keep their pixels between uses: converting a few rects of a new
+// picture only touches those, grown to whole chroma samples
+static void
+TestConvertRects() {
+    const int32 width = 333, height = 201, stride = width * 4 + 16;
+    std::vector<uint8> before((size_t) stride * height), after((size_t) stride * height);
+    FillRandom(before.data(), before.size(), 1);
+    FillRandom(after.data(), after.size(), 2);
+
+    VideoEncoder encoder(nullptr), full(nullptr);
+    CHECK_EQUAL(encoder.Init(width, height, 2000, "fake"), B_OK);
+    CHECK_EQUAL(full.Init(width, height, 2000, "fake"), B_OK);
+    YUVFrame *frame = encoder.FrameAt(1);
+    encoder.Convert(before.data(), stride, frame);
+    full.Convert(before.data(), stride, full.FrameAt(0));
+    full.Convert(after.data(), stride, full.FrameAt(1));
+
+    const clipping_rect rects[] = {{5, 3, 40, 20}, {300, 150, 332, 200}, {101, 101, 101, 101}};
+    encoder.Convert(after.data(), stride, frame, rects, 3);
+
+    // Luma: the new picture inside the rects grown to even bounds, the old
+    // one everywhere else
+    int32 wrong = 0;
+    for (int32 y = 0; y < height; y++) {
+        for (int32 x = 0; x < width; x++) {
+            bool inside = false;
+            for (const clipping_rect &rect : rects) {
+                inside |= x >= (rect.left & ~1) && x <= (rect.right | 1) && y >= (rect.top & ~1) &&
+                          y <= (rect.bottom | 1);
+            }
+            const YUVPlanes &expected = full.FrameAt(inside ? 1 : 0)->planes;
+            wrong += frame->planes.plane[0][y * frame->planes.stride[0] + x] !=
+                     expected.plane[0][y * expected.stride[0] + x];
+        }
+    }
+    CHECK_EQUAL(wrong, 0);
+}
+
+// Only the last refinement step, over a known area of up to a sixteenth of
+// the picture
+static void
+TestLosslessRefine() {
+    const int32 width = 1366, height = 768; // 86 x 48 blocks, partly cut off
+    const int32 blocks = 86 * 48;
+    std::vector<uint8> changed(blocks, 0);
+    YUVFrame frame = {};
+    frame.changedBlocks = changed.data();
+
+    for (int32 step = 0; step <= kRefineSteps; step++) {
+        frame.refine = step;
+        changed[100] = 1;
+        CHECK_EQUAL(IsLosslessRefine(frame, width, height), step == kRefineSteps);
+    }
+
+    std::fill(changed.begin(), changed.end(), 0);
+    CHECK(!IsLosslessRefine(frame, width, height));
+    std::fill(changed.end() - blocks / kLosslessRefineShare, changed.end(), 1);
+    CHECK(IsLosslessRefine(frame, width, height));
+    changed[0] = 1;
+    CHECK(!IsLosslessRefine(frame, width, height));
+
+    frame.changedBlocks = nullptr;
+    CHECK(!IsLosslessRefine(frame, width, height));
+}
+
+int
+main() {
+    TestInit();
+    TestEncode();
+    TestResize();
+    TestConvertRects();
+    TestLosslessRefine();
+
+    return TestResult("VideoEncoderTest");
+}
@@ -0,0 +1,83 @@
+/*
+ * WorkerPoolTest.cpp
+ * Every part runs once, on a thread index no other running part has
+ */
+#include "TestUtils.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <vector>
+
+struct CountJob {
+    std::vector<std::atomic<int32>> runs;
+    std::atomic<int32> busy[WorkerPool::kMaxThreads];
+    std::atomic<int32> collisions;
+    std::atomic<int32> badThreads;
+    int32 threads;
+
+    CountJob(int32 parts, int32 threads) : runs(parts), collisions(0), badThreads(0), threads(threads) {
+        for (auto &run : runs) run = 0;
+        for (auto &flag : busy) flag = 0;
+    }
+};
+
+static void
+CountPart(void *data, int32 part, int32 parts, int32 thread) {
+    CountJob &job = *(CountJob *) data;
+    if (thread < 0 || thread >= job.threads || parts != (int32) job.runs.size()) {
+        job.badThreads++;
+        return;
+    }
+
+    // Two parts on one thread index at once would share its scratch space
+    if (job.busy[thread].fetch_add(1) != 0) job.collisions++;
+    for (volatile int32 spin = 0; spin < 2000; spin++) {
+    }
+    job.runs[part]++;
+    job.busy[thread]--;
+}
+
+static void
+TestRun(int32 threads) {
+    WorkerPool workers;
+    CHECK_EQUAL(workers.Init(threads, "WorkerPoolTest"), B_OK);
+    CHECK_EQUAL(workers.CountThreads(), threads);
+
+    // Fewer parts than threads, as many, and many more; run after run
+    const int32 partCounts[] = {1, 2, threads, threads * 2 + 1, 97};
+    for (int32 round = 0; round < 50; round++) {
+        for (int32 parts : partCounts) {
+            CountJob job(parts, threads);
+            workers.Run(CountPart, &job, parts);
+
+            int32 wrong = 0;
+            for (auto &run : job.runs) wrong += run != 1;
+            CHECK_EQUAL(wrong, 0);
+            CHECK_EQUAL(job.collisions.load(), 0);
+            CHECK_EQUAL(job.badThreads.load(), 0);
+        }
+    }
+
+    // No parts is a no-op
+    CountJob empty(0, threads);
+    workers.Run(CountPart, &empty, 0);
+    CHECK_EQUAL(empty.badThreads.load(), 0);
+}
+
+int
+main() {
+    TestRun(1);
+    TestRun(2);
+    TestRun(5);
+    TestRun(WorkerPool::kMaxThreads);
+
+    // More than the limit are capped, 0 means one per CPU
+    WorkerPool workers;
+    CHECK_EQUAL(workers.Init(WorkerPool::kMaxThreads + 10), B_OK);
+    CHECK_EQUAL(workers.CountThreads(), WorkerPool::kMaxThreads);
+    CHECK_EQUAL(workers.Init(0), B_OK);
+    CHECK(workers.CountThreads() >= 1);
+    workers.Shutdown();
+    CHECK_EQUAL(workers.CountThreads(), 1);
+
+    return TestResult("WorkerPoolTest");
+}
@@ -0,0 +1,47 @@
+/*
+ * GraphicsDefs.h
+ * Test shim: color spaces and the system palette
+ */
+#ifndef _GRAPHICS_DEFS_H
+#define _GRAPHICS_DEFS_H
+
+#include <SupportDefs.h>
+
+// Values as in Haiku, recordings store them
+enum color_space {
+    B_NO_COLOR_SPACE = 0x0000,
+    B_RGB32 = 0x0008,
+    B_RGBA32 = 0x2008,
+    B_RGB24 = 0x0003,
+    B_RGB16 = 0x0005,
+    B_RGB15 = 0x0010,
+    B_RGBA15 = 0x2010,
+    B_CMAP8 = 0x0004,
+    B_GRAY8 = 0x0002
+};
+
+struct rgb_color {
+    uint8 red;
+    uint8 green;
+    uint8 blue;
+    uint8 alpha;
+};
+
+struct color_map {
+    int32 id;
+    rgb_color color_list[256];
+    uint8 inversion_map[256];
+    uint8 index_map[32768];
+};
+
+// A fixed palette where every entry differs, so lookups can be checked
+const color_map *system_colors();
+
+struct clipping_rect {
+    int32 left;
+    int32 top;
+    int32 right;
+    int32 bottom;
+};
+
+#endif // _GRAPHICS_DEFS_H
@@ -0,0 +1,10 @@
+/*
+ * InterfaceDefs.h
+ * Test shim: only system_colors() is used, see GraphicsDefs.h
+ */
+#ifndef _INTERFACE_DEFS_H
+#define _INTERFACE_DEFS_H
+
+#include <GraphicsDefs.h>
+
+#endif // _INTERFACE_DEFS_H
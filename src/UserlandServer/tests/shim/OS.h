@@ -0,0 +1,57 @@
+/*
+ * OS.h
+ * Test shim: the kernel kit calls the server code makes, on POSIX
+ */
+#ifndef _OS_H
+#define _OS_H
+
+#include <SupportDefs.h>
+
+// Microseconds since an arbitrary point, monotonic
+bigtime_t system_time();
+
+status_t snooze(bigtime_t amount);
+
+// Threads, created suspended like on Haiku. The priority is ignored.
+typedef int32 thread_id;
+typedef status_t (*thread_func)(void *data);
+
+#define B_NORMAL_PRIORITY 10
+#define B_DISPLAY_PRIORITY 15
+#define B_BAD_THREAD_ID (INT32_MIN + 0x1000 + 2)
+
+thread_id spawn_thread(thread_func function, const char *name, int32 priority, void *data);
+status_t resume_thread(thread_id thread);
+status_t wait_for_thread(thread_id thread, status_t *exitValue);
+
+// Counting semaphores. Deleting one wakes its waiters with B_BAD_SEM_ID.
+typedef int32 sem_id;
+
+#define B_BAD_SEM_ID (INT32_MIN + 0x1000 + 1)
+
+sem_id create_sem(int32 count, const char *name);
+status_t delete_sem(sem_id sem);
+status_t acquire_sem(sem_id sem);
+status_t release_sem(sem_id sem);
+status_t release_sem_etc(sem_id sem, int32 count, uint32 flags);
+
+// Areas are anonymous mappings, the lock and address specs are ignored
+typedef int32 area_id;
+
+#define B_PAGE_SIZE 4096
+#define B_ANY_ADDRESS 1
+#define B_NO_LOCK 0
+#define B_READ_AREA 1
+#define B_WRITE_AREA 2
+
+area_id create_area(const char *name, void **address, uint32 addressSpec, size_t size, uint32 lock,
+                    uint32 protection);
+status_t delete_area(area_id area);
+
+typedef struct {
+    uint32 cpu_count;
+} system_info;
+
+status_t get_system_info(system_info *info);
+
+#endif // _OS_H
@@ -0,0 +1,225 @@
+/*
+ * Shim.cpp
+ * POSIX implementations of the shimmed Haiku calls
+ */
+#include <GraphicsDefs.h>
+#include <OS.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <sys/mman.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+bigtime_t
+system_time() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (bigtime_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+status_t
+snooze(bigtime_t amount) {
+    if (amount > 0) usleep((useconds_t) amount);
+    return B_OK;
+}
+
+// Threads wait for resume_thread() before calling their function
+struct Thread {
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable resumed;
+    bool running = false;
+    status_t exitValue = B_OK;
+};
+
+struct Semaphore {
+    std::mutex lock;
+    std::condition_variable released;
+    int32 count = 0;
+    bool deleted = false;
+};
+
+static std::mutex sTableLock;
+static std::map<thread_id, Thread *> sThreads;
+static std::map<sem_id, Semaphore *> sSemaphores;
+static int32 sNextId = 1;
+
+static Thread *
+FindThread(thread_id id) {
+    std::lock_guard<std::mutex> guard(sTableLock);
+    auto found = sThreads.find(id);
+    return found != sThreads.end() ? found->second : nullptr;
+}
+
+static Semaphore *
+FindSemaphore(sem_id id) {
+    std::lock_guard<std::mutex> guard(sTableLock);
+    auto found = sSemaphores.find(id);
+    return found != sSemaphores.end() ? found->second : nullptr;
+}
+
+thread_id
+spawn_thread(thread_func function, const char * /* name */, int32 /* priority */, void *data) {
+    Thread *thread = new Thread;
+    thread->thread = std::thread([thread, function, data]() {
+        {
+            std::unique_lock<std::mutex> guard(thread->lock);
+            thread->resumed.wait(guard, [thread]() { return thread->running; });
+        }
+        thread->exitValue = function(data);
+    });
+
+    std::lock_guard<std::mutex> guard(sTableLock);
+    thread_id id = sNextId++;
+    sThreads[id] = thread;
+    return id;
+}
+
+status_t
+resume_thread(thread_id id) {
+    Thread *thread = FindThread(id);
+    if (!thread) return B_BAD_THREAD_ID;
+
+    std::lock_guard<std::mutex> guard(thread->lock);
+    thread->running = true;
+    thread->resumed.notify_one();
+    return B_OK;
+}
+
+status_t
+wait_for_thread(thread_id id, status_t *exitValue) {
+    Thread *thread = FindThread(id);
+    if (!thread) return B_BAD_THREAD_ID;
+
+    // Never resumed threads run now, as on Haiku
+    resume_thread(id);
+    thread->thread.join();
+    if (exitValue) *exitValue = thread->exitValue;
+
+    std::lock_guard<std::mutex> guard(sTableLock);
+    sThreads.erase(id);
+    delete thread;
+    return B_OK;
+}
+
+sem_id
+create_sem(int32 count, const char * /* name */) {
+    if (count < 0) return B_BAD_VALUE;
+
+    Semaphore *sem = new Semaphore;
+    sem->count = count;
+
+    std::lock_guard<std::mutex> guard(sTableLock);
+    sem_id id = sNextId++;
+    sSemaphores[id] = sem;
+    return id;
+}
+
+status_t
+delete_sem(sem_id id) {
+    Semaphore *sem;
+    {
+        std::lock_guard<std::mutex> guard(sTableLock);
+        auto found = sSemaphores.find(id);
+        if (found == sSemaphores.end()) return B_BAD_SEM_ID;
+        sem = found->second;
+        sSemaphores.erase(found);
+    }
+
+    // Never freed: a thread that just looked it up may still be about to
+    // wait on it. Tests create a handful.
+    std::lock_guard<std::mutex> guard(sem->lock);
+    sem->deleted = true;
+    sem->released.notify_all();
+    return B_OK;
+}
+
+status_t
+acquire_sem(sem_id id) {
+    Semaphore *sem = FindSemaphore(id);
+    if (!sem) return B_BAD_SEM_ID;
+
+    std::unique_lock<std::mutex> guard(sem->lock);
+    sem->released.wait(guard, [sem]() { return sem->count > 0 || sem->deleted; });
+    if (sem->deleted) return B_BAD_SEM_ID;
+
+    sem->count--;
+    return B_OK;
+}
+
+status_t
+release_sem_etc(sem_id id, int32 count, uint32 /* flags */) {
+    if (count < 1) return B_BAD_VALUE;
+
+    Semaphore *sem = FindSemaphore(id);
+    if (!sem) return B_BAD_SEM_ID;
+
+    std::lock_guard<std::mutex> guard(sem->lock);
+    sem->count += count;
+    sem->released.notify_all();
+    return B_OK;
+}
+
+status_t
+release_sem(sem_id id) {
+    return release_sem_etc(id, 1, 0);
+}
+
+struct Area {
+    void *address;
+    size_t size;
+};
+
+static std::map<area_id, Area> sAreas;
+
+area_id
+create_area(const char * /* name */, void **address, uint32 /* addressSpec */, size_t size, uint32 /* lock */,
+            uint32 protection) {
+    int prot = (protection & B_READ_AREA ? PROT_READ : 0) | (protection & B_WRITE_AREA ? PROT_WRITE : 0);
+    void *mapped = mmap(nullptr, size, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) return B_NO_MEMORY;
+
+    std::lock_guard<std::mutex> guard(sTableLock);
+    area_id id = sNextId++;
+    sAreas[id] = {mapped, size};
+    *address = mapped;
+    return id;
+}
+
+status_t
+delete_area(area_id id) {
+    std::lock_guard<std::mutex> guard(sTableLock);
+    auto found = sAreas.find(id);
+    if (found == sAreas.end()) return B_BAD_VALUE;
+    munmap(found->second.address, found->second.size);
+    sAreas.erase(found);
+    return B_OK;
+}
+
+status_t
+get_system_info(system_info *info) {
+    unsigned int count = std::thread::hardware_concurrency();
+    info->cpu_count = count > 0 ? count : 1;
+    return B_OK;
+}
+
+static color_map
+MakeSystemColors() {
+    color_map map = {};
+    // Odd multipliers walk every byte value once, so no two entries are equal
+    for (int32 i = 0; i < 256; i++) {
+        map.color_list[i].red = (uint8) (i * 7 + 3);
+        map.color_list[i].green = (uint8) (i * 13 + 101);
+        map.color_list[i].blue = (uint8) (i * 29 + 57);
+        map.color_list[i].alpha = 255;
+    }
+    return map;
+}
+
+const color_map *
+system_colors() {
+    static const color_map map = MakeSystemColors();
+    return &map;
+}
@@ -0,0 +1,25 @@
+/*
+ * String.h
+ * Test shim: the part of BString the server code uses
+ */
+#ifndef _B_STRING_H
+#define _B_STRING_H
+
+#include <string>
+
+class BString {
+public:
+    BString(const char *string = "") : fString(string ? string : "") {}
+
+    BString &operator=(const char *string) {
+        fString = string ? string : "";
+        return *this;
+    }
+
+    const char *String() const { return fString.c_str(); }
+
+private:
+    std::string fString;
+};
+
+#endif // _B_STRING_H
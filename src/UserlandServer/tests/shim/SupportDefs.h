@@ -0,0 +1,34 @@
+/*
+ * SupportDefs.h
+ * Test shim: the Haiku integer types and error codes the server code uses
+ */
+#ifndef _SUPPORT_DEFS_H
+#define _SUPPORT_DEFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+
+typedef int32 status_t;
+typedef int64 bigtime_t;
+
+// Negative and distinct like Haiku's, nothing here depends on the exact values
+#define B_OK ((status_t) 0)
+#define B_ERROR (-1)
+#define B_NO_MEMORY (INT32_MIN + 0)
+#define B_IO_ERROR (INT32_MIN + 1)
+#define B_BAD_VALUE (INT32_MIN + 5)
+#define B_NO_INIT (INT32_MIN + 13)
+#define B_NO_MORE_SEMS (INT32_MIN + 0x1001)
+#define B_NOT_SUPPORTED (INT32_MIN + 0x7009)
+
+#endif // _SUPPORT_DEFS_H